@@ -0,0 +1,845 @@
+#include <accelstruct.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace NRC
+{
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	VkDeviceAddress getBufferDeviceAddress(VkDevice device, VkBuffer buffer)
+	{
+		auto addressInfo = nvvk::make<VkBufferDeviceAddressInfo>();
+		addressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddress(device, &addressInfo);
+	}
+
+	void destroyAccelStruct(VkDevice device, AccelStruct& accelStruct)
+	{
+		vkDestroyAccelerationStructureKHR(device, accelStruct.handle, nullptr);
+		vkDestroyBuffer(device, accelStruct.buffer, nullptr);
+		vkFreeMemory(device, accelStruct.memory, nullptr);
+		accelStruct = AccelStruct{};
+	}
+
+	static BlasInput makeTriangleBlasInput(VkDeviceOrHostAddressConstKHR vertexData, uint32_t vertexCount,
+										   VkDeviceOrHostAddressConstKHR indexData, uint32_t indexCount)
+	{
+		// positions are tightly packed vec3 floats, as they come out of tinyobj
+		auto triangles = nvvk::make<VkAccelerationStructureGeometryTrianglesDataKHR>();
+		triangles.vertexFormat				= VK_FORMAT_R32G32B32_SFLOAT;
+		triangles.vertexData				= vertexData;
+		triangles.vertexStride				= 3 * sizeof(float);
+		triangles.maxVertex					= vertexCount - 1;
+		triangles.indexType					= VK_INDEX_TYPE_UINT32;
+		triangles.indexData					= indexData;
+		triangles.transformData.deviceAddress = 0;	// identity transform
+
+		auto geometry = nvvk::make<VkAccelerationStructureGeometryKHR>();
+		geometry.geometryType		= VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		geometry.geometry.triangles = triangles;
+		geometry.flags				= VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+		VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+		rangeInfo.primitiveCount	= indexCount / 3;
+		rangeInfo.primitiveOffset	= 0;
+		rangeInfo.firstVertex		= 0;
+		rangeInfo.transformOffset	= 0;
+
+		BlasInput input;
+		input.geometries.push_back(geometry);
+		input.rangeInfos.push_back(rangeInfo);
+		return input;
+	}
+
+	BlasInput makeTriangleBlasInput(VkDevice device,
+									VkBuffer vertexBuffer, uint32_t vertexCount,
+									VkBuffer indexBuffer, uint32_t indexCount)
+	{
+		VkDeviceOrHostAddressConstKHR vertexData{};
+		VkDeviceOrHostAddressConstKHR indexData{};
+		vertexData.deviceAddress	= getBufferDeviceAddress(device, vertexBuffer);
+		indexData.deviceAddress		= getBufferDeviceAddress(device, indexBuffer);
+		return makeTriangleBlasInput(vertexData, vertexCount, indexData, indexCount);
+	}
+
+	BlasInput makeTriangleBlasInput(const float* positions, uint32_t vertexCount,
+									const uint32_t* indices, uint32_t indexCount)
+	{
+		VkDeviceOrHostAddressConstKHR vertexData{};
+		VkDeviceOrHostAddressConstKHR indexData{};
+		vertexData.hostAddress	= positions;
+		indexData.hostAddress	= indices;
+		return makeTriangleBlasInput(vertexData, vertexCount, indexData, indexCount);
+	}
+
+	static VkAccelerationStructureBuildGeometryInfoKHR makeBlasBuildInfo(const BlasInput& input, VkBuildAccelerationStructureModeKHR mode)
+	{
+		auto buildInfo = nvvk::make<VkAccelerationStructureBuildGeometryInfoKHR>();
+		buildInfo.type			= VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+		buildInfo.mode			= mode;
+		buildInfo.flags			= input.flags;
+		buildInfo.geometryCount = uint32_t(input.geometries.size());
+		buildInfo.pGeometries	= input.geometries.data();
+		return buildInfo;
+	}
+
+	static VkAccelerationStructureBuildSizesInfoKHR getBlasBuildSizes(VkDevice device, VkAccelerationStructureBuildTypeKHR buildType,
+																	   const VkAccelerationStructureBuildGeometryInfoKHR& buildInfo, const BlasInput& input)
+	{
+		std::vector<uint32_t> maxPrimitiveCounts(input.rangeInfos.size());
+		for (size_t g = 0; g < input.rangeInfos.size(); g++)
+		{
+			maxPrimitiveCounts[g] = input.rangeInfos[g].primitiveCount;
+		}
+		auto sizeInfo = nvvk::make<VkAccelerationStructureBuildSizesInfoKHR>();
+		vkGetAccelerationStructureBuildSizesKHR(device, buildType, &buildInfo, maxPrimitiveCounts.data(), &sizeInfo);
+		return sizeInfo;
+	}
+
+	// Let threadCount threads (the caller included) work on a deferred operation until it completes
+	static VkResult joinDeferredOperation(VkDevice device, VkDeferredOperationKHR deferredOp, uint32_t threadCount)
+	{
+		const uint32_t maxConcurrency = vkGetDeferredOperationMaxConcurrencyKHR(device, deferredOp);
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		threadCount = std::max(1u, std::min(threadCount, maxConcurrency));
+
+		auto join = [device, deferredOp]()
+		{
+			for (;;)
+			{
+				const VkResult result = vkDeferredOperationJoinKHR(device, deferredOp);
+				if (result == VK_THREAD_IDLE_KHR)
+				{
+					// no work to pick up right now, but the operation is not finished yet
+					std::this_thread::yield();
+					continue;
+				}
+				return;	// VK_SUCCESS, VK_THREAD_DONE_KHR or an error reported by the operation result
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (uint32_t i = 1; i < threadCount; i++)
+		{
+			workers.emplace_back(join);
+		}
+		join();
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+		return vkGetDeferredOperationResultKHR(device, deferredOp);
+	}
+
+
+	// ------------------
+	// AccelStructBuilder
+	// ------------------
+	void AccelStructBuilder::init(const nvvk::Context& context, const VkPhysicalDeviceAccelerationStructureFeaturesKHR& asFeatures,
+								  VkDeviceSize scratchBudget)
+	{
+		m_context		= &context;
+		m_scratchBudget = scratchBudget;
+		m_hostCommands	= asFeatures.accelerationStructureHostCommands == VK_TRUE;
+
+		// scratch addresses of every build in a batch must respect this alignment
+		auto asProperties = nvvk::make<VkPhysicalDeviceAccelerationStructurePropertiesKHR>();
+		auto properties2 = nvvk::make<VkPhysicalDeviceProperties2>();
+		properties2.pNext = &asProperties;
+		vkGetPhysicalDeviceProperties2(context.m_physicalDevice, &properties2);
+		m_scratchAlignment = std::max<VkDeviceSize>(1, asProperties.minAccelerationStructureScratchOffsetAlignment);
+	}
+
+	void AccelStructBuilder::deinit()
+	{
+		if (m_scratchBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(m_context->m_device, m_scratchBuffer, nullptr);
+			vkFreeMemory(m_context->m_device, m_scratchMemory, nullptr);
+		}
+		if (m_instanceBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(m_context->m_device, m_instanceMemory);
+			vkDestroyBuffer(m_context->m_device, m_instanceBuffer, nullptr);
+			vkFreeMemory(m_context->m_device, m_instanceMemory, nullptr);
+		}
+		m_scratchBuffer		= VK_NULL_HANDLE;
+		m_scratchMemory		= VK_NULL_HANDLE;
+		m_scratchSize		= 0;
+		m_scratchAddress	= 0;
+		m_instanceBuffer	= VK_NULL_HANDLE;
+		m_instanceMemory	= VK_NULL_HANDLE;
+		m_instanceSize		= 0;
+		m_instanceData		= nullptr;
+		m_context			= nullptr;
+	}
+
+	AccelStruct AccelStructBuilder::createAccelStruct(VkAccelerationStructureTypeKHR type, VkDeviceSize size,
+													  VkMemoryPropertyFlags memPropFlags)
+	{
+		AccelStruct accelStruct;
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		NRC::createBuffer(*m_context, unusedCmdBuffer, size,
+						  &accelStruct.buffer, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+						  &accelStruct.memory, memPropFlags);
+
+		auto createInfo = nvvk::make<VkAccelerationStructureCreateInfoKHR>();
+		createInfo.type		= type;
+		createInfo.size		= size;
+		createInfo.buffer	= accelStruct.buffer;
+		NVVK_CHECK(vkCreateAccelerationStructureKHR(m_context->m_device, &createInfo, nullptr, &accelStruct.handle));
+
+		auto addressInfo = nvvk::make<VkAccelerationStructureDeviceAddressInfoKHR>();
+		addressInfo.accelerationStructure = accelStruct.handle;
+		accelStruct.address = vkGetAccelerationStructureDeviceAddressKHR(m_context->m_device, &addressInfo);
+		return accelStruct;
+	}
+
+	void AccelStructBuilder::reserveScratch(VkDeviceSize size)
+	{
+		if (size <= m_scratchSize)
+		{
+			return;	// recycle the current arena
+		}
+
+		if (m_scratchBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(m_context->m_device, m_scratchBuffer, nullptr);
+			vkFreeMemory(m_context->m_device, m_scratchMemory, nullptr);
+		}
+
+		// over-allocate by one alignment so that the arena base can be aligned
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		NRC::createBuffer(*m_context, unusedCmdBuffer, size + m_scratchAlignment,
+						  &m_scratchBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+						  &m_scratchMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		m_scratchAddress	= alignUp(getBufferDeviceAddress(m_context->m_device, m_scratchBuffer), m_scratchAlignment);
+		m_scratchSize		= size;
+	}
+
+	void AccelStructBuilder::reserveInstances(VkDeviceSize size)
+	{
+		if (size <= m_instanceSize)
+		{
+			return;	// every build waits for its submission, so the last instances are no longer read
+		}
+
+		if (m_instanceBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(m_context->m_device, m_instanceMemory);
+			vkDestroyBuffer(m_context->m_device, m_instanceBuffer, nullptr);
+			vkFreeMemory(m_context->m_device, m_instanceMemory, nullptr);
+		}
+
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		NRC::createBuffer(*m_context, unusedCmdBuffer, size,
+						  &m_instanceBuffer, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+						  &m_instanceMemory, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		NVVK_CHECK(vkMapMemory(m_context->m_device, m_instanceMemory, 0, size, 0, &m_instanceData));
+		m_instanceSize = size;
+	}
+
+	void AccelStructBuilder::recordBatches(VkCommandBuffer cmdBuffer, std::vector<BuildRequest>& requests)
+	{
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR>	buildInfos;
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>	rangeInfos;
+		buildInfos.reserve(requests.size());
+		rangeInfos.reserve(requests.size());
+
+		// between two batches the scratch arena is reused, so the previous builds must be finished
+		auto batchBarrier = nvvk::make<VkMemoryBarrier>();
+		batchBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		batchBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+		m_lastBatchCount = 0;
+		size_t			batchBegin		= 0;
+		VkDeviceSize	scratchOffset	= 0;
+		auto flushBatch = [&](size_t batchEnd)
+		{
+			if (batchEnd == batchBegin)
+			{
+				return;
+			}
+			if (m_lastBatchCount > 0)
+			{
+				vkCmdPipelineBarrier(cmdBuffer,
+					VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+					VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+					0, 1, &batchBarrier, 0, nullptr, 0, nullptr);
+			}
+			vkCmdBuildAccelerationStructuresKHR(cmdBuffer, uint32_t(batchEnd - batchBegin),
+												buildInfos.data() + batchBegin, rangeInfos.data() + batchBegin);
+			m_lastBatchCount++;
+			batchBegin		= batchEnd;
+			scratchOffset	= 0;
+		};
+
+		for (size_t i = 0; i < requests.size(); i++)
+		{
+			BuildRequest& request = requests[i];
+			if (scratchOffset + request.scratchSize > m_scratchSize)
+			{
+				flushBatch(i);
+			}
+			request.buildInfo.scratchData.deviceAddress = m_scratchAddress + scratchOffset;
+			scratchOffset += request.scratchSize;
+
+			buildInfos.push_back(request.buildInfo);
+			rangeInfos.push_back(request.rangeInfos);
+		}
+		flushBatch(requests.size());
+	}
+
+	std::vector<AccelStruct> AccelStructBuilder::buildBlas(VkCommandPool cmdPool, const std::vector<BlasInput>& inputs)
+	{
+		std::vector<AccelStruct>	blases(inputs.size());
+		std::vector<BuildRequest>	requests(inputs.size());
+		if (inputs.empty())
+		{
+			m_lastBatchCount = 0;
+			return blases;
+		}
+
+		// ---------------------------------------
+		// Query sizes and create the BLAS objects
+		// ---------------------------------------
+		VkDeviceSize maxScratch		= 0;
+		VkDeviceSize totalScratch	= 0;
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			const BlasInput& input = inputs[i];
+
+			VkAccelerationStructureBuildGeometryInfoKHR buildInfo = makeBlasBuildInfo(input, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+			const VkAccelerationStructureBuildSizesInfoKHR sizeInfo = getBlasBuildSizes(m_context->m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+																						 buildInfo, input);
+
+			blases[i] = createAccelStruct(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo.accelerationStructureSize);
+			buildInfo.dstAccelerationStructure = blases[i].handle;
+
+			requests[i].buildInfo	= buildInfo;
+			requests[i].rangeInfos	= input.rangeInfos.data();
+			requests[i].scratchSize = alignUp(sizeInfo.buildScratchSize, m_scratchAlignment);
+			maxScratch		= std::max(maxScratch, requests[i].scratchSize);
+			totalScratch	+= requests[i].scratchSize;
+		}
+
+		// the arena holds at least the largest single build, at most the budget unless everything fits
+		reserveScratch(std::max(maxScratch, std::min(totalScratch, m_scratchBudget)));
+
+		// -----------------------------
+		// Record all batches, submit once
+		// -----------------------------
+		VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(m_context->m_device, cmdPool);
+		recordBatches(cmdBuffer, requests);
+		NRC::endSubmitSingleTimeCommandRecord(m_context->m_device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+
+		return blases;
+	}
+
+	std::vector<AccelStruct> AccelStructBuilder::buildBlasOnHost(const std::vector<BlasInput>& hostInputs, uint32_t threadCount)
+	{
+		std::vector<AccelStruct> blases(hostInputs.size());
+		if (hostInputs.empty())
+		{
+			return blases;
+		}
+
+		// -------------------------------------------------------------
+		// Query host build sizes; structures must live in host-visible memory
+		// -------------------------------------------------------------
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR>		buildInfos(hostInputs.size());
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*>	rangeInfos(hostInputs.size());
+		std::vector<VkDeviceSize>										scratchOffsets(hostInputs.size());
+		VkDeviceSize totalScratch = 0;
+		for (size_t i = 0; i < hostInputs.size(); i++)
+		{
+			const BlasInput& input = hostInputs[i];
+
+			VkAccelerationStructureBuildGeometryInfoKHR buildInfo = makeBlasBuildInfo(input, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR);
+			const VkAccelerationStructureBuildSizesInfoKHR sizeInfo = getBlasBuildSizes(m_context->m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR,
+																						 buildInfo, input);
+
+			blases[i] = createAccelStruct(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo.accelerationStructureSize,
+										  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			buildInfo.dstAccelerationStructure = blases[i].handle;
+
+			buildInfos[i]		= buildInfo;
+			rangeInfos[i]		= input.rangeInfos.data();
+			scratchOffsets[i]	= totalScratch;
+			totalScratch		+= alignUp(sizeInfo.buildScratchSize, m_scratchAlignment);
+		}
+
+		// all builds run concurrently in one operation, so each gets its own slice of host scratch
+		std::vector<uint8_t> hostScratch(size_t(totalScratch + m_scratchAlignment));
+		const VkDeviceSize scratchBase = alignUp(VkDeviceSize(reinterpret_cast<uintptr_t>(hostScratch.data())), m_scratchAlignment);
+		for (size_t i = 0; i < buildInfos.size(); i++)
+		{
+			buildInfos[i].scratchData.hostAddress = reinterpret_cast<void*>(uintptr_t(scratchBase + scratchOffsets[i]));
+		}
+
+		// ----------------------------------------
+		// Build through a deferred host operation
+		// ----------------------------------------
+		VkDeferredOperationKHR deferredOp;
+		NVVK_CHECK(vkCreateDeferredOperationKHR(m_context->m_device, nullptr, &deferredOp));
+		VkResult result = vkBuildAccelerationStructuresKHR(m_context->m_device, deferredOp,
+														   uint32_t(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+		if (result == VK_OPERATION_DEFERRED_KHR)
+		{
+			result = joinDeferredOperation(m_context->m_device, deferredOp, threadCount);
+		}
+		else if (result == VK_OPERATION_NOT_DEFERRED_KHR)
+		{
+			result = VK_SUCCESS;	// the implementation finished the work on the calling thread
+		}
+		NVVK_CHECK(result);
+		vkDestroyDeferredOperationKHR(m_context->m_device, deferredOp, nullptr);
+
+		return blases;
+	}
+
+	std::future<std::vector<AccelStruct>> AccelStructBuilder::buildBlasOnHostAsync(const std::vector<BlasInput>& hostInputs, uint32_t threadCount)
+	{
+		assert(m_hostCommands);
+		// inputs are copied, only the geometry memory they point at must stay alive
+		return std::async(std::launch::async, [this, hostInputs, threadCount]()
+		{
+			return buildBlasOnHost(hostInputs, threadCount);
+		});
+	}
+
+	void AccelStructBuilder::updateBlas(VkCommandPool cmdPool, const std::vector<AccelStruct>& blases, const std::vector<BlasInput>& inputs,
+										const std::vector<VkBuildAccelerationStructureModeKHR>& modes)
+	{
+		assert(blases.size() == inputs.size() && modes.size() == inputs.size());
+		std::vector<BuildRequest> requests(inputs.size());
+		if (inputs.empty())
+		{
+			m_lastBatchCount = 0;
+			return;
+		}
+
+		VkDeviceSize maxScratch		= 0;
+		VkDeviceSize totalScratch	= 0;
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			const BlasInput& input = inputs[i];
+			VkAccelerationStructureBuildGeometryInfoKHR buildInfo = makeBlasBuildInfo(input, modes[i]);
+			const VkAccelerationStructureBuildSizesInfoKHR sizeInfo = getBlasBuildSizes(m_context->m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+																						 buildInfo, input);
+			// both modes write into the existing structure, so its address stays valid for the TLAS
+			const bool refit = modes[i] == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+			buildInfo.srcAccelerationStructure = refit ? blases[i].handle : VK_NULL_HANDLE;
+			buildInfo.dstAccelerationStructure = blases[i].handle;
+
+			requests[i].buildInfo	= buildInfo;
+			requests[i].rangeInfos	= input.rangeInfos.data();
+			requests[i].scratchSize = alignUp(refit ? sizeInfo.updateScratchSize : sizeInfo.buildScratchSize, m_scratchAlignment);
+			maxScratch		= std::max(maxScratch, requests[i].scratchSize);
+			totalScratch	+= requests[i].scratchSize;
+		}
+		reserveScratch(std::max(maxScratch, std::min(totalScratch, m_scratchBudget)));
+
+		VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(m_context->m_device, cmdPool);
+		recordBatches(cmdBuffer, requests);
+		NRC::endSubmitSingleTimeCommandRecord(m_context->m_device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+	}
+
+	AccelStruct AccelStructBuilder::buildTlas(VkCommandPool cmdPool, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+											  VkBuildAccelerationStructureFlagsKHR flags)
+	{
+		AccelStruct tlas;
+		buildOrUpdateTlas(cmdPool, instances, flags, VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR, tlas);
+		return tlas;
+	}
+
+	void AccelStructBuilder::updateTlas(VkCommandPool cmdPool, AccelStruct& tlas, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+										VkBuildAccelerationStructureFlagsKHR flags)
+	{
+		assert(flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+		buildOrUpdateTlas(cmdPool, instances, flags, VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR, tlas);
+	}
+
+	void AccelStructBuilder::buildOrUpdateTlas(VkCommandPool cmdPool, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+											   VkBuildAccelerationStructureFlagsKHR flags, VkBuildAccelerationStructureModeKHR mode, AccelStruct& tlas)
+	{
+		// ---------------------------------------------------
+		// Upload instances (persistent host-visible buffer)
+		// ---------------------------------------------------
+		reserveInstances(std::max<VkDeviceSize>(1, instances.size()) * sizeof(VkAccelerationStructureInstanceKHR));
+		memcpy(m_instanceData, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+
+		auto instancesData = nvvk::make<VkAccelerationStructureGeometryInstancesDataKHR>();
+		instancesData.arrayOfPointers		= VK_FALSE;
+		instancesData.data.deviceAddress	= getBufferDeviceAddress(m_context->m_device, m_instanceBuffer);
+
+		auto geometry = nvvk::make<VkAccelerationStructureGeometryKHR>();
+		geometry.geometryType		= VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		geometry.geometry.instances = instancesData;
+
+		auto buildInfo = nvvk::make<VkAccelerationStructureBuildGeometryInfoKHR>();
+		buildInfo.type			= VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+		buildInfo.mode			= mode;
+		buildInfo.flags			= flags;
+		buildInfo.geometryCount = 1;
+		buildInfo.pGeometries	= &geometry;
+
+		const uint32_t instanceCount = uint32_t(instances.size());
+		auto sizeInfo = nvvk::make<VkAccelerationStructureBuildSizesInfoKHR>();
+		vkGetAccelerationStructureBuildSizesKHR(m_context->m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+												&buildInfo, &instanceCount, &sizeInfo);
+
+		if (mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR)
+		{
+			tlas = createAccelStruct(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizeInfo.accelerationStructureSize);
+			reserveScratch(alignUp(sizeInfo.buildScratchSize, m_scratchAlignment));
+		}
+		else
+		{
+			// moved instances only: refit the existing TLAS in place
+			buildInfo.srcAccelerationStructure = tlas.handle;
+			reserveScratch(alignUp(sizeInfo.updateScratchSize, m_scratchAlignment));
+		}
+		buildInfo.dstAccelerationStructure		= tlas.handle;
+		buildInfo.scratchData.deviceAddress		= m_scratchAddress;
+
+		VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+		rangeInfo.primitiveCount = instanceCount;
+		const VkAccelerationStructureBuildRangeInfoKHR* pRangeInfo = &rangeInfo;
+
+		// --------------------------------------
+		// Record build, after the BLAS builds land
+		// --------------------------------------
+		VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(m_context->m_device, cmdPool);
+		auto blasBarrier = nvvk::make<VkMemoryBarrier>();
+		blasBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		blasBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		vkCmdPipelineBarrier(cmdBuffer,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			0, 1, &blasBarrier, 0, nullptr, 0, nullptr);
+		vkCmdBuildAccelerationStructuresKHR(cmdBuffer, 1, &buildInfo, &pRangeInfo);
+		NRC::endSubmitSingleTimeCommandRecord(m_context->m_device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+	}
+
+
+	// ---------------
+	// BlasRefitPolicy
+	// ---------------
+	namespace
+	{
+	struct Bounds
+	{
+		float lo[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+		float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void grow(const float* p)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				lo[a] = std::min(lo[a], p[a]);
+				hi[a] = std::max(hi[a], p[a]);
+			}
+		}
+		void grow(const Bounds& b)
+		{
+			grow(b.lo);
+			grow(b.hi);
+		}
+		float halfArea() const
+		{
+			const float dx = std::max(0.0f, hi[0] - lo[0]);
+			const float dy = std::max(0.0f, hi[1] - lo[1]);
+			const float dz = std::max(0.0f, hi[2] - lo[2]);
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+	}
+
+	static Bounds triangleBounds(const float* positions, const uint32_t* indices, uint32_t triangle)
+	{
+		Bounds bounds;
+		for (uint32_t v = 0; v < 3; v++)
+		{
+			bounds.grow(positions + 3 * size_t(indices[3 * triangle + v]));
+		}
+		return bounds;
+	}
+
+	// spread the lower 10 bits of v so that two zero bits separate each of them
+	static uint32_t expandBits(uint32_t v)
+	{
+		v = (v * 0x00010001u) & 0xFF0000FFu;
+		v = (v * 0x00000101u) & 0x0F00F00Fu;
+		v = (v * 0x00000011u) & 0xC30C30C3u;
+		v = (v * 0x00000005u) & 0x49249249u;
+		return v;
+	}
+
+	// SAH cost of the implicit binary tree over order[begin, end), accumulated unnormalized
+	static Bounds accumulateSahCost(const float* positions, const uint32_t* indices, const uint32_t* order,
+									uint32_t begin, uint32_t end, double& cost)
+	{
+		static const uint32_t leafSize = 4;
+		Bounds bounds;
+		if (end - begin <= leafSize)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				bounds.grow(triangleBounds(positions, indices, order[i]));
+			}
+			cost += double(bounds.halfArea()) * (end - begin);		// intersection cost of the leaf
+			return bounds;
+		}
+		const uint32_t middle = begin + (end - begin) / 2;
+		bounds.grow(accumulateSahCost(positions, indices, order, begin, middle, cost));
+		bounds.grow(accumulateSahCost(positions, indices, order, middle, end, cost));
+		cost += bounds.halfArea();									// traversal cost of the node
+		return bounds;
+	}
+
+	float BlasRefitPolicy::measureCost(const float* positions, const uint32_t* indices) const
+	{
+		double cost = 0.0;
+		const Bounds root = accumulateSahCost(positions, indices, m_order.data(), 0, uint32_t(m_order.size()), cost);
+		// normalize by the root so that a uniformly scaled or translated mesh keeps its cost
+		const float rootArea = root.halfArea();
+		return rootArea > 0.0f ? float(cost / rootArea) : 0.0f;
+	}
+
+	void BlasRefitPolicy::onRebuild(const float* positions, const uint32_t* indices, uint32_t indexCount)
+	{
+		const uint32_t triangleCount = indexCount / 3;
+
+		// a fresh build clusters triangles spatially; approximate its topology by a Morton order
+		Bounds centroidBounds;
+		std::vector<float> centroids(3 * size_t(triangleCount));
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			const Bounds bounds = triangleBounds(positions, indices, t);
+			for (int a = 0; a < 3; a++)
+			{
+				centroids[3 * t + a] = 0.5f * (bounds.lo[a] + bounds.hi[a]);
+			}
+			centroidBounds.grow(&centroids[3 * t]);
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> keys(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t code = 0;
+			for (int a = 0; a < 3; a++)
+			{
+				const float extent	= centroidBounds.hi[a] - centroidBounds.lo[a];
+				const float unit	= extent > 0.0f ? (centroids[3 * t + a] - centroidBounds.lo[a]) / extent : 0.0f;
+				code |= expandBits(std::min(1023u, uint32_t(unit * 1024.0f))) << (2 - a);
+			}
+			keys[t] = { code, t };
+		}
+		std::sort(keys.begin(), keys.end());
+
+		// keep every sampleStride-th triangle, starting halfway into the first stride
+		m_order.clear();
+		for (uint32_t t = std::min(m_sampleStride / 2, triangleCount - 1); t < triangleCount; t += m_sampleStride)
+		{
+			m_order.push_back(keys[t].second);
+		}
+		m_triangleCount			= triangleCount;
+		m_callsSinceEvaluation	= 0;
+		m_referenceCost			= measureCost(positions, indices);
+		m_lastCostRatio			= 1.0f;
+	}
+
+	bool BlasRefitPolicy::shouldRebuild(const float* positions, const uint32_t* indices, uint32_t indexCount)
+	{
+		if (indexCount / 3 != m_triangleCount || m_order.empty())
+		{
+			return true;	// topology changed, a refit is not possible
+		}
+		if (++m_callsSinceEvaluation < m_evaluationInterval)
+		{
+			return false;	// keeps the ratio of the last evaluation
+		}
+		m_callsSinceEvaluation = 0;
+		const float cost = measureCost(positions, indices);
+		m_lastCostRatio = m_referenceCost > 0.0f ? cost / m_referenceCost : 1.0f;
+		return m_lastCostRatio > m_maxCostRatio;
+	}
+
+
+	// ---------
+	// Benchmark
+	// ---------
+	// positions twisted about the vertical axis through the centre of their bounds by up to amount turns,
+	// the most on the axis and none from the farthest vertex outwards
+	static void twistPositions(const std::vector<float>& positions, float amount, std::vector<float>& twisted)
+	{
+		Bounds bounds;
+		for (size_t v = 0; v < positions.size(); v += 3)
+		{
+			bounds.grow(&positions[v]);
+		}
+		const float centerX		= 0.5f * (bounds.lo[0] + bounds.hi[0]);
+		const float centerZ		= 0.5f * (bounds.lo[2] + bounds.hi[2]);
+		const float maxRadius	= std::max(1e-6f, 0.5f * std::sqrt((bounds.hi[0] - bounds.lo[0]) * (bounds.hi[0] - bounds.lo[0])
+																	+ (bounds.hi[2] - bounds.lo[2]) * (bounds.hi[2] - bounds.lo[2])));
+		twisted.resize(positions.size());
+		for (size_t v = 0; v < positions.size(); v += 3)
+		{
+			const float x		= positions[v + 0] - centerX;
+			const float z		= positions[v + 2] - centerZ;
+			const float angle	= 6.2831853f * amount * std::max(0.0f, 1.0f - std::sqrt(x * x + z * z) / maxRadius);
+			twisted[v + 0]	= centerX + x * std::cos(angle) - z * std::sin(angle);
+			twisted[v + 1]	= positions[v + 1];
+			twisted[v + 2]	= centerZ + x * std::sin(angle) + z * std::cos(angle);
+		}
+	}
+
+	void benchmarkBlasRefit(const nvvk::Context& context, VkCommandPool cmdPool, AccelStructBuilder& builder,
+							const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t		frames		= 32;
+		const float			turns		= 2.0f;		// of the twist at the last frame
+		const uint32_t		vertexCount	= uint32_t(positions.size() / 3);
+		const uint32_t		indexCount	= uint32_t(indices.size());
+		const VkDeviceSize	vertexBytes	= positions.size() * sizeof(float);
+		const VkDeviceSize	indexBytes	= indices.size() * sizeof(uint32_t);
+
+		// device-local geometry as the renderer keeps it, the vertices rewritten through a staging buffer every frame
+		const VkBufferUsageFlags geometryUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+											   | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+		const VkMemoryPropertyFlags stagingMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		VkBuffer		vertexBuffer, indexBuffer, stagingBuffer;
+		VkDeviceMemory	vertexMemory, indexMemory, stagingBufferMemory;
+		NRC::createBuffer(context, unusedCmdBuffer, vertexBytes, &vertexBuffer, geometryUsage, &vertexMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		NRC::createBuffer(context, unusedCmdBuffer, indexBytes, &indexBuffer, geometryUsage, &indexMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		NRC::createBuffer(context, unusedCmdBuffer, std::max(vertexBytes, indexBytes), &stagingBuffer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+						  &stagingBufferMemory, stagingMemory);
+		void* staging;
+		vkMapMemory(context.m_device, stagingBufferMemory, 0, std::max(vertexBytes, indexBytes), 0, &staging);
+		auto upload = [&](VkBuffer buffer, const void* data, VkDeviceSize bytes)
+		{
+			memcpy(staging, data, size_t(bytes));
+			VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(context.m_device, cmdPool);
+			NRC::copyBuffer(cmdBuffer, stagingBuffer, buffer, bytes);
+			// the builds of later submissions read what the copy wrote
+			auto uploadBarrier = nvvk::make<VkMemoryBarrier>();
+			uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+								 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+			NRC::endSubmitSingleTimeCommandRecord(context.m_device, context.m_queueGCT, cmdPool, cmdBuffer);
+		};
+		upload(indexBuffer, indices.data(), indexBytes);
+
+		// a refit needs ALLOW_UPDATE on the build it refits, and every update of the BLAS has to use the same flags
+		BlasInput input = makeTriangleBlasInput(context.m_device, vertexBuffer, vertexCount, indexBuffer, indexCount);
+		input.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+
+		printf("BLAS refit against rebuild, %u triangles twisted by up to %.2f turns over %u frames\n", indexCount / 3, turns, frames);
+		printf("%-26s %9s %7s %11s %10s %10s %10s %9s %8s\n", "updates", "rebuilds", "refits", "rebuild ms", "refit ms",
+			   "decide ms", "TLAS ms", "mean SAH", "max SAH");
+		// the decision time is per frame; a decision is made every frame, also by the strategies that ignore it
+		struct Strategy { const char* name; float maxCostRatio; uint32_t sampleStride; uint32_t evaluationInterval; };
+		const Strategy strategies[] = {
+			{ "always rebuild",				0.0f,		8, 1 },
+			{ "always refit",				FLT_MAX,	8, 1 },
+			{ "policy 1.25x",				1.25f,		8, 1 },
+			{ "policy 1.5x",				1.5f,		8, 1 },
+			{ "policy 2x",					2.0f,		8, 1 },
+			{ "policy 1.5x, full tree",		1.5f,		1, 1 },
+			{ "policy 1.5x, every 4th",		1.5f,		8, 4 },
+		};
+		std::vector<float> twisted;
+		for (const Strategy& strategy : strategies)
+		{
+			upload(vertexBuffer, positions.data(), vertexBytes);
+			std::vector<AccelStruct> blases = builder.buildBlas(cmdPool, { input });
+			VkAccelerationStructureInstanceKHR instance{};
+			instance.transform.matrix[0][0]				= 1.0f;
+			instance.transform.matrix[1][1]				= 1.0f;
+			instance.transform.matrix[2][2]				= 1.0f;
+			instance.mask								= 0xFF;
+			instance.flags								= VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference		= blases[0].address;
+			const VkBuildAccelerationStructureFlagsKHR tlasFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+																 | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+			AccelStruct tlas = builder.buildTlas(cmdPool, { instance }, tlasFlags);
+
+			// the SAH cost ratio of the hierarchy the frame traces is measured on the full reference tree every frame,
+			// apart from the sampled and intermittent estimate the policy decides on
+			BlasRefitPolicy policy(strategy.maxCostRatio, strategy.sampleStride, strategy.evaluationInterval);
+			BlasRefitPolicy meter(FLT_MAX, 1, 1);
+			policy.onRebuild(positions.data(), indices.data(), indexCount);
+			meter.onRebuild(positions.data(), indices.data(), indexCount);
+			uint32_t	rebuilds		= 0;
+			double		rebuildSeconds	= 0.0;
+			double		refitSeconds	= 0.0;
+			double		tlasSeconds		= 0.0;
+			double		decideSeconds	= 0.0;
+			double		costSum			= 0.0;
+			float		maxCost			= 1.0f;
+			for (uint32_t frame = 1; frame <= frames; frame++)
+			{
+				twistPositions(positions, turns * float(frame) / float(frames), twisted);
+				upload(vertexBuffer, twisted.data(), vertexBytes);
+
+				const auto decideStart = std::chrono::high_resolution_clock::now();
+				const bool rebuild = policy.shouldRebuild(twisted.data(), indices.data(), indexCount);
+				const auto decideEnd = std::chrono::high_resolution_clock::now();
+				decideSeconds += std::chrono::duration<double>(decideEnd - decideStart).count();
+				meter.shouldRebuild(twisted.data(), indices.data(), indexCount);
+
+				const auto blasStart = std::chrono::high_resolution_clock::now();
+				builder.updateBlas(cmdPool, blases, { input }, { rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR
+																		 : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR });
+				const auto blasEnd = std::chrono::high_resolution_clock::now();
+				// the BLAS stays at its address, but the TLAS bounds have to follow its new extent
+				builder.updateTlas(cmdPool, tlas, { instance }, tlasFlags);
+				const auto tlasEnd = std::chrono::high_resolution_clock::now();
+				(rebuild ? rebuildSeconds : refitSeconds) += std::chrono::duration<double>(blasEnd - blasStart).count();
+				tlasSeconds += std::chrono::duration<double>(tlasEnd - blasEnd).count();
+
+				if (rebuild)
+				{
+					policy.onRebuild(twisted.data(), indices.data(), indexCount);
+					meter.onRebuild(twisted.data(), indices.data(), indexCount);
+					rebuilds++;
+				}
+				costSum += meter.lastCostRatio();
+				maxCost	= std::max(maxCost, meter.lastCostRatio());
+			}
+			// rebuild and refit ms per update of that kind, decide and TLAS ms per frame
+			const uint32_t refits = frames - rebuilds;
+			printf("%-26s %9u %7u %11.3f %10.3f %10.3f %10.3f %9.2f %8.2f\n", strategy.name, rebuilds, refits,
+				   rebuilds ? 1e3 * rebuildSeconds / rebuilds : 0.0, refits ? 1e3 * refitSeconds / refits : 0.0,
+				   1e3 * decideSeconds / frames, 1e3 * tlasSeconds / frames, costSum / frames, maxCost);
+
+			destroyAccelStruct(context.m_device, tlas);
+			destroyAccelStruct(context.m_device, blases[0]);
+		}
+
+		vkUnmapMemory(context.m_device, stagingBufferMemory);
+		vkDestroyBuffer(context.m_device, stagingBuffer, nullptr);
+		vkFreeMemory(context.m_device, stagingBufferMemory, nullptr);
+		vkDestroyBuffer(context.m_device, indexBuffer, nullptr);
+		vkFreeMemory(context.m_device, indexMemory, nullptr);
+		vkDestroyBuffer(context.m_device, vertexBuffer, nullptr);
+		vkFreeMemory(context.m_device, vertexMemory, nullptr);
+	}
+}
@@ -0,0 +1,183 @@
+# pragma once
+
+#include <algorithm>
+#include <future>
+#include <vector>
+#include <utility.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Geometry of one bottom-level acceleration structure (BLAS).
+	// Several geometries may be packed into one BLAS; every geometry
+	// needs exactly one range info.
+	// ----------------------------------------------------------------
+	struct BlasInput
+	{
+		std::vector<VkAccelerationStructureGeometryKHR>			geometries;
+		std::vector<VkAccelerationStructureBuildRangeInfoKHR>	rangeInfos;
+		VkBuildAccelerationStructureFlagsKHR					flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	};
+
+	// An acceleration structure together with the buffer backing it
+	struct AccelStruct
+	{
+		VkAccelerationStructureKHR	handle	= VK_NULL_HANDLE;
+		VkBuffer					buffer	= VK_NULL_HANDLE;
+		VkDeviceMemory				memory	= VK_NULL_HANDLE;
+		VkDeviceAddress				address = 0;
+	};
+
+	// describe an indexed triangle mesh (vec3 float positions, uint32 indices) living in device buffers
+	BlasInput makeTriangleBlasInput(VkDevice device,
+									VkBuffer vertexBuffer, uint32_t vertexCount,
+									VkBuffer indexBuffer, uint32_t indexCount);
+	// same mesh, read from host memory; only valid for host builds and the memory must outlive the build
+	BlasInput makeTriangleBlasInput(const float* positions, uint32_t vertexCount,
+									const uint32_t* indices, uint32_t indexCount);
+
+	VkDeviceAddress getBufferDeviceAddress(VkDevice device, VkBuffer buffer);
+	void destroyAccelStruct(VkDevice device, AccelStruct& accelStruct);
+
+	// ----------------------------------------------------------------
+	// Builds acceleration structures with one shared scratch arena.
+	//
+	// BLAS builds are grouped into batches whose summed scratch size
+	// fits the arena; each batch is a single vkCmdBuildAccelerationStructuresKHR
+	// call, and the only barriers are the ones between batches (the next
+	// batch reuses the scratch memory of the previous one).
+	// The arena is kept between build calls and only grows when a single
+	// build does not fit into it.
+	//
+	// When the device supports accelerationStructureHostCommands, BLAS can
+	// also be built on the CPU through VK_KHR_deferred_host_operations,
+	// leaving the queue free for rendering.
+	// ----------------------------------------------------------------
+	class AccelStructBuilder
+	{
+	public:
+		// asFeatures:    the acceleration structure features enabled on the context
+		// scratchBudget: upper bound of the shared scratch arena in bytes
+		void init(const nvvk::Context& context, const VkPhysicalDeviceAccelerationStructureFeaturesKHR& asFeatures,
+				  VkDeviceSize scratchBudget = VkDeviceSize(128) << 20);
+		void deinit();
+
+		// build one BLAS per input, returned in the order of inputs
+		std::vector<AccelStruct> buildBlas(VkCommandPool cmdPool, const std::vector<BlasInput>& inputs);
+
+		// true when BLAS may be built on the host (accelerationStructureHostCommands)
+		bool supportsHostBuilds() const { return m_hostCommands; }
+
+		// Build one BLAS per input on CPU worker threads through a deferred host operation.
+		// Inputs must reference host memory (see the host makeTriangleBlasInput). The
+		// structures live in host-visible memory and can be used by the device once the
+		// future is ready. threadCount 0 means: as many as the operation can use.
+		// Must only be called when supportsHostBuilds() is true.
+		std::future<std::vector<AccelStruct>> buildBlasOnHostAsync(const std::vector<BlasInput>& hostInputs, uint32_t threadCount = 0);
+
+		// Rebuild or refit existing BLAS in place, batched like buildBlas. MODE_UPDATE refits
+		// the current hierarchy to moved vertices (the BLAS must have been built with
+		// ALLOW_UPDATE and the same input flags); MODE_BUILD rebuilds into the same storage,
+		// so TLAS instances keep referencing valid addresses either way.
+		void updateBlas(VkCommandPool cmdPool, const std::vector<AccelStruct>& blases, const std::vector<BlasInput>& inputs,
+						const std::vector<VkBuildAccelerationStructureModeKHR>& modes);
+
+		// build a TLAS over the given instances (instanceCustomIndex, mask, sbt offset and
+		// flags are taken as they are, accelerationStructureReference is filled by the caller)
+		AccelStruct buildTlas(VkCommandPool cmdPool, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+							  VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+
+		// refit a TLAS built with ALLOW_UPDATE to moved instances; the instance count and
+		// the flags must be the ones it was built with
+		void updateTlas(VkCommandPool cmdPool, AccelStruct& tlas, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+						VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+																   | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+		// number of vkCmdBuildAccelerationStructuresKHR calls issued by the last buildBlas()
+		uint32_t lastBatchCount() const { return m_lastBatchCount; }
+
+	private:
+		struct BuildRequest
+		{
+			VkAccelerationStructureBuildGeometryInfoKHR			buildInfo;
+			const VkAccelerationStructureBuildRangeInfoKHR*		rangeInfos;
+			VkDeviceSize										scratchSize;		// aligned to the scratch offset alignment
+		};
+
+		AccelStruct createAccelStruct(VkAccelerationStructureTypeKHR type, VkDeviceSize size,
+									  VkMemoryPropertyFlags memPropFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		void buildOrUpdateTlas(VkCommandPool cmdPool, const std::vector<VkAccelerationStructureInstanceKHR>& instances,
+							   VkBuildAccelerationStructureFlagsKHR flags, VkBuildAccelerationStructureModeKHR mode, AccelStruct& tlas);
+		std::vector<AccelStruct> buildBlasOnHost(const std::vector<BlasInput>& hostInputs, uint32_t threadCount);
+		void reserveScratch(VkDeviceSize size);
+		// grow-only, persistently mapped buffer for the TLAS instances, so a refit per frame allocates nothing
+		void reserveInstances(VkDeviceSize size);
+		// split requests into batches under the arena size and record them with barriers in between
+		void recordBatches(VkCommandBuffer cmdBuffer, std::vector<BuildRequest>& requests);
+
+		const nvvk::Context*	m_context			= nullptr;
+		VkDeviceSize			m_scratchBudget		= 0;
+		VkDeviceSize			m_scratchAlignment	= 1;
+		bool					m_hostCommands		= false;
+		VkBuffer				m_scratchBuffer		= VK_NULL_HANDLE;
+		VkDeviceMemory			m_scratchMemory		= VK_NULL_HANDLE;
+		VkDeviceSize			m_scratchSize		= 0;
+		VkDeviceAddress			m_scratchAddress	= 0;
+		VkBuffer				m_instanceBuffer	= VK_NULL_HANDLE;
+		VkDeviceMemory			m_instanceMemory	= VK_NULL_HANDLE;
+		VkDeviceSize			m_instanceSize		= 0;
+		void*					m_instanceData		= nullptr;
+		uint32_t				m_lastBatchCount	= 0;
+	};
+
+	// ----------------------------------------------------------------
+	// Decides between refitting and rebuilding a deforming BLAS.
+	//
+	// A refit keeps the hierarchy of the last build while the vertices
+	// move, so its quality degrades. The policy measures the SAH cost of
+	// a reference hierarchy (Morton order of the triangles at the last
+	// rebuild) refitted to the current positions, normalized by the root
+	// area, and asks for a rebuild once it exceeds maxCostRatio times the
+	// cost right after the rebuild.
+	//
+	// The reference hierarchy is sampled: only every sampleStride-th
+	// triangle of the order is refitted, each sampled leaf standing for
+	// sampleStride leaves of the full tree, and the cost is measured only
+	// every evaluationInterval-th call, the calls in between keeping the
+	// refit. A decision is then a pass over indexCount / (3 * sampleStride)
+	// triangles instead of all of them.
+	// ----------------------------------------------------------------
+	class BlasRefitPolicy
+	{
+	public:
+		explicit BlasRefitPolicy(float maxCostRatio = 1.5f, uint32_t sampleStride = 8, uint32_t evaluationInterval = 1)
+			: m_maxCostRatio(maxCostRatio), m_sampleStride(std::max(1u, sampleStride)), m_evaluationInterval(std::max(1u, evaluationInterval)) {}
+
+		// call after each full build of the BLAS
+		void onRebuild(const float* positions, const uint32_t* indices, uint32_t indexCount);
+		// call after the vertices changed; true when a rebuild should replace the refit
+		bool shouldRebuild(const float* positions, const uint32_t* indices, uint32_t indexCount);
+
+		float lastCostRatio() const { return m_lastCostRatio; }
+
+	private:
+		float measureCost(const float* positions, const uint32_t* indices) const;
+
+		std::vector<uint32_t>	m_order;					// sampled triangle order of the reference hierarchy
+		uint32_t				m_triangleCount			= 0;
+		uint32_t				m_callsSinceEvaluation	= 0;
+		float					m_referenceCost			= 0.0f;
+		float					m_lastCostRatio			= 1.0f;
+		float					m_maxCostRatio;
+		uint32_t				m_sampleStride;
+		uint32_t				m_evaluationInterval;
+	};
+
+	// Twists a mesh about the vertical axis through its bounds, more towards the axis, over a number of frames
+	// and updates its BLAS (built with ALLOW_UPDATE) and a TLAS over it after every frame: always rebuilding,
+	// always refitting and as BlasRefitPolicy decides. Prints the cost per rebuild and per refit, the time the
+	// policy takes to decide per frame and the SAH cost ratio of the hierarchies that were traced, measured on
+	// the full reference tree. Run with --blas-bench.
+	void benchmarkBlasRefit(const nvvk::Context& context, VkCommandPool cmdPool, AccelStructBuilder& builder,
+							const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+}
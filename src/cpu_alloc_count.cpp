@@ -0,0 +1,134 @@
+#include <cpu_arena.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace NRC
+{
+#ifdef NRC_COUNT_ALLOCATIONS
+	// ---------------------------
+	// Heap allocation counting
+	// ---------------------------
+	static thread_local uint64_t heapAllocations = 0;
+
+	bool heapAllocationsCounted()
+	{
+		return true;
+	}
+
+	uint64_t threadHeapAllocations()
+	{
+		return heapAllocations;
+	}
+
+	static void* tryAllocate(size_t bytes, size_t alignment)
+	{
+		bytes = std::max<size_t>(bytes, 1);
+		if (alignment <= alignof(std::max_align_t))
+		{
+			return std::malloc(bytes);
+		}
+#if defined(_WIN32)
+		return _aligned_malloc(bytes, alignment);
+#else
+		void* data = nullptr;
+		return posix_memalign(&data, alignment, bytes) == 0 ? data : nullptr;
+#endif
+	}
+
+	// counts the call once, then retries through the installed new_handler as [new.delete.single] asks
+	static void* countedAllocate(size_t bytes, size_t alignment)
+	{
+		heapAllocations++;
+		for (;;)
+		{
+			if (void* data = tryAllocate(bytes, alignment))
+			{
+				return data;
+			}
+			const std::new_handler handler = std::get_new_handler();
+			if (handler == nullptr)
+			{
+				throw std::bad_alloc();
+			}
+			handler();
+		}
+	}
+
+	static void* countedAllocateNothrow(size_t bytes, size_t alignment) noexcept
+	{
+		try
+		{
+			return countedAllocate(bytes, alignment);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return nullptr;
+		}
+	}
+
+	static void countedFree(void* data, size_t alignment)
+	{
+#if defined(_WIN32)
+		if (alignment > alignof(std::max_align_t))
+		{
+			_aligned_free(data);
+			return;
+		}
+#endif
+		(void)alignment;
+		std::free(data);
+	}
+#else
+	bool heapAllocationsCounted()
+	{
+		return false;
+	}
+
+	uint64_t threadHeapAllocations()
+	{
+		return 0;
+	}
+#endif
+}
+
+#ifdef NRC_COUNT_ALLOCATIONS
+// ----------------------------------------------------------------
+// Replacements of the global operator new and delete, forwarding to
+// malloc and counting the calls per thread for threadHeapAllocations.
+// The array, nothrow and sized forms are replaced as well, so the
+// count does not depend on how the standard library layers them.
+// Every allocation of the process goes through them, the Vulkan
+// loader's and nvpro_core's included, so they are only built with
+// the NRC_COUNT_ALLOCATIONS option (for --bench arena).
+// ----------------------------------------------------------------
+void* operator new(size_t bytes)											{ return NRC::countedAllocate(bytes, 0); }
+void* operator new[](size_t bytes)											{ return NRC::countedAllocate(bytes, 0); }
+void* operator new(size_t bytes, std::align_val_t alignment)				{ return NRC::countedAllocate(bytes, size_t(alignment)); }
+void* operator new[](size_t bytes, std::align_val_t alignment)				{ return NRC::countedAllocate(bytes, size_t(alignment)); }
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept			{ return NRC::countedAllocateNothrow(bytes, 0); }
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept			{ return NRC::countedAllocateNothrow(bytes, 0); }
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return NRC::countedAllocateNothrow(bytes, size_t(alignment));
+}
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return NRC::countedAllocateNothrow(bytes, size_t(alignment));
+}
+
+void operator delete(void* data) noexcept											{ NRC::countedFree(data, 0); }
+void operator delete[](void* data) noexcept											{ NRC::countedFree(data, 0); }
+void operator delete(void* data, size_t) noexcept									{ NRC::countedFree(data, 0); }
+void operator delete[](void* data, size_t) noexcept									{ NRC::countedFree(data, 0); }
+void operator delete(void* data, const std::nothrow_t&) noexcept					{ NRC::countedFree(data, 0); }
+void operator delete[](void* data, const std::nothrow_t&) noexcept					{ NRC::countedFree(data, 0); }
+void operator delete(void* data, std::align_val_t alignment) noexcept				{ NRC::countedFree(data, size_t(alignment)); }
+void operator delete[](void* data, std::align_val_t alignment) noexcept				{ NRC::countedFree(data, size_t(alignment)); }
+void operator delete(void* data, size_t, std::align_val_t alignment) noexcept		{ NRC::countedFree(data, size_t(alignment)); }
+void operator delete[](void* data, size_t, std::align_val_t alignment) noexcept		{ NRC::countedFree(data, size_t(alignment)); }
+void operator delete(void* data, std::align_val_t alignment, const std::nothrow_t&) noexcept	{ NRC::countedFree(data, size_t(alignment)); }
+void operator delete[](void* data, std::align_val_t alignment, const std::nothrow_t&) noexcept	{ NRC::countedFree(data, size_t(alignment)); }
+#endif
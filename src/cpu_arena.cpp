@@ -0,0 +1,87 @@
+#include <cpu_arena.h>
+
+#include <algorithm>
+#include <new>
+
+namespace NRC
+{
+	// -----
+	// Arena
+	// -----
+	Arena::~Arena()
+	{
+		for (const Block& block : m_blocks)
+		{
+			::operator delete(block.data, std::align_val_t(64));
+		}
+	}
+
+	void Arena::addBlock(size_t bytes)
+	{
+		Block block;
+		block.size = std::max(bytes, m_blockBytes);
+		block.data = static_cast<char*>(::operator new(block.size, std::align_val_t(64)));
+		m_blocks.push_back(block);
+		m_blockAllocations++;
+	}
+
+	void* Arena::allocateBytes(size_t bytes, size_t alignment)
+	{
+		for (;;)
+		{
+			if (m_block < m_blocks.size())
+			{
+				const Block&	block	= m_blocks[m_block];
+				const size_t	offset	= (m_offset + alignment - 1) / alignment * alignment;
+				if (offset + bytes <= block.size)
+				{
+					m_offset = offset + bytes;
+					return block.data + offset;
+				}
+				// the rest of this block stays unused until the next reset
+				if (m_block + 1 < m_blocks.size())
+				{
+					m_block++;
+					m_offset = 0;
+					continue;
+				}
+			}
+			// blocks are 64-byte aligned, which covers every type handed out
+			addBlock(bytes);
+			m_block		= m_blocks.size() - 1;
+			m_offset	= 0;
+		}
+	}
+
+	void Arena::rewind(const Marker& marker)
+	{
+		m_block		= marker.block;
+		m_offset	= marker.offset;
+	}
+
+	void Arena::reset()
+	{
+		if (m_blocks.size() > 1)
+		{
+			const size_t bytes = capacity();
+			for (const Block& block : m_blocks)
+			{
+				::operator delete(block.data, std::align_val_t(64));
+			}
+			m_blocks.clear();
+			addBlock(bytes);
+		}
+		m_block		= 0;
+		m_offset	= 0;
+	}
+
+	size_t Arena::capacity() const
+	{
+		size_t bytes = 0;
+		for (const Block& block : m_blocks)
+		{
+			bytes += block.size;
+		}
+		return bytes;
+	}
+}
@@ -0,0 +1,117 @@
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Bump allocator for the transient state of one worker.
+	//
+	// Everything a ray stream (or a tile) needs while it is traced, such
+	// as rays, hits, per-pixel path state and binning buffers, is carved
+	// from the arena and released all at once by reset() before the next
+	// one. Allocating is a pointer bump, there is no per-object free,
+	// and only trivially destructible types are handed out. When a block
+	// runs out another one is chained; reset() then merges the chain
+	// into a single block of the combined size, so after the first few
+	// streams a worker renders without touching the heap at all.
+	// Blocks are allocated by the worker that uses the arena, so on a
+	// NUMA host they are local to it.
+	// ----------------------------------------------------------------
+	class Arena
+	{
+	public:
+		// position to rewind() to, releasing everything allocated after it
+		struct Marker
+		{
+			size_t block;
+			size_t offset;
+		};
+
+		explicit Arena(size_t blockBytes = size_t(1) << 20) : m_blockBytes(blockBytes) {}
+		~Arena();
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		// uninitialized storage for count objects of T
+		template <typename T>
+		T* allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without destructors");
+			return static_cast<T*>(allocateBytes(count * sizeof(T), alignof(T)));
+		}
+		void* allocateBytes(size_t bytes, size_t alignment);
+
+		Marker mark() const { return { m_block, m_offset }; }
+		void rewind(const Marker& marker);
+		// releases everything, merging the blocks if more than one was needed
+		void reset();
+
+		size_t		capacity() const;
+		// heap allocations made for blocks so far
+		uint64_t	blockAllocations() const { return m_blockAllocations; }
+
+	private:
+		struct Block
+		{
+			char*	data;
+			size_t	size;
+		};
+
+		void addBlock(size_t bytes);
+
+		std::vector<Block>	m_blocks;
+		size_t				m_block				= 0;		// block allocations are bumped in
+		size_t				m_offset			= 0;		// bytes used in it
+		size_t				m_blockBytes;
+		uint64_t			m_blockAllocations	= 0;
+	};
+
+	// ----------------------------------------------------------------
+	// Fixed-capacity array in arena memory, for the hot-loop containers
+	// that used to be std::vectors. Its size is bounded up front (the
+	// pixels of a stream, the bins of a sort), so it never reallocates.
+	// ----------------------------------------------------------------
+	template <typename T>
+	class ArenaArray
+	{
+	public:
+		ArenaArray() = default;
+		ArenaArray(Arena& arena, size_t capacity) : m_data(arena.allocate<T>(capacity)), m_capacity(capacity) {}
+
+		T*			data()					{ return m_data; }
+		const T*	data() const			{ return m_data; }
+		size_t		size() const			{ return m_size; }
+		size_t		capacity() const		{ return m_capacity; }
+		T&			operator[](size_t i)		{ return m_data[i]; }
+		const T&	operator[](size_t i) const	{ return m_data[i]; }
+		T*			begin()					{ return m_data; }
+		T*			end()					{ return m_data + m_size; }
+
+		void clear()					{ m_size = 0; }
+		void push_back(const T& value)	{ m_data[m_size++] = value; }
+		// new elements are left uninitialized, like the arena memory
+		void resize(size_t size)		{ m_size = size; }
+		void assign(size_t size, const T& value)
+		{
+			m_size = size;
+			for (size_t i = 0; i < size; i++)
+			{
+				m_data[i] = value;
+			}
+		}
+
+	private:
+		T*		m_data		= nullptr;
+		size_t	m_capacity	= 0;
+		size_t	m_size		= 0;
+	};
+
+	// operator new calls made by the calling thread so far; the difference around a piece of code counts its heap allocations.
+	// Only builds with the NRC_COUNT_ALLOCATIONS option replace operator new to count them (cpu_alloc_count.cpp), 0 otherwise
+	uint64_t threadHeapAllocations();
+	bool heapAllocationsCounted();
+}
@@ -0,0 +1,1481 @@
+#include <cpu_benchmark.h>
+#include <cpu_renderer.h>
+#include <cpu_bvh_cache.h>
+#include <cpu_nrc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace NRC
+{
+	// best of a few runs, in seconds
+	template <typename Fn>
+	static double bestTime(int runs, Fn fn)
+	{
+		double best = 1e30;
+		for (int r = 0; r < runs; r++)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			fn();
+			const auto end = std::chrono::high_resolution_clock::now();
+			best = std::min(best, std::chrono::duration<double>(end - start).count());
+		}
+		return best;
+	}
+
+	// a hit differs from its reference when it names another triangle or its distance moves beyond float noise
+	static const float hitDistanceTolerance = 1e-5f;		// relative, at least 1
+
+	static bool hitsDiffer(const Hit& hit, const Hit& reference)
+	{
+		return hit.primitive != reference.primitive ||
+			   std::fabs(hit.t - reference.t) > hitDistanceTolerance * std::max(1.0f, std::fabs(reference.t));
+	}
+
+	void makeBenchmarkMesh(uint32_t triangleCount, std::vector<float>& positions, std::vector<uint32_t>& indices)
+	{
+		const uint32_t quads = std::max(1u, uint32_t(std::sqrt(double(triangleCount) / 2.0)));
+		positions.clear();
+		indices.clear();
+		positions.reserve(size_t(quads + 1) * (quads + 1) * 3);
+		indices.reserve(size_t(quads) * quads * 6);
+		for (uint32_t z = 0; z <= quads; z++)
+		{
+			for (uint32_t x = 0; x <= quads; x++)
+			{
+				const float u = float(x) / quads;
+				const float v = float(z) / quads;
+				positions.push_back(2.0f * u - 1.0f);
+				positions.push_back(0.2f * std::sin(12.0f * u) * std::cos(9.0f * v) + 0.05f * std::sin(57.0f * u * v));
+				positions.push_back(2.0f * v - 1.0f);
+			}
+		}
+		for (uint32_t z = 0; z < quads; z++)
+		{
+			for (uint32_t x = 0; x < quads; x++)
+			{
+				const uint32_t i0 = z * (quads + 1) + x;
+				const uint32_t i1 = i0 + 1;
+				const uint32_t i2 = i0 + quads + 1;
+				const uint32_t i3 = i2 + 1;
+				indices.insert(indices.end(), { i0, i2, i1, i1, i2, i3 });
+			}
+		}
+	}
+
+	void makeBenchmarkRays(const AABB& bounds, uint32_t rayCount, std::vector<Ray>& rays)
+	{
+		uint32_t rngState = 12345u;
+		auto random = [&rngState]()
+		{
+			rngState = rngState * 747796405u + 1u;
+			uint32_t word = ((rngState >> ((rngState >> 28) + 4)) ^ rngState) * 277803737u;
+			return float((word >> 22) ^ word) / 4294967295.0f;
+		};
+		const vec3	center	= bounds.center();
+		const float radius	= 0.5f * length(bounds.extent());
+		rays.resize(rayCount);
+		for (Ray& ray : rays)
+		{
+			// origin on a sphere around the bounds, target inside them
+			const float z	= 2.0f * random() - 1.0f;
+			const float phi = 2.0f * 3.14159265f * random();
+			const float r	= std::sqrt(std::max(0.0f, 1.0f - z * z));
+			ray.origin = center + vec3(r * std::cos(phi), z, r * std::sin(phi)) * (1.5f * radius);
+			const vec3 target = bounds.lo + bounds.extent() * vec3(random(), random(), random());
+			ray.direction	= normalize(target - ray.origin);
+			ray.tMin		= 0.0f;
+			ray.tMax		= FLT_MAX;
+		}
+	}
+
+	void benchmarkBvhBuild(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		printf("BVH build, %u triangles (binned SAH)\n", triangleCount);
+		printf("%8s %12s %14s %10s %8s\n", "threads", "ms", "Mtris/s", "SAH cost", "nodes");
+		for (uint32_t threads = 1; threads <= 64; threads *= 2)
+		{
+			BvhBuildSettings settings;
+			settings.threadCount = threads;
+			Bvh bvh;
+			const double seconds = bestTime(3, [&]() { bvh.build(positions.data(), indices.data(), triangleCount, settings); });
+			printf("%8u %12.2f %14.2f %10.2f %8zu\n", threads, seconds * 1e3, triangleCount / seconds * 1e-6,
+				   bvh.sahCost(), bvh.nodes().size());
+		}
+	}
+
+	void benchmarkTraversal(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		Bvh bvh;
+		bvh.build(positions.data(), indices.data(), triangleCount);
+		Bvh bvhWideLeaves;
+		bvhWideLeaves.build(positions.data(), indices.data(), triangleCount, Bvh8::buildSettings());
+		Bvh8 bvh8;
+		bvh8.collapse(bvhWideLeaves, positions.data(), indices.data());
+
+		std::vector<Ray> rays;
+		makeBenchmarkRays(bvh8.bounds(), 1 << 20, rays);
+
+		// reference hits of the binary BVH; the BVH8 node tests are conservative, so any difference is a bug
+		std::vector<Hit> reference(rays.size());
+		const double binarySeconds = bestTime(3, [&]()
+		{
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				reference[i] = Hit();
+				bvh.intersect(rays[i], reference[i], positions.data(), indices.data());
+			}
+		});
+
+		printf("Closest hit, %u triangles, %zu rays, BVH2 %zu nodes, BVH8 %u nodes (%.1f KiB)\n", triangleCount, rays.size(),
+			   bvh.nodes().size(), bvh8.nodeCount(), bvh8.memoryBytes() / 1024.0);
+		printf("%12s %12s %10s\n", "kernel", "Mrays/s", "differ");
+		printf("%12s %12.2f %10d\n", "BVH2 scalar", rays.size() / binarySeconds * 1e-6, 0);
+
+		const SimdLevel supported = detectSimdLevel();
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 })
+		{
+			if (level > supported)
+			{
+				continue;
+			}
+			uint32_t mismatches = 0;
+			const double seconds = bestTime(3, [&]()
+			{
+				mismatches = 0;
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					Hit hit;
+					bvh8.intersect(rays[i], hit, level);
+					mismatches += hitsDiffer(hit, reference[i]);
+				}
+			});
+			printf("%5s %-6s %12.2f %10u\n", "BVH8", simdLevelName(level), rays.size() / seconds * 1e-6, mismatches);
+		}
+	}
+
+	void benchmarkTriangleKernels(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		// triangles packed in leaf order, as traversal sees them
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		Bvh bvh;
+		bvh.build(positions.data(), indices.data(), triangleCount, Bvh8::buildSettings());
+		Bvh8 bvh8;
+		bvh8.collapse(bvh, positions.data(), indices.data());
+		const TriangleGroup*	groups		= bvh8.triangles();
+		const uint32_t			groupCount	= bvh8.groupCount();
+
+		// every ray tests a window of groups, about 32M triangle tests per kernel
+		const uint32_t windowGroups = std::min(groupCount, 64u);
+		const uint32_t windowTests	= windowGroups * triangleGroupWidth;
+		std::vector<Ray> rays;
+		makeBenchmarkRays(bvh8.bounds(), std::max(1u << 12, (1u << 25) / windowTests), rays);
+		auto windowStart = [&](size_t ray) { return uint32_t(ray * 40503u % (groupCount - windowGroups + 1)); };
+
+		// baseline: the same triangles through the index and position arrays
+		std::vector<Hit> reference(rays.size());
+		const double indexedSeconds = bestTime(3, [&]()
+		{
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				reference[i] = Hit();
+				const uint32_t first = windowStart(i);
+				for (uint32_t g = first; g < first + windowGroups; g++)
+				{
+					for (uint32_t lane = 0; lane < triangleGroupWidth && groups[g].primitive[lane] != ~0u; lane++)
+					{
+						const uint32_t prim = groups[g].primitive[lane];
+						intersectTriangle(rays[i],
+										  loadVec3(positions.data(), indices[3 * size_t(prim) + 0]),
+										  loadVec3(positions.data(), indices[3 * size_t(prim) + 1]),
+										  loadVec3(positions.data(), indices[3 * size_t(prim) + 2]),
+										  prim, reference[i]);
+					}
+				}
+			}
+		});
+
+		const double tests = double(rays.size()) * windowTests;
+		printf("Ray-triangle kernels, %u triangles in %u groups, %zu rays x %u triangles\n", triangleCount, groupCount,
+			   rays.size(), windowTests);
+		printf("%16s %12s %10s %8s\n", "kernel", "Mtests/s", "differ", "speedup");
+		printf("%16s %12.1f %10d %8.2f\n", "indexed scalar", tests / indexedSeconds * 1e-6, 0, 1.0);
+
+		const SimdLevel supported = detectSimdLevel();
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 })
+		{
+			if (level > supported)
+			{
+				continue;
+			}
+			uint32_t mismatches = 0;
+			const double seconds = bestTime(3, [&]()
+			{
+				mismatches = 0;
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					Hit hit;
+					intersectTriangleGroups(rays[i], groups + windowStart(i), windowGroups, hit, level);
+					mismatches += hitsDiffer(hit, reference[i]);
+				}
+			});
+			printf("%9s %-6s %12.1f %10u %8.2f\n", "packed", simdLevelName(level), tests / seconds * 1e-6, mismatches,
+				   indexedSeconds / seconds);
+		}
+	}
+
+	void benchmarkPackets(const std::vector<float>& positions, const std::vector<uint32_t>& indices, bool renderScene)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		Bvh bvh;
+		bvh.build(positions.data(), indices.data(), triangleCount, Bvh8::buildSettings());
+		Bvh8 bvh8;
+		bvh8.collapse(bvh, positions.data(), indices.data());
+
+		// one camera ray per pixel of a full frame looking at the bounds, in 4x4 blocks (a 16-ray packet, or two 8-ray ones)
+		const AABB		bounds	= bvh8.bounds();
+		const float		radius	= 0.5f * length(bounds.extent());
+		const vec3		eye		= bounds.center() + vec3(0.3f, 0.6f, 1.6f) * radius;
+		const vec3		forward = normalize(bounds.center() - eye);
+		const vec3		right	= normalize(cross(forward, vec3(0.0f, 1.0f, 0.0f)));
+		const vec3		up		= cross(right, forward);
+		const uint32_t	width	= RENDER_WIDTH;
+		const uint32_t	height	= RENDER_HEIGHT;
+		std::vector<Ray> rays;
+		rays.reserve(size_t(width) * height);
+		for (uint32_t by = 0; by < height; by += 4)
+		{
+			for (uint32_t bx = 0; bx < width; bx += 4)
+			{
+				for (uint32_t y = by; y < std::min(by + 4, height); y++)
+				{
+					for (uint32_t x = bx; x < std::min(bx + 4, width); x++)
+					{
+						const float u = (2.0f * (x + 0.5f) - width) / height;
+						const float v = -(2.0f * (y + 0.5f) - height) / height;
+						Ray ray;
+						ray.origin		= eye;
+						ray.direction	= normalize(forward + right * (0.5f * u) + up * (0.5f * v));
+						ray.tMin		= 0.0f;
+						ray.tMax		= FLT_MAX;
+						rays.push_back(ray);
+					}
+				}
+			}
+		}
+
+		std::vector<Hit> reference(rays.size());
+		const double singleSeconds = bestTime(3, [&]()
+		{
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				reference[i] = Hit();
+				bvh8.intersect(rays[i], reference[i]);
+			}
+		});
+		printf("Camera rays, %u triangles, %ux%u rays, %s\n", triangleCount, width, height, simdLevelName(bvh8.simdLevel()));
+		printf("%12s %12s %10s %8s\n", "packet", "Mrays/s", "differ", "speedup");
+		printf("%12s %12.2f %10d %8.2f\n", "single", rays.size() / singleSeconds * 1e-6, 0, 1.0);
+
+		std::vector<Hit> hits(rays.size());
+		for (uint32_t packetSize : { 8u, 16u })
+		{
+			const double seconds = bestTime(3, [&]()
+			{
+				for (size_t first = 0; first < rays.size(); first += packetSize)
+				{
+					const uint32_t count = uint32_t(std::min<size_t>(packetSize, rays.size() - first));
+					for (uint32_t i = 0; i < count; i++)
+					{
+						hits[first + i] = Hit();
+					}
+					bvh8.intersectPacket(rays.data() + first, hits.data() + first, count, CpuRenderSettings().packetMinActiveRays);
+				}
+			});
+			uint32_t mismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				mismatches += hitsDiffer(hits[i], reference[i]);
+			}
+			printf("%9u ray %12.2f %10u %8.2f\n", packetSize, rays.size() / seconds * 1e-6, mismatches, singleSeconds / seconds);
+		}
+
+		if (!renderScene)
+		{
+			return;
+		}
+
+		// whole path tracer on the scene, bounces are incoherent and mostly fall back to single rays
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width		= RENDER_WIDTH / 4;
+		settings.height		= RENDER_HEIGHT / 4;
+		settings.packetSize = 0;
+		CpuImage referenceImage, image;
+		const CpuRenderStats singleStats = renderer.render(settings, referenceImage);
+		printf("Path tracer, %ux%u, %d spp\n", settings.width, settings.height, NUM_SAMPLES);
+		printf("%12s %12s %12s\n", "packet", "Mrays/s", "max error");
+		printf("%12s %12.2f %12g\n", "single", singleStats.raysPerSecond() * 1e-6, 0.0);
+		for (uint32_t packetSize : { 8u, 16u })
+		{
+			settings.packetSize = packetSize;
+			const CpuRenderStats stats = renderer.render(settings, image);
+			float maxError = 0.0f;
+			for (size_t i = 0; i < image.size(); i++)
+			{
+				maxError = std::max(maxError, std::fabs(image[i] - referenceImage[i]));
+			}
+			printf("%9u ray %12.2f %12g\n", packetSize, stats.raysPerSecond() * 1e-6, maxError);
+		}
+	}
+
+	void benchmarkRaySorting(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width			= RENDER_WIDTH / 4;
+		settings.height			= RENDER_HEIGHT / 4;
+		settings.streamTiles	= 64;
+
+		printf("Ray stream of %u tiles, %ux%u, %d spp, %u triangles\n", settings.streamTiles, settings.width, settings.height,
+			   NUM_SAMPLES, uint32_t(indices.size() / 3));
+		printf("%12s %10s %12s %8s\n", "packet", "binned", "Mrays/s", "gain");
+		double lowestGain	= 1e30;
+		double highestGain	= 0.0;
+		for (uint32_t packetSize : { 0u, 16u })
+		{
+			CpuImage image;
+			settings.packetSize			= packetSize;
+			settings.sortSecondaryRays	= false;
+			const double unsorted = renderer.render(settings, image).raysPerSecond();
+			settings.sortSecondaryRays	= true;
+			const double sorted = renderer.render(settings, image).raysPerSecond();
+			printf("%12u %10s %12.2f %8s\n", packetSize, "no", unsorted * 1e-6, "");
+			printf("%12u %10s %12.2f %7.2fx\n", packetSize, "yes", sorted * 1e-6, sorted / unsorted);
+			lowestGain	= std::min(lowestGain, sorted / unsorted);
+			highestGain	= std::max(highestGain, sorted / unsorted);
+		}
+		printf("binned streams trace at %.2fx to %.2fx of unbinned ones; --sort-rays is off by default\n", lowestGain, highestGain);
+	}
+
+	void benchmarkBvhCache(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t			triangleCount	= uint32_t(indices.size() / 3);
+		const BvhBuildSettings	settings		= Bvh8::buildSettings();
+		std::vector<Ray> rays;
+
+		// the cold path: hash, build, collapse, store
+		uint64_t sceneHash = 0;
+		const double hashSeconds = bestTime(3, [&]()
+		{
+			sceneHash = hashScene(positions.data(), positions.size(), indices.data(), indices.size(), settings);
+		});
+		Bvh8 built;
+		const double buildSeconds = bestTime(1, [&]()
+		{
+			Bvh bvh;
+			bvh.build(positions.data(), indices.data(), triangleCount, settings);
+			built.collapse(bvh, positions.data(), indices.data());
+		});
+		const std::string path = bvhCachePath(".", sceneHash);
+		bool saved = false;
+		const double saveSeconds = bestTime(1, [&]() { saved = saveBvhCache(path, sceneHash, built); });
+		if (!saved)
+		{
+			printf("BVH cache: could not write %s\n", path.c_str());
+			return;
+		}
+
+		// the warm path: map only, or map and check every byte
+		Bvh8 mapped;
+		bool loaded = true;
+		const double mapSeconds = bestTime(5, [&]() { loaded &= loadBvhCache(path, sceneHash, false, mapped); });
+		const double verifySeconds = bestTime(5, [&]() { loaded &= loadBvhCache(path, sceneHash, true, mapped); });
+		const bool rejectsOtherScene = !loadBvhCache(path, sceneHash + 1, false, mapped);
+
+		// first rays fault the mapped pages in; hits must match the built BVH
+		makeBenchmarkRays(built.bounds(), 1 << 18, rays);
+		std::vector<Hit> builtHits(rays.size()), mappedHits(rays.size());
+		auto trace = [&rays](const Bvh8& bvh, std::vector<Hit>& hits)
+		{
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				hits[i] = Hit();
+				bvh.intersect(rays[i], hits[i]);
+			}
+		};
+		Bvh8 fresh;
+		loaded &= loadBvhCache(path, sceneHash, false, fresh);
+		const double firstTraceSeconds	= bestTime(1, [&]() { trace(fresh, mappedHits); });
+		const double builtTraceSeconds	= bestTime(3, [&]() { trace(built, builtHits); });
+		const double mappedTraceSeconds	= bestTime(3, [&]() { trace(fresh, mappedHits); });
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < rays.size(); i++)
+		{
+			mismatches += builtHits[i].primitive != mappedHits[i].primitive || builtHits[i].t != mappedHits[i].t;
+		}
+		remove(path.c_str());
+
+		printf("BVH cache, %u triangles, %.1f KiB of nodes and groups\n", triangleCount, built.memoryBytes() / 1024.0);
+		printf("%28s %12s\n", "step", "ms");
+		printf("%28s %12.3f\n", "scene hash", hashSeconds * 1e3);
+		printf("%28s %12.3f\n", "build + collapse", buildSeconds * 1e3);
+		printf("%28s %12.3f\n", "store", saveSeconds * 1e3);
+		printf("%28s %12.3f\n", "map", mapSeconds * 1e3);
+		printf("%28s %12.3f\n", "map + verify checksum", verifySeconds * 1e3);
+		printf("%28s %12.3f\n", "first rays, mapped (faults)", firstTraceSeconds * 1e3);
+		printf("%28s %12.3f\n", "rays, mapped", mappedTraceSeconds * 1e3);
+		printf("%28s %12.3f\n", "rays, built", builtTraceSeconds * 1e3);
+		printf("%zu rays, %u differ, loads %s, other scene %s\n", rays.size(), mismatches, loaded ? "ok" : "FAILED",
+			   rejectsOtherScene ? "rejected" : "ACCEPTED");
+	}
+
+	// the generated mesh crossed by long thin quads at random diagonal angles: each beam's box spans much of the
+	// scene and overlaps the mesh below it, the bad case for object splits
+	static void makeBeamScene(uint32_t triangleCount, std::vector<float>& positions, std::vector<uint32_t>& indices)
+	{
+		makeBenchmarkMesh(triangleCount, positions, indices);
+		const uint32_t beamCount = std::max(1u, triangleCount / 256);
+		uint32_t rngState = 777u;
+		auto random = [&rngState]()
+		{
+			rngState = rngState * 747796405u + 1u;
+			return float(rngState >> 8) / float(1u << 24);
+		};
+		for (uint32_t b = 0; b < beamCount; b++)
+		{
+			// as long as the scene and a hundredth of that wide, rotated around y and tilted
+			const float angle	= 3.14159265f * random();
+			const vec3	center	= vec3(2.0f * random() - 1.0f, 2.0f * random() - 1.0f, 2.0f * random() - 1.0f);
+			const vec3	along	= vec3(std::cos(angle), random() - 0.5f, std::sin(angle));
+			const vec3	across	= vec3(-along.z, 0.05f, along.x) * 0.01f;
+			const vec3	corners[4] = { center - along - across, center + along - across, center - along + across, center + along + across };
+			const uint32_t base = uint32_t(positions.size() / 3);
+			for (const vec3& c : corners)
+			{
+				positions.insert(positions.end(), { c.x, c.y, c.z });
+			}
+			indices.insert(indices.end(), { base, base + 1, base + 2, base + 1, base + 3, base + 2 });
+		}
+	}
+
+	void benchmarkSpatialSplits(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		std::vector<Ray> rays;
+		std::vector<Hit> reference;
+
+		printf("Binned SAH against spatial splits, %u triangles\n", triangleCount);
+		printf("%10s %10s %12s %10s %10s %12s %10s\n", "budget", "build ms", "references", "SAH cost", "BVH8 nodes", "Mrays/s", "differ");
+		for (float budget : { -1.0f, 0.1f, 0.25f, 0.5f })
+		{
+			BvhBuildSettings settings = Bvh8::buildSettings();
+			settings.spatialSplits	= budget >= 0.0f;
+			settings.splitBudget	= std::max(0.0f, budget);
+
+			Bvh		bvh;
+			Bvh8	bvh8;
+			const double buildSeconds = bestTime(3, [&]()
+			{
+				bvh.build(positions.data(), indices.data(), triangleCount, settings);
+				bvh8.collapse(bvh, positions.data(), indices.data());
+			});
+			if (rays.empty())
+			{
+				makeBenchmarkRays(bvh8.bounds(), 1 << 18, rays);
+			}
+
+			std::vector<Hit> hits(rays.size());
+			const double traceSeconds = bestTime(3, [&]()
+			{
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					hits[i] = Hit();
+					bvh8.intersect(rays[i], hits[i]);
+				}
+			});
+			// the binned build is the reference; a clipped reference never changes which triangle is hit
+			uint32_t mismatches = 0;
+			if (reference.empty())
+			{
+				reference = hits;
+			}
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				mismatches += hitsDiffer(hits[i], reference[i]);
+			}
+
+			char budgetName[16];
+			snprintf(budgetName, sizeof(budgetName), budget < 0.0f ? "binned" : "%.2f", budget);
+			printf("%10s %10.1f %12zu %10.2f %10u %12.2f %10u\n", budgetName, buildSeconds * 1e3, bvh.primIndices().size(),
+				   bvh.sahCost(settings.traversalCost, settings.intersectionCost), bvh8.nodeCount(), rays.size() / traceSeconds * 1e-6,
+				   mismatches);
+		}
+	}
+
+	void benchmarkQuantizedNodes(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		Bvh bvh;
+		bvh.build(positions.data(), indices.data(), triangleCount, Bvh8::buildSettings());
+		Bvh8 bvh8;
+		bvh8.collapse(bvh, positions.data(), indices.data());
+		const size_t floatNodeBytes = bvh8.nodeBytes();
+		Bvh8 quantized = bvh8;
+		const auto quantizeStart = std::chrono::high_resolution_clock::now();
+		const bool packed = quantized.quantize();
+		const double quantizeSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - quantizeStart).count();
+		if (!packed)
+		{
+			printf("Quantized BVH8 nodes, %u triangles: children not stored consecutively\n", triangleCount);
+			return;
+		}
+
+		std::vector<Ray> rays;
+		makeBenchmarkRays(bvh8.bounds(), 1 << 20, rays);
+		std::vector<Hit> reference(rays.size());
+
+		printf("Quantized BVH8 nodes, %u triangles, %u nodes: %.1f MiB float, %.1f MiB quantized (%.2fx smaller, %.1f ms), "
+			   "%.1f MiB triangle groups\n", triangleCount, bvh8.nodeCount(), floatNodeBytes / 1048576.0, quantized.nodeBytes() / 1048576.0,
+			   double(floatNodeBytes) / double(quantized.nodeBytes()), quantizeSeconds * 1e3, (bvh8.memoryBytes() - floatNodeBytes) / 1048576.0);
+		printf("%12s %12s %12s %8s %10s\n", "kernel", "float Mrays", "quant Mrays", "ratio", "differ");
+		const SimdLevel supported = detectSimdLevel();
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 })
+		{
+			if (level > supported)
+			{
+				continue;
+			}
+			const double floatSeconds = bestTime(3, [&]()
+			{
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					reference[i] = Hit();
+					bvh8.intersect(rays[i], reference[i], level);
+				}
+			});
+			// dequantized boxes contain the float ones, so the same triangles are found
+			uint32_t mismatches = 0;
+			const double quantizedSeconds = bestTime(3, [&]()
+			{
+				mismatches = 0;
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					Hit hit;
+					quantized.intersect(rays[i], hit, level);
+					mismatches += hitsDiffer(hit, reference[i]);
+				}
+			});
+			printf("%12s %12.2f %12.2f %8.2f %10u\n", simdLevelName(level), rays.size() / floatSeconds * 1e-6,
+				   rays.size() / quantizedSeconds * 1e-6, floatSeconds / quantizedSeconds, mismatches);
+		}
+	}
+
+	void benchmarkTileScheduling(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width		= RENDER_WIDTH / 4;
+		settings.height		= RENDER_HEIGHT / 4;
+		settings.packetSize = 0;
+		settings.threadCount = 1;
+		CpuImage referenceImage, image;
+		renderer.render(settings, referenceImage);
+
+		printf("Tile scheduling, %ux%u, %d spp, %u triangles, %u hardware threads\n", settings.width, settings.height, NUM_SAMPLES,
+			   uint32_t(indices.size() / 3), std::thread::hardware_concurrency());
+		printf("%8s %10s %12s %8s %8s %10s %10s\n", "threads", "scheduler", "Mrays/s", "chunks", "steals", "imbalance", "max error");
+		const uint32_t maxThreads = std::max(64u, std::thread::hardware_concurrency());
+		for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			for (TileScheduling scheduling : { TileScheduling::Static, TileScheduling::SharedCounter, TileScheduling::WorkStealing })
+			{
+				settings.threadCount	= threads;
+				settings.scheduling		= scheduling;
+				const CpuRenderStats stats = renderer.render(settings, image);
+				float maxError = 0.0f;
+				for (size_t i = 0; i < image.size(); i++)
+				{
+					maxError = std::max(maxError, std::fabs(image[i] - referenceImage[i]));
+				}
+				printf("%8u %10s %12.2f %8llu %8llu %10.2f %10g\n", threads, tileSchedulingName(scheduling), stats.raysPerSecond() * 1e-6,
+					   static_cast<unsigned long long>(stats.tileChunks), static_cast<unsigned long long>(stats.tileSteals),
+					   stats.imbalance, maxError);
+			}
+		}
+	}
+
+	void benchmarkNumaPlacement(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		const NumaTopology& topology = renderer.numaTopology();
+		printf("NUMA placement, %u triangles, %u nodes:", uint32_t(indices.size() / 3), topology.nodeCount());
+		for (uint32_t node = 0; node < topology.nodeCount(); node++)
+		{
+			printf(" node %u: %zu CPUs", topology.nodeIds[node], topology.nodeCpus[node].size());
+		}
+		printf("\n");
+
+		CpuRenderSettings settings;
+		settings.width		= RENDER_WIDTH / 2;
+		settings.height		= RENDER_HEIGHT / 2;
+		settings.packetSize = 0;
+		CpuImage referenceImage, image;
+		renderer.render(settings, referenceImage);
+
+		printf("%11s %8s %8s %12s %10s  %s\n", "bvh", "pinning", "placed", "Mrays/s", "max error", "Mrays/s per node");
+		for (BvhPlacement placement : { BvhPlacement::Shared, BvhPlacement::Replicate, BvhPlacement::Interleave })
+		{
+			const bool placed = renderer.placeBvh(placement);
+			for (bool pinning : { false, true })
+			{
+				settings.numaPinning = pinning;
+				const CpuRenderStats stats = renderer.render(settings, image);
+				float maxError = 0.0f;
+				for (size_t i = 0; i < image.size(); i++)
+				{
+					maxError = std::max(maxError, std::fabs(image[i] - referenceImage[i]));
+				}
+				printf("%11s %8s %8s %12.2f %10g ", bvhPlacementName(placement), pinning ? "on" : "off", placed ? "yes" : "no",
+					   stats.raysPerSecond() * 1e-6, maxError);
+				for (uint64_t nodeRays : stats.nodeRaysTraced)
+				{
+					printf(" %8.2f", stats.seconds > 0.0 ? double(nodeRays) / stats.seconds * 1e-6 : 0.0);
+				}
+				printf("\n");
+			}
+		}
+		renderer.placeBvh(BvhPlacement::Shared);
+	}
+
+	void benchmarkArenaAllocations(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width	= RENDER_WIDTH / 4;
+		settings.height = RENDER_HEIGHT / 4;
+
+		struct Mode
+		{
+			const char* name;
+			uint32_t	packetSize;
+			bool		sortSecondaryRays;
+			uint32_t	streamTiles;
+			bool		radianceCache;
+		};
+		// with the cache, the workers' training records come from their arenas, one reset per frame
+		const Mode modes[] = {
+			{ "single rays",		0,						false,	1,	false },
+			{ "packets",			Bvh8::maxPacketSize,	false,	1,	false },
+			{ "packets, sorted",	Bvh8::maxPacketSize,	true,	1,	false },
+			{ "4-tile streams",		Bvh8::maxPacketSize,	true,	4,	false },
+			{ "radiance cache",		0,						false,	1,	true },
+		};
+		printf("Arena allocations, %ux%u, %d spp, %u triangles\n", settings.width, settings.height, NUM_SAMPLES, uint32_t(indices.size() / 3));
+		if (!heapAllocationsCounted())
+		{
+			printf("heap allocations are only counted in builds with -DNRC_COUNT_ALLOCATIONS=ON\n");
+		}
+		printf("%16s %8s %12s %20s\n", "mode", "threads", "Mrays/s", "steady allocations");
+		const uint32_t threadCounts[] = { 1, std::max(4u, std::thread::hardware_concurrency()) };
+		for (const Mode& mode : modes)
+		{
+			for (uint32_t threads : threadCounts)
+			{
+				settings.packetSize			= mode.packetSize;
+				settings.sortSecondaryRays	= mode.sortSecondaryRays;
+				settings.streamTiles		= mode.streamTiles;
+				settings.radianceCache		= mode.radianceCache;
+				settings.threadCount		= threads;
+				CpuImage image;
+				const CpuRenderStats stats = renderer.render(settings, image);
+				if (heapAllocationsCounted())
+				{
+					printf("%16s %8u %12.2f %20llu\n", mode.name, threads, stats.raysPerSecond() * 1e-6,
+						   static_cast<unsigned long long>(stats.steadyHeapAllocations));
+				}
+				else
+				{
+					printf("%16s %8u %12.2f %20s\n", mode.name, threads, stats.raysPerSecond() * 1e-6, "-");
+				}
+			}
+		}
+	}
+
+	void benchmarkCpuNrc()
+	{
+		const uint32_t	queryCount		= 1 << 16;
+		const uint32_t	recordCount		= 1 << 14;		// per training step
+		const uint32_t	steps			= 8;
+		const uint32_t	checkedCount	= 1024;
+		const uint32_t	threads			= std::thread::hardware_concurrency();
+
+		std::vector<NrcTrainingRecord> records(recordCount);
+		std::vector<NrcQuery> queries(queryCount);
+		uint32_t rngState = 1234u;
+		for (NrcTrainingRecord& record : records)
+		{
+			record = makeNrcBenchmarkRecord(rngState);
+		}
+		for (NrcQuery& query : queries)
+		{
+			query = nrcQueryOf(makeNrcBenchmarkRecord(rngState));
+		}
+
+		printf("CPU NRC, %u queries, %u records per training step, %u threads\n", queryCount, recordCount, threads);
+		printf("%-46s %8s %12s %10s %12s %10s %18s\n", "network", "kernel", "Mqueries/s", "max error", "Mrecords/s", "step error",
+			   "loss");
+		const SimdLevel supported = detectSimdLevel();
+		for (const NrcNetworkConfig& network : nrcBenchmarkNetworks())
+		{
+			for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512 })
+			{
+				if (level > supported)
+				{
+					continue;
+				}
+				NrcSettings settings;
+				settings.network = network;
+				CpuNeuralRadianceCache cache;
+				cache.init(settings, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax, threads, level);
+				std::vector<float> weights	= cache.weights();
+				std::vector<float> grid		= initializeNrcGrid(settings.network, settings.seed);
+				for (float& parameter : grid)
+				{
+					parameter *= 1e3f;		// features of the size a trained grid has
+				}
+				cache.setParameters(weights, grid);
+
+				// queries against nrcForward
+				std::vector<float> results(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+				const double querySeconds = bestTime(3, [&]() { cache.query(queries.data(), queryCount, results.data()); });
+				float maxError = 0.0f;
+				for (uint32_t q = 0; q < checkedCount; q++)
+				{
+					const uint32_t	index	= q * (queryCount / checkedCount);
+					float			unitPos[3];
+					float			encoded[NRC_WIDTH];
+					float			expected[NRC_OUTPUT_WIDTH];
+					const uint32_t	region	= nrcRegionUnitPosition(network, queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, unitPos);
+					nrcEncodeInput(settings.network, grid.data(), queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+					nrcForward(settings.network, weights.data() + region * network.regionWeightCount(), encoded, expected);
+					for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+					{
+						maxError = std::max(maxError, std::fabs(results[index * NRC_OUTPUT_WIDTH + c] - expected[c]));
+					}
+				}
+
+				// the first step on a few records against nrcBackward, nrcGridBackward and nrcAdamStep
+				cache.train(records.data(), checkedCount);
+				std::vector<float> gradients(weights.size(), 0.0f);
+				std::vector<float> gridGradients(grid.size(), 0.0f);
+				const std::vector<uint32_t> regionRecords = nrcRegionCounts(network, records.data(), checkedCount, nrcBenchmarkSceneMin,
+																			nrcBenchmarkSceneScale);
+				for (uint32_t r = 0; r < checkedCount; r++)
+				{
+					const NrcQuery	query	= nrcQueryOf(records[r]);
+					float			encoded[NRC_WIDTH];
+					float			inputGradients[NRC_WIDTH];
+					float			unitPos[3];
+					const uint32_t	region	= nrcRegionUnitPosition(network, query, nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, unitPos);
+					nrcEncodeInput(settings.network, grid.data(), query, nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+					nrcBackward(settings.network, weights.data() + region * network.regionWeightCount(), encoded, records[r].radiance,
+								1.0f / float(regionRecords[region]), gradients.data() + region * network.regionWeightCount(), inputGradients);
+					nrcGridBackward(settings.network, unitPos, inputGradients, gridGradients.data() + region * network.regionGridParameterCount());
+				}
+				std::vector<float> moments(2 * weights.size(), 0.0f);
+				std::vector<float> gridMoments(2 * grid.size(), 0.0f);
+				nrcAdamStep(weights.data(), gradients.data(), moments.data(), weights.size(), 1, settings.learningRate);
+				nrcAdamStep(grid.data(), gridGradients.data(), gridMoments.data(), grid.size(), 1, settings.learningRate);
+				float stepError = 0.0f;
+				for (size_t w = 0; w < weights.size(); w++)
+				{
+					stepError = std::max(stepError, std::fabs(cache.weights()[w] - weights[w]));
+				}
+				for (size_t e = 0; e < grid.size(); e++)
+				{
+					stepError = std::max(stepError, std::fabs(cache.grid()[e] - grid[e]));
+				}
+
+				// timed steps from the initial parameters
+				cache.setParameters(initializeNrcWeights(settings.network, settings.seed), initializeNrcGrid(settings.network, settings.seed));
+				float firstLoss = 0.0f;
+				float lastLoss	= 0.0f;
+				const double trainSeconds = bestTime(1, [&]()
+				{
+					for (uint32_t step = 0; step < steps; step++)
+					{
+						lastLoss = cache.train(records.data(), recordCount);
+						firstLoss = step == 0 ? lastLoss : firstLoss;
+					}
+				});
+
+				char loss[32];
+				snprintf(loss, sizeof(loss), "%.3f -> %.3f", firstLoss, lastLoss);
+				printf("%-46s %8s %12.2f %10.1e %12.3f %10.1e %18s\n", describeNrcNetwork(network).c_str(), simdLevelName(level),
+					   queryCount / querySeconds * 1e-6, maxError, double(recordCount) * steps / trainSeconds * 1e-6, stepError, loss);
+			}
+		}
+	}
+
+	void benchmarkNrcPathSpread(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width	= RENDER_WIDTH / 5;
+		settings.height	= RENDER_HEIGHT / 5;
+		CpuImage referenceImage, image;
+		const CpuRenderStats	reference	= renderer.render(settings, referenceImage);
+		const double			paths		= double(settings.width) * settings.height * NUM_SAMPLES;
+
+		printf("Radiance cache path termination, %ux%u, %d frames, %u triangles\n", settings.width, settings.height, NUM_SAMPLES,
+			   uint32_t(indices.size() / 3));
+		double referenceMean = 0.0;
+		for (float value : referenceImage)
+		{
+			referenceMean += value;
+		}
+		referenceMean /= double(referenceImage.size());
+		printf("%-28s %10s %10s %12s %10s %10s %10s %10s %10s\n", "paths end", "rays/path", "shorter", "trace s", "speedup", "total s", "mean",
+			   "vs ref", "rmse");
+		printf("%-28s %10.2f %10s %12.3f %10s %10.3f %10.4f %10s %10s\n", "reference", double(reference.raysTraced) / paths, "", reference.seconds,
+			   "", reference.seconds, referenceMean, "", "");
+
+		// the fixed default, then the heuristic with room for the paths to get there; the
+		// last rows skip the warm-up, to show what the cold cache's overshoot costs
+		const uint32_t warmupFrames = NrcPathSettings().warmupFrames;
+		struct Variant { const char* name; uint32_t cacheVertex; uint32_t suffixVertices; float spreadThreshold; uint32_t warmupFrames; };
+		const Variant variants[] = {
+			{ "vertex 1",					1, 8, 0.0f,		warmupFrames },
+			{ "vertex 2",					2, 8, 0.0f,		warmupFrames },
+			{ "spread c = 0.1",				8, 8, 0.1f,		warmupFrames },
+			{ "spread c = 0.01",			8, 8, 0.01f,	warmupFrames },
+			{ "spread c = 0.001",			8, 8, 0.001f,	warmupFrames },
+			{ "vertex 1, no warm-up",		1, 8, 0.0f,		0 },
+			{ "spread c = 0.1, no warm-up",	8, 8, 0.1f,		0 },
+		};
+		settings.radianceCache = true;
+		for (const Variant& variant : variants)
+		{
+			settings.nrc.cacheVertex		= variant.cacheVertex;
+			settings.nrc.suffixVertices		= variant.suffixVertices;
+			settings.nrc.spreadThreshold	= variant.spreadThreshold;
+			settings.nrc.warmupFrames		= variant.warmupFrames;
+			const CpuRenderStats stats = renderer.render(settings, image);
+			double mean			= 0.0;
+			double squaredError	= 0.0;
+			for (size_t i = 0; i < image.size(); i++)
+			{
+				mean			+= image[i];
+				squaredError	+= double(image[i] - referenceImage[i]) * double(image[i] - referenceImage[i]);
+			}
+			mean /= double(image.size());
+			const double raysPerPath	= double(stats.raysTraced) / paths;
+			const double traceSeconds	= stats.seconds - stats.cacheSeconds;
+			printf("%-28s %10.2f %9.2fx %12.3f %9.2fx %10.3f %10.4f %+9.1f%% %10.4f\n", variant.name, raysPerPath,
+				   double(reference.raysTraced) / paths / raysPerPath, traceSeconds, reference.seconds / traceSeconds, stats.seconds, mean,
+				   100.0 * (mean / referenceMean - 1.0), std::sqrt(squaredError / double(image.size())));
+		}
+	}
+
+	bool benchmarkNrcCheckpoint(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width	= RENDER_WIDTH / 5;
+		settings.height	= RENDER_HEIGHT / 5;
+		CpuImage referenceImage, image;
+		// the reference traces other samples than the jobs: with the same seed, a cold job's warm-up frames would be
+		// the reference's own and hide their error, which jobs that skip the warm-up cannot match
+		settings.seed = 1;
+		renderer.render(settings, referenceImage);
+		settings.seed = 0;
+		auto rmse = [&]()
+		{
+			double squaredError = 0.0;
+			for (size_t i = 0; i < image.size(); i++)
+			{
+				squaredError += double(image[i] - referenceImage[i]) * double(image[i] - referenceImage[i]);
+			}
+			return std::sqrt(squaredError / double(image.size()));
+		};
+
+		renderer.render(settings, image);
+		const double noiseFloor = rmse();		// of the reference at the jobs' seed
+
+		const uint64_t		sceneHash	= hashNrcScene(positions.data(), positions.size(), indices.data(), indices.size());
+		const float			camera[3]	= { float(CAMERA_ORIGIN_X), float(CAMERA_ORIGIN_Y), float(CAMERA_ORIGIN_Z) };
+		NrcNetworkConfig	gridNetwork;
+		gridNetwork.hiddenLayers	= 2;
+		gridNetwork.gridLevels		= 8;
+		bool passed = true;
+		for (const NrcNetworkConfig& network : { NrcNetworkConfig(), gridNetwork })
+		{
+			settings.radianceCache			= true;
+			settings.nrc.cache.network		= network;
+			settings.nrcCheckpointDirectory	= ".";
+			settings.nrcCheckpointPolicy	= NrcCheckpointPolicy();
+			const std::string path = nrcCheckpointPath(settings.nrcCheckpointDirectory, sceneHash, network);
+			remove(path.c_str());
+
+			printf("Radiance cache checkpoints, %s, %ux%u, %d frames per job\n", describeNrcNetwork(network).c_str(), settings.width,
+				   settings.height, NUM_SAMPLES);
+			printf("%-28s %12s %10s %10s\n", "job", "start", "steps", "rmse");
+			printf("%-28s %12s %10s %10.4f\n", "no cache", "", "", noiseFloor);
+			auto job = [&](const char* name)
+			{
+				const CpuRenderStats stats = renderer.render(settings, image);
+				const double error = rmse();
+				printf("%-28s %12s %10u %10.4f%s\n", name, nrcWarmStartName(stats.warmStart), stats.trainingSteps, error,
+					   stats.checkpointSaved ? "" : " (not saved)");
+				return error;
+			};
+			const double coldError		= job("first job");
+			const double secondError	= job("second job");
+			const double resumedError	= std::max(secondError, job("third job"));
+			// a camera further than resumeDistance keeps the parameters and restarts Adam
+			settings.nrcCheckpointPolicy.resumeDistance = -1.0f;
+			job("after a camera move");
+			settings.nrcCheckpointPolicy.discardDistance = -1.0f;
+			job("camera move, discarding");
+
+			NrcCacheState state;
+			float writerCamera[3];
+			bool loaded = true;
+			const double loadSeconds = bestTime(5, [&]() { loaded &= loadNrcCheckpoint(path, sceneHash, network, writerCamera, state); });
+			bool saved = true;
+			const double saveSeconds = bestTime(5, [&]() { saved &= saveNrcCheckpoint(path, sceneHash, network, camera, state); });
+			NrcNetworkConfig otherNetwork = network;
+			otherNetwork.hiddenLayers = network.hiddenLayers + 1;
+			const bool rejectsOther = !loadNrcCheckpoint(path, sceneHash + 1, network, writerCamera, state)
+								   && !loadNrcCheckpoint(path, sceneHash, otherNetwork, writerCamera, state);
+			FILE* file = fopen(path.c_str(), "rb");
+			long bytes = 0;
+			if (file != nullptr)
+			{
+				fseek(file, 0, SEEK_END);
+				bytes = ftell(file);
+				fclose(file);
+			}
+			remove(path.c_str());
+			printf("%.1f KiB, store %.3f ms, load %.3f ms, saves %s, loads %s, other scene or network %s\n", bytes / 1024.0, saveSeconds * 1e3,
+				   loadSeconds * 1e3, saved ? "ok" : "FAILED", loaded ? "ok" : "FAILED", rejectsOther ? "rejected" : "ACCEPTED");
+			const bool resumesBetter = resumedError <= coldError;
+			printf("resumed jobs against the cold one: %s\n", resumesBetter ? "ok" : "WORSE");
+			passed &= saved && loaded && rejectsOther && resumesBetter;
+		}
+		return passed;
+	}
+
+	void benchmarkNrcHalfPrecision(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t	queryCount		= 1 << 16;
+		const uint32_t	recordCount		= 1 << 14;
+		const uint32_t	steps			= 32;		// before the comparison, so the weights are past their initial scale
+		const uint32_t	checkedCount	= 1024;
+		const uint32_t	threads			= std::thread::hardware_concurrency();
+
+		std::vector<NrcTrainingRecord> records(recordCount);
+		std::vector<NrcTrainingRecord> testRecords(queryCount);
+		std::vector<NrcQuery> queries(queryCount);
+		uint32_t rngState = 1234u;
+		for (NrcTrainingRecord& record : records)
+		{
+			record = makeNrcBenchmarkRecord(rngState);
+		}
+		for (uint32_t q = 0; q < queryCount; q++)
+		{
+			testRecords[q]	= makeNrcBenchmarkRecord(rngState);
+			queries[q]		= nrcQueryOf(testRecords[q]);
+		}
+
+		printf("Half-precision NRC queries, %u queries after %u training steps, %s, %u threads\n", queryCount, steps,
+			   simdLevelName(detectSimdLevel()), threads);
+		printf("%-46s %9s %12s %10s %12s %12s %12s %10s\n", "network", "precision", "Mqueries/s", "CPU speed", "bytes/query", "max error",
+			   "vs fp32", "test loss");
+		// the CPU rounds like the device to show the error of fp16; the conversions cost it time rather than saving any
+		double slowestHalf = 1e30;
+		double fastestHalf = 0.0;
+		for (const NrcNetworkConfig& network : nrcBenchmarkNetworks())
+		{
+			NrcSettings settings;
+			settings.network = network;
+			CpuNeuralRadianceCache cache;
+			cache.init(settings, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax, threads);
+			for (uint32_t step = 0; step < steps; step++)
+			{
+				cache.train(records.data(), recordCount);
+			}
+			const NrcCacheState state = cache.state();
+			std::vector<float> expected(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+			cache.query(queries.data(), queryCount, expected.data());
+
+			double fp32Seconds = 0.0;
+			for (bool half : { false, true })
+			{
+				settings.halfPrecision = half;
+				CpuNeuralRadianceCache variant;
+				variant.init(settings, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax, threads);
+				variant.setState(state);
+				std::vector<float> results(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+				const double seconds = bestTime(3, [&]() { variant.query(queries.data(), queryCount, results.data()); });
+
+				// against the reference of the same precision, and how far fp16 is from fp32
+				const std::vector<uint16_t> weightsHalf	= nrcHalfCopy(state.weights);
+				const std::vector<uint16_t> gridHalf	= nrcHalfCopy(state.grid);
+				float maxError = 0.0f;
+				for (uint32_t q = 0; q < checkedCount; q++)
+				{
+					const uint32_t	index	= q * (queryCount / checkedCount);
+					float			unitPos[3];
+					float			encoded[NRC_WIDTH];
+					float			reference[NRC_OUTPUT_WIDTH];
+					const size_t	weights	= nrcRegionUnitPosition(network, queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, unitPos)
+											* network.regionWeightCount();
+					if (half)
+					{
+						nrcEncodeInput(network, gridHalf.data(), queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+						nrcForwardHalf(network, weightsHalf.data() + weights, encoded, reference);
+					}
+					else
+					{
+						nrcEncodeInput(network, state.grid.data(), queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+						nrcForward(network, state.weights.data() + weights, encoded, reference);
+					}
+					for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+					{
+						maxError = std::max(maxError, std::fabs(results[index * NRC_OUTPUT_WIDTH + c] - reference[c]));
+					}
+				}
+				float fp32Error = 0.0f;
+				double loss = 0.0;
+				for (uint32_t q = 0; q < queryCount; q++)
+				{
+					for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+					{
+						fp32Error = std::max(fp32Error, std::fabs(results[q * NRC_OUTPUT_WIDTH + c] - expected[q * NRC_OUTPUT_WIDTH + c]));
+					}
+					loss += nrcLoss(results.data() + size_t(q) * NRC_OUTPUT_WIDTH, testRecords[q].radiance, nullptr);
+				}
+
+				// what a device query reads: its share of the matrices of a workgroup, and eight grid entries per level
+				const size_t	parameterBytes	= half ? sizeof(uint16_t) : sizeof(float);
+				const double	bytesPerQuery	= double(network.regionWeightCount() * parameterBytes) / NRC_QUERY_BATCH
+												+ 8.0 * network.gridLevels * network.gridFeatures * parameterBytes;
+				fp32Seconds = half ? fp32Seconds : seconds;
+				if (half)
+				{
+					slowestHalf = std::min(slowestHalf, fp32Seconds / seconds);
+					fastestHalf = std::max(fastestHalf, fp32Seconds / seconds);
+				}
+				printf("%-46s %9s %12.2f %9.2fx %12.1f %12.1e %12.1e %10.4f\n", describeNrcNetwork(network).c_str(), half ? "fp16" : "fp32",
+					   queryCount / seconds * 1e-6, fp32Seconds / seconds, bytesPerQuery, maxError, fp32Error, loss / queryCount);
+			}
+		}
+		printf("fp16 queries run at %.2fx to %.2fx of the fp32 speed on this CPU: they only emulate the device's rounding, the halved "
+			   "bytes/query pay off on the device\n", slowestHalf, fastestHalf);
+
+		// renders with the cache in either precision against the reference
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings renderSettings;
+		renderSettings.width	= RENDER_WIDTH / 5;
+		renderSettings.height	= RENDER_HEIGHT / 5;
+		CpuImage referenceImage, image;
+		renderer.render(renderSettings, referenceImage);
+		NrcNetworkConfig gridNetwork;
+		gridNetwork.hiddenLayers	= 2;
+		gridNetwork.gridLevels		= 8;
+		printf("Radiance cache renders, %ux%u, %d frames\n", renderSettings.width, renderSettings.height, NUM_SAMPLES);
+		printf("%-46s %9s %12s %10s %10s\n", "network", "precision", "cache s", "CPU speed", "rmse");
+		renderSettings.radianceCache = true;
+		for (const NrcNetworkConfig& network : { NrcNetworkConfig(), gridNetwork })
+		{
+			double fp32CacheSeconds = 0.0;
+			for (bool half : { false, true })
+			{
+				renderSettings.nrc.cache.network		= network;
+				renderSettings.nrc.cache.halfPrecision	= half;
+				const CpuRenderStats stats = renderer.render(renderSettings, image);
+				double squaredError = 0.0;
+				for (size_t i = 0; i < image.size(); i++)
+				{
+					squaredError += double(image[i] - referenceImage[i]) * double(image[i] - referenceImage[i]);
+				}
+				fp32CacheSeconds = half ? fp32CacheSeconds : stats.cacheSeconds;
+				printf("%-46s %9s %12.3f %9.2fx %10.4f\n", describeNrcNetwork(network).c_str(), half ? "fp16" : "fp32", stats.cacheSeconds,
+					   fp32CacheSeconds / stats.cacheSeconds, std::sqrt(squaredError / double(image.size())));
+			}
+		}
+	}
+
+	void benchmarkNrcAsyncTraining(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings settings;
+		settings.width	= RENDER_WIDTH / 5;
+		settings.height	= RENDER_HEIGHT / 5;
+		CpuImage referenceImage, image;
+		renderer.render(settings, referenceImage);
+		NrcNetworkConfig gridNetwork;
+		gridNetwork.hiddenLayers	= 2;
+		gridNetwork.gridLevels		= 8;
+		printf("Radiance cache training order, %ux%u, %d frames\n", settings.width, settings.height, NUM_SAMPLES);
+		printf("%-46s %-10s %10s %12s %12s %10s\n", "network", "training", "total s", "training s", "of frame", "rmse");
+		settings.radianceCache = true;
+		for (const NrcNetworkConfig& network : { NrcNetworkConfig(), gridNetwork })
+		{
+			for (bool async : { false, true })
+			{
+				settings.nrc.cache.network			= network;
+				settings.nrc.cache.asyncTraining	= async;
+				const CpuRenderStats stats = renderer.render(settings, image);
+				double squaredError = 0.0;
+				for (size_t i = 0; i < image.size(); i++)
+				{
+					squaredError += double(image[i] - referenceImage[i]) * double(image[i] - referenceImage[i]);
+				}
+				printf("%-46s %-10s %10.3f %12.3f %11.1f%% %10.4f\n", describeNrcNetwork(network).c_str(), async ? "async" : "in frame",
+					   stats.seconds, stats.trainingSeconds, 100.0 * stats.trainingSeconds / stats.seconds, std::sqrt(squaredError / double(image.size())));
+			}
+		}
+	}
+
+	void benchmarkNrcRegions(const std::vector<float>& positions, const std::vector<uint32_t>& indices)
+	{
+		// one network against eight and 27 region networks with as many grid parameters in all
+		NrcNetworkConfig frequencyNetwork;
+		NrcNetworkConfig gridNetwork;
+		gridNetwork.hiddenLayers = 2;
+		gridNetwork.gridLevels	 = 8;
+		std::vector<NrcNetworkConfig> networks;
+		for (const NrcNetworkConfig& network : { frequencyNetwork, gridNetwork })
+		{
+			for (uint32_t regionsPerAxis = 1; regionsPerAxis <= 3; regionsPerAxis++)
+			{
+				NrcNetworkConfig partitioned = network;
+				partitioned.regionsPerAxis = regionsPerAxis;
+				if (network.gridLevels > 0)
+				{
+					partitioned.gridLog2TableSize -= regionsPerAxis == 2 ? 3 : regionsPerAxis == 3 ? 5 : 0;
+				}
+				networks.push_back(partitioned);
+			}
+		}
+
+		// throughput on random records, and the queries against the reference network of their region
+		const uint32_t	queryCount		= 1 << 16;
+		const uint32_t	recordCount		= 1 << 14;
+		const uint32_t	steps			= 8;
+		const uint32_t	checkedCount	= 1024;
+		const uint32_t	threads			= std::thread::hardware_concurrency();
+		std::vector<NrcTrainingRecord> records(recordCount);
+		std::vector<NrcQuery> queries(queryCount);
+		uint32_t rngState = 1234u;
+		for (NrcTrainingRecord& record : records)
+		{
+			record = makeNrcBenchmarkRecord(rngState);
+		}
+		for (NrcQuery& query : queries)
+		{
+			query = nrcQueryOf(makeNrcBenchmarkRecord(rngState));
+		}
+		printf("Spatially partitioned NRC, %u queries, %u records per training step, %s, %u threads\n", queryCount, recordCount,
+			   simdLevelName(detectSimdLevel()), threads);
+		printf("%-46s %12s %10s %12s %18s %10s\n", "network", "Mqueries/s", "max error", "Mrecords/s", "loss", "face jump");
+		for (const NrcNetworkConfig& network : networks)
+		{
+			NrcSettings settings;
+			settings.network = network;
+			CpuNeuralRadianceCache cache;
+			cache.init(settings, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax, threads);
+			float firstLoss = 0.0f;
+			float lastLoss	= 0.0f;
+			const double trainSeconds = bestTime(1, [&]()
+			{
+				for (uint32_t step = 0; step < steps; step++)
+				{
+					lastLoss = cache.train(records.data(), recordCount);
+					firstLoss = step == 0 ? lastLoss : firstLoss;
+				}
+			});
+			std::vector<float> results(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+			const double querySeconds = bestTime(3, [&]() { cache.query(queries.data(), queryCount, results.data()); });
+			float maxError = 0.0f;
+			for (uint32_t q = 0; q < checkedCount; q++)
+			{
+				const uint32_t	index	= q * (queryCount / checkedCount);
+				float			unitPos[3];
+				float			encoded[NRC_WIDTH];
+				float			expected[NRC_OUTPUT_WIDTH];
+				const uint32_t	region	= nrcRegionUnitPosition(network, queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, unitPos);
+				nrcEncodeInput(network, cache.grid().data(), queries[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+				nrcForward(network, cache.weights().data() + region * network.regionWeightCount(), encoded, expected);
+				for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+				{
+					maxError = std::max(maxError, std::fabs(results[index * NRC_OUTPUT_WIDTH + c] - expected[c]));
+				}
+			}
+
+			// seams: answers just below and above the planes at a half and at a third of the bounds along x, where the
+			// faces of the 2- and 3-way splits lie; one network only moves by its slope over the gap, region networks
+			// are not blended and jump by however much the networks on both sides disagree
+			std::vector<NrcQuery> across(2 * checkedCount);
+			for (uint32_t q = 0; q < checkedCount; q++)
+			{
+				const float fraction	= q % 3 == 0 ? 0.5f : q % 3 == 1 ? 1.0f / 3.0f : 2.0f / 3.0f;
+				const float extent		= nrcBenchmarkSceneMax[0] - nrcBenchmarkSceneMin[0];
+				const float plane		= nrcBenchmarkSceneMin[0] + fraction * extent;
+				across[2 * q]					= queries[q];
+				across[2 * q + 1]				= queries[q];
+				across[2 * q].position[0]		= plane - 1e-4f * extent;
+				across[2 * q + 1].position[0]	= plane + 1e-4f * extent;
+			}
+			std::vector<float> acrossResults(across.size() * NRC_OUTPUT_WIDTH);
+			cache.query(across.data(), uint32_t(across.size()), acrossResults.data());
+			double jump			= 0.0;
+			double magnitude	= 0.0;
+			for (uint32_t q = 0; q < checkedCount; q++)
+			{
+				for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+				{
+					const float below = acrossResults[(2 * q) * NRC_OUTPUT_WIDTH + c];
+					const float above = acrossResults[(2 * q + 1) * NRC_OUTPUT_WIDTH + c];
+					jump		+= std::fabs(above - below);
+					magnitude	+= 0.5 * (std::fabs(above) + std::fabs(below));
+				}
+			}
+
+			char loss[32];
+			snprintf(loss, sizeof(loss), "%.3f -> %.3f", firstLoss, lastLoss);
+			printf("%-46s %12.2f %10.1e %12.3f %18s %9.1f%%\n", describeNrcNetwork(network).c_str(), queryCount / querySeconds * 1e-6, maxError,
+				   double(recordCount) * steps / trainSeconds * 1e-6, loss, 100.0 * jump / std::max(magnitude, 1e-20));
+		}
+
+		// the partitioning itself adds no error: with the bounds doubled, region 0 of a 2x2x2 split covers exactly the bounds
+		// of one network and sees every record at the same unit position, so from the same parameters it has to follow
+		// the single network step for step on the same records
+		const uint32_t	sameSteps	= 64;
+		float			doubledMax[3];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			doubledMax[a] = 2.0f * nrcBenchmarkSceneMax[a] - nrcBenchmarkSceneMin[a];
+		}
+		printf("One network against region 0 of eight over doubled bounds, %u steps on the same %u records\n", sameSteps, recordCount);
+		printf("%-46s %12s %12s %14s %14s\n", "network", "loss", "region loss", "max param diff", "max query diff");
+		for (const NrcNetworkConfig& network : { frequencyNetwork, gridNetwork })
+		{
+			NrcSettings settings;
+			settings.network = network;
+			CpuNeuralRadianceCache single;
+			single.init(settings, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax, threads);
+			settings.network.regionsPerAxis = 2;
+			CpuNeuralRadianceCache partitioned;
+			partitioned.init(settings, nrcBenchmarkSceneMin, doubledMax, threads);
+			std::vector<float> weights	= partitioned.weights();
+			std::vector<float> grid		= partitioned.grid();
+			std::copy(single.weights().begin(), single.weights().end(), weights.begin());
+			std::copy(single.grid().begin(), single.grid().end(), grid.begin());
+			partitioned.setParameters(weights, grid);
+
+			float singleLoss	= 0.0f;
+			float regionLoss	= 0.0f;
+			for (uint32_t step = 0; step < sameSteps; step++)
+			{
+				singleLoss	= single.train(records.data(), recordCount);
+				regionLoss	= partitioned.train(records.data(), recordCount);
+			}
+			float parameterError = 0.0f;
+			for (size_t w = 0; w < single.weights().size(); w++)
+			{
+				parameterError = std::max(parameterError, std::fabs(single.weights()[w] - partitioned.weights()[w]));
+			}
+			for (size_t e = 0; e < single.grid().size(); e++)
+			{
+				parameterError = std::max(parameterError, std::fabs(single.grid()[e] - partitioned.grid()[e]));
+			}
+			std::vector<float> singleResults(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+			std::vector<float> regionResults(size_t(queryCount) * NRC_OUTPUT_WIDTH);
+			single.query(queries.data(), queryCount, singleResults.data());
+			partitioned.query(queries.data(), queryCount, regionResults.data());
+			float queryError = 0.0f;
+			for (size_t i = 0; i < singleResults.size(); i++)
+			{
+				queryError = std::max(queryError, std::fabs(singleResults[i] - regionResults[i]));
+			}
+			printf("%-46s %12.4f %12.4f %14.1e %14.1e\n", describeNrcNetwork(network).c_str(), singleLoss, regionLoss, parameterError, queryError);
+		}
+
+		// quality per time in the cache: error of cache renders against the reference, and the seconds of their steps and queries
+		CpuRenderer renderer;
+		renderer.init(positions, indices);
+		CpuRenderSettings renderSettings;
+		renderSettings.width	= RENDER_WIDTH / 5;
+		renderSettings.height	= RENDER_HEIGHT / 5;
+		CpuImage referenceImage, image;
+		renderer.render(renderSettings, referenceImage);
+		double referenceMean = 0.0;
+		for (float value : referenceImage)
+		{
+			referenceMean += value;
+		}
+		referenceMean /= double(referenceImage.size());
+		printf("Spatially partitioned radiance cache renders, %ux%u, %d frames, reference mean %.4f\n", renderSettings.width,
+			   renderSettings.height, NUM_SAMPLES, referenceMean);
+		printf("%-46s %10s %10s %14s %10s %10s %10s\n", "network", "total s", "cache s", "cache ms/frame", "mean", "vs ref", "rmse");
+		renderSettings.radianceCache = true;
+		double		singleRmse			= 0.0;
+		double		singleCacheSeconds	= 0.0;
+		uint32_t	regionRuns			= 0;
+		uint32_t	regionGains			= 0;		// clearly lower error in less cache time than the one network of the encoding
+		for (const NrcNetworkConfig& network : networks)
+		{
+			renderSettings.nrc.cache.network = network;
+			const CpuRenderStats stats = renderer.render(renderSettings, image);
+			double mean			= 0.0;
+			double squaredError	= 0.0;
+			for (size_t i = 0; i < image.size(); i++)
+			{
+				mean			+= image[i];
+				squaredError	+= double(image[i] - referenceImage[i]) * double(image[i] - referenceImage[i]);
+			}
+			mean /= double(image.size());
+			const double rmse = std::sqrt(squaredError / double(image.size()));
+			printf("%-46s %10.3f %10.3f %14.2f %10.4f %+9.1f%% %10.4f\n", describeNrcNetwork(network).c_str(), stats.seconds, stats.cacheSeconds,
+				   1e3 * stats.cacheSeconds / NUM_SAMPLES, mean, 100.0 * (mean / referenceMean - 1.0), rmse);
+			if (network.regionsPerAxis == 1)
+			{
+				singleRmse			= rmse;
+				singleCacheSeconds	= stats.cacheSeconds;
+			}
+			else
+			{
+				regionRuns++;
+				// beyond the run-to-run noise of both
+				regionGains += rmse < 0.98 * singleRmse && stats.cacheSeconds < 0.95 * singleCacheSeconds;
+			}
+		}
+		printf("region networks: 2%% lower rmse in 5%% less cache time than one network in %u of %u runs, answers jump at region faces%s\n",
+			   regionGains, regionRuns, regionGains == 0 ? "; a regression here, --nrc-regions stays off by default" : "");
+	}
+
+	BenchmarkResult runBenchmark(const std::string& name, const std::vector<float>& scenePositions, const std::vector<uint32_t>& sceneIndices,
+					  uint32_t generatedTriangles)
+	{
+		std::vector<float>		meshPositions;
+		std::vector<uint32_t>	meshIndices;
+		makeBenchmarkMesh(generatedTriangles, meshPositions, meshIndices);
+
+		if (name == "bvh")
+		{
+			benchmarkBvhBuild(scenePositions, sceneIndices);
+			benchmarkBvhBuild(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "traverse")
+		{
+			benchmarkTraversal(scenePositions, sceneIndices);
+			benchmarkTraversal(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "triangles")
+		{
+			benchmarkTriangleKernels(scenePositions, sceneIndices);
+			benchmarkTriangleKernels(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "packets")
+		{
+			benchmarkPackets(scenePositions, sceneIndices, true);
+			benchmarkPackets(meshPositions, meshIndices, false);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "raysort")
+		{
+			benchmarkRaySorting(scenePositions, sceneIndices);
+			benchmarkRaySorting(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "sbvh")
+		{
+			std::vector<float>		beamPositions;
+			std::vector<uint32_t>	beamIndices;
+			makeBeamScene(generatedTriangles, beamPositions, beamIndices);
+			benchmarkSpatialSplits(scenePositions, sceneIndices);
+			benchmarkSpatialSplits(meshPositions, meshIndices);
+			benchmarkSpatialSplits(beamPositions, beamIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "scheduler")
+		{
+			benchmarkTileScheduling(scenePositions, sceneIndices);
+			benchmarkTileScheduling(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "numa")
+		{
+			benchmarkNumaPlacement(scenePositions, sceneIndices);
+			benchmarkNumaPlacement(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "arena")
+		{
+			benchmarkArenaAllocations(scenePositions, sceneIndices);
+			benchmarkArenaAllocations(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "quantized")
+		{
+			benchmarkQuantizedNodes(scenePositions, sceneIndices);
+			benchmarkQuantizedNodes(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "nrc")
+		{
+			benchmarkCpuNrc();
+			return BenchmarkResult::Passed;
+		}
+		if (name == "nrchalf")
+		{
+			benchmarkNrcHalfPrecision(scenePositions, sceneIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "nrcasync")
+		{
+			benchmarkNrcAsyncTraining(scenePositions, sceneIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "nrcregions")
+		{
+			benchmarkNrcRegions(scenePositions, sceneIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "nrccheckpoint")
+		{
+			return benchmarkNrcCheckpoint(scenePositions, sceneIndices) ? BenchmarkResult::Passed : BenchmarkResult::Failed;
+		}
+		if (name == "nrcspread")
+		{
+			benchmarkNrcPathSpread(scenePositions, sceneIndices);
+			return BenchmarkResult::Passed;
+		}
+		if (name == "bvhcache")
+		{
+			benchmarkBvhCache(scenePositions, sceneIndices);
+			benchmarkBvhCache(meshPositions, meshIndices);
+			return BenchmarkResult::Passed;
+		}
+		return BenchmarkResult::Unknown;
+	}
+}
@@ -0,0 +1,91 @@
+# pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cpu_math.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Benchmarks of the CPU backend, run with --bench <name>.
+	// Each one runs on the loaded scene and on a generated mesh that is
+	// large enough to show scaling (--bench-triangles, default 1M).
+	// ----------------------------------------------------------------
+
+	// tessellated height field with roughly triangleCount triangles
+	void makeBenchmarkMesh(uint32_t triangleCount, std::vector<float>& positions, std::vector<uint32_t>& indices);
+
+	// rays from outside the bounds towards random points inside them, reproducible
+	void makeBenchmarkRays(const AABB& bounds, uint32_t rayCount, std::vector<Ray>& rays);
+
+	// BVH build throughput in triangles per second for 1 to 64 threads
+	void benchmarkBvhBuild(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// closest-hit throughput (rays per second) of the binary BVH and the BVH8 kernels
+	void benchmarkTraversal(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// ray-triangle tests per second of the packed eight-wide kernels against the scalar indexed test
+	void benchmarkTriangleKernels(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// camera rays traced one by one against 8- and 16-ray packets; renderScene also compares whole path traced frames
+	void benchmarkPackets(const std::vector<float>& positions, const std::vector<uint32_t>& indices, bool renderScene);
+
+	// path tracer rays per second with and without binning the bounce rays of a ray stream
+	void benchmarkRaySorting(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// building the BVH against mapping it from the cache file, and tracing the mapped copy
+	void benchmarkBvhCache(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// SAH cost, build time and closest-hit throughput of the binned builder against spatial splits with growing budgets;
+	// runBenchmark adds the generated mesh crossed by long diagonal beams, where the spatial splits pay off
+	void benchmarkSpatialSplits(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// node memory and closest-hit throughput of float BVH8 nodes against quantized ones
+	void benchmarkQuantizedNodes(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// path tracer throughput and load balance of the tile schedulers for 1 to 64 workers
+	void benchmarkTileScheduling(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// NUMA topology, and path tracer throughput per node for every BVH placement with and without pinned workers
+	void benchmarkNumaPlacement(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// heap allocations on the render workers after warm-up, which the per-worker arenas should bring to zero
+	void benchmarkArenaAllocations(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// CPU neural radiance cache per instruction set: query and training throughput, checked against the host reference
+	void benchmarkCpuNrc();
+
+	// path length, tracing time and error against the reference of cache renders that end their paths at a fixed vertex
+	// and by the area spread heuristic at several thresholds
+	void benchmarkNrcPathSpread(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// consecutive cache render jobs through a checkpoint: error against the reference of a cold start, of jobs that resume
+	// and of one after a camera move; checkpoint size and the time to store and load it. False when a resumed job ends up
+	// with more error than the cold one, or the checkpoint does not store, load or reject as it should
+	bool benchmarkNrcCheckpoint(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// the half-precision cache queries against fp32: throughput and its ratio to fp32 (below 1 on a CPU, which only
+	// emulates the rounding), parameter bytes a device query reads, error against the fp16 reference and against fp32
+	// after training, and the error of cache renders against the reference
+	void benchmarkNrcHalfPrecision(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// cache renders that train in the frame against ones whose queries use the weights of the step before, as with async
+	// training on the device: error against the reference, and the training time async training takes out of the frame
+	void benchmarkNrcAsyncTraining(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	// one cache network against networks per region with as many grid parameters in all: query and training throughput,
+	// and the error of cache renders against the reference next to the time they spend in the cache
+	void benchmarkNrcRegions(const std::vector<float>& positions, const std::vector<uint32_t>& indices);
+
+	enum class BenchmarkResult
+	{
+		Passed,
+		Failed,			// a benchmark that checks its results found a wrong one
+		Unknown,		// no benchmark of that name
+	};
+
+	// runs the named benchmark
+	BenchmarkResult runBenchmark(const std::string& name, const std::vector<float>& scenePositions, const std::vector<uint32_t>& sceneIndices,
+					  uint32_t generatedTriangles);
+}
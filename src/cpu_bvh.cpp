@@ -0,0 +1,955 @@
+#include <cpu_bvh.h>
+
+#include <array>
+#include <cassert>
+#include <atomic>
+#include <thread>
+
+namespace NRC
+{
+	// run fn(begin, end) over [0, count) split into threadCount contiguous chunks
+	template <typename Fn>
+	static void parallelChunks(uint32_t threadCount, uint32_t count, Fn fn)
+	{
+		threadCount = std::max(1u, std::min(threadCount, count));
+		if (threadCount == 1)
+		{
+			fn(0u, count, 0u);
+			return;
+		}
+		std::vector<std::thread> workers;
+		workers.reserve(threadCount - 1);
+		for (uint32_t t = 1; t < threadCount; t++)
+		{
+			workers.emplace_back(fn, uint32_t(uint64_t(count) * t / threadCount), uint32_t(uint64_t(count) * (t + 1) / threadCount), t);
+		}
+		fn(0u, uint32_t(uint64_t(count) / threadCount), 0u);
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+
+	static AABB intersectBounds(const AABB& a, const AABB& b)
+	{
+		AABB bounds;
+		bounds.lo = max(a.lo, b.lo);
+		bounds.hi = min(a.hi, b.hi);
+		return bounds;
+	}
+
+	// AABB::empty() only looks at x, which is enough for boxes that were grown; clipped boxes may be inverted on any axis
+	static bool isInverted(const AABB& bounds)
+	{
+		return bounds.lo.x > bounds.hi.x || bounds.lo.y > bounds.hi.y || bounds.lo.z > bounds.hi.z;
+	}
+
+
+	// ----------
+	// BvhBuilder
+	// ----------
+	class BvhBuilder
+	{
+	public:
+		static constexpr uint32_t maxBins = 64;
+		// below this many primitives a subtree is not worth another thread
+		static constexpr uint32_t minParallelPrims = 4096;
+
+		BvhBuilder(Bvh& bvh, const BvhBuildSettings& settings) : m_bvh(bvh), m_settings(settings) {}
+
+		void build(const float* positions, const uint32_t* indices, uint32_t triangleCount)
+		{
+			uint32_t threadCount = m_settings.threadCount != 0 ? m_settings.threadCount : std::thread::hardware_concurrency();
+			threadCount = std::max(1u, threadCount);
+			m_settings.binCount = std::max(2u, std::min(m_settings.binCount, maxBins));
+
+			// an empty mesh is an empty node pool, which Bvh::intersect and Bvh8::collapse take as no hits; the pool sizes
+			// below (2N-1) would wrap
+			if (triangleCount == 0)
+			{
+				m_bvh.m_nodes.clear();
+				m_bvh.m_primIndices.clear();
+				m_bvh.m_depth = 0;
+				return;
+			}
+
+			// -----------------------------
+			// Per-triangle bounds, centroids
+			// -----------------------------
+			m_primBounds.resize(triangleCount);
+			m_centroids.resize(triangleCount);
+			m_bvh.m_primIndices.resize(triangleCount);
+			parallelChunks(threadCount, triangleCount, [&](uint32_t begin, uint32_t end, uint32_t)
+			{
+				for (uint32_t t = begin; t < end; t++)
+				{
+					AABB bounds;
+					bounds.grow(loadVec3(positions, indices[3 * size_t(t) + 0]));
+					bounds.grow(loadVec3(positions, indices[3 * size_t(t) + 1]));
+					bounds.grow(loadVec3(positions, indices[3 * size_t(t) + 2]));
+					m_primBounds[t]				= bounds;
+					m_centroids[t]				= bounds.center();
+					m_bvh.m_primIndices[t]		= t;
+				}
+			});
+
+			if (m_settings.spatialSplits)
+			{
+				buildSpatial(positions, indices, triangleCount, threadCount);
+				return;
+			}
+
+			// -------------------------------------
+			// Node pool: a full binary tree has 2N-1
+			// -------------------------------------
+			m_bvh.m_nodes.resize(2 * triangleCount - 1);
+			m_nodeCount		= 1;
+			m_depth			= 0;
+			buildNode(0, 0, triangleCount, 1, threadCount);
+			m_bvh.m_nodes.resize(m_nodeCount);
+			m_bvh.m_depth = m_depth;
+			assert(m_bvh.m_depth < Bvh::maxTraversalDepth);
+		}
+
+	private:
+		// trivially constructible, only the bins in use get cleared
+		struct Bin
+		{
+			AABB		bounds;
+			uint32_t	count;
+		};
+		struct Bins
+		{
+			Bin bins[3][maxBins];
+
+			Bins(uint32_t binCount)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					for (uint32_t b = 0; b < binCount; b++)
+					{
+						bins[axis][b].bounds	= AABB();
+						bins[axis][b].count		= 0;
+					}
+				}
+			}
+			Bin* operator[](int axis) { return bins[axis]; }
+		};
+
+		// small nodes do not need the full bin resolution
+		uint32_t binCountFor(uint32_t primCount) const
+		{
+			return std::min(m_settings.binCount, std::max(4u, primCount));
+		}
+
+		// bin centroids of primIndices[begin, end) into binCount bins for every axis
+		void binRange(uint32_t begin, uint32_t end, uint32_t binCount, const AABB& centroidBounds, Bins& bins) const
+		{
+			const vec3 extent = centroidBounds.extent();
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const uint32_t prim = m_bvh.m_primIndices[i];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (extent[axis] <= 0.0f)
+					{
+						continue;
+					}
+					const float scale = float(binCount) * (1.0f - 1e-6f) / extent[axis];
+					const uint32_t bin = std::min(binCount - 1, uint32_t((m_centroids[prim][axis] - centroidBounds.lo[axis]) * scale));
+					bins[axis][bin].bounds.grow(m_primBounds[prim]);
+					bins[axis][bin].count++;
+				}
+			}
+		}
+
+		struct Split
+		{
+			int			axis	= -1;			// -1: no plane separates the centroids
+			uint32_t	bin		= 0;			// first bin of the right side
+			float		cost	= FLT_MAX;		// unnormalized: sum of child area * count
+		};
+
+		void makeLeaf(BvhNode& node, uint32_t begin, uint32_t end)
+		{
+			node.firstOrChild	= begin;
+			node.primCount		= end - begin;
+		}
+
+		// bounds of the primitives and of their centroids in primIndices[begin, end)
+		void computeBounds(uint32_t begin, uint32_t end, uint32_t threadCount, AABB& bounds, AABB& centroidBounds) const
+		{
+			if (threadCount == 1)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					bounds.grow(m_primBounds[m_bvh.m_primIndices[i]]);
+					centroidBounds.grow(m_centroids[m_bvh.m_primIndices[i]]);
+				}
+				return;
+			}
+			std::vector<AABB> partialBounds(threadCount);
+			std::vector<AABB> partialCentroids(threadCount);
+			parallelChunks(threadCount, end - begin, [&](uint32_t chunkBegin, uint32_t chunkEnd, uint32_t chunk)
+			{
+				computeBounds(begin + chunkBegin, begin + chunkEnd, 1, partialBounds[chunk], partialCentroids[chunk]);
+			});
+			for (uint32_t c = 0; c < threadCount; c++)
+			{
+				bounds.grow(partialBounds[c]);
+				centroidBounds.grow(partialCentroids[c]);
+			}
+		}
+
+		// bin primIndices[begin, end) (in parallel chunks at top levels) and sweep for the cheapest plane
+		Split findSplit(uint32_t begin, uint32_t end, uint32_t threadCount, const AABB& centroidBounds) const
+		{
+			const uint32_t binCount = binCountFor(end - begin);
+			Bins bins(binCount);
+			if (threadCount == 1)
+			{
+				binRange(begin, end, binCount, centroidBounds, bins);
+			}
+			else
+			{
+				std::vector<Bins> partialBins(threadCount, Bins(binCount));
+				parallelChunks(threadCount, end - begin, [&](uint32_t chunkBegin, uint32_t chunkEnd, uint32_t chunk)
+				{
+					binRange(begin + chunkBegin, begin + chunkEnd, binCount, centroidBounds, partialBins[chunk]);
+				});
+				for (uint32_t c = 0; c < threadCount; c++)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						for (uint32_t b = 0; b < binCount; b++)
+						{
+							bins[axis][b].bounds.grow(partialBins[c][axis][b].bounds);
+							bins[axis][b].count += partialBins[c][axis][b].count;
+						}
+					}
+				}
+			}
+
+			Split best;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (centroidBounds.extent()[axis] <= 0.0f)
+				{
+					continue;
+				}
+				// right-to-left suffix areas and counts
+				std::array<float, maxBins>		rightArea;
+				std::array<uint32_t, maxBins>	rightCount;
+				AABB		rightBounds;
+				uint32_t	rightSum = 0;
+				for (uint32_t b = binCount - 1; b > 0; b--)
+				{
+					rightBounds.grow(bins[axis][b].bounds);
+					rightSum		+= bins[axis][b].count;
+					rightArea[b]	= rightBounds.halfArea();
+					rightCount[b]	= rightSum;
+				}
+				AABB		leftBounds;
+				uint32_t	leftSum = 0;
+				for (uint32_t split = 1; split < binCount; split++)
+				{
+					leftBounds.grow(bins[axis][split - 1].bounds);
+					leftSum += bins[axis][split - 1].count;
+					if (leftSum == 0 || rightCount[split] == 0)
+					{
+						continue;
+					}
+					const float cost = leftBounds.halfArea() * leftSum + rightArea[split] * rightCount[split];
+					if (cost < best.cost)
+					{
+						best.cost	= cost;
+						best.axis	= axis;
+						best.bin	= split;
+					}
+				}
+			}
+			return best;
+		}
+
+		void buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth, uint32_t threadCount)
+		{
+			BvhNode&		node	= m_bvh.m_nodes[nodeIndex];
+			const uint32_t	count	= end - begin;
+			// below minParallelPrims a subtree stays on the current thread
+			if (count < minParallelPrims)
+			{
+				threadCount = 1;
+			}
+
+			uint32_t observed = m_depth.load(std::memory_order_relaxed);
+			while (depth > observed && !m_depth.compare_exchange_weak(observed, depth))
+			{
+			}
+
+			AABB centroidBounds;
+			node.bounds = AABB();
+			computeBounds(begin, end, threadCount, node.bounds, centroidBounds);
+			if (count <= 1)
+			{
+				makeLeaf(node, begin, end);
+				return;
+			}
+
+			const Split		best		= findSplit(begin, end, threadCount, centroidBounds);
+			const uint32_t	binCount	= binCountFor(count);
+			const int		bestAxis	= best.axis;
+			const uint32_t	bestSplit	= best.bin;
+			const float		bestCost	= best.cost;
+			const float parentArea	= std::max(node.bounds.halfArea(), 1e-20f);
+			const float splitCost	= m_settings.traversalCost + m_settings.intersectionCost * bestCost / parentArea;
+			const float leafCost	= m_settings.intersectionCost * count;
+
+			uint32_t middle;
+			if (bestAxis >= 0)
+			{
+				if (count <= m_settings.maxLeafSize && splitCost >= leafCost)
+				{
+					makeLeaf(node, begin, end);
+					return;
+				}
+				const float scale = float(binCount) * (1.0f - 1e-6f) / centroidBounds.extent()[bestAxis];
+				const float lo = centroidBounds.lo[bestAxis];
+				uint32_t* first = m_bvh.m_primIndices.data() + begin;
+				uint32_t* split = std::partition(first, first + count, [&](uint32_t prim)
+				{
+					return std::min(binCount - 1, uint32_t((m_centroids[prim][bestAxis] - lo) * scale)) < bestSplit;
+				});
+				middle = begin + uint32_t(split - first);
+			}
+			else
+			{
+				// all centroids coincide: no plane separates them
+				if (count <= m_settings.maxLeafSize)
+				{
+					makeLeaf(node, begin, end);
+					return;
+				}
+				middle = begin + count / 2;
+			}
+
+			// ------------------------------------------
+			// Children from the pool, built as two tasks
+			// ------------------------------------------
+			const uint32_t leftIndex = m_nodeCount.fetch_add(2);
+			node.firstOrChild	= leftIndex;
+			node.primCount		= 0;
+
+			if (threadCount > 1)
+			{
+				const uint32_t leftThreads = threadCount / 2;
+				std::thread leftTask([=]() { buildNode(leftIndex, begin, middle, depth + 1, leftThreads); });
+				buildNode(leftIndex + 1, middle, end, depth + 1, threadCount - leftThreads);
+				leftTask.join();
+			}
+			else
+			{
+				buildNode(leftIndex, begin, middle, depth + 1, 1);
+				buildNode(leftIndex + 1, middle, end, depth + 1, 1);
+			}
+		}
+
+		// ------------------------------------------------------------------
+		// Spatial splits (SBVH, Stich et al. 2009). Nodes hold references:
+		// a triangle and the part of its bounds that lies in the node. Every
+		// node compares the best object split of the reference boxes with
+		// the best plane of a spatial binning, where a reference adds its
+		// triangle clipped to each bin it spans. Straddling references of a
+		// spatial split are clipped to both sides, unless keeping them whole
+		// on one side is cheaper. The pools are sized for the budget: a tree
+		// over R references has at most 2R-1 nodes and R leaf entries.
+		// ------------------------------------------------------------------
+		struct Reference
+		{
+			AABB		bounds;
+			uint32_t	prim;
+		};
+
+		struct ReferenceSplit
+		{
+			int			axis		= -1;
+			float		cost		= FLT_MAX;		// unnormalized, like Split::cost
+			float		position	= 0.0f;			// plane of a spatial split
+			uint32_t	bin			= 0;			// first right bin of an object split
+			AABB		left, right;
+			uint32_t	leftCount	= 0;
+			uint32_t	rightCount	= 0;
+		};
+
+		// spatial splits stop this deep, the traversal stack must hold the tree
+		static const uint32_t maxSpatialDepth = 64;
+
+		void buildSpatial(const float* positions, const uint32_t* indices, uint32_t triangleCount, uint32_t threadCount)
+		{
+			m_positions = positions;
+			m_indices	= indices;
+			const uint32_t budget = uint32_t(std::max(0.0f, m_settings.splitBudget) * float(triangleCount));
+			m_splitBudget	= budget;
+			m_primCursor	= 0;
+
+			std::vector<Reference> refs(triangleCount);
+			for (uint32_t t = 0; t < triangleCount; t++)
+			{
+				refs[t] = { m_primBounds[t], t };
+			}
+
+			const uint32_t maxReferences = triangleCount + budget;
+			m_bvh.m_nodes.resize(2 * maxReferences - 1);
+			m_bvh.m_primIndices.resize(maxReferences);
+			m_nodeCount		= 1;
+			m_depth			= 0;
+			buildSpatialNode(0, refs, 1, threadCount);
+			m_bvh.m_nodes.resize(m_nodeCount);
+			m_bvh.m_primIndices.resize(m_primCursor);
+			m_bvh.m_depth = m_depth;
+			assert(m_bvh.m_depth < Bvh::maxTraversalDepth);
+		}
+
+		void loadTriangle(uint32_t prim, vec3 v[3]) const
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				v[i] = loadVec3(m_positions, m_indices[3 * size_t(prim) + i]);
+			}
+		}
+
+		// bounds of where the triangle's edges cross the plane p[axis] = plane
+		static AABB triangleSection(const vec3 v[3], int axis, float plane)
+		{
+			AABB bounds;
+			for (int i = 0; i < 3; i++)
+			{
+				const vec3& a	= v[i];
+				const vec3& b	= v[(i + 1) % 3];
+				const float pa	= a[axis];
+				const float pb	= b[axis];
+				if ((pa < plane && pb > plane) || (pa > plane && pb < plane))
+				{
+					vec3 p = a + (b - a) * ((plane - pa) / (pb - pa));
+					p[axis] = plane;
+					bounds.grow(p);
+				}
+			}
+			return bounds;
+		}
+
+		// bounds of the triangle inside the slab lo <= p[axis] <= hi, given its sections by both planes
+		static AABB clipTriangle(const vec3 v[3], int axis, float lo, float hi, const AABB& loSection, const AABB& hiSection)
+		{
+			AABB bounds = loSection;
+			bounds.grow(hiSection);
+			for (int i = 0; i < 3; i++)
+			{
+				if (v[i][axis] >= lo && v[i][axis] <= hi)
+				{
+					bounds.grow(v[i]);
+				}
+			}
+			return bounds;
+		}
+
+		// clipped part of a reference, limited to the box it already had
+		AABB clipReference(const Reference& ref, int axis, float lo, float hi) const
+		{
+			vec3 v[3];
+			loadTriangle(ref.prim, v);
+			return intersectBounds(clipTriangle(v, axis, lo, hi, triangleSection(v, axis, lo), triangleSection(v, axis, hi)), ref.bounds);
+		}
+
+		ReferenceSplit findObjectSplit(const std::vector<Reference>& refs, const AABB& centroidBounds) const
+		{
+			const uint32_t	binCount	= binCountFor(uint32_t(refs.size()));
+			const vec3		extent		= centroidBounds.extent();
+			Bins bins(binCount);
+			for (const Reference& ref : refs)
+			{
+				const vec3 center = ref.bounds.center();
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (extent[axis] <= 0.0f)
+					{
+						continue;
+					}
+					const float scale = float(binCount) * (1.0f - 1e-6f) / extent[axis];
+					const uint32_t bin = std::min(binCount - 1, uint32_t((center[axis] - centroidBounds.lo[axis]) * scale));
+					bins[axis][bin].bounds.grow(ref.bounds);
+					bins[axis][bin].count++;
+				}
+			}
+
+			ReferenceSplit best;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (extent[axis] <= 0.0f)
+				{
+					continue;
+				}
+				std::array<AABB, maxBins>		rightBounds;
+				std::array<uint32_t, maxBins>	rightCount;
+				AABB		right;
+				uint32_t	rightSum = 0;
+				for (uint32_t b = binCount - 1; b > 0; b--)
+				{
+					right.grow(bins[axis][b].bounds);
+					rightSum		+= bins[axis][b].count;
+					rightBounds[b]	= right;
+					rightCount[b]	= rightSum;
+				}
+				AABB		left;
+				uint32_t	leftSum = 0;
+				for (uint32_t split = 1; split < binCount; split++)
+				{
+					left.grow(bins[axis][split - 1].bounds);
+					leftSum += bins[axis][split - 1].count;
+					if (leftSum == 0 || rightCount[split] == 0)
+					{
+						continue;
+					}
+					const float cost = left.halfArea() * leftSum + rightBounds[split].halfArea() * rightCount[split];
+					if (cost < best.cost)
+					{
+						best.axis		= axis;
+						best.cost		= cost;
+						best.bin		= split;
+						best.left		= left;
+						best.right		= rightBounds[split];
+						best.leftCount	= leftSum;
+						best.rightCount = rightCount[split];
+					}
+				}
+			}
+			return best;
+		}
+
+		ReferenceSplit findSpatialSplit(const std::vector<Reference>& refs, const AABB& nodeBounds) const
+		{
+			struct SpatialBin
+			{
+				AABB		bounds;
+				uint32_t	enter;		// references starting in the bin
+				uint32_t	exit;		// references ending in the bin
+			};
+			const uint32_t binCount = binCountFor(uint32_t(refs.size()));
+
+			ReferenceSplit best;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float extent = nodeBounds.extent()[axis];
+				if (extent <= 0.0f)
+				{
+					continue;
+				}
+				const float lo		= nodeBounds.lo[axis];
+				const float binSize	= extent / float(binCount);
+				const float scale	= float(binCount) * (1.0f - 1e-6f) / extent;
+				auto binOf = [&](float p) { return std::min(binCount - 1, uint32_t(std::max(0.0f, (p - lo) * scale))); };
+
+				SpatialBin bins[maxBins];
+				for (uint32_t b = 0; b < binCount; b++)
+				{
+					bins[b] = { AABB(), 0, 0 };
+				}
+				for (const Reference& ref : refs)
+				{
+					const uint32_t first	= binOf(ref.bounds.lo[axis]);
+					const uint32_t last		= binOf(ref.bounds.hi[axis]);
+					if (first == last)
+					{
+						bins[first].bounds.grow(ref.bounds);
+					}
+					else
+					{
+						// sweep the planes the reference crosses, each section bounds the bins on both sides of it
+						vec3 v[3];
+						loadTriangle(ref.prim, v);
+						float	binLo	= lo + binSize * float(first);
+						AABB	lower	= triangleSection(v, axis, binLo);
+						for (uint32_t b = first; b <= last; b++)
+						{
+							const float binHi = lo + binSize * float(b + 1);
+							const AABB	upper = triangleSection(v, axis, binHi);
+							bins[b].bounds.grow(intersectBounds(clipTriangle(v, axis, binLo, binHi, lower, upper), ref.bounds));
+							binLo = binHi;
+							lower = upper;
+						}
+					}
+					bins[first].enter++;
+					bins[last].exit++;
+				}
+
+				std::array<AABB, maxBins>		rightBounds;
+				std::array<uint32_t, maxBins>	rightCount;
+				AABB		right;
+				uint32_t	rightSum = 0;
+				for (uint32_t b = binCount - 1; b > 0; b--)
+				{
+					right.grow(bins[b].bounds);
+					rightSum		+= bins[b].exit;
+					rightBounds[b]	= right;
+					rightCount[b]	= rightSum;
+				}
+				AABB		left;
+				uint32_t	leftSum = 0;
+				for (uint32_t split = 1; split < binCount; split++)
+				{
+					left.grow(bins[split - 1].bounds);
+					leftSum += bins[split - 1].enter;
+					if (leftSum == 0 || rightCount[split] == 0)
+					{
+						continue;
+					}
+					const float cost = left.halfArea() * leftSum + rightBounds[split].halfArea() * rightCount[split];
+					if (cost < best.cost)
+					{
+						best.axis		= axis;
+						best.cost		= cost;
+						best.position	= lo + binSize * float(split);
+						best.left		= left;
+						best.right		= rightBounds[split];
+						best.leftCount	= leftSum;
+						best.rightCount = rightCount[split];
+					}
+				}
+			}
+			return best;
+		}
+
+		// references of a spatial split per side; straddling ones are clipped in two or kept whole when that is cheaper
+		void splitReferences(const std::vector<Reference>& refs, const ReferenceSplit& split,
+							 std::vector<Reference>& leftRefs, std::vector<Reference>& rightRefs) const
+		{
+			const int	axis		= split.axis;
+			AABB		left		= split.left;
+			AABB		right		= split.right;
+			float		leftCount	= float(split.leftCount);
+			float		rightCount	= float(split.rightCount);
+			for (const Reference& ref : refs)
+			{
+				if (ref.bounds.hi[axis] <= split.position)
+				{
+					leftRefs.push_back(ref);
+					continue;
+				}
+				if (ref.bounds.lo[axis] >= split.position)
+				{
+					rightRefs.push_back(ref);
+					continue;
+				}
+				AABB leftWhole	= left;
+				AABB rightWhole	= right;
+				leftWhole.grow(ref.bounds);
+				rightWhole.grow(ref.bounds);
+				const float splitCost		= left.halfArea() * leftCount + right.halfArea() * rightCount;
+				const float leftWholeCost	= leftWhole.halfArea() * leftCount + right.halfArea() * (rightCount - 1.0f);
+				const float rightWholeCost	= left.halfArea() * (leftCount - 1.0f) + rightWhole.halfArea() * rightCount;
+				if (leftWholeCost < splitCost && leftWholeCost <= rightWholeCost)
+				{
+					leftRefs.push_back(ref);
+					left = leftWhole;
+					rightCount -= 1.0f;
+				}
+				else if (rightWholeCost < splitCost)
+				{
+					rightRefs.push_back(ref);
+					right = rightWhole;
+					leftCount -= 1.0f;
+				}
+				else
+				{
+					const AABB leftPart		= clipReference(ref, axis, ref.bounds.lo[axis], split.position);
+					const AABB rightPart	= clipReference(ref, axis, split.position, ref.bounds.hi[axis]);
+					// rounding may leave nothing of a triangle that barely crosses the plane
+					if (!isInverted(leftPart))
+					{
+						leftRefs.push_back({ leftPart, ref.prim });
+					}
+					if (!isInverted(rightPart))
+					{
+						rightRefs.push_back({ rightPart, ref.prim });
+					}
+				}
+			}
+		}
+
+		// take count references from the shared budget, false when not enough are left
+		bool reserveReferences(uint32_t count)
+		{
+			uint32_t available = m_splitBudget.load(std::memory_order_relaxed);
+			while (available >= count)
+			{
+				if (m_splitBudget.compare_exchange_weak(available, available - count))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void makeSpatialLeaf(BvhNode& node, const std::vector<Reference>& refs)
+		{
+			const uint32_t first = m_primCursor.fetch_add(uint32_t(refs.size()));
+			for (size_t i = 0; i < refs.size(); i++)
+			{
+				m_bvh.m_primIndices[first + i] = refs[i].prim;
+			}
+			node.firstOrChild	= first;
+			node.primCount		= uint32_t(refs.size());
+		}
+
+		void buildSpatialNode(uint32_t nodeIndex, std::vector<Reference>& refs, uint32_t depth, uint32_t threadCount)
+		{
+			BvhNode&		node	= m_bvh.m_nodes[nodeIndex];
+			const uint32_t	count	= uint32_t(refs.size());
+			if (count < minParallelPrims)
+			{
+				threadCount = 1;
+			}
+
+			uint32_t observed = m_depth.load(std::memory_order_relaxed);
+			while (depth > observed && !m_depth.compare_exchange_weak(observed, depth))
+			{
+			}
+
+			AABB centroidBounds;
+			node.bounds = AABB();
+			for (const Reference& ref : refs)
+			{
+				node.bounds.grow(ref.bounds);
+				centroidBounds.grow(ref.bounds.center());
+			}
+			if (count <= 1)
+			{
+				makeSpatialLeaf(node, refs);
+				return;
+			}
+
+			const ReferenceSplit objectSplit = findObjectSplit(refs, centroidBounds);
+			ReferenceSplit best = objectSplit;
+			bool spatial = false;
+			if (depth < maxSpatialDepth && m_splitBudget.load(std::memory_order_relaxed) > 0)
+			{
+				// only worth a look where the object split leaves children overlapping by a part of this node
+				const AABB overlap = intersectBounds(best.left, best.right);
+				if (best.axis < 0 || (!isInverted(overlap) && overlap.halfArea() > m_settings.splitMinOverlap * node.bounds.halfArea()))
+				{
+					// estimated duplicates must fit what is left of the budget, unsplitting only lowers them
+					const ReferenceSplit	spatialSplit	= findSpatialSplit(refs, node.bounds);
+					const uint32_t			duplicates		= spatialSplit.leftCount + spatialSplit.rightCount - std::min(count, spatialSplit.leftCount + spatialSplit.rightCount);
+					if (spatialSplit.cost < best.cost && duplicates <= m_splitBudget.load(std::memory_order_relaxed))
+					{
+						best	= spatialSplit;
+						spatial	= true;
+					}
+				}
+			}
+
+			const float parentArea	= std::max(node.bounds.halfArea(), 1e-20f);
+			const float leafCost	= m_settings.intersectionCost * count;
+			auto leafIsCheaper = [&](const ReferenceSplit& split)
+			{
+				const float splitCost = m_settings.traversalCost + m_settings.intersectionCost * split.cost / parentArea;
+				return count <= m_settings.maxLeafSize && (split.axis < 0 || splitCost >= leafCost);
+			};
+			if (leafIsCheaper(best))
+			{
+				makeSpatialLeaf(node, refs);
+				return;
+			}
+
+			std::vector<Reference> leftRefs, rightRefs;
+			leftRefs.reserve(best.leftCount);
+			rightRefs.reserve(best.rightCount);
+			if (spatial)
+			{
+				splitReferences(refs, best, leftRefs, rightRefs);
+				// the binned cost assumed every straddling reference clipped at a bin plane; the references as they were
+				// actually clipped or kept whole may lose against the object split after all
+				AABB leftBounds, rightBounds;
+				for (const Reference& ref : leftRefs)
+				{
+					leftBounds.grow(ref.bounds);
+				}
+				for (const Reference& ref : rightRefs)
+				{
+					rightBounds.grow(ref.bounds);
+				}
+				const float		cost	= leftBounds.halfArea() * float(leftRefs.size()) + rightBounds.halfArea() * float(rightRefs.size());
+				const size_t	total	= leftRefs.size() + rightRefs.size();
+				// the exact duplicates are known only now as well; without budget or with an empty side take the object split
+				if (leftRefs.empty() || rightRefs.empty() || cost >= objectSplit.cost ||
+					(total > count && !reserveReferences(uint32_t(total - count))))
+				{
+					leftRefs.clear();
+					rightRefs.clear();
+					best	= objectSplit;
+					spatial	= false;
+					if (leafIsCheaper(best))
+					{
+						makeSpatialLeaf(node, refs);
+						return;
+					}
+				}
+			}
+			if (!spatial)
+			{
+				if (best.axis >= 0)
+				{
+					const uint32_t	binCount	= binCountFor(count);
+					const float		scale		= float(binCount) * (1.0f - 1e-6f) / centroidBounds.extent()[best.axis];
+					for (const Reference& ref : refs)
+					{
+						const uint32_t bin = std::min(binCount - 1, uint32_t((ref.bounds.center()[best.axis] - centroidBounds.lo[best.axis]) * scale));
+						(bin < best.bin ? leftRefs : rightRefs).push_back(ref);
+					}
+				}
+				else
+				{
+					// all centroids coincide: no plane separates them
+					leftRefs.assign(refs.begin(), refs.begin() + count / 2);
+					rightRefs.assign(refs.begin() + count / 2, refs.end());
+				}
+			}
+			std::vector<Reference>().swap(refs);
+
+			const uint32_t leftIndex = m_nodeCount.fetch_add(2);
+			node.firstOrChild	= leftIndex;
+			node.primCount		= 0;
+			if (threadCount > 1)
+			{
+				const uint32_t leftThreads = threadCount / 2;
+				std::thread leftTask([&, leftIndex, depth, leftThreads]() { buildSpatialNode(leftIndex, leftRefs, depth + 1, leftThreads); });
+				buildSpatialNode(leftIndex + 1, rightRefs, depth + 1, threadCount - leftThreads);
+				leftTask.join();
+			}
+			else
+			{
+				buildSpatialNode(leftIndex, leftRefs, depth + 1, 1);
+				buildSpatialNode(leftIndex + 1, rightRefs, depth + 1, 1);
+			}
+		}
+
+		Bvh&					m_bvh;
+		BvhBuildSettings		m_settings;
+		std::vector<AABB>		m_primBounds;
+		std::vector<vec3>		m_centroids;
+		std::atomic<uint32_t>	m_nodeCount{ 0 };
+		std::atomic<uint32_t>	m_depth{ 0 };
+		// spatial splits
+		const float*			m_positions			= nullptr;
+		const uint32_t*			m_indices			= nullptr;
+		std::atomic<uint32_t>	m_splitBudget{ 0 };		// duplicate references still allowed
+		std::atomic<uint32_t>	m_primCursor{ 0 };		// next free entry of primIndices
+	};
+
+
+	// ---
+	// Bvh
+	// ---
+	void Bvh::build(const float* positions, const uint32_t* indices, uint32_t triangleCount, const BvhBuildSettings& settings)
+	{
+		m_nodes.clear();
+		m_primIndices.clear();
+		m_depth = 0;
+		if (triangleCount == 0)
+		{
+			return;
+		}
+		BvhBuilder builder(*this, settings);
+		builder.build(positions, indices, triangleCount);
+	}
+
+	// conservative slab test against the ray's [tMin, tMax], returns a lower bound of the entry distance or FLT_MAX
+	static float intersectAABB(const AABB& box, const vec3& origin, const vec3& invDirection, float tMin, float tMax)
+	{
+		const vec3 t0 = (box.lo - origin) * invDirection;
+		const vec3 t1 = (box.hi - origin) * invDirection;
+		const vec3 tNear = min(t0, t1);
+		const vec3 tFar  = max(t0, t1);
+		const float enter = roundEnterDown(std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tMin)));
+		const float exit  = roundExitUp(std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax)));
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	bool Bvh::intersect(const Ray& ray, Hit& hit, const float* positions, const uint32_t* indices) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+		const vec3 invDirection(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+		// nodes are pushed with their entry distance, so they are only tested once
+		struct StackEntry
+		{
+			uint32_t	node;
+			float		tEnter;
+		};
+		StackEntry	stack[maxTraversalDepth];
+		uint32_t	stackSize = 0;
+		const float tRoot = intersectAABB(m_nodes[0].bounds, ray.origin, invDirection, ray.tMin, ray.tMax);
+		if (tRoot != FLT_MAX)
+		{
+			stack[stackSize++] = { 0, tRoot };
+		}
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (entry.tEnter > hit.t)
+			{
+				continue;	// a closer hit was found since the node was pushed
+			}
+			const BvhNode& node = m_nodes[entry.node];
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.firstOrChild; i < node.firstOrChild + node.primCount; i++)
+				{
+					const uint32_t prim = m_primIndices[i];
+					intersectTriangle(ray,
+									  loadVec3(positions, indices[3 * size_t(prim) + 0]),
+									  loadVec3(positions, indices[3 * size_t(prim) + 1]),
+									  loadVec3(positions, indices[3 * size_t(prim) + 2]),
+									  prim, hit);
+				}
+				continue;
+			}
+
+			// visit the nearer child first
+			const uint32_t	left	= node.firstOrChild;
+			const float		tMax	= std::min(ray.tMax, hit.t);
+			const float		tLeft	= intersectAABB(m_nodes[left].bounds, ray.origin, invDirection, ray.tMin, tMax);
+			const float		tRight	= intersectAABB(m_nodes[left + 1].bounds, ray.origin, invDirection, ray.tMin, tMax);
+			const bool		leftFirst = tLeft <= tRight;
+			const StackEntry nearChild	= leftFirst ? StackEntry{ left, tLeft } : StackEntry{ left + 1, tRight };
+			const StackEntry farChild	= leftFirst ? StackEntry{ left + 1, tRight } : StackEntry{ left, tLeft };
+			if (farChild.tEnter != FLT_MAX)
+			{
+				stack[stackSize++] = farChild;
+			}
+			if (nearChild.tEnter != FLT_MAX)
+			{
+				stack[stackSize++] = nearChild;
+			}
+		}
+		return hit.valid();
+	}
+
+	float Bvh::sahCost(float traversalCost, float intersectionCost) const
+	{
+		if (m_nodes.empty())
+		{
+			return 0.0f;
+		}
+		double cost = 0.0;
+		for (const BvhNode& node : m_nodes)
+		{
+			cost += node.isLeaf() ? double(intersectionCost) * node.primCount * node.bounds.halfArea()
+								  : double(traversalCost) * node.bounds.halfArea();
+		}
+		return float(cost / std::max(m_nodes[0].bounds.halfArea(), 1e-20f));
+	}
+}
@@ -0,0 +1,76 @@
+# pragma once
+
+#include <vector>
+#include <cpu_math.h>
+
+namespace NRC
+{
+	// 32 bytes, two per cache line. Children of an interior node are adjacent.
+	struct BvhNode
+	{
+		AABB		bounds;
+		uint32_t	firstOrChild;		// leaf: first entry in primIndices, interior: index of the left child
+		uint32_t	primCount;			// 0 for interior nodes
+
+		bool isLeaf() const { return primCount != 0; }
+	};
+
+	struct BvhBuildSettings
+	{
+		uint32_t	threadCount			= 0;		// 0: one per hardware thread
+		uint32_t	binCount			= 32;		// SAH bins per axis, at most 64
+		uint32_t	maxLeafSize			= 4;
+		float		traversalCost		= 1.0f;
+		float		intersectionCost	= 1.0f;
+
+		// spatial splits (SBVH): a triangle straddling a split plane may be referenced from both sides
+		bool		spatialSplits		= false;
+		float		splitBudget			= 0.25f;	// extra references allowed, as a fraction of the triangle count
+		float		splitMinOverlap		= 0.2f;		// tried where the object split children overlap by more than this part of the node area
+	};
+
+	// ----------------------------------------------------------------
+	// Binary BVH over an indexed triangle mesh (the flattened position
+	// and index arrays main.cpp gets from tinyobj).
+	//
+	// Built top-down with binned SAH. While more than one thread is left
+	// for a subtree, its binning runs in parallel and its two children
+	// are built as separate tasks, each with half of the threads. Nodes
+	// come from a pool sized for the worst case (2N-1) and are handed out
+	// pairwise by an atomic bump pointer, so tasks never lock.
+	//
+	// With spatialSplits the builder also bins the space of a node and
+	// considers planes that cut the triangles straddling them, each
+	// side keeping a reference clipped to its half. Long triangles such
+	// as walls then stop inflating the boxes of everything around them.
+	// Duplicated references come from a shared budget; once it is used
+	// up, the remaining nodes only get object splits. primIndices may
+	// then list a triangle in several leaves.
+	// ----------------------------------------------------------------
+	class Bvh
+	{
+	public:
+		// traversal stack size; the builder keeps the tree shallower than this
+		static const uint32_t maxTraversalDepth = 128;
+
+		void build(const float* positions, const uint32_t* indices, uint32_t triangleCount,
+				   const BvhBuildSettings& settings = BvhBuildSettings());
+
+		// closest hit; hit.primitive is the triangle index of the mesh
+		bool intersect(const Ray& ray, Hit& hit, const float* positions, const uint32_t* indices) const;
+
+		// SAH cost of the hierarchy, normalized by the root area
+		float sahCost(float traversalCost = 1.0f, float intersectionCost = 1.0f) const;
+
+		const std::vector<BvhNode>&		nodes() const		{ return m_nodes; }
+		const std::vector<uint32_t>&	primIndices() const	{ return m_primIndices; }		// with duplicates after spatial splits
+		uint32_t						depth() const		{ return m_depth; }
+
+	private:
+		friend class BvhBuilder;
+
+		std::vector<BvhNode>	m_nodes;			// node 0 is the root
+		std::vector<uint32_t>	m_primIndices;		// triangle indices referenced by the leaves
+		uint32_t				m_depth = 0;
+	};
+}
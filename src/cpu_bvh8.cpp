@@ -0,0 +1,898 @@
+#include <cpu_bvh8.h>
+
+#include <cstring>
+
+namespace NRC
+{
+	// --------
+	// Collapse
+	// --------
+	void Bvh8::collapse(const Bvh& bvh, const float* positions, const uint32_t* indices)
+	{
+		m_nodes.clear();
+		m_triangles.clear();
+		m_quantizedNodes.clear();
+		m_nodeCount		= 0;
+		m_groupCount	= 0;
+		m_storage.reset();
+		m_bounds = AABB();
+		const std::vector<BvhNode>& binaryNodes = bvh.nodes();
+		if (binaryNodes.empty())
+		{
+			return;
+		}
+		m_bounds = binaryNodes[0].bounds;
+
+		// (BVH8 node, binary node it stands for)
+		std::vector<std::pair<uint32_t, uint32_t>> pending;
+		m_nodes.emplace_back();
+		pending.emplace_back(0, 0);
+		while (!pending.empty())
+		{
+			const uint32_t nodeIndex	= pending.back().first;
+			const uint32_t binaryIndex	= pending.back().second;
+			pending.pop_back();
+
+			// open the largest interior slot until all eight are used
+			uint32_t slots[8];
+			uint32_t slotCount = 0;
+			const BvhNode& binaryNode = binaryNodes[binaryIndex];
+			if (binaryNode.isLeaf())
+			{
+				slots[slotCount++] = binaryIndex;
+			}
+			else
+			{
+				slots[slotCount++] = binaryNode.firstOrChild;
+				slots[slotCount++] = binaryNode.firstOrChild + 1;
+			}
+			while (slotCount < 8)
+			{
+				int		largest		= -1;
+				float	largestArea = -1.0f;
+				for (uint32_t s = 0; s < slotCount; s++)
+				{
+					const BvhNode& candidate = binaryNodes[slots[s]];
+					if (!candidate.isLeaf() && candidate.bounds.halfArea() > largestArea)
+					{
+						largest		= int(s);
+						largestArea = candidate.bounds.halfArea();
+					}
+				}
+				if (largest < 0)
+				{
+					break;	// only leaves left
+				}
+				const uint32_t opened = slots[largest];
+				slots[largest]			= binaryNodes[opened].firstOrChild;
+				slots[slotCount++]		= binaryNodes[opened].firstOrChild + 1;
+			}
+
+			// ---------------------------------
+			// Fill the SoA node, queue interiors
+			// ---------------------------------
+			Bvh8Node node{};
+			for (uint32_t s = 0; s < 8; s++)
+			{
+				if (s >= slotCount)
+				{
+					node.loX[s] = node.loY[s] = node.loZ[s] = FLT_MAX;
+					node.hiX[s] = node.hiY[s] = node.hiZ[s] = -FLT_MAX;
+					node.child[s]		= ~0u;
+					node.primCount[s]	= 0;
+					continue;
+				}
+				const BvhNode& slotNode = binaryNodes[slots[s]];
+				node.loX[s] = slotNode.bounds.lo.x;		node.hiX[s] = slotNode.bounds.hi.x;
+				node.loY[s] = slotNode.bounds.lo.y;		node.hiY[s] = slotNode.bounds.hi.y;
+				node.loZ[s] = slotNode.bounds.lo.z;		node.hiZ[s] = slotNode.bounds.hi.z;
+				if (slotNode.isLeaf())
+				{
+					node.child[s]		= packTriangles(positions, indices, bvh.primIndices().data() + slotNode.firstOrChild,
+														slotNode.primCount, m_triangles);
+					node.primCount[s]	= uint8_t(slotNode.primCount);
+				}
+				else
+				{
+					node.child[s]		= uint32_t(m_nodes.size());
+					node.primCount[s]	= 0;
+					m_nodes.emplace_back();
+					pending.emplace_back(node.child[s], slots[s]);
+				}
+			}
+			m_nodes[nodeIndex] = node;
+		}
+		m_nodeCount		= uint32_t(m_nodes.size());
+		m_groupCount	= uint32_t(m_triangles.size());
+	}
+
+	void Bvh8::attach(std::shared_ptr<const void> storage, const Bvh8Node* nodes, uint32_t nodeCount,
+					  const TriangleGroup* triangles, uint32_t groupCount, const AABB& bounds)
+	{
+		m_nodes.clear();
+		m_triangles.clear();
+		m_quantizedNodes.clear();
+		m_storage			= std::move(storage);
+		m_attachedNodes		= nodes;
+		m_attachedTriangles = triangles;
+		m_nodeCount			= nodeCount;
+		m_groupCount		= groupCount;
+		m_bounds			= bounds;
+	}
+
+	void Bvh8::replicate(const Bvh8& source)
+	{
+		m_storage.reset();
+		m_attachedNodes		= nullptr;
+		m_attachedTriangles = nullptr;
+		m_nodes.clear();
+		m_quantizedNodes.clear();
+		if (source.quantized())
+		{
+			m_quantizedNodes.assign(source.quantizedNodes(), source.quantizedNodes() + source.nodeCount());
+		}
+		else
+		{
+			m_nodes.assign(source.nodes(), source.nodes() + source.nodeCount());
+		}
+		m_triangles.assign(source.triangles(), source.triangles() + source.groupCount());
+		m_nodeCount		= source.m_nodeCount;
+		m_groupCount	= source.m_groupCount;
+		m_bounds		= source.m_bounds;
+		m_simdLevel		= source.m_simdLevel;
+	}
+
+
+	// --------
+	// Quantize
+	// --------
+	static float exponentScale(int exponent)
+	{
+		const uint32_t bits = uint32_t(exponent + 127) << 23;
+		float scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		return scale;
+	}
+
+	// frame of one axis: the smallest power-of-two step whose 255 steps from lo reach hi
+	static void quantizationFrame(float lo, float hi, float& origin, int& exponent)
+	{
+		origin		= lo;
+		exponent	= -126;
+		if (hi > lo)
+		{
+			std::frexp((hi - lo) / 255.0f, &exponent);
+			exponent = std::max(exponent - 1, -126);
+			while (exponent < 127 && origin + 255.0f * exponentScale(exponent) < hi)
+			{
+				exponent++;
+			}
+		}
+	}
+
+	static uint8_t quantizeDown(float value, float origin, float scale)
+	{
+		int q = std::min(255, std::max(0, int(std::floor((value - origin) / scale))));
+		while (q > 0 && origin + float(q) * scale > value)
+		{
+			q--;
+		}
+		return uint8_t(q);
+	}
+
+	static uint8_t quantizeUp(float value, float origin, float scale)
+	{
+		int q = std::min(255, std::max(0, int(std::ceil((value - origin) / scale))));
+		while (q < 255 && origin + float(q) * scale < value)
+		{
+			q++;
+		}
+		return uint8_t(q);
+	}
+
+	bool Bvh8::quantize()
+	{
+		if (quantized() || m_nodeCount == 0)
+		{
+			return true;
+		}
+		const Bvh8Node* nodes = this->nodes();
+
+		std::vector<Bvh8QuantizedNode> quantized(m_nodeCount);
+		for (uint32_t n = 0; n < m_nodeCount; n++)
+		{
+			const Bvh8Node&		node	= nodes[n];
+			Bvh8QuantizedNode&	packed	= quantized[n];
+			packed = Bvh8QuantizedNode{};
+
+			// consecutive children: offsets from the smallest node and group index
+			packed.firstNode	= ~0u;
+			packed.firstGroup	= ~0u;
+			AABB frame;
+			for (uint32_t s = 0; s < 8; s++)
+			{
+				if (node.child[s] == ~0u)
+				{
+					continue;
+				}
+				packed.validMask |= uint8_t(1u << s);
+				frame.grow(vec3(node.loX[s], node.loY[s], node.loZ[s]));
+				frame.grow(vec3(node.hiX[s], node.hiY[s], node.hiZ[s]));
+				uint32_t& first = node.isLeaf(s) ? packed.firstGroup : packed.firstNode;
+				first = std::min(first, node.child[s]);
+			}
+			for (uint32_t s = 0; s < 8; s++)
+			{
+				if (node.child[s] == ~0u)
+				{
+					continue;
+				}
+				const uint32_t offset = node.child[s] - (node.isLeaf(s) ? packed.firstGroup : packed.firstNode);
+				if (offset > 255)
+				{
+					return false;
+				}
+				packed.childOffset[s]	= uint8_t(offset);
+				packed.groupCount[s]	= uint8_t(node.isLeaf(s) ? triangleGroupCount(node.primCount[s]) : 0);
+			}
+
+			// bounds rounded outwards in the node's frame, empty slots inverted
+			const float*	lo[3]	= { node.loX, node.loY, node.loZ };
+			const float*	hi[3]	= { node.hiX, node.hiY, node.hiZ };
+			uint8_t*		qLo[3]	= { packed.loX, packed.loY, packed.loZ };
+			uint8_t*		qHi[3]	= { packed.hiX, packed.hiY, packed.hiZ };
+			for (int a = 0; a < 3; a++)
+			{
+				int exponent = -126;
+				if (packed.validMask != 0)
+				{
+					quantizationFrame(frame.lo[a], frame.hi[a], packed.origin[a], exponent);
+				}
+				packed.exponent[a] = int8_t(exponent);
+				const float scale = exponentScale(exponent);
+				for (uint32_t s = 0; s < 8; s++)
+				{
+					const bool valid = (packed.validMask >> s & 1) != 0;
+					qLo[a][s] = valid ? quantizeDown(lo[a][s], packed.origin[a], scale) : 255;
+					qHi[a][s] = valid ? quantizeUp(hi[a][s], packed.origin[a], scale) : 0;
+					// dequantized as the kernels do; a frame clamped at either end cannot enclose the box
+					if (valid && (packed.origin[a] + float(qLo[a][s]) * scale > lo[a][s] ||
+								  packed.origin[a] + float(qHi[a][s]) * scale < hi[a][s]))
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		m_quantizedNodes = std::move(quantized);
+		std::vector<Bvh8Node>().swap(m_nodes);
+		m_attachedNodes = nullptr;
+		return true;
+	}
+
+
+	// ---------
+	// Traversal
+	// ---------
+	namespace
+	{
+	// per-ray constants of the slab test; near/far select lo or hi per axis from the direction sign
+	struct RaySlabs
+	{
+		float		invDirection[3];
+		float		origin[3];
+		uint32_t	nearOffset[3];			// float offset of the near plane array inside Bvh8Node
+		uint32_t	farOffset[3];
+		float		tMin;
+
+		explicit RaySlabs(const Ray& ray)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				invDirection[a]		= 1.0f / ray.direction[a];
+				origin[a]			= ray.origin[a];
+				nearOffset[a]		= 16 * a + (ray.direction[a] >= 0.0f ? 0 : 8);
+				farOffset[a]		= 16 * a + (ray.direction[a] >= 0.0f ? 8 : 0);
+			}
+			tMin = ray.tMin;
+		}
+	};
+
+	// roundEnterDown / roundExitUp (cpu_math.h) of eight distances. A ray lying in a slab's plane gives
+	// 0 * inf = NaN, which the min/max operand order of the kernels drops in favour of the other bounds
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	__m256 roundEnterDown8(__m256 t)
+	{
+		const __m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), t);
+		return _mm256_fnmadd_ps(magnitude, _mm256_set1_ps(slabRounding), t);
+	}
+
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	__m256 roundExitUp8(__m256 t)
+	{
+		const __m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), t);
+		return _mm256_fmadd_ps(magnitude, _mm256_set1_ps(slabRounding), t);
+	}
+
+	struct StackEntry
+	{
+		uint32_t	child;
+		uint32_t	primCount;		// 0: child is a node
+		float		tEnter;
+	};
+
+	// dense list of the children a node test hit
+	struct ChildHits
+	{
+		uint32_t	slots[8];
+		float		dists[8];
+	};
+
+	// sort far to near (insertion sort over at most eight), so the nearest ends on top of the stack
+	inline void sortFarToNear(ChildHits& hits, uint32_t hitCount)
+	{
+		for (uint32_t i = 1; i < hitCount; i++)
+		{
+			const uint32_t	slot = hits.slots[i];
+			const float		dist = hits.dists[i];
+			uint32_t j = i;
+			for (; j > 0 && hits.dists[j - 1] < dist; j--)
+			{
+				hits.slots[j] = hits.slots[j - 1];
+				hits.dists[j] = hits.dists[j - 1];
+			}
+			hits.slots[j] = slot;
+			hits.dists[j] = dist;
+		}
+	}
+
+	// ----------------------------------------------------------------
+	// Interval bounds of a packet whose rays share a direction octant.
+	// Entry and exit distances of a box are bounded by the corner
+	// products of [plane - origin] and [1 / direction], so a child the
+	// bounds miss is missed by every ray of the packet. The bounds are
+	// only worth using while they stay tight: the rays must leave from
+	// nearly one point and fit in a narrow cone.
+	// ----------------------------------------------------------------
+	static const float packetMinDirectionCosine = 0.999f;		// about 2.5 degrees
+	static const float packetMaxOriginSpread	= 1e-3f;		// relative to the scene bounds
+
+	struct PacketFrustum
+	{
+		float		originMin[3], originMax[3];
+		float		invMin[3], invMax[3];
+		uint32_t	nearOffset[3];
+		uint32_t	farOffset[3];
+		float		tMin;
+		bool		coherent;			// one octant, finite reciprocals, tight origins and cone
+
+		PacketFrustum(const Ray* rays, uint32_t count, const AABB& sceneBounds)
+		{
+			coherent	= true;
+			tMin		= FLT_MAX;
+			for (int a = 0; a < 3; a++)
+			{
+				const bool positive = rays[0].direction[a] >= 0.0f;
+				nearOffset[a]	= 16 * a + (positive ? 0 : 8);
+				farOffset[a]	= 16 * a + (positive ? 8 : 0);
+				originMin[a]	= invMin[a] = FLT_MAX;
+				originMax[a]	= invMax[a] = -FLT_MAX;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const float inv = 1.0f / rays[i].direction[a];
+					coherent		= coherent && (rays[i].direction[a] >= 0.0f) == positive && std::isfinite(inv);
+					originMin[a]	= std::min(originMin[a], rays[i].origin[a]);
+					originMax[a]	= std::max(originMax[a], rays[i].origin[a]);
+					invMin[a]		= std::min(invMin[a], inv);
+					invMax[a]		= std::max(invMax[a], inv);
+				}
+			}
+			const float maxSpread = packetMaxOriginSpread * length(sceneBounds.extent());
+			for (int a = 0; a < 3; a++)
+			{
+				coherent = coherent && originMax[a] - originMin[a] <= maxSpread;
+			}
+			for (uint32_t i = 0; i < count; i++)
+			{
+				coherent	= coherent && dot(rays[i].direction, rays[0].direction) >= packetMinDirectionCosine;
+				tMin		= std::min(tMin, rays[i].tMin);
+			}
+		}
+	};
+
+	struct PacketStackEntry
+	{
+		uint32_t	child;
+		uint32_t	primCount;		// 0: child is a node
+		uint32_t	rayMask;		// rays of the packet that may hit the child
+		float		tEnter;			// lower bound of their entry distances
+	};
+
+	// ----------------------------------------------------------------
+	// Child planes of either node format, at the float offsets of the
+	// Bvh8Node layout (16 * axis, + 8 for hi). Float nodes are read in
+	// place; quantized ones are dequantized as the kernels load them.
+	// ----------------------------------------------------------------
+	struct FloatPlanes
+	{
+		static const uint32_t validMask = 0xff;		// empty slots have inverted boxes
+
+		const float* planes;
+
+		explicit FloatPlanes(const Bvh8Node& node) : planes(node.loX) {}
+
+		float get(uint32_t offset, uint32_t slot) const { return planes[offset + slot]; }
+
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		__m256 load8(uint32_t offset) const { return _mm256_load_ps(planes + offset); }
+	};
+
+	struct QuantizedPlanes
+	{
+		const uint8_t*	q;
+		float			origin[3];
+		float			scale[3];
+		uint32_t		validMask;
+
+		explicit QuantizedPlanes(const Bvh8QuantizedNode& node) : q(node.loX), validMask(node.validMask)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				const uint32_t bits = uint32_t(node.exponent[a] + 127) << 23;
+				memcpy(&scale[a], &bits, sizeof(float));
+				origin[a] = node.origin[a];
+			}
+		}
+
+		float get(uint32_t offset, uint32_t slot) const
+		{
+			const uint32_t axis = offset >> 4;
+			return origin[axis] + float(q[offset + slot]) * scale[axis];
+		}
+
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		__m256 load8(uint32_t offset) const
+		{
+			const uint32_t	axis	= offset >> 4;
+			const __m256	steps	= _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q + offset))));
+			return _mm256_fmadd_ps(steps, _mm256_set1_ps(scale[axis]), _mm256_set1_ps(origin[axis]));
+		}
+	};
+
+	inline FloatPlanes		nodePlanes(const Bvh8Node& node)			{ return FloatPlanes(node); }
+	inline QuantizedPlanes	nodePlanes(const Bvh8QuantizedNode& node)	{ return QuantizedPlanes(node); }
+
+	// stack entry fields of a child; quantized leaves give a prim count that only rounds up to their group count
+	inline void childEntry(const Bvh8Node& node, uint32_t slot, uint32_t& child, uint32_t& primCount)
+	{
+		child		= node.child[slot];
+		primCount	= node.primCount[slot];
+	}
+
+	inline void childEntry(const Bvh8QuantizedNode& node, uint32_t slot, uint32_t& child, uint32_t& primCount)
+	{
+		primCount	= node.groupCount[slot] * triangleGroupWidth;
+		child		= (primCount != 0 ? node.firstGroup : node.firstNode) + node.childOffset[slot];
+	}
+
+	// ---------------------------------------------------------------
+	// Per-ISA kernels: eight child boxes per node, eight triangles per
+	// leaf group
+	// ---------------------------------------------------------------
+	struct ScalarKernel
+	{
+		static bool intersectLeaf(const Ray& ray, const TriangleGroup& group, Hit& hit)
+		{
+			return intersectTriangleGroupScalar(ray, group, hit);
+		}
+
+		template <typename Planes>
+		static uint32_t testFrustum(const Planes& planes, const PacketFrustum& f, float tMax, ChildHits& hits)
+		{
+			uint32_t count = 0;
+			for (uint32_t s = 0; s < 8; s++)
+			{
+				if ((planes.validMask >> s & 1) == 0)
+				{
+					continue;
+				}
+				float enter = f.tMin;
+				float exit	= tMax;
+				for (int a = 0; a < 3; a++)
+				{
+					const float nearP = planes.get(f.nearOffset[a], s);
+					const float farP  = planes.get(f.farOffset[a], s);
+					const float nearLo = nearP - f.originMax[a], nearHi = nearP - f.originMin[a];
+					const float farLo  = farP - f.originMax[a],  farHi  = farP - f.originMin[a];
+					enter	= std::max(enter, std::min(std::min(nearLo * f.invMin[a], nearLo * f.invMax[a]),
+													   std::min(nearHi * f.invMin[a], nearHi * f.invMax[a])));
+					exit	= std::min(exit, std::max(std::max(farLo * f.invMin[a], farLo * f.invMax[a]),
+													  std::max(farHi * f.invMin[a], farHi * f.invMax[a])));
+				}
+				enter	= roundEnterDown(enter);
+				exit	= roundExitUp(exit);
+				if (enter <= exit)
+				{
+					hits.slots[count] = s;
+					hits.dists[count] = enter;
+					count++;
+				}
+			}
+			return count;
+		}
+
+		template <typename Planes>
+		static uint32_t testNode(const Planes& planes, const RaySlabs& r, float tMax, ChildHits& hits)
+		{
+			uint32_t count = 0;
+			for (uint32_t s = 0; s < 8; s++)
+			{
+				if ((planes.validMask >> s & 1) == 0)
+				{
+					continue;
+				}
+				float enter = r.tMin;
+				float exit	= tMax;
+				for (int a = 0; a < 3; a++)
+				{
+					// std::max/min keep the first operand when the other is NaN
+					enter	= std::max(enter, (planes.get(r.nearOffset[a], s) - r.origin[a]) * r.invDirection[a]);
+					exit	= std::min(exit, (planes.get(r.farOffset[a], s) - r.origin[a]) * r.invDirection[a]);
+				}
+				enter	= roundEnterDown(enter);
+				exit	= roundExitUp(exit);
+				if (enter <= exit)
+				{
+					hits.slots[count] = s;
+					hits.dists[count] = enter;
+					count++;
+				}
+			}
+			return count;
+		}
+	};
+
+	struct Avx2Kernel
+	{
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		static bool intersectLeaf(const Ray& ray, const TriangleGroup& group, Hit& hit)
+		{
+			return intersectTriangleGroupAvx2(ray, group, hit);
+		}
+
+		template <typename Planes>
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		static uint32_t testFrustum(const Planes& planes, const PacketFrustum& f, float tMax, ChildHits& hits)
+		{
+			__m256 enter = _mm256_set1_ps(f.tMin);
+			__m256 exit	 = _mm256_set1_ps(tMax);
+			for (int a = 0; a < 3; a++)
+			{
+				const __m256 oMin	= _mm256_set1_ps(f.originMin[a]);
+				const __m256 oMax	= _mm256_set1_ps(f.originMax[a]);
+				const __m256 iMin	= _mm256_set1_ps(f.invMin[a]);
+				const __m256 iMax	= _mm256_set1_ps(f.invMax[a]);
+				const __m256 nearP	= planes.load8(f.nearOffset[a]);
+				const __m256 farP	= planes.load8(f.farOffset[a]);
+				const __m256 nearLo = _mm256_sub_ps(nearP, oMax), nearHi = _mm256_sub_ps(nearP, oMin);
+				const __m256 farLo	= _mm256_sub_ps(farP, oMax),  farHi	 = _mm256_sub_ps(farP, oMin);
+				enter	= _mm256_max_ps(enter, _mm256_min_ps(_mm256_min_ps(_mm256_mul_ps(nearLo, iMin), _mm256_mul_ps(nearLo, iMax)),
+															 _mm256_min_ps(_mm256_mul_ps(nearHi, iMin), _mm256_mul_ps(nearHi, iMax))));
+				exit	= _mm256_min_ps(exit, _mm256_max_ps(_mm256_max_ps(_mm256_mul_ps(farLo, iMin), _mm256_mul_ps(farLo, iMax)),
+															_mm256_max_ps(_mm256_mul_ps(farHi, iMin), _mm256_mul_ps(farHi, iMax))));
+			}
+			enter	= roundEnterDown8(enter);
+			exit	= roundExitUp8(exit);
+			uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ))) & planes.validMask;
+			alignas(32) float dists[8];
+			_mm256_store_ps(dists, enter);
+			uint32_t count = 0;
+			while (mask != 0)
+			{
+				const uint32_t s = bitScanForward(mask);
+				mask &= mask - 1;
+				hits.slots[count] = s;
+				hits.dists[count] = dists[s];
+				count++;
+			}
+			return count;
+		}
+
+		template <typename Planes>
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		static uint32_t testNode(const Planes& planes, const RaySlabs& r, float tMax, ChildHits& hits)
+		{
+			__m256 enter = _mm256_set1_ps(r.tMin);
+			__m256 exit	 = _mm256_set1_ps(tMax);
+			for (int a = 0; a < 3; a++)
+			{
+				const __m256 invD	= _mm256_set1_ps(r.invDirection[a]);
+				const __m256 o		= _mm256_set1_ps(r.origin[a]);
+				// _mm256_max/min_ps return the second operand when either is NaN
+				enter	= _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(planes.load8(r.nearOffset[a]), o), invD), enter);
+				exit	= _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(planes.load8(r.farOffset[a]), o), invD), exit);
+			}
+			enter	= roundEnterDown8(enter);
+			exit	= roundExitUp8(exit);
+			uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ))) & planes.validMask;
+			alignas(32) float dists[8];
+			_mm256_store_ps(dists, enter);
+			uint32_t count = 0;
+			while (mask != 0)
+			{
+				const uint32_t s = bitScanForward(mask);
+				mask &= mask - 1;
+				hits.slots[count] = s;
+				hits.dists[count] = dists[s];
+				count++;
+			}
+			return count;
+		}
+	};
+
+	struct Avx512Kernel
+	{
+		NRC_TARGET_AVX512 NRC_SIMD_INLINE
+		static bool intersectLeaf(const Ray& ray, const TriangleGroup& group, Hit& hit)
+		{
+			return intersectTriangleGroupAvx512(ray, group, hit);
+		}
+
+		template <typename Planes>
+		NRC_TARGET_AVX512 NRC_SIMD_INLINE
+		static uint32_t testFrustum(const Planes& planes, const PacketFrustum& f, float tMax, ChildHits& hits)
+		{
+			return Avx2Kernel::testFrustum(planes, f, tMax, hits);
+		}
+
+		template <typename Planes>
+		NRC_TARGET_AVX512 NRC_SIMD_INLINE
+		static uint32_t testNode(const Planes& planes, const RaySlabs& r, float tMax, ChildHits& hits)
+		{
+			__m256 enter = _mm256_set1_ps(r.tMin);
+			__m256 exit	 = _mm256_set1_ps(tMax);
+			for (int a = 0; a < 3; a++)
+			{
+				const __m256 invD	= _mm256_set1_ps(r.invDirection[a]);
+				const __m256 o		= _mm256_set1_ps(r.origin[a]);
+				// _mm256_max/min_ps return the second operand when either is NaN
+				enter	= _mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(planes.load8(r.nearOffset[a]), o), invD), enter);
+				exit	= _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(planes.load8(r.farOffset[a]), o), invD), exit);
+			}
+			// mask register + compress store: hit slots and distances come out dense, no bit loop
+			enter	= roundEnterDown8(enter);
+			exit	= roundExitUp8(exit);
+			const __mmask8 mask = _mm256_mask_cmp_ps_mask(__mmask8(planes.validMask), enter, exit, _CMP_LE_OQ);
+			_mm256_mask_compressstoreu_epi32(hits.slots, mask, _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			_mm256_mask_compressstoreu_ps(hits.dists, mask, enter);
+			return uint32_t(_mm_popcnt_u32(mask));
+		}
+	};
+	}
+
+	// flattened into the per-ISA entry points, so the node test inlines into the loop
+	template <typename Kernel, typename Node>
+	NRC_SIMD_INLINE bool Bvh8::traverse(const Node* nodes, const Ray& ray, Hit& hit, uint32_t rootChild, uint32_t rootPrimCount) const
+	{
+		if (m_nodeCount == 0)
+		{
+			return false;
+		}
+		const TriangleGroup* triangles = this->triangles();
+		const RaySlabs slabs(ray);
+
+		StackEntry	stack[maxStackSize];
+		uint32_t	stackSize = 0;
+		stack[stackSize++] = { rootChild, rootPrimCount, ray.tMin };
+		while (stackSize > 0)
+		{
+			const StackEntry entry = stack[--stackSize];
+			if (entry.tEnter > hit.t)
+			{
+				continue;	// a closer hit was found since this entry was pushed
+			}
+
+			if (entry.primCount != 0)
+			{
+				const uint32_t groupEnd = entry.child + triangleGroupCount(entry.primCount);
+				for (uint32_t g = entry.child; g < groupEnd; g++)
+				{
+					Kernel::intersectLeaf(ray, triangles[g], hit);
+				}
+				continue;
+			}
+
+			// test all eight children at once
+			const Node& node = nodes[entry.child];
+			ChildHits hits;
+			const uint32_t hitCount = Kernel::testNode(nodePlanes(node), slabs, std::min(ray.tMax, hit.t), hits);
+
+			sortFarToNear(hits, hitCount);
+			for (uint32_t i = 0; i < hitCount; i++)
+			{
+				StackEntry& pushed = stack[stackSize++];
+				childEntry(node, hits.slots[i], pushed.child, pushed.primCount);
+				pushed.tEnter = hits.dists[i];
+			}
+		}
+		return hit.valid();
+	}
+
+	// -----------------------------------------------------------------
+	// Packet traversal: the packet visits each node once and culls its
+	// children with one interval test against the packet frustum
+	// instead of a slab test per ray. A stack entry remembers which
+	// rays are still looking for a hit there; rays drop out once they
+	// hit something closer, and entries left with fewer than
+	// minActiveRays rays continue as single-ray traversals.
+	// -----------------------------------------------------------------
+	template <typename Kernel, typename Node>
+	NRC_SIMD_INLINE void Bvh8::traversePacket(const Node* nodes, const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const
+	{
+		if (m_nodeCount == 0)
+		{
+			return;
+		}
+		const TriangleGroup* triangles = this->triangles();
+		const PacketFrustum frustum(rays, count, m_bounds);
+		if (!frustum.coherent || count < minActiveRays)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				traverse<Kernel>(nodes, rays[i], hits[i], 0, 0);
+			}
+			return;
+		}
+
+		PacketStackEntry	stack[maxStackSize];
+		uint32_t			stackSize = 0;
+		stack[stackSize++] = { 0, 0, (1u << count) - 1, frustum.tMin };
+		while (stackSize > 0)
+		{
+			const PacketStackEntry entry = stack[--stackSize];
+
+			// drop the rays that found a closer hit since this entry was pushed
+			uint32_t	rayMask = 0;
+			float		tMax	= -FLT_MAX;
+			for (uint32_t bits = entry.rayMask; bits != 0; bits &= bits - 1)
+			{
+				const uint32_t i = bitScanForward(bits);
+				if (hits[i].t >= entry.tEnter)
+				{
+					rayMask |= 1u << i;
+					tMax	= std::max(tMax, std::min(rays[i].tMax, hits[i].t));
+				}
+			}
+			if (rayMask == 0)
+			{
+				continue;
+			}
+
+			// coherence is gone, the remaining rays finish the subtree on their own
+			if (bitCount(rayMask) < minActiveRays)
+			{
+				for (uint32_t bits = rayMask; bits != 0; bits &= bits - 1)
+				{
+					const uint32_t i = bitScanForward(bits);
+					traverse<Kernel>(nodes, rays[i], hits[i], entry.child, entry.primCount);
+				}
+				continue;
+			}
+
+			if (entry.primCount != 0)
+			{
+				const uint32_t groupEnd = entry.child + triangleGroupCount(entry.primCount);
+				for (uint32_t g = entry.child; g < groupEnd; g++)
+				{
+					for (uint32_t bits = rayMask; bits != 0; bits &= bits - 1)
+					{
+						const uint32_t i = bitScanForward(bits);
+						Kernel::intersectLeaf(rays[i], triangles[g], hits[i]);
+					}
+				}
+				continue;
+			}
+
+			// children the frustum reaches inherit the ray mask; rays are told apart only in the leaves
+			const Node& node = nodes[entry.child];
+			ChildHits children;
+			const uint32_t childCount = Kernel::testFrustum(nodePlanes(node), frustum, tMax, children);
+			sortFarToNear(children, childCount);
+			for (uint32_t c = 0; c < childCount; c++)
+			{
+				PacketStackEntry& pushed = stack[stackSize++];
+				childEntry(node, children.slots[c], pushed.child, pushed.primCount);
+				pushed.rayMask	= rayMask;
+				pushed.tEnter	= children.dists[c];
+			}
+		}
+	}
+
+	NRC_FLATTEN
+	bool Bvh8::intersectScalar(const Ray& ray, Hit& hit) const
+	{
+		return quantized() ? traverse<ScalarKernel>(m_quantizedNodes.data(), ray, hit, 0, 0) : traverse<ScalarKernel>(nodes(), ray, hit, 0, 0);
+	}
+
+	NRC_TARGET_AVX2 NRC_FLATTEN
+	bool Bvh8::intersectAvx2(const Ray& ray, Hit& hit) const
+	{
+		return quantized() ? traverse<Avx2Kernel>(m_quantizedNodes.data(), ray, hit, 0, 0) : traverse<Avx2Kernel>(nodes(), ray, hit, 0, 0);
+	}
+
+	NRC_TARGET_AVX512 NRC_FLATTEN
+	bool Bvh8::intersectAvx512(const Ray& ray, Hit& hit) const
+	{
+		return quantized() ? traverse<Avx512Kernel>(m_quantizedNodes.data(), ray, hit, 0, 0) : traverse<Avx512Kernel>(nodes(), ray, hit, 0, 0);
+	}
+
+	NRC_FLATTEN
+	void Bvh8::intersectPacketScalar(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const
+	{
+		if (quantized())
+		{
+			traversePacket<ScalarKernel>(m_quantizedNodes.data(), rays, hits, count, minActiveRays);
+		}
+		else
+		{
+			traversePacket<ScalarKernel>(nodes(), rays, hits, count, minActiveRays);
+		}
+	}
+
+	NRC_TARGET_AVX2 NRC_FLATTEN
+	void Bvh8::intersectPacketAvx2(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const
+	{
+		if (quantized())
+		{
+			traversePacket<Avx2Kernel>(m_quantizedNodes.data(), rays, hits, count, minActiveRays);
+		}
+		else
+		{
+			traversePacket<Avx2Kernel>(nodes(), rays, hits, count, minActiveRays);
+		}
+	}
+
+	NRC_TARGET_AVX512 NRC_FLATTEN
+	void Bvh8::intersectPacketAvx512(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const
+	{
+		if (quantized())
+		{
+			traversePacket<Avx512Kernel>(m_quantizedNodes.data(), rays, hits, count, minActiveRays);
+		}
+		else
+		{
+			traversePacket<Avx512Kernel>(nodes(), rays, hits, count, minActiveRays);
+		}
+	}
+
+	bool Bvh8::intersect(const Ray& ray, Hit& hit, SimdLevel level) const
+	{
+		switch (level)
+		{
+		case SimdLevel::Avx512:	return intersectAvx512(ray, hit);
+		case SimdLevel::Avx2:	return intersectAvx2(ray, hit);
+		default:				return intersectScalar(ray, hit);
+		}
+	}
+
+	bool Bvh8::intersect(const Ray& ray, Hit& hit) const
+	{
+		return intersect(ray, hit, m_simdLevel);
+	}
+
+	void Bvh8::intersectPacket(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays, SimdLevel level) const
+	{
+		switch (level)
+		{
+		case SimdLevel::Avx512:	intersectPacketAvx512(rays, hits, count, minActiveRays);	break;
+		case SimdLevel::Avx2:	intersectPacketAvx2(rays, hits, count, minActiveRays);		break;
+		default:				intersectPacketScalar(rays, hits, count, minActiveRays);	break;
+		}
+	}
+
+	void Bvh8::intersectPacket(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const
+	{
+		intersectPacket(rays, hits, count, minActiveRays, m_simdLevel);
+	}
+}
@@ -0,0 +1,156 @@
+# pragma once
+
+#include <memory>
+#include <vector>
+#include <cpu_bvh.h>
+#include <cpu_triangles.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Eight-wide BVH node, children in SoA so one AVX register holds one
+	// bound of all eight children. 256 bytes, aligned to cache lines.
+	// Empty slots have inverted bounds and never intersect.
+	// ----------------------------------------------------------------
+	struct alignas(64) Bvh8Node
+	{
+		float		loX[8], hiX[8];
+		float		loY[8], hiY[8];
+		float		loZ[8], hiZ[8];
+		uint32_t	child[8];			// interior: node index, leaf: first triangle group
+		uint8_t		primCount[8];		// triangles of a leaf child, 0 for interior children
+		uint8_t		padding[24];
+
+		bool isLeaf(int slot) const { return primCount[slot] != 0; }
+	};
+	static_assert(sizeof(Bvh8Node) == 256, "Bvh8Node is expected to span four cache lines");
+
+	// ----------------------------------------------------------------
+	// Compressed Bvh8Node: child bounds are 8-bit offsets in a frame
+	// spanning the node, origin + q * 2^exponent per axis, rounded
+	// outwards so the dequantized boxes contain the exact ones. The
+	// scale is a power of two, so q * scale is exact and dequantizing
+	// rounds once, with or without FMA. Interior children and leaf
+	// groups of a node are stored consecutively by the collapse, so one
+	// base index each plus a byte per slot replaces the child array.
+	// 88 bytes, about a third of the float node.
+	// ----------------------------------------------------------------
+	struct Bvh8QuantizedNode
+	{
+		float		origin[3];
+		int8_t		exponent[3];
+		uint8_t		validMask;			// slots holding a child
+		uint32_t	firstNode;			// interior child: firstNode + childOffset
+		uint32_t	firstGroup;			// leaf child: groupCount groups from firstGroup + childOffset
+		uint8_t		childOffset[8];
+		uint8_t		groupCount[8];		// 0 for interior children
+		uint8_t		loX[8], hiX[8];		// same order as the planes of Bvh8Node
+		uint8_t		loY[8], hiY[8];
+		uint8_t		loZ[8], hiZ[8];
+
+		bool isLeaf(int slot) const { return groupCount[slot] != 0; }
+	};
+	static_assert(sizeof(Bvh8QuantizedNode) == 88, "Bvh8QuantizedNode is expected to be 88 bytes");
+
+	// ----------------------------------------------------------------
+	// BVH8 collapsed from a binary BVH. Each BVH8 node takes the eight
+	// largest-area descendants of a binary node (interior children are
+	// opened greedily by surface area), leaves keep their triangles but
+	// as pre-packed groups of eight, so the BVH8 no longer needs the
+	// mesh arrays. Traversal tests all eight children and all eight
+	// triangles of a group per step with AVX-512, AVX2 or a scalar
+	// fallback, chosen at runtime.
+	//
+	// The nodes and groups are either built by collapse() or borrowed
+	// from read-only storage (a mapped cache file, see cpu_bvh_cache.h)
+	// that the BVH8 and its copies keep alive.
+	//
+	// quantize() swaps the float nodes for Bvh8QuantizedNode, trading a
+	// few instructions per node test for a third of the node memory, so
+	// more of a large scene's nodes stay in the caches.
+	// ----------------------------------------------------------------
+	class Bvh8
+	{
+	public:
+		// children of every BVH8 node along one path are at most this deep on the stack
+		static const uint32_t maxStackSize = 8 * Bvh::maxTraversalDepth;
+		// rays per packet, one bit each in a 32-bit ray mask
+		static constexpr uint32_t maxPacketSize = 16;
+
+		// settings for the binary build of a BVH that is collapsed afterwards: a leaf fills one triangle
+		// group, and testing a triangle costs about an eighth of what it does one at a time
+		static BvhBuildSettings buildSettings()
+		{
+			BvhBuildSettings settings;
+			settings.maxLeafSize		= triangleGroupWidth;
+			settings.intersectionCost	= 1.0f / triangleGroupWidth;
+			return settings;
+		}
+
+		// positions and indices are the arrays bvh was built over
+		void collapse(const Bvh& bvh, const float* positions, const uint32_t* indices);
+
+		// trace nodes and groups that live in storage instead of building them; storage owns the memory
+		void attach(std::shared_ptr<const void> storage, const Bvh8Node* nodes, uint32_t nodeCount,
+					const TriangleGroup* triangles, uint32_t groupCount, const AABB& bounds);
+
+		// copies the nodes and groups of source, attached or not, into memory of its own written by the
+		// calling thread, so on a NUMA host the copy lives on that thread's node
+		void replicate(const Bvh8& source);
+
+		// Replaces the nodes by quantized ones and releases the float nodes (a mapping only stops being read).
+		// False, leaving the BVH8 as it is, if a node's children are not stored consecutively or its boxes are
+		// too far apart for an 8-bit frame to enclose them.
+		bool quantize();
+
+		// closest hit; level defaults to the widest supported instruction set
+		bool intersect(const Ray& ray, Hit& hit) const;
+		bool intersect(const Ray& ray, Hit& hit, SimdLevel level) const;
+
+		// closest hits of up to maxPacketSize rays traced together; incoherent packets (several origins, or
+		// directions beyond a narrow cone) and subtrees reached by fewer than minActiveRays of them fall
+		// back to single rays
+		void intersectPacket(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const;
+		void intersectPacket(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays, SimdLevel level) const;
+
+		SimdLevel simdLevel() const { return m_simdLevel; }
+		void setSimdLevel(SimdLevel level) { m_simdLevel = level; }
+
+		// float nodes, nullptr once quantized
+		const Bvh8Node*				nodes() const			{ return quantized() ? nullptr : m_storage ? m_attachedNodes : m_nodes.data(); }
+		const Bvh8QuantizedNode*	quantizedNodes() const	{ return m_quantizedNodes.data(); }
+		uint32_t					nodeCount() const		{ return m_nodeCount; }
+		const TriangleGroup*		triangles() const		{ return m_storage ? m_attachedTriangles : m_triangles.data(); }
+		uint32_t					groupCount() const		{ return m_groupCount; }
+		AABB						bounds() const			{ return m_bounds; }
+		bool						attached() const		{ return m_storage != nullptr; }
+		bool						quantized() const		{ return !m_quantizedNodes.empty(); }
+
+		size_t nodeBytes() const { return size_t(m_nodeCount) * (quantized() ? sizeof(Bvh8QuantizedNode) : sizeof(Bvh8Node)); }
+		size_t memoryBytes() const { return nodeBytes() + size_t(m_groupCount) * sizeof(TriangleGroup); }
+
+	private:
+		template <typename Kernel, typename Node>
+		bool traverse(const Node* nodes, const Ray& ray, Hit& hit, uint32_t rootChild, uint32_t rootPrimCount) const;
+		template <typename Kernel, typename Node>
+		void traversePacket(const Node* nodes, const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const;
+		bool intersectScalar(const Ray& ray, Hit& hit) const;
+		bool intersectAvx2(const Ray& ray, Hit& hit) const;
+		bool intersectAvx512(const Ray& ray, Hit& hit) const;
+		void intersectPacketScalar(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const;
+		void intersectPacketAvx2(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const;
+		void intersectPacketAvx512(const Ray* rays, Hit* hits, uint32_t count, uint32_t minActiveRays) const;
+
+		std::vector<Bvh8Node>		m_nodes;			// node 0 is the root
+		std::vector<TriangleGroup>	m_triangles;		// leaf triangles, packed per leaf
+		std::vector<Bvh8QuantizedNode>	m_quantizedNodes;	// replaces the float nodes after quantize()
+		uint32_t					m_nodeCount			= 0;
+		uint32_t					m_groupCount		= 0;
+		// attached instead of built: the vectors stay empty
+		std::shared_ptr<const void>	m_storage;
+		const Bvh8Node*				m_attachedNodes		= nullptr;
+		const TriangleGroup*		m_attachedTriangles = nullptr;
+		AABB						m_bounds;
+		SimdLevel					m_simdLevel = detectSimdLevel();
+	};
+}
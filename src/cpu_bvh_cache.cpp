@@ -0,0 +1,356 @@
+#include <cpu_bvh_cache.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NRC
+{
+	// nodes and groups start on page boundaries, so the mapping hands them out aligned
+	static const uint64_t bvhCacheAlignment = 4096;
+	static const char bvhCacheMagic[8] = { 'N', 'R', 'C', 'B', 'V', 'H', '8', '\0' };
+
+	struct BvhCacheHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	headerSize;
+		uint32_t	nodeSize;			// sizeof(Bvh8Node) of the writer
+		uint32_t	groupSize;			// sizeof(TriangleGroup) of the writer
+		uint32_t	nodeCount;
+		uint32_t	groupCount;
+		uint64_t	sceneHash;
+		uint64_t	nodeOffset;
+		uint64_t	groupOffset;
+		uint64_t	fileSize;
+		float		boundsLo[3];
+		float		boundsHi[3];
+		uint64_t	payloadChecksum;	// nodes, then groups
+		uint64_t	headerChecksum;		// every field above
+	};
+	static_assert(sizeof(BvhCacheHeader) == 104, "BvhCacheHeader is expected to have no padding");
+
+	static uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// -------
+	// Hashing
+	// -------
+	static uint64_t rotateLeft(uint64_t v, int bits)
+	{
+		return (v << bits) | (v >> (64 - bits));
+	}
+
+	static uint64_t finalizeHash(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// one 64-bit word at a time in the style of MurmurHash3, fast enough to check a large BVH on load
+	uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+	{
+		const uint8_t*	bytes	= reinterpret_cast<const uint8_t*>(data);
+		uint64_t		h		= seed ^ (uint64_t(size) * 0x9e3779b97f4a7c15ull);
+		auto mix = [&h](uint64_t word)
+		{
+			word *= 0x87c37b91114253d5ull;
+			word  = rotateLeft(word, 31);
+			word *= 0x4cf5ad432745937full;
+			h ^= word;
+			h  = rotateLeft(h, 27) * 5 + 0x52dce729;
+		};
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, 8);
+			mix(word);
+		}
+		if (i < size)
+		{
+			uint64_t word = 0;
+			memcpy(&word, bytes + i, size - i);
+			mix(word);
+		}
+		return finalizeHash(h);
+	}
+
+	uint64_t hashScene(const float* positions, size_t positionCount, const uint32_t* indices, size_t indexCount,
+					   const BvhBuildSettings& settings)
+	{
+		// field by field, the struct may have padding
+		uint64_t h = hashBytes(positions, positionCount * sizeof(float));
+		h = hashBytes(indices, indexCount * sizeof(uint32_t), h);
+		h = hashBytes(&settings.binCount, sizeof(settings.binCount), h);
+		h = hashBytes(&settings.maxLeafSize, sizeof(settings.maxLeafSize), h);
+		h = hashBytes(&settings.traversalCost, sizeof(settings.traversalCost), h);
+		h = hashBytes(&settings.intersectionCost, sizeof(settings.intersectionCost), h);
+		if (settings.spatialSplits)
+		{
+			h = hashBytes(&settings.splitBudget, sizeof(settings.splitBudget), h);
+			h = hashBytes(&settings.splitMinOverlap, sizeof(settings.splitMinOverlap), h);
+		}
+		return h;
+	}
+
+	std::string bvhCachePath(const std::string& directory, uint64_t sceneHash)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bvh8", static_cast<unsigned long long>(sceneHash));
+		if (directory.empty())
+		{
+			return name;
+		}
+		const char last = directory.back();
+		return directory + (last == '/' || last == '\\' ? "" : "/") + name;
+	}
+
+	static uint64_t payloadChecksum(const Bvh8Node* nodes, uint32_t nodeCount, const TriangleGroup* groups, uint32_t groupCount)
+	{
+		const uint64_t h = hashBytes(nodes, size_t(nodeCount) * sizeof(Bvh8Node));
+		return hashBytes(groups, size_t(groupCount) * sizeof(TriangleGroup), h);
+	}
+
+	static uint64_t headerChecksum(const BvhCacheHeader& header)
+	{
+		return hashBytes(&header, offsetof(BvhCacheHeader, headerChecksum));
+	}
+
+
+	// -----------------
+	// Read-only mapping
+	// -----------------
+	namespace
+	{
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { close(); }
+
+		bool open(const std::string& path)
+		{
+#ifdef _WIN32
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+								 FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			{
+				return false;
+			}
+			m_size		= size_t(size.QuadPart);
+			m_mapping	= CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping == nullptr)
+			{
+				return false;
+			}
+			m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			return m_data != nullptr;
+#else
+			const int file = ::open(path.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				return false;
+			}
+			struct stat status;
+			if (fstat(file, &status) != 0 || status.st_size == 0)
+			{
+				::close(file);
+				return false;
+			}
+			// shared: every process mapping the file reads the same page cache pages
+			m_size = size_t(status.st_size);
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+			::close(file);		// the mapping keeps the file open
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+			m_data = data;
+			return true;
+#endif
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (m_data != nullptr)
+			{
+				UnmapViewOfFile(m_data);
+			}
+			if (m_mapping != nullptr)
+			{
+				CloseHandle(m_mapping);
+			}
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+			}
+			m_mapping	= nullptr;
+			m_file		= INVALID_HANDLE_VALUE;
+#else
+			if (m_data != nullptr)
+			{
+				munmap(m_data, m_size);
+			}
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		const uint8_t*	data() const { return reinterpret_cast<const uint8_t*>(m_data); }
+		size_t			size() const { return m_size; }
+
+	private:
+		void*	m_data		= nullptr;
+		size_t	m_size		= 0;
+#ifdef _WIN32
+		HANDLE	m_file		= INVALID_HANDLE_VALUE;
+		HANDLE	m_mapping	= nullptr;
+#endif
+	};
+	}
+
+
+	// -------------
+	// Save and load
+	// -------------
+	bool saveBvhCache(const std::string& path, uint64_t sceneHash, const Bvh8& bvh)
+	{
+		if (bvh.quantized())
+		{
+			return false;	// files hold float nodes, quantizing after loading is cheap
+		}
+		BvhCacheHeader header;
+		memset(&header, 0, sizeof(header));		// padding-free, but keep the checksum independent of stack garbage
+		memcpy(header.magic, bvhCacheMagic, sizeof(header.magic));
+		header.version		= bvhCacheVersion;
+		header.headerSize	= sizeof(BvhCacheHeader);
+		header.nodeSize		= sizeof(Bvh8Node);
+		header.groupSize	= sizeof(TriangleGroup);
+		header.nodeCount	= bvh.nodeCount();
+		header.groupCount	= bvh.groupCount();
+		header.sceneHash	= sceneHash;
+		header.nodeOffset	= bvhCacheAlignment;
+		header.groupOffset	= alignUp(header.nodeOffset + uint64_t(header.nodeCount) * sizeof(Bvh8Node), bvhCacheAlignment);
+		header.fileSize		= header.groupOffset + uint64_t(header.groupCount) * sizeof(TriangleGroup);
+		const AABB bounds = bvh.bounds();
+		for (int a = 0; a < 3; a++)
+		{
+			header.boundsLo[a] = bounds.lo[a];
+			header.boundsHi[a] = bounds.hi[a];
+		}
+		header.payloadChecksum	= payloadChecksum(bvh.nodes(), bvh.nodeCount(), bvh.triangles(), bvh.groupCount());
+		header.headerChecksum	= headerChecksum(header);
+
+		// unique per process, several renderers may miss on the same scene at once
+#ifdef _WIN32
+		const std::string temporaryPath = path + ".tmp" + std::to_string(GetCurrentProcessId());
+#else
+		const std::string temporaryPath = path + ".tmp" + std::to_string(getpid());
+#endif
+		FILE* file = fopen(temporaryPath.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const std::vector<uint8_t> zeros(bvhCacheAlignment, 0);
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1
+					&& fwrite(zeros.data(), header.nodeOffset - sizeof(header), 1, file) == 1;
+		if (written && header.nodeCount > 0)
+		{
+			const uint64_t nodeEnd = header.nodeOffset + uint64_t(header.nodeCount) * sizeof(Bvh8Node);
+			written = fwrite(bvh.nodes(), sizeof(Bvh8Node), header.nodeCount, file) == header.nodeCount
+				   && (header.groupOffset == nodeEnd || fwrite(zeros.data(), header.groupOffset - nodeEnd, 1, file) == 1);
+		}
+		if (written && header.groupCount > 0)
+		{
+			written = fwrite(bvh.triangles(), sizeof(TriangleGroup), header.groupCount, file) == header.groupCount;
+		}
+		written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+		written = written && MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		written = written && rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+		if (!written)
+		{
+			remove(temporaryPath.c_str());
+		}
+		return written;
+	}
+
+	bool loadBvhCache(const std::string& path, uint64_t sceneHash, bool verifyPayload, Bvh8& bvh)
+	{
+		std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+		if (!file->open(path) || file->size() < sizeof(BvhCacheHeader))
+		{
+			return false;
+		}
+
+		// the header is the only part read up front
+		BvhCacheHeader header;
+		memcpy(&header, file->data(), sizeof(header));
+		if (memcmp(header.magic, bvhCacheMagic, sizeof(header.magic)) != 0
+			|| header.version		!= bvhCacheVersion
+			|| header.headerSize	!= sizeof(BvhCacheHeader)
+			|| header.nodeSize		!= sizeof(Bvh8Node)
+			|| header.groupSize		!= sizeof(TriangleGroup)
+			|| header.sceneHash		!= sceneHash
+			|| header.headerChecksum != headerChecksum(header))
+		{
+			return false;
+		}
+		// the offsets are covered by the checksum, these only catch truncated files and bugs of the writer
+		const uint64_t nodeEnd	= header.nodeOffset + uint64_t(header.nodeCount) * sizeof(Bvh8Node);
+		const uint64_t groupEnd = header.groupOffset + uint64_t(header.groupCount) * sizeof(TriangleGroup);
+		if (header.fileSize != file->size()
+			|| header.nodeOffset % bvhCacheAlignment != 0 || header.groupOffset % bvhCacheAlignment != 0
+			|| header.nodeOffset < sizeof(BvhCacheHeader) || nodeEnd > header.groupOffset || groupEnd > header.fileSize)
+		{
+			return false;
+		}
+
+		const Bvh8Node*			nodes	= reinterpret_cast<const Bvh8Node*>(file->data() + header.nodeOffset);
+		const TriangleGroup*	groups	= reinterpret_cast<const TriangleGroup*>(file->data() + header.groupOffset);
+		if (verifyPayload && payloadChecksum(nodes, header.nodeCount, groups, header.groupCount) != header.payloadChecksum)
+		{
+			return false;
+		}
+
+		AABB bounds;
+		for (int a = 0; a < 3; a++)
+		{
+			bounds.lo[a] = header.boundsLo[a];
+			bounds.hi[a] = header.boundsHi[a];
+		}
+		bvh.attach(std::move(file), nodes, header.nodeCount, groups, header.groupCount, bounds);
+		return true;
+	}
+}
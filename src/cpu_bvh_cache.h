@@ -0,0 +1,46 @@
+# pragma once
+
+#include <memory>
+#include <string>
+#include <cpu_bvh8.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// On-disk cache of a built BVH8, so rendering the same scene again
+	// skips the build.
+	//
+	// A cache file is a 4 KiB header followed by the nodes and then the
+	// triangle groups, both page aligned and stored exactly as they sit
+	// in memory. Loading maps the file read-only and attaches the BVH8
+	// to the mapping: there is no parsing and no copy, pages are faulted
+	// in as traversal touches them, and processes rendering the same
+	// scene share them through the page cache.
+	//
+	// The header holds a format version, the sizes of the node and group
+	// structs, the scene hash and checksums of itself and of the payload.
+	// A file that does not match is treated as a miss. Files are written
+	// to a temporary name and renamed, so a reader never maps a partly
+	// written file. The layout is that of the writing host; a file from
+	// a host with other endianness or struct layout fails the checks.
+	// ----------------------------------------------------------------
+	static const uint32_t bvhCacheVersion = 1;
+
+	// 64-bit hash of a byte range, not cryptographic
+	uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+	// key of a scene: its geometry and the settings the BVH is built with (threadCount does not change the result)
+	uint64_t hashScene(const float* positions, size_t positionCount, const uint32_t* indices, size_t indexCount,
+					   const BvhBuildSettings& settings);
+
+	// cache file name of a scene inside directory
+	std::string bvhCachePath(const std::string& directory, uint64_t sceneHash);
+
+	// writes bvh to path (through a temporary file), false on I/O errors or for a quantized bvh
+	bool saveBvhCache(const std::string& path, uint64_t sceneHash, const Bvh8& bvh);
+
+	// Maps path and attaches bvh to it. False when the file is missing, belongs to another scene,
+	// has another version or layout, or its header checksum fails; bvh is left untouched then.
+	// verifyPayload also checks the node and group checksum, which reads the whole file.
+	bool loadBvhCache(const std::string& path, uint64_t sceneHash, bool verifyPayload, Bvh8& bvh);
+}
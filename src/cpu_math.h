@@ -0,0 +1,148 @@
+# pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+namespace NRC
+{
+	// --------------------------------------------------------
+	// Minimal vector math of the CPU backend, mirrors the GLSL
+	// built-ins used by raytracer.comp.glsl
+	// --------------------------------------------------------
+	struct vec3
+	{
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+
+		vec3() = default;
+		explicit vec3(float s) : x(s), y(s), z(s) {}
+		vec3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+		float  operator[](int i) const	{ return (&x)[i]; }
+		float& operator[](int i)		{ return (&x)[i]; }
+
+		vec3  operator-() const						{ return vec3(-x, -y, -z); }
+		vec3& operator+=(const vec3& b)				{ x += b.x; y += b.y; z += b.z; return *this; }
+		vec3& operator*=(const vec3& b)				{ x *= b.x; y *= b.y; z *= b.z; return *this; }
+		vec3& operator*=(float s)					{ x *= s; y *= s; z *= s; return *this; }
+	};
+
+	inline vec3 operator+(const vec3& a, const vec3& b)	{ return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	inline vec3 operator-(const vec3& a, const vec3& b)	{ return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline vec3 operator*(const vec3& a, const vec3& b)	{ return vec3(a.x * b.x, a.y * b.y, a.z * b.z); }
+	inline vec3 operator*(const vec3& a, float s)		{ return vec3(a.x * s, a.y * s, a.z * s); }
+	inline vec3 operator*(float s, const vec3& a)		{ return a * s; }
+	inline vec3 operator/(const vec3& a, float s)		{ return a * (1.0f / s); }
+
+	inline float dot(const vec3& a, const vec3& b)		{ return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline vec3  cross(const vec3& a, const vec3& b)	{ return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+	inline float length(const vec3& a)					{ return std::sqrt(dot(a, a)); }
+	inline vec3  normalize(const vec3& a)				{ return a / length(a); }
+	inline vec3  min(const vec3& a, const vec3& b)		{ return vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+	inline vec3  max(const vec3& a, const vec3& b)		{ return vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+	inline vec3  mix(const vec3& a, const vec3& b, float t) { return a * (1.0f - t) + b * t; }
+
+	struct AABB
+	{
+		vec3 lo = vec3( FLT_MAX);
+		vec3 hi = vec3(-FLT_MAX);
+
+		void grow(const vec3& p)		{ lo = min(lo, p); hi = max(hi, p); }
+		void grow(const AABB& b)		{ lo = min(lo, b.lo); hi = max(hi, b.hi); }
+		bool  empty() const				{ return lo.x > hi.x; }
+		vec3  center() const			{ return (lo + hi) * 0.5f; }
+		vec3  extent() const			{ return hi - lo; }
+		// half of the surface area, enough for SAH ratios
+		float halfArea() const
+		{
+			if (empty())
+			{
+				return 0.0f;
+			}
+			const vec3 e = extent();
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+	};
+
+	// read vertex i of a tightly packed vec3 position array
+	inline vec3 loadVec3(const float* positions, uint32_t i)
+	{
+		return vec3(positions[3 * size_t(i) + 0], positions[3 * size_t(i) + 1], positions[3 * size_t(i) + 2]);
+	}
+
+	// -------------------------------------
+	// Rays, hits and triangle intersection
+	// -------------------------------------
+	struct Ray
+	{
+		vec3	origin;
+		vec3	direction;
+		float	tMin = 0.0f;
+		float	tMax = FLT_MAX;
+	};
+
+	struct Hit
+	{
+		float		t			= FLT_MAX;
+		float		u			= 0.0f;			// barycentric of vertex 1
+		float		v			= 0.0f;			// barycentric of vertex 2
+		uint32_t	primitive	= ~0u;
+
+		bool valid() const { return primitive != ~0u; }
+	};
+
+	// ----------------------------------------------------------------
+	// Conservative slab distances. (plane - o) * (1/d) rounds three
+	// times (difference, reciprocal, product), so a computed distance
+	// is within 3 ulp relative of the exact one; rounding the entry down
+	// and the exit up by twice that before comparing them never culls a
+	// box the ray touches, flat ones included, and the entry stays a
+	// lower bound of the exact one.
+	// ----------------------------------------------------------------
+	static const float slabRounding = 2.0f * 3.0f * FLT_EPSILON;
+
+	inline float roundEnterDown(float t)	{ return t - std::fabs(t) * slabRounding; }
+	inline float roundExitUp(float t)		{ return t + std::fabs(t) * slabRounding; }
+
+	// Moeller-Trumbore, two-sided; updates hit when closer than hit.t and within [tMin, tMax]. On a tie
+	// the smaller primitive wins, so the hit does not depend on the order triangles are tested in
+	// e1 = v1 - v0, e2 = v2 - v0
+	inline bool intersectTriangleEdges(const Ray& ray, const vec3& v0, const vec3& e1, const vec3& e2, uint32_t primitive, Hit& hit)
+	{
+		const vec3	p	= cross(ray.direction, e2);
+		const float det = dot(e1, p);
+		if (std::fabs(det) < 1e-12f)
+		{
+			return false;	// parallel
+		}
+		const float invDet	= 1.0f / det;
+		const vec3	s		= ray.origin - v0;
+		const float u		= dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+		const vec3	q	= cross(s, e1);
+		const float v	= dot(ray.direction, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+		const float t = dot(e2, q) * invDet;
+		if (t < ray.tMin || t > ray.tMax || t > hit.t || (t == hit.t && primitive >= hit.primitive))
+		{
+			return false;
+		}
+		hit.t			= t;
+		hit.u			= u;
+		hit.v			= v;
+		hit.primitive	= primitive;
+		return true;
+	}
+
+	inline bool intersectTriangle(const Ray& ray, const vec3& v0, const vec3& v1, const vec3& v2, uint32_t primitive, Hit& hit)
+	{
+		return intersectTriangleEdges(ray, v0, v1 - v0, v2 - v0, primitive, hit);
+	}
+}
@@ -0,0 +1,709 @@
+#include <cpu_nrc.h>
+#include <cpu_scheduler.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace NRC
+{
+	static const uint32_t blockRows		= NRC_QUERY_BATCH;
+	static const uint32_t blockSize		= blockRows * NRC_WIDTH;
+	static const size_t	  adamRange		= 1 << 14;		// parameters per Adam work item
+
+	// --------------------------------------------------------------
+	// C[i][0, NRC_WIDTH) = (or +=) sum over p < depth of X(i, p) * Y[p][0, NRC_WIDTH)
+	// for rows i < rows, a multiple of 4. X(i, p) = x[i * xRow + p * xDepth], so the
+	// same kernel multiplies activations by a matrix (xRow NRC_WIDTH, xDepth 1) and
+	// sums input times delta over a block (xRow 1, xDepth NRC_WIDTH). roundToHalf
+	// emulates the fp16 activations of the half-precision query kernel.
+	// --------------------------------------------------------------
+	struct ScalarGemm
+	{
+		static void multiply(uint32_t rows, uint32_t depth, const float* x, uint32_t xRow, uint32_t xDepth, const float* y, float* c,
+							 bool accumulate)
+		{
+			for (uint32_t i = 0; i < rows; i++)
+			{
+				float sums[NRC_WIDTH];
+				for (uint32_t o = 0; o < NRC_WIDTH; o++)
+				{
+					sums[o] = accumulate ? c[i * NRC_WIDTH + o] : 0.0f;
+				}
+				for (uint32_t p = 0; p < depth; p++)
+				{
+					const float xValue = x[i * xRow + p * xDepth];
+					for (uint32_t o = 0; o < NRC_WIDTH; o++)
+					{
+						sums[o] += xValue * y[p * NRC_WIDTH + o];
+					}
+				}
+				memcpy(c + i * NRC_WIDTH, sums, sizeof(sums));
+			}
+		}
+
+		// values through fp16 and back, count a multiple of 16
+		static void roundToHalf(float* values, uint32_t count)
+		{
+			for (uint32_t e = 0; e < count; e++)
+			{
+				values[e] = nrcRoundToHalf(values[e]);
+			}
+		}
+	};
+
+	// 4 rows x 32 columns of sums in 16 registers, 4 loads of Y and 4 broadcasts of X per 16 FMAs. The tile is
+	// spelled out: as arrays the sums would live on the stack.
+	struct Avx2Gemm
+	{
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		static void multiply(uint32_t rows, uint32_t depth, const float* x, uint32_t xRow, uint32_t xDepth, const float* y, float* c,
+							 bool accumulate)
+		{
+			for (uint32_t i = 0; i < rows; i += 4)
+			{
+				for (uint32_t column = 0; column < NRC_WIDTH; column += 32)
+				{
+					float* c0 = c + (i + 0) * NRC_WIDTH + column;
+					float* c1 = c + (i + 1) * NRC_WIDTH + column;
+					float* c2 = c + (i + 2) * NRC_WIDTH + column;
+					float* c3 = c + (i + 3) * NRC_WIDTH + column;
+					const __m256 zero = _mm256_setzero_ps();
+					__m256 s00 = accumulate ? _mm256_loadu_ps(c0 +  0) : zero,	s01 = accumulate ? _mm256_loadu_ps(c0 +  8) : zero;
+					__m256 s02 = accumulate ? _mm256_loadu_ps(c0 + 16) : zero,	s03 = accumulate ? _mm256_loadu_ps(c0 + 24) : zero;
+					__m256 s10 = accumulate ? _mm256_loadu_ps(c1 +  0) : zero,	s11 = accumulate ? _mm256_loadu_ps(c1 +  8) : zero;
+					__m256 s12 = accumulate ? _mm256_loadu_ps(c1 + 16) : zero,	s13 = accumulate ? _mm256_loadu_ps(c1 + 24) : zero;
+					__m256 s20 = accumulate ? _mm256_loadu_ps(c2 +  0) : zero,	s21 = accumulate ? _mm256_loadu_ps(c2 +  8) : zero;
+					__m256 s22 = accumulate ? _mm256_loadu_ps(c2 + 16) : zero,	s23 = accumulate ? _mm256_loadu_ps(c2 + 24) : zero;
+					__m256 s30 = accumulate ? _mm256_loadu_ps(c3 +  0) : zero,	s31 = accumulate ? _mm256_loadu_ps(c3 +  8) : zero;
+					__m256 s32 = accumulate ? _mm256_loadu_ps(c3 + 16) : zero,	s33 = accumulate ? _mm256_loadu_ps(c3 + 24) : zero;
+					const float* x0 = x + (i + 0) * xRow;
+					const float* x1 = x + (i + 1) * xRow;
+					const float* x2 = x + (i + 2) * xRow;
+					const float* x3 = x + (i + 3) * xRow;
+					for (uint32_t p = 0; p < depth; p++)
+					{
+						const float* yRow = y + p * NRC_WIDTH + column;
+						const __m256 y0 = _mm256_loadu_ps(yRow + 0);
+						const __m256 y1 = _mm256_loadu_ps(yRow + 8);
+						const __m256 y2 = _mm256_loadu_ps(yRow + 16);
+						const __m256 y3 = _mm256_loadu_ps(yRow + 24);
+						const size_t offset = size_t(p) * xDepth;
+						__m256 xValue = _mm256_broadcast_ss(x0 + offset);
+						s00 = _mm256_fmadd_ps(xValue, y0, s00);		s01 = _mm256_fmadd_ps(xValue, y1, s01);
+						s02 = _mm256_fmadd_ps(xValue, y2, s02);		s03 = _mm256_fmadd_ps(xValue, y3, s03);
+						xValue = _mm256_broadcast_ss(x1 + offset);
+						s10 = _mm256_fmadd_ps(xValue, y0, s10);		s11 = _mm256_fmadd_ps(xValue, y1, s11);
+						s12 = _mm256_fmadd_ps(xValue, y2, s12);		s13 = _mm256_fmadd_ps(xValue, y3, s13);
+						xValue = _mm256_broadcast_ss(x2 + offset);
+						s20 = _mm256_fmadd_ps(xValue, y0, s20);		s21 = _mm256_fmadd_ps(xValue, y1, s21);
+						s22 = _mm256_fmadd_ps(xValue, y2, s22);		s23 = _mm256_fmadd_ps(xValue, y3, s23);
+						xValue = _mm256_broadcast_ss(x3 + offset);
+						s30 = _mm256_fmadd_ps(xValue, y0, s30);		s31 = _mm256_fmadd_ps(xValue, y1, s31);
+						s32 = _mm256_fmadd_ps(xValue, y2, s32);		s33 = _mm256_fmadd_ps(xValue, y3, s33);
+					}
+					_mm256_storeu_ps(c0 +  0, s00);	_mm256_storeu_ps(c0 +  8, s01);	_mm256_storeu_ps(c0 + 16, s02);	_mm256_storeu_ps(c0 + 24, s03);
+					_mm256_storeu_ps(c1 +  0, s10);	_mm256_storeu_ps(c1 +  8, s11);	_mm256_storeu_ps(c1 + 16, s12);	_mm256_storeu_ps(c1 + 24, s13);
+					_mm256_storeu_ps(c2 +  0, s20);	_mm256_storeu_ps(c2 +  8, s21);	_mm256_storeu_ps(c2 + 16, s22);	_mm256_storeu_ps(c2 + 24, s23);
+					_mm256_storeu_ps(c3 +  0, s30);	_mm256_storeu_ps(c3 +  8, s31);	_mm256_storeu_ps(c3 + 16, s32);	_mm256_storeu_ps(c3 + 24, s33);
+				}
+			}
+		}
+
+		NRC_TARGET_AVX2 NRC_SIMD_INLINE
+		static void roundToHalf(float* values, uint32_t count)
+		{
+			for (uint32_t e = 0; e < count; e += 8)
+			{
+				const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(values + e), _MM_FROUND_TO_NEAREST_INT);
+				_mm256_storeu_ps(values + e, _mm256_cvtph_ps(half));
+			}
+		}
+	};
+
+	// 4 rows x all 64 columns of sums in 16 of the 32 registers
+	struct Avx512Gemm
+	{
+		NRC_TARGET_AVX512 NRC_SIMD_INLINE
+		static void multiply(uint32_t rows, uint32_t depth, const float* x, uint32_t xRow, uint32_t xDepth, const float* y, float* c,
+							 bool accumulate)
+		{
+			for (uint32_t i = 0; i < rows; i += 4)
+			{
+				float* c0 = c + (i + 0) * NRC_WIDTH;
+				float* c1 = c + (i + 1) * NRC_WIDTH;
+				float* c2 = c + (i + 2) * NRC_WIDTH;
+				float* c3 = c + (i + 3) * NRC_WIDTH;
+				const __m512 zero = _mm512_setzero_ps();
+				__m512 s00 = accumulate ? _mm512_loadu_ps(c0 +  0) : zero,	s01 = accumulate ? _mm512_loadu_ps(c0 + 16) : zero;
+				__m512 s02 = accumulate ? _mm512_loadu_ps(c0 + 32) : zero,	s03 = accumulate ? _mm512_loadu_ps(c0 + 48) : zero;
+				__m512 s10 = accumulate ? _mm512_loadu_ps(c1 +  0) : zero,	s11 = accumulate ? _mm512_loadu_ps(c1 + 16) : zero;
+				__m512 s12 = accumulate ? _mm512_loadu_ps(c1 + 32) : zero,	s13 = accumulate ? _mm512_loadu_ps(c1 + 48) : zero;
+				__m512 s20 = accumulate ? _mm512_loadu_ps(c2 +  0) : zero,	s21 = accumulate ? _mm512_loadu_ps(c2 + 16) : zero;
+				__m512 s22 = accumulate ? _mm512_loadu_ps(c2 + 32) : zero,	s23 = accumulate ? _mm512_loadu_ps(c2 + 48) : zero;
+				__m512 s30 = accumulate ? _mm512_loadu_ps(c3 +  0) : zero,	s31 = accumulate ? _mm512_loadu_ps(c3 + 16) : zero;
+				__m512 s32 = accumulate ? _mm512_loadu_ps(c3 + 32) : zero,	s33 = accumulate ? _mm512_loadu_ps(c3 + 48) : zero;
+				const float* x0 = x + (i + 0) * xRow;
+				const float* x1 = x + (i + 1) * xRow;
+				const float* x2 = x + (i + 2) * xRow;
+				const float* x3 = x + (i + 3) * xRow;
+				for (uint32_t p = 0; p < depth; p++)
+				{
+					const float* yRow = y + p * NRC_WIDTH;
+					const __m512 y0 = _mm512_loadu_ps(yRow + 0);
+					const __m512 y1 = _mm512_loadu_ps(yRow + 16);
+					const __m512 y2 = _mm512_loadu_ps(yRow + 32);
+					const __m512 y3 = _mm512_loadu_ps(yRow + 48);
+					const size_t offset = size_t(p) * xDepth;
+					__m512 xValue = _mm512_set1_ps(x0[offset]);
+					s00 = _mm512_fmadd_ps(xValue, y0, s00);		s01 = _mm512_fmadd_ps(xValue, y1, s01);
+					s02 = _mm512_fmadd_ps(xValue, y2, s02);		s03 = _mm512_fmadd_ps(xValue, y3, s03);
+					xValue = _mm512_set1_ps(x1[offset]);
+					s10 = _mm512_fmadd_ps(xValue, y0, s10);		s11 = _mm512_fmadd_ps(xValue, y1, s11);
+					s12 = _mm512_fmadd_ps(xValue, y2, s12);		s13 = _mm512_fmadd_ps(xValue, y3, s13);
+					xValue = _mm512_set1_ps(x2[offset]);
+					s20 = _mm512_fmadd_ps(xValue, y0, s20);		s21 = _mm512_fmadd_ps(xValue, y1, s21);
+					s22 = _mm512_fmadd_ps(xValue, y2, s22);		s23 = _mm512_fmadd_ps(xValue, y3, s23);
+					xValue = _mm512_set1_ps(x3[offset]);
+					s30 = _mm512_fmadd_ps(xValue, y0, s30);		s31 = _mm512_fmadd_ps(xValue, y1, s31);
+					s32 = _mm512_fmadd_ps(xValue, y2, s32);		s33 = _mm512_fmadd_ps(xValue, y3, s33);
+				}
+				_mm512_storeu_ps(c0 +  0, s00);	_mm512_storeu_ps(c0 + 16, s01);	_mm512_storeu_ps(c0 + 32, s02);	_mm512_storeu_ps(c0 + 48, s03);
+				_mm512_storeu_ps(c1 +  0, s10);	_mm512_storeu_ps(c1 + 16, s11);	_mm512_storeu_ps(c1 + 32, s12);	_mm512_storeu_ps(c1 + 48, s13);
+				_mm512_storeu_ps(c2 +  0, s20);	_mm512_storeu_ps(c2 + 16, s21);	_mm512_storeu_ps(c2 + 32, s22);	_mm512_storeu_ps(c2 + 48, s23);
+				_mm512_storeu_ps(c3 +  0, s30);	_mm512_storeu_ps(c3 + 16, s31);	_mm512_storeu_ps(c3 + 32, s32);	_mm512_storeu_ps(c3 + 48, s33);
+			}
+		}
+
+		// the 8-wide conversions, GCC 12 warns about the undefined sources inside the 16-wide ones
+		NRC_TARGET_AVX512 NRC_SIMD_INLINE
+		static void roundToHalf(float* values, uint32_t count)
+		{
+			Avx2Gemm::roundToHalf(values, count);
+		}
+	};
+
+
+	// ------------------------------------
+	// Hidden layers of one block of rows
+	// ------------------------------------
+
+	// activations holds the encoded block; fills in the input of every further matrix. With roundToHalf the encoded
+	// block and every input are rounded to fp16.
+	template <typename Gemm>
+	NRC_SIMD_INLINE static void hiddenForwardKernel(const float* weights, uint32_t hiddenLayers, float* activations, bool roundToHalf)
+	{
+		if (roundToHalf)
+		{
+			Gemm::roundToHalf(activations, blockSize);
+		}
+		for (uint32_t m = 0; m < hiddenLayers; m++)
+		{
+			float* next = activations + (m + 1) * blockSize;
+			Gemm::multiply(blockRows, NRC_WIDTH, activations + m * blockSize, NRC_WIDTH, 1, weights + m * NRC_MATRIX_SIZE, next, false);
+			for (uint32_t e = 0; e < blockSize; e++)
+			{
+				next[e] = std::max(next[e], 0.0f);
+			}
+			if (roundToHalf)
+			{
+				Gemm::roundToHalf(next, blockSize);
+			}
+		}
+	}
+
+	// deltas holds the loss gradient at the output of the last hidden layer; adds the gradients of the hidden matrices
+	// and returns the deltas at the encoded input if inputGradient, else nullptr (deltas and spare are overwritten)
+	template <typename Gemm>
+	NRC_SIMD_INLINE static float* hiddenBackwardKernel(const float* transposed, uint32_t hiddenLayers, const float* activations, float* deltas,
+													   float* spare, float* gradients, bool inputGradient)
+	{
+		for (uint32_t m = hiddenLayers; m-- > 0;)
+		{
+			Gemm::multiply(NRC_WIDTH, blockRows, activations + m * blockSize, 1, NRC_WIDTH, deltas, gradients + m * NRC_MATRIX_SIZE, true);
+			if (m == 0 && !inputGradient)
+			{
+				return nullptr;
+			}
+			Gemm::multiply(blockRows, NRC_WIDTH, deltas, NRC_WIDTH, 1, transposed + m * NRC_MATRIX_SIZE, spare, false);
+			if (m > 0)
+			{
+				const float* inputs = activations + m * blockSize;
+				for (uint32_t e = 0; e < blockSize; e++)
+				{
+					spare[e] = inputs[e] > 0.0f ? spare[e] : 0.0f;
+				}
+			}
+			std::swap(deltas, spare);
+		}
+		return deltas;
+	}
+
+	NRC_FLATTEN
+	static void hiddenForwardScalar(const float* weights, uint32_t hiddenLayers, float* activations, bool roundToHalf)
+	{
+		hiddenForwardKernel<ScalarGemm>(weights, hiddenLayers, activations, roundToHalf);
+	}
+
+	NRC_TARGET_AVX2 NRC_FLATTEN
+	static void hiddenForwardAvx2(const float* weights, uint32_t hiddenLayers, float* activations, bool roundToHalf)
+	{
+		hiddenForwardKernel<Avx2Gemm>(weights, hiddenLayers, activations, roundToHalf);
+	}
+
+	NRC_TARGET_AVX512 NRC_FLATTEN
+	static void hiddenForwardAvx512(const float* weights, uint32_t hiddenLayers, float* activations, bool roundToHalf)
+	{
+		hiddenForwardKernel<Avx512Gemm>(weights, hiddenLayers, activations, roundToHalf);
+	}
+
+	static void hiddenForward(SimdLevel level, const float* weights, uint32_t hiddenLayers, float* activations, bool roundToHalf = false)
+	{
+		switch (level)
+		{
+		case SimdLevel::Avx512:	hiddenForwardAvx512(weights, hiddenLayers, activations, roundToHalf);	break;
+		case SimdLevel::Avx2:	hiddenForwardAvx2(weights, hiddenLayers, activations, roundToHalf);		break;
+		default:				hiddenForwardScalar(weights, hiddenLayers, activations, roundToHalf);	break;
+		}
+	}
+
+	NRC_FLATTEN
+	static float* hiddenBackwardScalar(const float* transposed, uint32_t hiddenLayers, const float* activations, float* deltas, float* spare,
+									   float* gradients, bool inputGradient)
+	{
+		return hiddenBackwardKernel<ScalarGemm>(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+	}
+
+	NRC_TARGET_AVX2 NRC_FLATTEN
+	static float* hiddenBackwardAvx2(const float* transposed, uint32_t hiddenLayers, const float* activations, float* deltas, float* spare,
+									 float* gradients, bool inputGradient)
+	{
+		return hiddenBackwardKernel<Avx2Gemm>(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+	}
+
+	NRC_TARGET_AVX512 NRC_FLATTEN
+	static float* hiddenBackwardAvx512(const float* transposed, uint32_t hiddenLayers, const float* activations, float* deltas, float* spare,
+									   float* gradients, bool inputGradient)
+	{
+		return hiddenBackwardKernel<Avx512Gemm>(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+	}
+
+	static float* hiddenBackward(SimdLevel level, const float* transposed, uint32_t hiddenLayers, const float* activations, float* deltas,
+								 float* spare, float* gradients, bool inputGradient)
+	{
+		switch (level)
+		{
+		case SimdLevel::Avx512:	return hiddenBackwardAvx512(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+		case SimdLevel::Avx2:	return hiddenBackwardAvx2(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+		default:				return hiddenBackwardScalar(transposed, hiddenLayers, activations, deltas, spare, gradients, inputGradient);
+		}
+	}
+
+
+	// ----------------------
+	// CpuNeuralRadianceCache
+	// ----------------------
+	void CpuNeuralRadianceCache::init(const NrcSettings& settings, const float sceneMin[3], const float sceneMax[3], uint32_t threadCount,
+									  SimdLevel simdLevel)
+	{
+		m_settings			= settings;
+		m_settings.network	= validNrcConfig(settings.network);
+		m_simdLevel			= std::min(simdLevel, detectSimdLevel());
+		m_threadCount		= std::max(threadCount != 0 ? threadCount : std::thread::hardware_concurrency(), 1u);
+		for (int a = 0; a < 3; a++)
+		{
+			const float extent = sceneMax[a] - sceneMin[a];
+			m_sceneMin[a]	= sceneMin[a];
+			m_sceneScale[a]	= extent > 0.0f ? 1.0f / extent : 0.0f;
+		}
+
+		m_workers = std::vector<Worker>(m_threadCount);
+		for (Worker& worker : m_workers)
+		{
+			worker.activations.assign(size_t(config().matrixCount()) * blockSize, 0.0f);
+			worker.deltas.assign(blockSize, 0.0f);
+			worker.inputDeltas.assign(blockSize, 0.0f);
+			worker.gradients.assign(config().weightCount(), 0.0f);
+		}
+		setParameters(initializeNrcWeights(config(), m_settings.seed), initializeNrcGrid(config(), m_settings.seed));
+	}
+
+	void CpuNeuralRadianceCache::setParameters(const std::vector<float>& weights, const std::vector<float>& grid)
+	{
+		m_weights.assign(config().weightCount(), 0.0f);
+		std::copy(weights.begin(), weights.begin() + std::min(weights.size(), m_weights.size()), m_weights.begin());
+		m_grid.assign(config().gridParameterCount(), 0.0f);
+		std::copy(grid.begin(), grid.begin() + std::min(grid.size(), m_grid.size()), m_grid.begin());
+		m_moments.assign(2 * m_weights.size(), 0.0f);
+		m_gridGradients.assign(m_grid.size(), 0.0f);
+		m_gridMoments.assign(2 * m_grid.size(), 0.0f);
+		m_transposed.assign(m_weights.size(), 0.0f);
+		m_step = 0;
+		if (halfPrecision())
+		{
+			m_weightsHalf.assign(m_weights.size(), 0.0f);
+			m_gridHalf.assign(m_grid.size(), 0);
+			updateHalfCopies(0, m_weights.size() + m_grid.size());
+		}
+	}
+
+	// parameters [begin, end) of the weights and then the grid into the fp16 copies, as nrc_adam.comp.glsl does
+	void CpuNeuralRadianceCache::updateHalfCopies(size_t begin, size_t end)
+	{
+		const size_t weightCount = m_weights.size();
+		for (size_t p = begin; p < std::min(end, weightCount); p++)
+		{
+			m_weightsHalf[p] = nrcRoundToHalf(m_weights[p]);
+		}
+		for (size_t e = std::max(begin, weightCount) - weightCount; e + weightCount < end; e++)
+		{
+			m_gridHalf[e] = nrcFloatToHalf(m_grid[e]);
+		}
+	}
+
+	NrcCacheState CpuNeuralRadianceCache::state() const
+	{
+		NrcCacheState state;
+		state.step			= m_step;
+		state.weights		= m_weights;
+		state.weightMoments	= m_moments;
+		state.grid			= m_grid;
+		state.gridMoments	= m_gridMoments;
+		return state;
+	}
+
+	void CpuNeuralRadianceCache::setState(const NrcCacheState& state)
+	{
+		setParameters(state.weights, state.grid);
+		std::copy(state.weightMoments.begin(), state.weightMoments.begin() + std::min(state.weightMoments.size(), m_moments.size()),
+				  m_moments.begin());
+		std::copy(state.gridMoments.begin(), state.gridMoments.begin() + std::min(state.gridMoments.size(), m_gridMoments.size()),
+				  m_gridMoments.begin());
+		m_step = state.step;
+	}
+
+	void CpuNeuralRadianceCache::encodeBlock(Worker& worker, const NrcQuery* queries, const NrcTrainingRecord* records, uint32_t rows,
+											 bool half) const
+	{
+		float* encoded = worker.activations.data();
+		for (uint32_t r = 0; r < rows; r++)
+		{
+			const NrcQuery query = queries != nullptr ? queries[r] : nrcQueryOf(records[r]);
+			if (half)
+			{
+				nrcEncodeInput(config(), m_gridHalf.data(), query, m_sceneMin, m_sceneScale, encoded + r * NRC_WIDTH);
+			}
+			else
+			{
+				nrcEncodeInput(config(), m_grid.data(), query, m_sceneMin, m_sceneScale, encoded + r * NRC_WIDTH);
+			}
+		}
+		// rows past the end are zero all the way through, without a bias input to start from
+		std::fill(encoded + rows * NRC_WIDTH, encoded + blockSize, 0.0f);
+	}
+
+	// blocks of count queries (or records, queries == nullptr); with several regions m_order is the stable counting sort of
+	// their indices by region and the blocks cut each region's range
+	void CpuNeuralRadianceCache::makeBlocks(const NrcQuery* queries, const NrcTrainingRecord* records, uint32_t count)
+	{
+		const uint32_t regions = config().regionCount();
+		m_blocks.clear();
+		m_regionCounts.assign(regions, 0);
+		if (regions == 1)
+		{
+			m_regionCounts[0] = count;
+			for (uint32_t first = 0; first < count; first += blockRows)
+			{
+				m_blocks.push_back({ 0, first, std::min(blockRows, count - first) });
+			}
+			return;
+		}
+
+		m_itemRegions.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float unitPos[3];
+			m_itemRegions[i] = nrcRegionUnitPosition(config(), queries != nullptr ? queries[i] : nrcQueryOf(records[i]), m_sceneMin,
+													 m_sceneScale, unitPos);
+			m_regionCounts[m_itemRegions[i]]++;
+		}
+		std::vector<uint32_t> cursors(regions);
+		uint32_t start = 0;
+		for (uint32_t region = 0; region < regions; region++)
+		{
+			cursors[region] = start;
+			for (uint32_t first = start; first < start + m_regionCounts[region]; first += blockRows)
+			{
+				m_blocks.push_back({ region, first, std::min(blockRows, start + m_regionCounts[region] - first) });
+			}
+			start += m_regionCounts[region];
+		}
+		m_order.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			m_order[cursors[m_itemRegions[i]]++] = i;
+		}
+	}
+
+	void CpuNeuralRadianceCache::queryBlock(Worker& worker, uint32_t region, const NrcQuery* queries, uint32_t rows, float* results) const
+	{
+		const uint32_t	hiddenLayers	= config().hiddenLayers;
+		const bool		half			= halfPrecision();
+		const float*	weights			= (half ? m_weightsHalf.data() : m_weights.data()) + region * config().regionWeightCount();
+		encodeBlock(worker, queries, nullptr, rows, half);
+		hiddenForward(m_simdLevel, weights, hiddenLayers, worker.activations.data(), half);
+
+		const float* inputs		= worker.activations.data() + hiddenLayers * blockSize;
+		const float* matrix		= weights + hiddenLayers * NRC_MATRIX_SIZE;
+		for (uint32_t r = 0; r < rows; r++)
+		{
+			float output[NRC_OUTPUT_WIDTH] = {};
+			for (uint32_t k = 0; k < NRC_WIDTH; k++)
+			{
+				for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+				{
+					output[c] += inputs[r * NRC_WIDTH + k] * matrix[k * NRC_WIDTH + c];
+				}
+			}
+			if (half)
+			{
+				for (float& value : output)
+				{
+					value = nrcRoundToHalf(value);
+				}
+			}
+			memcpy(results + r * NRC_OUTPUT_WIDTH, output, sizeof(output));
+		}
+	}
+
+	void CpuNeuralRadianceCache::query(const NrcQuery* queries, uint32_t count, float* results)
+	{
+		makeBlocks(queries, nullptr, count);
+		const bool		sorted			= config().regionCount() > 1;
+		const NrcQuery*	blockQueries	= queries;
+		float*			blockResults	= results;
+		if (sorted)
+		{
+			m_sortedQueries.resize(count);
+			m_sortedResults.resize(size_t(count) * NRC_OUTPUT_WIDTH);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				m_sortedQueries[i] = queries[m_order[i]];
+			}
+			blockQueries	= m_sortedQueries.data();
+			blockResults	= m_sortedResults.data();
+		}
+
+		const uint32_t blocks = uint32_t(m_blocks.size());
+		TileScheduler scheduler;
+		scheduler.run(blocks, std::min(m_threadCount, blocks), TileSchedulerSettings(), [&](uint32_t w, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t b = begin; b < end; b++)
+			{
+				const Block& block = m_blocks[b];
+				queryBlock(m_workers[w], block.region, blockQueries + block.first, block.rows, blockResults + size_t(block.first) * NRC_OUTPUT_WIDTH);
+			}
+		});
+
+		if (sorted)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				memcpy(results + size_t(m_order[i]) * NRC_OUTPUT_WIDTH, blockResults + size_t(i) * NRC_OUTPUT_WIDTH, NRC_OUTPUT_WIDTH * sizeof(float));
+			}
+		}
+	}
+
+	void CpuNeuralRadianceCache::trainBlock(Worker& worker, uint32_t region, const NrcTrainingRecord* records, uint32_t first, uint32_t rows,
+											float lossScale, float* inputGradients) const
+	{
+		const uint32_t	hiddenLayers		= config().hiddenLayers;
+		const size_t	regionWeights		= region * config().regionWeightCount();
+		const float*	weights				= m_weights.data() + regionWeights;
+		float*			regionGradients		= worker.gradients.data() + regionWeights;
+		encodeBlock(worker, nullptr, records + first, rows, false);
+		hiddenForward(m_simdLevel, weights, hiddenLayers, worker.activations.data());
+
+		// output matrix: loss, its gradient, and the deltas at its input
+		const float*	inputs		= worker.activations.data() + hiddenLayers * blockSize;
+		const float*	matrix		= weights + hiddenLayers * NRC_MATRIX_SIZE;
+		float*			gradients	= regionGradients + hiddenLayers * NRC_MATRIX_SIZE;
+		float*			deltas		= worker.deltas.data();
+		std::fill(deltas, deltas + blockSize, 0.0f);
+		for (uint32_t r = 0; r < rows; r++)
+		{
+			const float*	input			= inputs + r * NRC_WIDTH;
+			float			output[NRC_OUTPUT_WIDTH] = {};
+			for (uint32_t k = 0; k < NRC_WIDTH; k++)
+			{
+				for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+				{
+					output[c] += input[k] * matrix[k * NRC_WIDTH + c];
+				}
+			}
+			float outputDeltas[NRC_OUTPUT_WIDTH];
+			worker.loss += nrcLoss(output, records[first + r].radiance, outputDeltas);
+			for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+			{
+				outputDeltas[c] *= lossScale;
+			}
+			for (uint32_t k = 0; k < NRC_WIDTH; k++)
+			{
+				float delta = 0.0f;
+				for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+				{
+					gradients[k * NRC_WIDTH + c] += input[k] * outputDeltas[c];
+					delta += matrix[k * NRC_WIDTH + c] * outputDeltas[c];
+				}
+				deltas[r * NRC_WIDTH + k] = input[k] > 0.0f ? delta : 0.0f;
+			}
+		}
+
+		const bool gridEncoding = config().gridLevels > 0;
+		const float* inputDeltas = hiddenBackward(m_simdLevel, m_transposed.data() + regionWeights, hiddenLayers, worker.activations.data(),
+												  deltas, worker.inputDeltas.data(), regionGradients, gridEncoding);
+		if (gridEncoding)
+		{
+			const uint32_t gridEncoded = config().gridLevels * config().gridFeatures;
+			for (uint32_t r = 0; r < rows; r++)
+			{
+				memcpy(inputGradients + size_t(first + r) * gridEncoded, inputDeltas + r * NRC_WIDTH, gridEncoded * sizeof(float));
+			}
+		}
+	}
+
+	void CpuNeuralRadianceCache::adamStep(size_t begin, size_t end)
+	{
+		const size_t weightCount = m_weights.size();
+		if (begin < weightCount)
+		{
+			// the workers' gradients summed into the first one's, which starts the next step from zero like the others
+			const size_t	weightEnd	= std::min(end, weightCount);
+			float*			gradients	= m_workers[0].gradients.data();
+			for (size_t w = 1; w < m_workers.size(); w++)
+			{
+				float* other = m_workers[w].gradients.data();
+				for (size_t p = begin; p < weightEnd; p++)
+				{
+					gradients[p] += other[p];
+					other[p] = 0.0f;
+				}
+			}
+			nrcAdamStep(m_weights.data() + begin, gradients + begin, m_moments.data() + 2 * begin, weightEnd - begin, m_step,
+						m_settings.learningRate);
+			std::fill(gradients + begin, gradients + weightEnd, 0.0f);
+		}
+		if (end > weightCount)
+		{
+			const size_t gridBegin	= std::max(begin, weightCount) - weightCount;
+			const size_t gridEnd	= end - weightCount;
+			nrcAdamStep(m_grid.data() + gridBegin, m_gridGradients.data() + gridBegin, m_gridMoments.data() + 2 * gridBegin, gridEnd - gridBegin,
+						m_step, m_settings.learningRate);
+			std::fill(m_gridGradients.begin() + gridBegin, m_gridGradients.begin() + gridEnd, 0.0f);
+		}
+		if (halfPrecision())
+		{
+			updateHalfCopies(begin, end);
+		}
+	}
+
+	float CpuNeuralRadianceCache::train(const NrcTrainingRecord* records, uint32_t count)
+	{
+		if (count == 0)
+		{
+			return 0.0f;
+		}
+		m_step++;
+		const NrcNetworkConfig& network = config();
+		for (uint32_t region = 0; region < network.regionCount(); region++)
+		{
+			const float*	weights		= m_weights.data() + region * network.regionWeightCount();
+			float*			transposed	= m_transposed.data() + region * network.regionWeightCount();
+			for (uint32_t m = 0; m < network.hiddenLayers; m++)
+			{
+				for (uint32_t in = 0; in < NRC_WIDTH; in++)
+				{
+					for (uint32_t out = 0; out < NRC_WIDTH; out++)
+					{
+						transposed[nrcWeightIndex(m, in, out)] = weights[nrcWeightIndex(m, out, in)];
+					}
+				}
+			}
+		}
+		for (Worker& worker : m_workers)
+		{
+			worker.loss = 0.0;
+		}
+
+		// with several regions the records sorted by region; every region's network learns the mean loss of its own records
+		makeBlocks(nullptr, records, count);
+		if (network.regionCount() > 1)
+		{
+			m_sortedRecords.resize(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				m_sortedRecords[i] = records[m_order[i]];
+			}
+			records = m_sortedRecords.data();
+		}
+
+		// forward and backward of every block, the weight gradients into the workers' copies
+		const uint32_t	gridEncoded	= network.gridLevels * network.gridFeatures;
+		m_inputGradients.resize(size_t(count) * gridEncoded);
+		const uint32_t blocks = uint32_t(m_blocks.size());
+		TileScheduler scheduler;
+		scheduler.run(blocks, std::min(m_threadCount, blocks), TileSchedulerSettings(), [&](uint32_t w, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t b = begin; b < end; b++)
+			{
+				const Block& block = m_blocks[b];
+				trainBlock(m_workers[w], block.region, records, block.first, block.rows, 1.0f / float(m_regionCounts[block.region]),
+						   m_inputGradients.data());
+			}
+		});
+
+		// grid gradients, one level per work item
+		if (network.gridLevels > 0)
+		{
+			scheduler.run(network.gridLevels, std::min(m_threadCount, network.gridLevels), TileSchedulerSettings(),
+						  [&](uint32_t, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t level = begin; level < end; level++)
+				{
+					for (uint32_t r = 0; r < count; r++)
+					{
+						float			unitPos[3];
+						uint32_t		entries[8];
+						float			cornerWeights[8];
+						const uint32_t	region			= nrcRegionUnitPosition(network, nrcQueryOf(records[r]), m_sceneMin, m_sceneScale, unitPos);
+						float*			gridGradients	= m_gridGradients.data() + region * network.regionGridParameterCount();
+						nrcGridCorners(network, level, unitPos, entries, cornerWeights);
+						const float* inputGradients = m_inputGradients.data() + size_t(r) * gridEncoded + level * network.gridFeatures;
+						for (uint32_t corner = 0; corner < 8; corner++)
+						{
+							for (uint32_t c = 0; c < network.gridFeatures; c++)
+							{
+								gridGradients[size_t(entries[corner]) * network.gridFeatures + c] += cornerWeights[corner] * inputGradients[c];
+							}
+						}
+					}
+				}
+			});
+		}
+
+		// Adam over ranges of the weights and then the grid
+		const size_t	parameterCount	= m_weights.size() + m_grid.size();
+		const uint32_t	ranges			= uint32_t((parameterCount + adamRange - 1) / adamRange);
+		scheduler.run(ranges, std::min(m_threadCount, ranges), TileSchedulerSettings(), [&](uint32_t, uint32_t begin, uint32_t end)
+		{
+			adamStep(size_t(begin) * adamRange, std::min(size_t(end) * adamRange, parameterCount));
+		});
+
+		double loss = 0.0;
+		for (const Worker& worker : m_workers)
+		{
+			loss += worker.loss;
+		}
+		return float(loss / count);
+	}
+}
@@ -0,0 +1,133 @@
+# pragma once
+
+#include <cstdint>
+#include <vector>
+#include <cpu_simd.h>
+#include <nrc_checkpoint.h>
+#include <nrc_network.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// The neural radiance cache on the CPU: the network, encodings and
+	// Adam step of the device kernels (shaders/nrc_*.comp.glsl), for
+	// hosts without a GPU and to regression-test the kernels.
+	//
+	// Queries and training records go in blocks of NRC_QUERY_BATCH rows,
+	// spread over the workers of a TileScheduler. Within a block every
+	// hidden layer is one small GEMM of the block's activations (rows of
+	// NRC_WIDTH floats) with the matrix, whose rows of NRC_WIDTH outputs
+	// are contiguous in the device layout. The SIMD kernels keep a tile
+	// of 4 rows by 32 (AVX2) or 64 (AVX-512) sums in registers and read
+	// each matrix row once per four activation rows. The 3-wide output
+	// layer is a plain dot product, there is no point padding it to 64.
+	//
+	// Training works like nrc_train.comp.glsl: each worker adds the
+	// weight gradient of its blocks into its own copy, as the workgroups
+	// do into their slices, and the Adam step sums the copies range by
+	// range. The hash grid gradient is scattered afterwards with one
+	// worker per level, so no two workers ever write one table and no
+	// atomics are needed. Results are deterministic for a given number
+	// of threads.
+	//
+	// With NrcSettings::halfPrecision queries compute what
+	// nrc_query_half.comp.glsl does: weights and grid from fp16 copies
+	// that every Adam step refreshes, activations rounded to fp16 after
+	// every layer, sums in fp32. Training works on the fp32 parameters.
+	// This is for the error of the device's fp16 path and costs a CPU
+	// throughput: the conversions make frequency queries up to a
+	// quarter and hash grid queries about 2x slower (--bench nrchalf).
+	//
+	// With NrcNetworkConfig::regionsPerAxis > 1 queries and records are
+	// first sorted by region (a stable counting sort) and cut into
+	// blocks that never straddle two regions, so every block runs one
+	// region's network, whose matrices and grid stay in the worker's
+	// caches while it works through the region's blocks.
+	// ----------------------------------------------------------------
+	class CpuNeuralRadianceCache
+	{
+	public:
+		// threadCount 0: one worker per hardware thread; the weights and grid start from settings.seed
+		void init(const NrcSettings& settings, const float sceneMin[3], const float sceneMax[3], uint32_t threadCount = 0,
+				  SimdLevel simdLevel = detectSimdLevel());
+
+		const NrcNetworkConfig&		config() const			{ return m_settings.network; }
+		SimdLevel					simdLevel() const		{ return m_simdLevel; }
+		uint32_t					threadCount() const		{ return m_threadCount; }
+		uint32_t					trainingSteps() const	{ return m_step; }
+		float						learningRate() const	{ return m_settings.learningRate; }
+		bool						halfPrecision() const	{ return m_settings.halfPrecision; }
+		const std::vector<float>&	weights() const			{ return m_weights; }
+		const std::vector<float>&	grid() const			{ return m_grid; }
+
+		// replaces the weights (config().weightCount() floats) and the hash grid (config().gridParameterCount() floats), restarts Adam
+		void setParameters(const std::vector<float>& weights, const std::vector<float>& grid);
+
+		// parameters, Adam moments and step, for checkpoints (nrc_checkpoint.h); setState keeps the Adam state,
+		// arrays shorter than the config are padded with zeros
+		NrcCacheState state() const;
+		void setState(const NrcCacheState& state);
+
+		// of the training steps from now on
+		void setLearningRate(float learningRate) { m_settings.learningRate = learningRate; }
+
+		// radiance of count queries into results, NRC_OUTPUT_WIDTH floats per query
+		void query(const NrcQuery* queries, uint32_t count, float* results);
+
+		// one training step on count records; returns their mean loss before the step
+		float train(const NrcTrainingRecord* records, uint32_t count);
+
+	private:
+		struct alignas(64) Worker
+		{
+			std::vector<float>	activations;	// input of every matrix for one block
+			std::vector<float>	deltas;			// loss gradient at the output of the current matrix
+			std::vector<float>	inputDeltas;
+			std::vector<float>	gradients;		// weightCount(), summed over the worker's blocks
+			double				loss = 0.0;
+		};
+
+		// up to NRC_QUERY_BATCH queries or records of one region
+		struct Block
+		{
+			uint32_t	region;
+			uint32_t	first;
+			uint32_t	rows;
+		};
+
+		void makeBlocks(const NrcQuery* queries, const NrcTrainingRecord* records, uint32_t count);
+		void queryBlock(Worker& worker, uint32_t region, const NrcQuery* queries, uint32_t rows, float* results) const;
+		void trainBlock(Worker& worker, uint32_t region, const NrcTrainingRecord* records, uint32_t first, uint32_t rows,
+						float lossScale, float* inputGradients) const;
+		void encodeBlock(Worker& worker, const NrcQuery* queries, const NrcTrainingRecord* records, uint32_t rows, bool half) const;
+		void adamStep(size_t begin, size_t end);
+		void updateHalfCopies(size_t begin, size_t end);
+
+		NrcSettings			m_settings;
+		SimdLevel			m_simdLevel		= SimdLevel::Scalar;
+		uint32_t			m_threadCount	= 1;
+		uint32_t			m_step			= 0;
+		float				m_sceneMin[3]	= {};
+		float				m_sceneScale[3]	= {};
+		std::vector<float>	m_weights;
+		std::vector<float>	m_transposed;		// matrix m with in and out swapped, for the deltas at its input
+		std::vector<float>	m_moments;
+		std::vector<float>	m_grid;
+		std::vector<float>	m_gridGradients;
+		std::vector<float>	m_gridMoments;
+		std::vector<float>	m_inputGradients;	// per training record, the gradient of its grid features
+		std::vector<float>	m_weightsHalf;		// with halfPrecision, the weights through fp16 (as the GEMMs read floats)
+		std::vector<uint16_t>	m_gridHalf;		// with halfPrecision, the fp16 copy of the grid
+		std::vector<Worker>	m_workers;
+
+		// blocks of the current query or training call; with several regions the region of every query or record, their
+		// indices sorted by region, the queries or records in that order and the results in that order
+		std::vector<Block>				m_blocks;
+		std::vector<uint32_t>			m_regionCounts;
+		std::vector<uint32_t>			m_itemRegions;
+		std::vector<uint32_t>			m_order;
+		std::vector<NrcQuery>			m_sortedQueries;
+		std::vector<NrcTrainingRecord>	m_sortedRecords;
+		std::vector<float>				m_sortedResults;
+	};
+}
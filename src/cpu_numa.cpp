@@ -0,0 +1,220 @@
+#include <cpu_numa.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace NRC
+{
+	// --------
+	// Topology
+	// --------
+#if defined(__linux__)
+	// "0-3,8-11" as written by sysfs
+	static std::vector<uint32_t> parseCpuList(const char* text)
+	{
+		std::vector<uint32_t> cpus;
+		const char* p = text;
+		while (*p != '\0' && *p != '\n')
+		{
+			char* next = nullptr;
+			const unsigned long first = strtoul(p, &next, 10);
+			if (next == p)
+			{
+				break;
+			}
+			unsigned long last = first;
+			p = next;
+			if (*p == '-')
+			{
+				last = strtoul(p + 1, &next, 10);
+				p = next;
+			}
+			for (unsigned long cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(uint32_t(cpu));
+			}
+			if (*p == ',')
+			{
+				p++;
+			}
+		}
+		return cpus;
+	}
+
+	static bool readFirstLine(const std::string& path, char* line, int size)
+	{
+		FILE* file = fopen(path.c_str(), "r");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const bool read = fgets(line, size, file) != nullptr;
+		fclose(file);
+		return read;
+	}
+#endif
+
+	NumaTopology detectNumaTopology()
+	{
+		NumaTopology topology;
+#if defined(__linux__)
+		char line[4096];
+		if (readFirstLine("/sys/devices/system/node/online", line, sizeof(line)))
+		{
+			for (uint32_t node : parseCpuList(line))
+			{
+				if (!readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", line, sizeof(line)))
+				{
+					continue;
+				}
+				std::vector<uint32_t> cpus = parseCpuList(line);
+				if (!cpus.empty())
+				{
+					topology.nodeIds.push_back(node);
+					topology.nodeCpus.push_back(std::move(cpus));
+				}
+			}
+		}
+#endif
+		if (topology.nodeCpus.empty())
+		{
+			topology.nodeIds.assign(1, 0);
+			topology.nodeCpus.resize(1);
+			const uint32_t cpuCount = std::max(1u, std::thread::hardware_concurrency());
+			for (uint32_t cpu = 0; cpu < cpuCount; cpu++)
+			{
+				topology.nodeCpus[0].push_back(cpu);
+			}
+		}
+		return topology;
+	}
+
+
+	// ---------
+	// Placement
+	// ---------
+	bool getThreadAffinity(std::vector<uint32_t>& cpus)
+	{
+		cpus.clear();
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+		{
+			return false;
+		}
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &set))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool setThreadAffinity(const std::vector<uint32_t>& cpus)
+	{
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (uint32_t cpu : cpus)
+		{
+			if (cpu < CPU_SETSIZE)
+			{
+				CPU_SET(cpu, &set);
+			}
+		}
+		return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)cpus;
+		return false;
+#endif
+	}
+
+	bool interleaveMemory(const void* data, size_t bytes, const NumaTopology& topology)
+	{
+#if defined(__linux__) && defined(SYS_mbind)
+		if (topology.nodeCount() < 2 || bytes == 0)
+		{
+			return false;
+		}
+		// mbind works on whole pages; the partial ones at both ends keep their placement
+		const uintptr_t pageSize	= uintptr_t(sysconf(_SC_PAGESIZE));
+		const uintptr_t begin		= (uintptr_t(data) + pageSize - 1) / pageSize * pageSize;
+		const uintptr_t end			= (uintptr_t(data) + bytes) / pageSize * pageSize;
+		if (begin >= end)
+		{
+			return false;
+		}
+		unsigned long mask[16] = {};
+		const uint32_t maxNode = uint32_t(sizeof(mask) * 8);
+		for (uint32_t node : topology.nodeIds)
+		{
+			if (node < maxNode)
+			{
+				mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+			}
+		}
+		// constants of linux/mempolicy.h
+		const int			interleave	= 3;			// MPOL_INTERLEAVE
+		const unsigned		move		= 1u << 1;		// MPOL_MF_MOVE
+		return syscall(SYS_mbind, begin, end - begin, interleave, mask, maxNode + 1, move) == 0;
+#else
+		(void)data;
+		(void)bytes;
+		(void)topology;
+		return false;
+#endif
+	}
+
+
+	// -----------------
+	// Untouched memory
+	// -----------------
+	// below this, blocks come from the heap: their pages may be shared with other allocations anyway
+	static const size_t untouchedMinBytes = size_t(1) << 20;
+
+	void* allocateUntouched(size_t bytes)
+	{
+#if defined(__linux__)
+		if (bytes >= untouchedMinBytes)
+		{
+			void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data == MAP_FAILED)
+			{
+				throw std::bad_alloc();
+			}
+			return data;
+		}
+#endif
+		return ::operator new(bytes);
+	}
+
+	void freeUntouched(void* data, size_t bytes)
+	{
+#if defined(__linux__)
+		if (bytes >= untouchedMinBytes)
+		{
+			munmap(data, bytes);
+			return;
+		}
+#endif
+		(void)bytes;
+		::operator delete(data);
+	}
+}
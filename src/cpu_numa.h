@@ -0,0 +1,91 @@
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// NUMA topology and placement for the CPU backend, without libnuma.
+	//
+	// On Linux the nodes and their CPUs come from sysfs, threads are
+	// pinned with pthread affinity and pages are interleaved with the
+	// mbind system call. Elsewhere, or when sysfs is missing, the host
+	// is one node holding every hardware thread and placement calls do
+	// nothing. Memory otherwise follows the kernel's first-touch rule:
+	// a page lands on the node of the thread that first writes it.
+	// ----------------------------------------------------------------
+	struct NumaTopology
+	{
+		std::vector<uint32_t>				nodeIds;		// sysfs node numbers, nodes without CPUs left out
+		std::vector<std::vector<uint32_t>>	nodeCpus;		// logical CPUs of each node
+
+		uint32_t nodeCount() const { return uint32_t(nodeCpus.size()); }
+
+		// workers are split into contiguous blocks per node, like their shares of the tiles
+		uint32_t workerNode(uint32_t worker, uint32_t workerCount) const
+		{
+			return uint32_t(uint64_t(worker) * nodeCount() / workerCount);
+		}
+	};
+
+	NumaTopology detectNumaTopology();
+
+	// CPUs the calling thread may run on; false where affinity is not supported
+	bool getThreadAffinity(std::vector<uint32_t>& cpus);
+	bool setThreadAffinity(const std::vector<uint32_t>& cpus);
+
+	// spreads the whole pages of [data, data + bytes) round-robin over the nodes, moving those already placed
+	bool interleaveMemory(const void* data, size_t bytes, const NumaTopology& topology);
+
+	// where the traversal data of the BVH lives on a multi-node host
+	enum class BvhPlacement
+	{
+		Shared,			// one copy, on the node that built or mapped it
+		Replicate,		// one copy per node, each first touched by a thread of that node
+		Interleave,		// one copy, pages interleaved over the nodes
+	};
+
+	inline const char* bvhPlacementName(BvhPlacement placement)
+	{
+		return placement == BvhPlacement::Replicate ? "replicate" : placement == BvhPlacement::Interleave ? "interleave" : "shared";
+	}
+
+	// ----------------------------------------------------------------
+	// Allocator that leaves elements default-initialized, so resizing
+	// a vector of floats does not write its pages. Large blocks come
+	// straight from the OS (fresh, unplaced pages), so whichever thread
+	// writes an element first decides the node of its page.
+	// ----------------------------------------------------------------
+	void* allocateUntouched(size_t bytes);
+	void freeUntouched(void* data, size_t bytes);
+
+	template <typename T>
+	struct FirstTouchAllocator
+	{
+		using value_type = T;
+
+		FirstTouchAllocator() = default;
+		template <typename U>
+		FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+
+		T* allocate(size_t count) { return static_cast<T*>(allocateUntouched(count * sizeof(T))); }
+		void deallocate(T* data, size_t count) { freeUntouched(data, count * sizeof(T)); }
+
+		template <typename U>
+		void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+		template <typename U, typename... Args>
+		void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+		template <typename U>
+		bool operator==(const FirstTouchAllocator<U>&) const { return true; }
+		template <typename U>
+		bool operator!=(const FirstTouchAllocator<U>&) const { return false; }
+	};
+
+	// rgb image of the CPU backend, 3 floats per pixel; its pages are placed by the render workers
+	using CpuImage = std::vector<float, FirstTouchAllocator<float>>;
+}
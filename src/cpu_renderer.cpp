@@ -0,0 +1,816 @@
+#include <cpu_renderer.h>
+#include <cpu_bvh_cache.h>
+
+#include <chrono>
+#include <thread>
+
+namespace NRC
+{
+	// ---------------------------------------------------
+	// Sampling, a line by line port of raytracer.comp.glsl
+	// ---------------------------------------------------
+	static float stepAndOutputRNGFloat(uint32_t& rngState)
+	{
+		rngState		= rngState * 747796405u + 1u;
+		uint32_t word	= ((rngState >> ((rngState >> 28) + 4)) ^ rngState) * 277803737u;
+		word			= (word >> 22) ^ word;
+		return float(word) / 4294967295.0f;
+	}
+
+	static void randomGaussian(uint32_t& rngState, float& g0, float& g1)
+	{
+		const float u1		= std::max(1e-38f, stepAndOutputRNGFloat(rngState));
+		const float u2		= stepAndOutputRNGFloat(rngState);
+		const float r		= std::sqrt(-2.0f * std::log(u1));
+		const float theta	= 2.0f * 3.14159265f * u2;
+		g0 = r * std::cos(theta);
+		g1 = r * std::sin(theta);
+	}
+
+	static vec3 skyColor(const vec3& direction)
+	{
+		if (direction.y > 0.0f)
+		{
+			return mix(vec3(1.0f), vec3(0.25f, 0.5f, 1.0f), direction.y);
+		}
+		return vec3(0.03f);
+	}
+
+	static vec3 diffuseReflection(const vec3& normal, uint32_t& rngState)
+	{
+		const float theta	= 2.0f * 3.14159265f * stepAndOutputRNGFloat(rngState);
+		const float u		= 2.0f * stepAndOutputRNGFloat(rngState) - 1.0f;
+		const float r		= std::sqrt(1.0f - u * u);
+		return normalize(normal + vec3(r * std::cos(theta), r * std::sin(theta), u));
+	}
+
+
+	// -----------
+	// CpuRenderer
+	// -----------
+	void CpuRenderer::init(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const BvhBuildSettings& bvhSettings,
+						   const std::string& bvhCacheDirectory, bool quantizeBvh)
+	{
+		m_positions		= positions;
+		m_indices		= indices;
+		m_topology		= detectNumaTopology();
+		m_bvhPlacement	= BvhPlacement::Shared;
+		m_bvhReplicas.clear();
+
+		const BvhBuildSettings&	buildSettings	= bvhSettings;
+		std::string				cachePath;
+		uint64_t				sceneHash		= 0;
+		if (!bvhCacheDirectory.empty())
+		{
+			sceneHash	= hashScene(m_positions.data(), m_positions.size(), m_indices.data(), m_indices.size(), buildSettings);
+			cachePath	= bvhCachePath(bvhCacheDirectory, sceneHash);
+			if (loadBvhCache(cachePath, sceneHash, false, m_bvh))
+			{
+				if (quantizeBvh)
+				{
+					m_bvh.quantize();
+				}
+				return;
+			}
+		}
+
+		// build binary, trace the eight-wide collapse
+		Bvh bvh;
+		bvh.build(m_positions.data(), m_indices.data(), uint32_t(m_indices.size() / 3), buildSettings);
+		m_bvh.collapse(bvh, m_positions.data(), m_indices.data());
+		if (!cachePath.empty())
+		{
+			// a read-only cache directory only costs the build next time
+			saveBvhCache(cachePath, sceneHash, m_bvh);
+		}
+		// the cache keeps float nodes, so quantize after saving
+		if (quantizeBvh)
+		{
+			m_bvh.quantize();
+		}
+	}
+
+	bool CpuRenderer::placeBvh(BvhPlacement placement)
+	{
+		m_bvhPlacement = BvhPlacement::Shared;
+		m_bvhReplicas.clear();
+		if (placement == BvhPlacement::Shared || m_topology.nodeCount() < 2)
+		{
+			return placement == BvhPlacement::Shared;
+		}
+
+		if (placement == BvhPlacement::Interleave)
+		{
+			const void* nodes = m_bvh.quantized() ? static_cast<const void*>(m_bvh.quantizedNodes()) : m_bvh.nodes();
+			const bool interleaved = interleaveMemory(nodes, m_bvh.nodeBytes(), m_topology) &&
+									 interleaveMemory(m_bvh.triangles(), size_t(m_bvh.groupCount()) * sizeof(TriangleGroup), m_topology);
+			m_bvhPlacement = interleaved ? BvhPlacement::Interleave : BvhPlacement::Shared;
+			return interleaved;
+		}
+
+		// every copy is written by a thread pinned to its node
+		m_bvhReplicas.resize(m_topology.nodeCount());
+		std::vector<std::thread> threads;
+		for (uint32_t node = 0; node < m_topology.nodeCount(); node++)
+		{
+			threads.emplace_back([this, node]()
+			{
+				setThreadAffinity(m_topology.nodeCpus[node]);
+				m_bvhReplicas[node].replicate(m_bvh);
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		m_bvhPlacement = BvhPlacement::Replicate;
+		return true;
+	}
+
+	Ray CpuRenderer::cameraRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t& rngState) const
+	{
+		const vec3	cameraOrigin		= vec3(float(CAMERA_ORIGIN_X), float(CAMERA_ORIGIN_Y), float(CAMERA_ORIGIN_Z));
+		const float fovVerticalSlope	= float(CAMERA_FOV_VERTICAL_SLOPE);
+
+		float g0, g1;
+		randomGaussian(rngState, g0, g1);
+		const float pixelCenterX	= float(x) + 0.5f + 0.375f * g0;
+		const float pixelCenterY	= float(y) + 0.5f + 0.375f * g1;
+		const float screenU			= (2.0f * pixelCenterX - float(width)) / float(height);
+		const float screenV			= -(2.0f * pixelCenterY - float(height)) / float(height);
+
+		Ray ray;
+		ray.origin		= cameraOrigin;
+		ray.direction	= normalize(vec3(fovVerticalSlope * screenU, fovVerticalSlope * screenV, -1.0f));
+		ray.tMin		= 0.0f;
+		ray.tMax		= 10000.0f;
+		return ray;
+	}
+
+	void CpuRenderer::hitGeometry(const Hit& hit, const Ray& ray, vec3& position, vec3& normal) const
+	{
+		const vec3 v0 = loadVec3(m_positions.data(), m_indices[3 * hit.primitive + 0]);
+		const vec3 v1 = loadVec3(m_positions.data(), m_indices[3 * hit.primitive + 1]);
+		const vec3 v2 = loadVec3(m_positions.data(), m_indices[3 * hit.primitive + 2]);
+		position	= v0 * (1.0f - hit.u - hit.v) + v1 * hit.u + v2 * hit.v;
+		normal		= normalize(cross(v1 - v0, v2 - v0));
+		if (dot(ray.direction, normal) > 0.0f)
+		{
+			normal = -normal;
+		}
+	}
+
+	bool CpuRenderer::scatter(const Hit& hit, Ray& ray, vec3& accumulatedRayColor, vec3& summedPixelColor, uint32_t& rngState) const
+	{
+		if (!hit.valid())
+		{
+			summedPixelColor += accumulatedRayColor * skyColor(ray.direction);
+			return false;
+		}
+		vec3 worldPosition, worldNormal;
+		hitGeometry(hit, ray, worldPosition, worldNormal);
+
+		accumulatedRayColor *= float(SURFACE_ALBEDO);
+		ray.origin		= worldPosition + 0.0001f * worldNormal;
+		ray.direction	= diffuseReflection(worldNormal, rngState);
+		return true;
+	}
+
+	vec3 CpuRenderer::tracePixel(const Bvh8& bvh, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t seed, uint64_t& raysTraced) const
+	{
+		// one random sequence per pixel
+		uint32_t rngState = (seed * height + y) * width + x;
+
+		vec3 summedPixelColor(0.0f);
+		for (int sampleIdx = 0; sampleIdx < NUM_SAMPLES; sampleIdx++)
+		{
+			Ray ray = cameraRay(x, y, width, height, rngState);
+			vec3 accumulatedRayColor(1.0f);
+			for (int tracedSegments = 0; tracedSegments < NUM_TRACED_SEGMENTS; tracedSegments++)
+			{
+				Hit hit;
+				raysTraced++;
+				bvh.intersect(ray, hit);
+				if (!scatter(hit, ray, accumulatedRayColor, summedPixelColor, rngState))
+				{
+					break;
+				}
+			}
+		}
+		return summedPixelColor / float(NUM_SAMPLES);
+	}
+
+	// -----------------------------------------------------------------
+	// Ray binning: Morton index of the origin's cell in a rayBinGridSize^3
+	// grid over the scene bounds, then the direction octant
+	// -----------------------------------------------------------------
+	static uint32_t expandBits3(uint32_t v)
+	{
+		v = (v | (v << 8)) & 0x0300F00Fu;
+		v = (v | (v << 4)) & 0x030C30C3u;
+		v = (v | (v << 2)) & 0x09249249u;
+		return v;
+	}
+
+	void CpuRenderer::binRays(Ray* rays, uint32_t* livePixels, uint32_t count, Arena& arena) const
+	{
+		const Arena::Marker marker = arena.mark();
+		const AABB	bounds	= m_bvh.bounds();
+		const vec3	extent	= bounds.extent();
+		vec3		cellScale;
+		for (int a = 0; a < 3; a++)
+		{
+			cellScale[a] = extent[a] > 0.0f ? float(rayBinGridSize) / extent[a] : 0.0f;
+		}
+
+		// counting sort, stable within a bin so neighbouring pixels stay together
+		ArenaArray<uint32_t> binOffsets(arena, rayBinCount + 1);
+		ArenaArray<uint32_t> keys(arena, count);
+		binOffsets.assign(rayBinCount + 1, 0);
+		keys.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t cell[3];
+			uint32_t octant = 0;
+			for (int a = 0; a < 3; a++)
+			{
+				const float position = (rays[i].origin[a] - bounds.lo[a]) * cellScale[a];
+				cell[a]	= uint32_t(std::min(std::max(position, 0.0f), float(rayBinGridSize - 1)));
+				octant	|= uint32_t(rays[i].direction[a] < 0.0f) << a;
+			}
+			// origin cell in Morton order first, so nearby origins stay nearby, then the octant
+			const uint32_t morton = expandBits3(cell[0]) | (expandBits3(cell[1]) << 1) | (expandBits3(cell[2]) << 2);
+			keys[i] = morton * 8 + octant;
+			binOffsets[keys[i] + 1]++;
+		}
+		for (uint32_t bin = 0; bin < rayBinCount; bin++)
+		{
+			binOffsets[bin + 1] += binOffsets[bin];
+		}
+		ArenaArray<Ray>			sortedRays(arena, count);
+		ArenaArray<uint32_t>	sortedPixels(arena, count);
+		sortedRays.resize(count);
+		sortedPixels.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t slot = binOffsets[keys[i]]++;
+			sortedRays[slot]	= rays[i];
+			sortedPixels[slot]	= livePixels[i];
+		}
+		std::copy(sortedRays.begin(), sortedRays.end(), rays);
+		std::copy(sortedPixels.begin(), sortedPixels.end(), livePixels);
+		arena.rewind(marker);
+	}
+
+	void CpuRenderer::traceTile(const Bvh8& bvh, uint32_t tile, const CpuRenderSettings& settings, CpuImage& rgb, uint64_t& raysTraced) const
+	{
+		const uint32_t tilesX	= (settings.width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t x0		= (tile % tilesX) * WORKGROUP_WIDTH;
+		const uint32_t y0		= (tile / tilesX) * WORKGROUP_HEIGHT;
+		for (uint32_t y = y0; y < std::min(y0 + WORKGROUP_HEIGHT, settings.height); y++)
+		{
+			for (uint32_t x = x0; x < std::min(x0 + WORKGROUP_WIDTH, settings.width); x++)
+			{
+				const vec3		color = tracePixel(bvh, x, y, settings.width, settings.height, settings.seed, raysTraced);
+				const size_t	index = size_t(y) * settings.width + x;
+				rgb[3 * index + 0] = color.x;
+				rgb[3 * index + 1] = color.y;
+				rgb[3 * index + 2] = color.z;
+			}
+		}
+	}
+
+	void CpuRenderer::traceStream(const Bvh8& bvh, const uint32_t* tiles, uint32_t tileCount, const CpuRenderSettings& settings, CpuImage& rgb,
+								  uint64_t& raysTraced, Arena& arena) const
+	{
+		const uint32_t tilesX		= (settings.width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t packetSize	= std::max(1u, std::min(settings.packetSize, Bvh8::maxPacketSize));
+		const uint32_t blockWidth	= std::min(4u, packetSize);
+		const uint32_t blockHeight	= std::max(1u, packetSize / blockWidth);
+
+		// pixels tile by tile, in blocks of blockWidth x blockHeight so each packet covers a compact patch
+		const size_t			maxPixels = size_t(tileCount) * WORKGROUP_WIDTH * WORKGROUP_HEIGHT;
+		ArenaArray<uint32_t>	pixelX(arena, maxPixels);
+		ArenaArray<uint32_t>	pixelY(arena, maxPixels);
+		for (uint32_t t = 0; t < tileCount; t++)
+		{
+			const uint32_t tile	= tiles[t];
+			const uint32_t x0	= (tile % tilesX) * WORKGROUP_WIDTH;
+			const uint32_t y0 = (tile / tilesX) * WORKGROUP_HEIGHT;
+			for (uint32_t by = 0; by < WORKGROUP_HEIGHT; by += blockHeight)
+			{
+				for (uint32_t bx = 0; bx < WORKGROUP_WIDTH; bx += blockWidth)
+				{
+					for (uint32_t y = y0 + by; y < std::min(y0 + by + blockHeight, settings.height); y++)
+					{
+						for (uint32_t x = x0 + bx; x < std::min(x0 + bx + blockWidth, settings.width); x++)
+						{
+							pixelX.push_back(x);
+							pixelY.push_back(y);
+						}
+					}
+				}
+			}
+		}
+		const uint32_t pixelCount = uint32_t(pixelX.size());
+
+		// per pixel state, the random sequence is consumed in the same order as in tracePixel
+		uint32_t*	rngState			= arena.allocate<uint32_t>(pixelCount);
+		vec3*		summedPixelColor	= arena.allocate<vec3>(pixelCount);
+		vec3*		accumulatedRayColor	= arena.allocate<vec3>(pixelCount);
+		for (uint32_t p = 0; p < pixelCount; p++)
+		{
+			rngState[p]			= (settings.seed * settings.height + pixelY[p]) * settings.width + pixelX[p];
+			summedPixelColor[p]	= vec3(0.0f);
+		}
+
+		// live paths, compacted in order after every segment so neighbours stay in the same packet
+		Ray*		rays		= arena.allocate<Ray>(pixelCount);
+		Hit*		hits		= arena.allocate<Hit>(pixelCount);
+		uint32_t*	livePixels	= arena.allocate<uint32_t>(pixelCount);
+		for (int sampleIdx = 0; sampleIdx < NUM_SAMPLES; sampleIdx++)
+		{
+			uint32_t liveCount = pixelCount;
+			for (uint32_t p = 0; p < pixelCount; p++)
+			{
+				livePixels[p]					= p;
+				rays[p]					= cameraRay(pixelX[p], pixelY[p], settings.width, settings.height, rngState[p]);
+				accumulatedRayColor[p]	= vec3(1.0f);
+			}
+			for (int tracedSegments = 0; tracedSegments < NUM_TRACED_SEGMENTS && liveCount > 0; tracedSegments++)
+			{
+				// bounce rays scatter in all directions; regroup them so packets and caches see coherent batches
+				if (settings.sortSecondaryRays && tracedSegments > 0 && liveCount >= rayBinMinStream)
+				{
+					binRays(rays, livePixels, liveCount, arena);
+				}
+				for (uint32_t first = 0; first < liveCount; first += packetSize)
+				{
+					const uint32_t count = std::min(packetSize, liveCount - first);
+					for (uint32_t i = first; i < first + count; i++)
+					{
+						hits[i] = Hit();
+					}
+					if (count == 1)
+					{
+						bvh.intersect(rays[first], hits[first]);
+						continue;
+					}
+					bvh.intersectPacket(rays + first, hits + first, count, settings.packetMinActiveRays);
+				}
+				raysTraced += liveCount;
+
+				uint32_t stillLive = 0;
+				for (uint32_t i = 0; i < liveCount; i++)
+				{
+					const uint32_t p = livePixels[i];
+					if (scatter(hits[i], rays[i], accumulatedRayColor[p], summedPixelColor[p], rngState[p]))
+					{
+						rays[stillLive]			= rays[i];
+						livePixels[stillLive]	= p;
+						stillLive++;
+					}
+				}
+				liveCount = stillLive;
+			}
+		}
+
+		for (uint32_t p = 0; p < pixelCount; p++)
+		{
+			const vec3		color = summedPixelColor[p] / float(NUM_SAMPLES);
+			const size_t	index = size_t(pixelY[p]) * settings.width + pixelX[p];
+			rgb[3 * index + 0] = color.x;
+			rgb[3 * index + 1] = color.y;
+			rgb[3 * index + 2] = color.z;
+		}
+	}
+
+	void CpuRenderer::clearTile(uint32_t tile, const CpuRenderSettings& settings, CpuImage& rgb) const
+	{
+		const uint32_t tilesX	= (settings.width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t x0		= (tile % tilesX) * WORKGROUP_WIDTH;
+		const uint32_t y0		= (tile / tilesX) * WORKGROUP_HEIGHT;
+		const uint32_t x1		= std::min(x0 + WORKGROUP_WIDTH, settings.width);
+		for (uint32_t y = y0; y < std::min(y0 + WORKGROUP_HEIGHT, settings.height); y++)
+		{
+			const size_t index = size_t(y) * settings.width;
+			std::fill(rgb.begin() + 3 * (index + x0), rgb.begin() + 3 * (index + x1), 0.0f);
+		}
+	}
+
+	CpuRenderStats CpuRenderer::render(const CpuRenderSettings& settings, CpuImage& rgb) const
+	{
+		if (settings.radianceCache)
+		{
+			return renderWithCache(settings, rgb);
+		}
+
+		const uint32_t width	= settings.width;
+		const uint32_t height	= settings.height;
+		// left unwritten: the workers first-touch their tiles below
+		rgb.resize(size_t(width) * height * 3);
+
+		const uint32_t tilesX		= (width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t tilesY		= (height + WORKGROUP_HEIGHT - 1) / WORKGROUP_HEIGHT;
+		const std::vector<uint32_t> tiles = mortonTileOrder(tilesX, tilesY);
+		uint32_t threadCount = settings.threadCount != 0 ? settings.threadCount : std::thread::hardware_concurrency();
+		threadCount = std::max(1u, threadCount);
+
+		// a ray stream takes streamTiles consecutive tiles, the scheduler never splits one
+		const bool		streaming	= settings.packetSize > 1 || settings.sortSecondaryRays;
+		const uint32_t	tileStep	= streaming ? std::max(1u, settings.streamTiles) : 1;
+		TileSchedulerSettings schedulerSettings;
+		schedulerSettings.scheduling	= settings.scheduling;
+		schedulerSettings.grainMultiple = tileStep;
+
+		std::vector<WorkerState> workers(threadCount);
+		auto workerBvh = [&](uint32_t worker) -> const Bvh8&
+		{
+			return m_bvhReplicas.empty() ? m_bvh : m_bvhReplicas[m_topology.workerNode(worker, threadCount)];
+		};
+		auto renderTiles = [&](uint32_t worker, uint32_t begin, uint32_t end)
+		{
+			WorkerState&	state	= workers[worker];
+			const Bvh8&		bvh		= workerBvh(worker);
+			for (uint32_t t = begin; t < end; t += tileStep)
+			{
+				state.arena.reset();
+				if (streaming)
+				{
+					traceStream(bvh, tiles.data() + t, std::min(tileStep, end - t), settings, rgb, state.raysTraced, state.arena);
+					continue;
+				}
+				traceTile(bvh, tiles[t], settings, rgb, state.raysTraced);
+			}
+			state.endChunk();
+		};
+		auto pinWorker = [&](uint32_t worker)
+		{
+			setThreadAffinity(m_topology.nodeCpus[m_topology.workerNode(worker, threadCount)]);
+		};
+		auto clearTiles = [&](uint32_t, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t t = begin; t < end; t++)
+			{
+				clearTile(tiles[t], settings, rgb);
+			}
+		};
+
+		// the calling thread is worker 0, give it its affinity back afterwards
+		std::vector<uint32_t> callerCpus;
+		const bool pinning = settings.numaPinning && getThreadAffinity(callerCpus);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		TileScheduler scheduler;
+		const TileSchedulerStats schedulerStats = scheduler.run(uint32_t(tiles.size()), threadCount, schedulerSettings, renderTiles,
+																pinning ? TileScheduler::WorkerStart(pinWorker) : nullptr, clearTiles);
+		const auto end = std::chrono::high_resolution_clock::now();
+		if (pinning)
+		{
+			setThreadAffinity(callerCpus);
+		}
+
+		CpuRenderStats stats;
+		stats.seconds		= std::chrono::duration<double>(end - start).count();
+		stats.tileChunks	= schedulerStats.chunks;
+		stats.tileSteals	= schedulerStats.steals;
+		stats.imbalance		= schedulerStats.imbalance();
+		stats.nodeRaysTraced.assign(m_topology.nodeCount(), 0);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			stats.raysTraced			+= workers[i].raysTraced;
+			stats.steadyHeapAllocations	+= workers[i].steadyAllocations;
+			stats.nodeRaysTraced[m_topology.workerNode(i, threadCount)] += workers[i].raysTraced;
+		}
+		return stats;
+	}
+
+
+	// ------------------------------------------------------------------
+	// Rendering with the radiance cache, a port of nrc_path.comp.glsl,
+	// nrc_resolve.comp.glsl and the frame loop of NrcRenderer
+	// ------------------------------------------------------------------
+	static NrcQuery cacheQuery(const vec3& position, const vec3& direction, const vec3& normal)
+	{
+		NrcQuery query{};
+		for (int a = 0; a < 3; a++)
+		{
+			query.position[a]	= position[a];
+			query.direction[a]	= direction[a];
+			query.normal[a]		= normal[a];
+		}
+		return query;
+	}
+
+	void CpuRenderer::traceCacheTile(const Bvh8& bvh, uint32_t tile, const CpuRenderSettings& settings, const NrcPathSettings& nrc,
+									 CacheFrame& frame, CpuImage& rgb, WorkerState& worker) const
+	{
+		const uint32_t tilesX		= (settings.width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t x0			= (tile % tilesX) * WORKGROUP_WIDTH;
+		const uint32_t y0			= (tile / tilesX) * WORKGROUP_HEIGHT;
+		const uint32_t maxRecords	= nrc.cacheVertex + nrc.suffixVertices;
+		uint64_t raysTraced = 0;		// into the worker's once per tile
+		for (uint32_t y = y0; y < std::min(y0 + WORKGROUP_HEIGHT, settings.height); y++)
+		{
+			for (uint32_t x = x0; x < std::min(x0 + WORKGROUP_WIDTH, settings.width); x++)
+			{
+				const uint32_t	pixelIndex	= y * settings.width + x;
+				uint32_t&		rngState	= frame.rngStates[pixelIndex];
+
+				const bool		training	= (x + frame.trainingOffset[0]) % nrc.trainingTile == 0 &&
+											  (y + frame.trainingOffset[1]) % nrc.trainingTile == 0;
+				// where the path queries the cache; a training path that gets there goes on for its suffix instead
+				uint32_t		endVertex	= frame.warmup ? NUM_TRACED_SEGMENTS : nrc.cacheVertex;
+				bool			suffix		= false;
+				// training paths in pixel order, the first training column or row is at the offset's complement
+				const uint32_t	path		= training ? ((y + frame.trainingOffset[1]) / nrc.trainingTile - (frame.trainingOffset[1] != 0)) * frame.trainingPathsX +
+														 (x + frame.trainingOffset[0]) / nrc.trainingTile - (frame.trainingOffset[0] != 0)
+													   : 0;
+				NrcTrainingRecord*	records = nullptr;
+				if (training)
+				{
+					records				= worker.arena.allocate<NrcTrainingRecord>(maxRecords);
+					frame.records[path]	= records;
+				}
+				vec3				vertexThroughputs[NRC_PATH_MAX_RECORDS];
+				uint32_t			vertexCount = 0;
+				// area spread: footprint of the primary hit, square root of the spread so far and pdf of the last bounce
+				float				primarySpread	= 0.0f;
+				float				spread			= 0.0f;
+				float				bouncePdf		= 1.0f;
+
+				Ray			ray				= cameraRay(x, y, settings.width, settings.height, rngState);
+				vec3		throughput(1.0f);
+				vec3		skyRadiance(0.0f);
+				bool		queried			= false;
+				NrcQuery	query			= cacheQuery(ray.origin, ray.direction, vec3(0.0f, 1.0f, 0.0f));
+				for (uint32_t vertex = 0; vertex < NUM_TRACED_SEGMENTS; vertex++)
+				{
+					Hit hit;
+					raysTraced++;
+					bvh.intersect(ray, hit);
+					if (!hit.valid())
+					{
+						skyRadiance = throughput * skyColor(ray.direction);
+						break;
+					}
+
+					vec3 worldPosition, worldNormal;
+					hitGeometry(hit, ray, worldPosition, worldNormal);
+					const vec3	toHit			= worldPosition - ray.origin;
+					const float	distanceSquared	= dot(toHit, toHit);
+					const float	cosine			= std::max(std::fabs(dot(ray.direction, worldNormal)), 1e-6f);
+					if (vertex == 0)
+					{
+						primarySpread = distanceSquared / (4.0f * 3.14159265f * cosine);
+					}
+					else
+					{
+						spread += std::sqrt(distanceSquared / (bouncePdf * cosine));
+					}
+					const bool spreadOut = !frame.warmup && nrc.spreadThreshold > 0.0f && spread * spread > nrc.spreadThreshold * primarySpread;
+
+					const NrcQuery here = cacheQuery(worldPosition, ray.direction, worldNormal);
+					if (vertex == endVertex || spreadOut)
+					{
+						if (!training || suffix)
+						{
+							query	= here;
+							queried	= true;
+							break;
+						}
+						// the suffix spreads from here on
+						suffix		= true;
+						endVertex	= vertex + nrc.suffixVertices;
+						spread		= 0.0f;
+					}
+					if (training && vertexCount < maxRecords)
+					{
+						std::copy(here.position, here.position + 4, records[vertexCount].position);
+						std::copy(here.direction, here.direction + 4, records[vertexCount].direction);
+						std::copy(here.normal, here.normal + 4, records[vertexCount].normal);
+						vertexThroughputs[vertexCount] = throughput;
+						vertexCount++;
+					}
+
+					throughput		*= float(SURFACE_ALBEDO);
+					ray.origin		= worldPosition + 0.0001f * worldNormal;
+					ray.direction	= diffuseReflection(worldNormal, rngState);
+					bouncePdf		= std::max(dot(ray.direction, worldNormal), 1e-6f) / 3.14159265f;
+				}
+
+				const vec3 sky = skyRadiance / float(NUM_SAMPLES);
+				rgb[3 * size_t(pixelIndex) + 0] += sky.x;
+				rgb[3 * size_t(pixelIndex) + 1] += sky.y;
+				rgb[3 * size_t(pixelIndex) + 2] += sky.z;
+				frame.queryThroughputs[pixelIndex]	= queried ? throughput : vec3(0.0f);
+				frame.queries[pixelIndex]			= query;
+
+				if (training)
+				{
+					const vec3 end = queried ? throughput : skyRadiance;
+					for (uint32_t v = 0; v < vertexCount; v++)
+					{
+						for (int a = 0; a < 3; a++)
+						{
+							records[v].radiance[a] = end[a] / vertexThroughputs[v][a];
+						}
+						records[v].radiance[3] = 0.0f;
+					}
+					frame.recordCounts[path]	= vertexCount;
+					frame.recordQueries[path]	= queried ? pixelIndex : ~0u;
+				}
+			}
+		}
+		worker.raysTraced += raysTraced;
+	}
+
+	CpuRenderStats CpuRenderer::renderWithCache(const CpuRenderSettings& settings, CpuImage& rgb) const
+	{
+		const uint32_t			width		= settings.width;
+		const uint32_t			height		= settings.height;
+		const uint32_t			pixelCount	= width * height;
+		const NrcPathSettings	nrc			= validNrcPathSettings(settings.nrc, width, height);
+		// left unwritten: the workers first-touch their tiles in the first frame
+		rgb.resize(size_t(pixelCount) * 3);
+
+		const uint32_t tilesX		= (width + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH;
+		const uint32_t tilesY		= (height + WORKGROUP_HEIGHT - 1) / WORKGROUP_HEIGHT;
+		const std::vector<uint32_t> tiles = mortonTileOrder(tilesX, tilesY);
+		uint32_t threadCount = settings.threadCount != 0 ? settings.threadCount : std::thread::hardware_concurrency();
+		threadCount = std::max(1u, threadCount);
+		TileSchedulerSettings schedulerSettings;
+		schedulerSettings.scheduling = settings.scheduling;
+
+		const AABB bounds = m_bvh.bounds();
+		CpuNeuralRadianceCache cache;
+		cache.init(nrc.cache, &bounds.lo.x, &bounds.hi.x, threadCount);
+
+		CpuRenderStats	stats;
+		const float		camera[3]	= { float(CAMERA_ORIGIN_X), float(CAMERA_ORIGIN_Y), float(CAMERA_ORIGIN_Z) };
+		const uint64_t	sceneHash	= settings.nrcCheckpointDirectory.empty() ? 0
+									: hashNrcScene(m_positions.data(), m_positions.size(), m_indices.data(), m_indices.size());
+		if (!settings.nrcCheckpointDirectory.empty())
+		{
+			NrcCacheState state;
+			stats.warmStart = loadNrcWarmStart(settings.nrcCheckpointDirectory, sceneHash, cache.config(), settings.nrcCheckpointPolicy,
+											   camera, &bounds.lo.x, &bounds.hi.x, state);
+			if (stats.warmStart != NrcWarmStart::Cold)
+			{
+				cache.setState(state);
+				cache.setLearningRate(cache.learningRate() * settings.nrcCheckpointPolicy.learningRateScale);
+			}
+		}
+
+		// one random sequence per pixel, continued across frames as in tracePixel
+		CacheFrame frame;
+		frame.trainingPathsX	= (width + nrc.trainingTile - 1) / nrc.trainingTile;
+		const uint32_t trainingPaths = frame.trainingPathsX * ((height + nrc.trainingTile - 1) / nrc.trainingTile);
+		frame.rngStates.resize(pixelCount);
+		for (uint32_t p = 0; p < pixelCount; p++)
+		{
+			frame.rngStates[p] = settings.seed * pixelCount + p;
+		}
+		frame.queryThroughputs.resize(pixelCount);
+		frame.queries.resize(pixelCount);
+		frame.records.resize(trainingPaths);
+		frame.recordCounts.resize(trainingPaths);
+		frame.recordQueries.resize(trainingPaths);
+
+		std::vector<NrcTrainingRecord>	ring(nrc.ringCapacity);
+		uint64_t						ringCursor	= 0;
+		std::vector<NrcQuery>			queries;
+		std::vector<uint32_t>			queryPixels;
+		std::vector<uint32_t>			pixelQueries(pixelCount);		// index into queries, for the records
+		std::vector<float>				results;
+		std::vector<WorkerState>		workers(threadCount);
+
+		const uint32_t firstStep = cache.trainingSteps();
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frameIndex = 0; frameIndex < NUM_SAMPLES; frameIndex++)
+		{
+			// learn from the records of the frames so far: before this frame's queries so they see the new weights, or
+			// after them with async training, on the same records
+			const uint32_t ringRecords = uint32_t(std::min<uint64_t>(ringCursor, nrc.ringCapacity));
+			auto trainStep = [&]()
+			{
+				const auto trainStart = std::chrono::high_resolution_clock::now();
+				if (ringRecords > 0)
+				{
+					cache.train(ring.data(), ringRecords);
+				}
+				const double trainSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - trainStart).count();
+				stats.cacheSeconds		+= trainSeconds;
+				stats.trainingSeconds	+= trainSeconds;
+			};
+			if (!nrc.cache.asyncTraining)
+			{
+				trainStep();
+			}
+
+			// a cold cache sits out its first frames, see NrcPathSettings::warmupFrames
+			frame.warmup = stats.warmStart == NrcWarmStart::Cold && frameIndex < nrc.warmupFrames;
+			nrcTrainingOffset(nrc, frameIndex, frame.trainingOffset);
+			std::fill(frame.recordCounts.begin(), frame.recordCounts.end(), 0u);
+			TileScheduler scheduler;
+			auto traceTiles = [&](uint32_t worker, uint32_t begin, uint32_t end)
+			{
+				// the records of the frame before have been resolved into the ring. Between frames the thread may have
+				// done other work (worker 0 is the one that trains the cache), so the count starts again here
+				WorkerState& state = workers[worker];
+				if (state.frame != frameIndex)
+				{
+					state.allocationsSeen = threadHeapAllocations();
+					state.arena.reset();
+					state.frame = frameIndex;
+				}
+				for (uint32_t t = begin; t < end; t++)
+				{
+					traceCacheTile(m_bvh, tiles[t], settings, nrc, frame, rgb, state);
+				}
+				state.endChunk();
+			};
+			auto clearTiles = [&](uint32_t, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t t = begin; t < end; t++)
+				{
+					clearTile(tiles[t], settings, rgb);
+				}
+			};
+			scheduler.run(uint32_t(tiles.size()), threadCount, schedulerSettings, traceTiles, nullptr,
+						  frameIndex == 0 ? TileScheduler::Body(clearTiles) : nullptr);
+
+			// only the paths that reached the cache vertex ask it
+			queries.clear();
+			queryPixels.clear();
+			for (uint32_t p = 0; p < pixelCount; p++)
+			{
+				const vec3& weight = frame.queryThroughputs[p];
+				if (weight.x != 0.0f || weight.y != 0.0f || weight.z != 0.0f)
+				{
+					pixelQueries[p] = uint32_t(queries.size());
+					queries.push_back(frame.queries[p]);
+					queryPixels.push_back(p);
+				}
+			}
+			results.resize(queries.size() * NRC_OUTPUT_WIDTH);
+			const auto queryStart = std::chrono::high_resolution_clock::now();
+			if (!queries.empty())
+			{
+				cache.query(queries.data(), uint32_t(queries.size()), results.data());
+			}
+			stats.cacheSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - queryStart).count();
+			stats.cacheQueries += queries.size();
+			if (nrc.cache.asyncTraining)
+			{
+				trainStep();
+			}
+
+			// resolve: the answers into the image, the records waiting for them into the ring
+			for (uint32_t q = 0; q < uint32_t(queryPixels.size()); q++)
+			{
+				const uint32_t	p		= queryPixels[q];
+				const vec3&		weight	= frame.queryThroughputs[p];
+				for (int a = 0; a < 3; a++)
+				{
+					rgb[3 * size_t(p) + a] += weight[a] * std::max(results[size_t(q) * NRC_OUTPUT_WIDTH + a], 0.0f) / float(NUM_SAMPLES);
+				}
+			}
+			for (uint32_t path = 0; path < trainingPaths; path++)
+			{
+				const uint32_t pixel = frame.recordQueries[path];
+				for (uint32_t v = 0; v < frame.recordCounts[path]; v++)
+				{
+					NrcTrainingRecord record = frame.records[path][v];
+					if (pixel != ~0u)
+					{
+						for (int a = 0; a < 3; a++)
+						{
+							record.radiance[a] *= std::max(results[size_t(pixelQueries[pixel]) * NRC_OUTPUT_WIDTH + a], 0.0f);
+						}
+					}
+					ring[ringCursor % nrc.ringCapacity] = record;
+					ringCursor++;
+				}
+			}
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		stats.seconds			= std::chrono::duration<double>(end - start).count();
+		stats.trainingRecords	= ringCursor;
+		stats.trainingSteps		= cache.trainingSteps() - firstStep;
+		if (!settings.nrcCheckpointDirectory.empty())
+		{
+			stats.checkpointSaved = saveNrcCheckpoint(nrcCheckpointPath(settings.nrcCheckpointDirectory, sceneHash, cache.config()), sceneHash,
+													  cache.config(), camera, cache.state());
+		}
+		stats.nodeRaysTraced.assign(m_topology.nodeCount(), 0);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			stats.raysTraced			+= workers[i].raysTraced;
+			stats.steadyHeapAllocations	+= workers[i].steadyAllocations;
+			stats.nodeRaysTraced[m_topology.workerNode(i, threadCount)] += workers[i].raysTraced;
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,193 @@
+# pragma once
+
+#include <string>
+#include <vector>
+#include <cpu_arena.h>
+#include <cpu_bvh8.h>
+#include <cpu_nrc.h>
+#include <cpu_numa.h>
+#include <cpu_scheduler.h>
+#include "shaders/common.h"
+
+namespace NRC
+{
+	struct CpuRenderSettings
+	{
+		uint32_t width			= RENDER_WIDTH;
+		uint32_t height			= RENDER_HEIGHT;
+		uint32_t threadCount	= 0;		// 0: one worker per hardware thread
+		// picks the per-pixel random sequences; renders with the same seed trace the same samples wherever their
+		// paths agree, so an image compared against a reference of another seed shows its own error only
+		uint32_t seed			= 0;
+		// how tiles (Morton ordered, workgroup sized) are spread over the workers
+		TileScheduling scheduling		= TileScheduling::WorkStealing;
+
+		// rays per packet (8 or 16), 0 or 1 traces every ray on its own
+		uint32_t packetSize				= Bvh8::maxPacketSize;
+		// packet traversal falls back to single rays below this many active rays
+		uint32_t packetMinActiveRays	= 4;
+
+		// tiles advanced together as one ray stream (packets or sorting enabled)
+		uint32_t streamTiles			= 1;
+		// bin bounce rays by origin cell and direction octant before tracing them; off, since the sort costs more than
+		// the coherence saves on these scenes (--bench raysort: 0.75x-0.99x on the mesh, 0.94x-1.03x, noise, on the box)
+		bool	 sortSecondaryRays		= false;
+
+		// pin every worker to the CPUs of its NUMA node; either way each worker first-touches
+		// the framebuffer pages of its initial share of the tiles
+		bool	 numaPinning			= true;
+
+		// render like NrcRenderer (see shaders/nrc_paths.h): every sample is a frame of short paths that end in
+		// a radiance cache, trained on the way; the cache starts from nrc.cache.seed in every render. With
+		// nrc.cache.asyncTraining a frame's queries see the weights of the step before, as on the device's
+		// compute queue, though the step still runs in sequence here
+		bool			radianceCache	= false;
+		NrcPathSettings	nrc;
+		// when not empty, the cache starts from the checkpoint of the scene and network in this directory, as far as
+		// nrcCheckpointPolicy allows for the camera, and the render writes its own back (see nrc_checkpoint.h)
+		std::string			nrcCheckpointDirectory;
+		NrcCheckpointPolicy	nrcCheckpointPolicy;
+	};
+
+	struct CpuRenderStats
+	{
+		double		seconds		= 0.0;
+		uint64_t	raysTraced	= 0;
+		uint64_t	tileChunks	= 0;		// scheduler hand-outs of one or more tiles
+		uint64_t	tileSteals	= 0;
+		double		imbalance	= 1.0;		// busiest worker against the mean
+		std::vector<uint64_t> nodeRaysTraced;	// per NUMA node, by the workers assigned to it
+		// heap allocations on the workers while rendering, after each one's first chunk
+		uint64_t	steadyHeapAllocations = 0;
+		// with radianceCache
+		double		cacheSeconds	= 0.0;		// part of seconds spent in the cache's training steps and queries
+		double		trainingSeconds	= 0.0;		// part of cacheSeconds spent in the training steps
+		uint64_t	cacheQueries	= 0;
+		uint64_t	trainingRecords	= 0;
+		uint32_t	trainingSteps	= 0;
+		NrcWarmStart warmStart		= NrcWarmStart::Cold;
+		bool		checkpointSaved	= false;
+
+		double raysPerSecond() const { return seconds > 0.0 ? double(raysTraced) / seconds : 0.0; }
+	};
+
+	// ray binning grid per axis over the scene bounds, times eight direction octants
+	static const uint32_t rayBinGridSize	= 4;
+	static const uint32_t rayBinCount		= 8 * rayBinGridSize * rayBinGridSize * rayBinGridSize;
+	// fewer live rays than this are traced as they are, binning them costs more than it saves
+	static const uint32_t rayBinMinStream	= 4 * rayBinCount;
+
+	// ----------------------------------------------------------------
+	// Multithreaded CPU reference of raytracer.comp.glsl.
+	//
+	// Same camera, random number sequence, sampling and shading as the
+	// compute shader, so it renders the same image on hosts without a
+	// Vulkan ray query device. Tiles have the size of a workgroup and
+	// are handed out along a Morton curve by a TileScheduler.
+	// With packets enabled a ray stream of one or more tiles advances
+	// all of its paths one segment at a time, so the camera rays of
+	// neighbouring pixels are traced as packets. Bounce rays are
+	// incoherent; they either fall back to single rays or, with
+	// sortSecondaryRays, are first binned by origin cell and direction
+	// octant so that packets and caches see coherent batches again.
+	// The binning has not paid for itself here: one counting sort per
+	// bounce over the whole stream costs more than the coherence
+	// saves, with or without packets, so it stays off by default.
+	// On NUMA hosts workers are assigned to nodes in contiguous blocks,
+	// matching their initial shares of the tiles, and pinned there;
+	// each writes its share of the image first so those pages are
+	// local. The BVH can be replicated per node or interleaved.
+	// With radianceCache it mirrors NrcRenderer on a CpuNeuralRadianceCache;
+	// training records are kept per training path and go into the ring
+	// in pixel order, so the result does not depend on the scheduling.
+	// ----------------------------------------------------------------
+	class CpuRenderer
+	{
+	public:
+		// positions: vec3 floats per vertex, indices: 3 per triangle (as produced from tinyobj)
+		// bvhSettings: binary build before the BVH8 collapse, e.g. with spatialSplits for scenes of long triangles
+		// bvhCacheDirectory: when not empty, the BVH is mapped from the cache file of the scene there,
+		// or built and written to it on a miss (see cpu_bvh_cache.h)
+		// quantizeBvh: trace quantized BVH8 nodes (Bvh8::quantize), about a third of the node memory
+		void init(const std::vector<float>& positions, const std::vector<uint32_t>& indices,
+				  const BvhBuildSettings& bvhSettings = Bvh8::buildSettings(), const std::string& bvhCacheDirectory = std::string(),
+				  bool quantizeBvh = false);
+
+		// true when init() mapped the BVH from the cache instead of building it
+		bool bvhFromCache() const { return m_bvh.attached(); }
+
+		// where the BVH lives relative to the NUMA nodes, shared after init(); false (and shared) when the
+		// host has a single node or the kernel refused to interleave
+		bool placeBvh(BvhPlacement placement);
+		BvhPlacement bvhPlacement() const { return m_bvhPlacement; }
+		const NumaTopology& numaTopology() const { return m_topology; }
+
+		// renders into rgb, 3 floats per pixel, row by row like the GPU storage buffer
+		CpuRenderStats render(const CpuRenderSettings& settings, CpuImage& rgb) const;
+
+	private:
+		// one per render worker, padded so that workers never write to the same cache line
+		struct alignas(64) WorkerState
+		{
+			uint64_t			raysTraced = 0;
+			Arena				arena;			// transient state of the current stream or cache frame
+			uint32_t			frame		= ~0u;	// cache frame the arena holds the records of
+			// heap allocations of the worker, the first chunk warms up its buffers and is left out
+			bool				warm				= false;
+			uint64_t			allocationsSeen		= 0;
+			uint64_t			steadyAllocations	= 0;
+
+			// counts the allocations since the end of the previous chunk, so taking or stealing this one counts as well
+			void endChunk()
+			{
+				const uint64_t allocations = threadHeapAllocations();
+				if (warm)
+				{
+					steadyAllocations += allocations - allocationsSeen;
+				}
+				allocationsSeen	= allocations;
+				warm			= true;
+			}
+		};
+
+		Ray cameraRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t& rngState) const;
+		// sky on a miss, next diffuse segment on a hit; false ends the path
+		bool scatter(const Hit& hit, Ray& ray, vec3& accumulatedRayColor, vec3& summedPixelColor, uint32_t& rngState) const;
+		// bvh: m_bvh or the replica of the worker's node
+		vec3 tracePixel(const Bvh8& bvh, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t seed, uint64_t& raysTraced) const;
+		void traceTile(const Bvh8& bvh, uint32_t tile, const CpuRenderSettings& settings, CpuImage& rgb, uint64_t& raysTraced) const;
+		void traceStream(const Bvh8& bvh, const uint32_t* tiles, uint32_t tileCount, const CpuRenderSettings& settings, CpuImage& rgb,
+						 uint64_t& raysTraced, Arena& arena) const;
+		// zeroes the pixels of a tile, placing their pages on the calling thread's node
+		void clearTile(uint32_t tile, const CpuRenderSettings& settings, CpuImage& rgb) const;
+		// position and normal (facing the ray) of a valid hit
+		void hitGeometry(const Hit& hit, const Ray& ray, vec3& position, vec3& normal) const;
+
+		// per pixel and per training path state of one frame of renderWithCache
+		struct CacheFrame
+		{
+			uint32_t							trainingOffset[2]	= {};
+			uint32_t							trainingPathsX		= 0;
+			bool								warmup				= false;	// paths trace to the end and do not query
+			std::vector<uint32_t>				rngStates;
+			std::vector<vec3>					queryThroughputs;	// zero for paths that ended without a query
+			std::vector<NrcQuery>				queries;
+			// per training path, cacheVertex + suffixVertices records in the arena of the worker that traced it
+			std::vector<NrcTrainingRecord*>		records;
+			std::vector<uint32_t>				recordCounts;		// per training path
+			std::vector<uint32_t>				recordQueries;		// per training path, the pixel whose answer scales its records, ~0u when final
+		};
+		CpuRenderStats renderWithCache(const CpuRenderSettings& settings, CpuImage& rgb) const;
+		void traceCacheTile(const Bvh8& bvh, uint32_t tile, const CpuRenderSettings& settings, const NrcPathSettings& nrc, CacheFrame& frame,
+							CpuImage& rgb, WorkerState& worker) const;
+		// sorts in place; the buffers come from arena and are released again
+		void binRays(Ray* rays, uint32_t* livePixels, uint32_t count, Arena& arena) const;
+
+		std::vector<float>		m_positions;
+		std::vector<uint32_t>	m_indices;
+		Bvh8					m_bvh;
+		NumaTopology			m_topology;
+		BvhPlacement			m_bvhPlacement	= BvhPlacement::Shared;
+		std::vector<Bvh8>		m_bvhReplicas;		// one per node with BvhPlacement::Replicate
+	};
+}
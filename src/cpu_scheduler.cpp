@@ -0,0 +1,275 @@
+#include <cpu_scheduler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+namespace NRC
+{
+	// ------------
+	// Morton order
+	// ------------
+	static uint32_t spreadBits(uint32_t v)
+	{
+		v &= 0xffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	std::vector<uint32_t> mortonTileOrder(uint32_t tilesX, uint32_t tilesY)
+	{
+		// the grid need not be a power of two: sort by code, tiles outside the frame just do not exist
+		std::vector<std::pair<uint32_t, uint32_t>> codes;
+		codes.reserve(size_t(tilesX) * tilesY);
+		for (uint32_t y = 0; y < tilesY; y++)
+		{
+			for (uint32_t x = 0; x < tilesX; x++)
+			{
+				codes.emplace_back(spreadBits(x) | (spreadBits(y) << 1), y * tilesX + x);
+			}
+		}
+		std::sort(codes.begin(), codes.end());
+		std::vector<uint32_t> order(codes.size());
+		for (size_t i = 0; i < codes.size(); i++)
+		{
+			order[i] = codes[i].second;
+		}
+		return order;
+	}
+
+	double TileSchedulerStats::imbalance() const
+	{
+		double slowest	= 0.0;
+		double sum		= 0.0;
+		for (double seconds : busySeconds)
+		{
+			slowest = std::max(slowest, seconds);
+			sum		+= seconds;
+		}
+		return sum > 0.0 ? slowest * double(busySeconds.size()) / sum : 1.0;
+	}
+
+
+	// ---------
+	// Scheduler
+	// ---------
+	static uint32_t roundUpToMultiple(uint32_t value, uint32_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	// next chunk of the worker's newest range, from its front
+	bool TileScheduler::takeChunk(Worker& worker, uint32_t grain, ItemRange& chunk)
+	{
+		std::lock_guard<std::mutex> guard(worker.lock);
+		if (worker.ranges.empty())
+		{
+			return false;
+		}
+		ItemRange& range = worker.ranges.back();
+		chunk.begin = range.begin;
+		chunk.end	= std::min(range.end, range.begin + grain);
+		range.begin = chunk.end;
+		if (range.begin == range.end)
+		{
+			worker.ranges.pop_back();
+		}
+		return true;
+	}
+
+	// moves work from the oldest range of another worker into the thief's deque, false when every deque is empty
+	bool TileScheduler::steal(uint32_t thief, uint32_t& victimSeed, uint32_t grainMultiple)
+	{
+		const uint32_t workerCount = uint32_t(m_workers.size());
+		victimSeed ^= victimSeed << 13;
+		victimSeed ^= victimSeed >> 17;
+		victimSeed ^= victimSeed << 5;
+		for (uint32_t k = 0; k < workerCount; k++)
+		{
+			const uint32_t victim = (victimSeed + k) % workerCount;
+			if (victim == thief)
+			{
+				continue;
+			}
+			ItemRange stolen;
+			{
+				std::lock_guard<std::mutex> guard(m_workers[victim].lock);
+				std::deque<ItemRange>& ranges = m_workers[victim].ranges;
+				if (ranges.empty())
+				{
+					continue;
+				}
+				// the back half, far from the items the owner takes next; split on the grain so streams stay whole
+				ItemRange&		range	= ranges.front();
+				const uint32_t	middle	= roundUpToMultiple(range.begin + (range.end - range.begin) / 2, grainMultiple);
+				if (ranges.size() == 1 && middle > range.begin && middle < range.end)
+				{
+					stolen		= { middle, range.end };
+					range.end	= middle;
+				}
+				else
+				{
+					stolen = range;
+					ranges.pop_front();
+				}
+			}
+			std::lock_guard<std::mutex> guard(m_workers[thief].lock);
+			m_workers[thief].ranges.push_back(stolen);
+			return true;
+		}
+		return false;
+	}
+
+	void TileScheduler::runWorker(uint32_t index, const TileSchedulerSettings& settings, const Body& body, WorkerTotals& totals)
+	{
+		using Clock = std::chrono::high_resolution_clock;
+		Worker&		self			= m_workers[index];
+		uint32_t	grain			= settings.grainMultiple;		// the first chunk only measures the cost
+		double		secondsPerItem	= 0.0;
+		uint32_t	victimSeed		= 2654435761u * (index + 1);
+		WorkerTotals local;
+		for (;;)
+		{
+			ItemRange chunk;
+			if (!takeChunk(self, grain, chunk))
+			{
+				if (settings.scheduling != TileScheduling::WorkStealing || !steal(index, victimSeed, settings.grainMultiple))
+				{
+					break;
+				}
+				local.steals++;
+				continue;
+			}
+
+			const auto start = Clock::now();
+			body(index, chunk.begin, chunk.end);
+			const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			local.busySeconds += seconds;
+			local.chunks++;
+
+			if (settings.scheduling == TileScheduling::WorkStealing)
+			{
+				const double itemSeconds = seconds / double(chunk.end - chunk.begin);
+				secondsPerItem	= secondsPerItem > 0.0 ? 0.75 * secondsPerItem + 0.25 * itemSeconds : itemSeconds;
+				const double items = secondsPerItem > 0.0 ? settings.targetChunkSeconds / secondsPerItem : double(settings.maxGrain);
+				grain = roundUpToMultiple(uint32_t(std::min(std::max(items, 1.0), double(settings.maxGrain))), settings.grainMultiple);
+			}
+		}
+		totals = local;
+	}
+
+	TileSchedulerStats TileScheduler::run(uint32_t itemCount, uint32_t workerCount, const TileSchedulerSettings& settings, const Body& body,
+										  const WorkerStart& workerStart, const Body& firstTouch)
+	{
+		workerCount = std::max(1u, workerCount);
+		TileSchedulerStats stats;
+		stats.busySeconds.assign(workerCount, 0.0);
+
+		// equal contiguous shares, aligned to the grain
+		const uint32_t multiple = std::max(1u, settings.grainMultiple);
+		auto shareBegin = [&](uint32_t worker)
+		{
+			return std::min(itemCount, roundUpToMultiple(uint32_t(uint64_t(itemCount) * worker / workerCount), multiple));
+		};
+
+		// hooks, then every worker waits until all shares are touched
+		std::mutex				barrierLock;
+		std::condition_variable barrierDone;
+		uint32_t				barrierWaiting = 0;
+		auto prepareWorker = [&](uint32_t index)
+		{
+			if (workerStart)
+			{
+				workerStart(index);
+			}
+			if (!firstTouch)
+			{
+				return;
+			}
+			if (shareBegin(index) < shareBegin(index + 1))
+			{
+				firstTouch(index, shareBegin(index), shareBegin(index + 1));
+			}
+			std::unique_lock<std::mutex> guard(barrierLock);
+			if (++barrierWaiting == workerCount)
+			{
+				barrierDone.notify_all();
+				return;
+			}
+			barrierDone.wait(guard, [&]() { return barrierWaiting == workerCount; });
+		};
+
+		if (settings.scheduling == TileScheduling::SharedCounter)
+		{
+			std::atomic<uint32_t> next(0);
+			std::atomic<uint64_t> chunks(0);
+			auto worker = [&](uint32_t index)
+			{
+				prepareWorker(index);
+				double busySeconds = 0.0;
+				for (uint32_t begin = next.fetch_add(multiple); begin < itemCount; begin = next.fetch_add(multiple))
+				{
+					const auto start = std::chrono::high_resolution_clock::now();
+					body(index, begin, std::min(itemCount, begin + multiple));
+					busySeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+					chunks++;
+				}
+				stats.busySeconds[index] = busySeconds;
+			};
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < workerCount; i++)
+			{
+				threads.emplace_back(worker, i);
+			}
+			worker(0);
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+			stats.chunks = chunks;
+			return stats;
+		}
+
+		std::vector<Worker>(workerCount).swap(m_workers);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			if (shareBegin(i) < shareBegin(i + 1))
+			{
+				m_workers[i].ranges.push_back({ shareBegin(i), shareBegin(i + 1) });
+			}
+		}
+
+		TileSchedulerSettings workerSettings = settings;
+		workerSettings.grainMultiple = multiple;
+		std::vector<WorkerTotals> totals(workerCount);
+		auto worker = [&](uint32_t index)
+		{
+			prepareWorker(index);
+			runWorker(index, workerSettings, body, totals[index]);
+		};
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < workerCount; i++)
+		{
+			threads.emplace_back(worker, i);
+		}
+		worker(0);
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		m_workers.clear();
+
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			stats.chunks			+= totals[i].chunks;
+			stats.steals			+= totals[i].steals;
+			stats.busySeconds[i]	= totals[i].busySeconds;
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,100 @@
+# pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace NRC
+{
+	// tile indices (row-major in a tilesX x tilesY grid) sorted along a Morton curve, so consecutive tiles are neighbours
+	std::vector<uint32_t> mortonTileOrder(uint32_t tilesX, uint32_t tilesY);
+
+	enum class TileScheduling
+	{
+		Static,				// every worker renders one contiguous share of the tiles
+		SharedCounter,		// workers take fixed chunks from one atomic counter
+		WorkStealing,		// per-worker deques, idle workers steal, chunk size follows the measured cost
+	};
+
+	inline const char* tileSchedulingName(TileScheduling scheduling)
+	{
+		return scheduling == TileScheduling::Static ? "static" : scheduling == TileScheduling::SharedCounter ? "counter" : "stealing";
+	}
+
+	struct TileSchedulerSettings
+	{
+		TileScheduling	scheduling			= TileScheduling::WorkStealing;
+		// chunks are multiples of this many items (a ray stream of several tiles is not split)
+		uint32_t		grainMultiple		= 1;
+		// work stealing: chunks are sized to take about this long at the worker's measured cost per item
+		double			targetChunkSeconds	= 2e-3;
+		uint32_t		maxGrain			= 64;
+	};
+
+	struct TileSchedulerStats
+	{
+		uint64_t			chunks		= 0;
+		uint64_t			steals		= 0;
+		std::vector<double>	busySeconds;		// per worker
+
+		// slowest worker against the mean, 1 when the load is balanced
+		double imbalance() const;
+	};
+
+	// ----------------------------------------------------------------
+	// Runs items [0, itemCount) on a set of workers, the calling thread
+	// being worker 0. With work stealing every worker starts with an
+	// equal contiguous share in its own deque of item ranges. It takes
+	// chunks from the front of its newest range and walks forward, so
+	// consecutive (Morton ordered) tiles stay on one core. An idle
+	// worker steals the back half of the oldest range of another one,
+	// the part furthest from where its owner is working. Each worker
+	// keeps a running average of its cost per item and sizes the next
+	// chunk to about targetChunkSeconds: cheap regions go in large
+	// blocks, expensive ones in single tiles that balance finely.
+	// Deques are guarded by their own mutex, which only a thief
+	// contends for, so the owner's fast path stays local.
+	// ----------------------------------------------------------------
+	class TileScheduler
+	{
+	public:
+		// body(worker, begin, end) processes items [begin, end); it runs concurrently for different workers
+		using Body = std::function<void(uint32_t worker, uint32_t begin, uint32_t end)>;
+		// called on a worker's thread before it takes any item, e.g. to pin the thread
+		using WorkerStart = std::function<void(uint32_t worker)>;
+
+		// firstTouch(worker, begin, end), when given, runs on every worker over the contiguous share it starts
+		// with (the one it keeps under static scheduling), and no worker takes an item before all of them are
+		// done, so memory indexed by item is placed by the worker most likely to use it
+		TileSchedulerStats run(uint32_t itemCount, uint32_t workerCount, const TileSchedulerSettings& settings, const Body& body,
+							   const WorkerStart& workerStart = nullptr, const Body& firstTouch = nullptr);
+
+	private:
+		struct ItemRange
+		{
+			uint32_t begin;
+			uint32_t end;
+		};
+
+		struct alignas(64) Worker
+		{
+			std::mutex				lock;
+			std::deque<ItemRange>	ranges;
+		};
+
+		struct WorkerTotals
+		{
+			uint64_t	chunks		= 0;
+			uint64_t	steals		= 0;
+			double		busySeconds = 0.0;
+		};
+
+		bool takeChunk(Worker& worker, uint32_t grain, ItemRange& chunk);
+		bool steal(uint32_t thief, uint32_t& victimSeed, uint32_t grainMultiple);
+		void runWorker(uint32_t index, const TileSchedulerSettings& settings, const Body& body, WorkerTotals& totals);
+
+		std::vector<Worker>	m_workers;
+	};
+}
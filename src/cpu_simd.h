@@ -0,0 +1,109 @@
+# pragma once
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+
+// ------------------------------------------------------------------
+// Per-function instruction set targets. GCC and Clang only emit AVX
+// code inside functions that ask for it, so the SIMD kernels carry a
+// target attribute and are selected at runtime; MSVC accepts the
+// intrinsics anywhere.
+// Shared kernel code is NRC_SIMD_INLINE and the per-ISA entry points
+// are NRC_FLATTEN, so the kernels inline into a single function per
+// target (GCC refuses to force-inline across differing targets).
+// ------------------------------------------------------------------
+#if defined(__GNUC__) || defined(__clang__)
+#define NRC_TARGET_AVX2		__attribute__((target("avx2,fma,f16c")))
+#define NRC_TARGET_AVX512	__attribute__((target("avx2,fma,f16c,avx512f,avx512vl")))
+#define NRC_FLATTEN			__attribute__((flatten))
+#define NRC_SIMD_INLINE		inline
+#else
+#define NRC_TARGET_AVX2
+#define NRC_TARGET_AVX512
+#define NRC_FLATTEN
+#define NRC_SIMD_INLINE		__forceinline
+#endif
+
+namespace NRC
+{
+	enum class SimdLevel
+	{
+		Scalar,
+		Avx2,		// AVX2 + FMA + F16C
+		Avx512,		// AVX-512 F + VL
+	};
+
+	inline const char* simdLevelName(SimdLevel level)
+	{
+		return level == SimdLevel::Avx512 ? "AVX-512" : level == SimdLevel::Avx2 ? "AVX2" : "scalar";
+	}
+
+	// index of the lowest set bit, mask must not be 0
+	inline uint32_t bitScanForward(uint32_t mask)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return uint32_t(index);
+#else
+		return uint32_t(__builtin_ctz(mask));
+#endif
+	}
+
+	// number of set bits, portable to targets without POPCNT
+	inline uint32_t bitCount(uint32_t mask)
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		uint32_t count = 0;
+		for (; mask != 0; mask &= mask - 1)
+		{
+			count++;
+		}
+		return count;
+#else
+		return uint32_t(__builtin_popcount(mask));
+#endif
+	}
+
+	// widest instruction set supported by the CPU (and the OS)
+	inline SimdLevel detectSimdLevel()
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("f16c"))
+		{
+			return SimdLevel::Avx512;
+		}
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+		{
+			return SimdLevel::Avx2;
+		}
+		return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave	= (info[2] & (1 << 27)) != 0;
+		const bool fma		= (info[2] & (1 << 12)) != 0;
+		const bool f16c		= (info[2] & (1 << 29)) != 0;
+		if (!osxsave)
+		{
+			return SimdLevel::Scalar;
+		}
+		const unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		const bool avx2		= (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+		const bool avx512	= (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 31)) != 0 && (xcr0 & 0xE6) == 0xE6;
+		if (avx512 && avx2 && fma && f16c)
+		{
+			return SimdLevel::Avx512;
+		}
+		return avx2 && fma && f16c ? SimdLevel::Avx2 : SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+}
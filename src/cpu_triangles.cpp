@@ -0,0 +1,74 @@
+#include <cpu_triangles.h>
+
+namespace NRC
+{
+	uint32_t packTriangles(const float* positions, const uint32_t* indices, const uint32_t* prims, uint32_t count,
+						   std::vector<TriangleGroup>& groups)
+	{
+		const uint32_t first = uint32_t(groups.size());
+		for (uint32_t begin = 0; begin < count; begin += triangleGroupWidth)
+		{
+			TriangleGroup group{};
+			for (uint32_t lane = 0; lane < triangleGroupWidth; lane++)
+			{
+				if (begin + lane >= count)
+				{
+					group.primitive[lane] = ~0u;
+					continue;
+				}
+				const uint32_t	prim	= prims[begin + lane];
+				const vec3		v0		= loadVec3(positions, indices[3 * size_t(prim) + 0]);
+				const vec3		e1		= loadVec3(positions, indices[3 * size_t(prim) + 1]) - v0;
+				const vec3		e2		= loadVec3(positions, indices[3 * size_t(prim) + 2]) - v0;
+				group.v0x[lane] = v0.x;		group.v0y[lane] = v0.y;		group.v0z[lane] = v0.z;
+				group.e1x[lane] = e1.x;		group.e1y[lane] = e1.y;		group.e1z[lane] = e1.z;
+				group.e2x[lane] = e2.x;		group.e2y[lane] = e2.y;		group.e2z[lane] = e2.z;
+				group.primitive[lane] = prim;
+			}
+			groups.push_back(group);
+		}
+		return first;
+	}
+
+	static bool intersectTriangleGroupsScalar(const Ray& ray, const TriangleGroup* groups, uint32_t groupCount, Hit& hit)
+	{
+		bool found = false;
+		for (uint32_t g = 0; g < groupCount; g++)
+		{
+			found |= intersectTriangleGroupScalar(ray, groups[g], hit);
+		}
+		return found;
+	}
+
+	NRC_TARGET_AVX2 NRC_FLATTEN
+	static bool intersectTriangleGroupsAvx2(const Ray& ray, const TriangleGroup* groups, uint32_t groupCount, Hit& hit)
+	{
+		bool found = false;
+		for (uint32_t g = 0; g < groupCount; g++)
+		{
+			found |= intersectTriangleGroupAvx2(ray, groups[g], hit);
+		}
+		return found;
+	}
+
+	NRC_TARGET_AVX512 NRC_FLATTEN
+	static bool intersectTriangleGroupsAvx512(const Ray& ray, const TriangleGroup* groups, uint32_t groupCount, Hit& hit)
+	{
+		bool found = false;
+		for (uint32_t g = 0; g < groupCount; g++)
+		{
+			found |= intersectTriangleGroupAvx512(ray, groups[g], hit);
+		}
+		return found;
+	}
+
+	bool intersectTriangleGroups(const Ray& ray, const TriangleGroup* groups, uint32_t groupCount, Hit& hit, SimdLevel level)
+	{
+		switch (level)
+		{
+		case SimdLevel::Avx512:	return intersectTriangleGroupsAvx512(ray, groups, groupCount, hit);
+		case SimdLevel::Avx2:	return intersectTriangleGroupsAvx2(ray, groups, groupCount, hit);
+		default:				return intersectTriangleGroupsScalar(ray, groups, groupCount, hit);
+		}
+	}
+}
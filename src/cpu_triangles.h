@@ -0,0 +1,179 @@
+# pragma once
+
+#include <vector>
+#include <cpu_math.h>
+#include <cpu_simd.h>
+
+namespace NRC
+{
+	static const uint32_t triangleGroupWidth = 8;
+
+	// ----------------------------------------------------------------
+	// Eight triangles pre-packed for the leaves: vertex 0 and the two
+	// edges in SoA, so a leaf test reads whole registers instead of
+	// gathering three indices and nine positions per triangle.
+	// Padding lanes have zero edges (determinant 0) and never hit.
+	// ----------------------------------------------------------------
+	struct alignas(32) TriangleGroup
+	{
+		float		v0x[8], v0y[8], v0z[8];
+		float		e1x[8], e1y[8], e1z[8];
+		float		e2x[8], e2y[8], e2z[8];
+		uint32_t	primitive[8];			// triangle index of the mesh, ~0u for padding
+	};
+	static_assert(sizeof(TriangleGroup) == 320, "TriangleGroup is expected to be ten AVX registers");
+
+	// appends ceil(count / 8) groups for the triangles prims[0..count), returns the index of the first one
+	uint32_t packTriangles(const float* positions, const uint32_t* indices, const uint32_t* prims, uint32_t count,
+						   std::vector<TriangleGroup>& groups);
+
+	inline uint32_t triangleGroupCount(uint32_t triangleCount)
+	{
+		return (triangleCount + triangleGroupWidth - 1) / triangleGroupWidth;
+	}
+
+	// -------------------------------------------------------------------
+	// Closest hit against one group, same rules as intersectTriangleEdges.
+	// Inline so they fold into the flattened per-ISA traversal loops.
+	// -------------------------------------------------------------------
+	inline bool intersectTriangleGroupScalar(const Ray& ray, const TriangleGroup& group, Hit& hit)
+	{
+		bool found = false;
+		for (uint32_t lane = 0; lane < triangleGroupWidth; lane++)
+		{
+			found |= intersectTriangleEdges(ray,
+											vec3(group.v0x[lane], group.v0y[lane], group.v0z[lane]),
+											vec3(group.e1x[lane], group.e1y[lane], group.e1z[lane]),
+											vec3(group.e2x[lane], group.e2y[lane], group.e2z[lane]),
+											group.primitive[lane], hit);
+		}
+		return found;
+	}
+
+	// --------------------------------------------------------------------
+	// Eight-wide Moeller-Trumbore in the operation order of the scalar
+	// test and without fused multiply-adds, so every ISA computes the
+	// same bits and finds the same hits, also on the edges two triangles
+	// share. Returns the per-lane distances with non-hits at FLT_MAX.
+	// --------------------------------------------------------------------
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	__m256 dot8(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz)
+	{
+		return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+	}
+
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	__m256 crossComponent8(__m256 a1, __m256 b2, __m256 a2, __m256 b1)
+	{
+		return _mm256_sub_ps(_mm256_mul_ps(a1, b2), _mm256_mul_ps(a2, b1));
+	}
+
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	__m256 intersectTriangleGroup8(const Ray& ray, const TriangleGroup& group, float hitT, __m256& u, __m256& v)
+	{
+		const __m256 dx = _mm256_set1_ps(ray.direction.x);
+		const __m256 dy = _mm256_set1_ps(ray.direction.y);
+		const __m256 dz = _mm256_set1_ps(ray.direction.z);
+		const __m256 e1x = _mm256_load_ps(group.e1x), e1y = _mm256_load_ps(group.e1y), e1z = _mm256_load_ps(group.e1z);
+		const __m256 e2x = _mm256_load_ps(group.e2x), e2y = _mm256_load_ps(group.e2y), e2z = _mm256_load_ps(group.e2z);
+
+		// p = d x e2, det = e1 . p
+		const __m256 px		= crossComponent8(dy, e2z, dz, e2y);
+		const __m256 py		= crossComponent8(dz, e2x, dx, e2z);
+		const __m256 pz		= crossComponent8(dx, e2y, dy, e2x);
+		const __m256 det	= dot8(e1x, e1y, e1z, px, py, pz);
+		const __m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+		// s = o - v0, u = (s . p) / det
+		const __m256 sx = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(group.v0x));
+		const __m256 sy = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(group.v0y));
+		const __m256 sz = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(group.v0z));
+		u = _mm256_mul_ps(dot8(sx, sy, sz, px, py, pz), invDet);
+
+		// q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+		const __m256 qx = crossComponent8(sy, e1z, sz, e1y);
+		const __m256 qy = crossComponent8(sz, e1x, sx, e1z);
+		const __m256 qz = crossComponent8(sx, e1y, sy, e1x);
+		v = _mm256_mul_ps(dot8(dx, dy, dz, qx, qy, qz), invDet);
+		const __m256 t = _mm256_mul_ps(dot8(e2x, e2y, e2z, qx, qy, qz), invDet);
+
+		const __m256 zero	= _mm256_setzero_ps();
+		const __m256 one	= _mm256_set1_ps(1.0f);
+		const __m256 absDet = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+		__m256 valid = _mm256_cmp_ps(absDet, _mm256_set1_ps(1e-12f), _CMP_GE_OQ);
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(ray.tMin), _CMP_GE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(ray.tMax), _CMP_LE_OQ));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(hitT), _CMP_LE_OQ));
+		return _mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), t, valid);
+	}
+
+	// lane of the nearest distance, the smallest primitive among equal ones; false when it does not
+	// improve on hit (see intersectTriangleEdges)
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	bool nearestLane8(__m256 t, const TriangleGroup& group, const Hit& hit, uint32_t& lane, float& tNearest)
+	{
+		uint32_t candidates = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(t, _mm256_set1_ps(FLT_MAX), _CMP_LT_OQ)));
+		if (candidates == 0)
+		{
+			return false;
+		}
+		__m256 m = _mm256_min_ps(t, _mm256_permute_ps(t, _MM_SHUFFLE(2, 3, 0, 1)));
+		m = _mm256_min_ps(m, _mm256_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2)));
+		m = _mm256_min_ps(m, _mm256_permute2f128_ps(m, m, 0x01));
+		tNearest	= _mm256_cvtss_f32(m);
+		candidates	= uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(t, m, _CMP_EQ_OQ)));
+		lane		= bitScanForward(candidates);
+		for (candidates &= candidates - 1; candidates != 0; candidates &= candidates - 1)
+		{
+			const uint32_t other = bitScanForward(candidates);
+			lane = group.primitive[other] < group.primitive[lane] ? other : lane;
+		}
+		return tNearest < hit.t || group.primitive[lane] < hit.primitive;
+	}
+
+	NRC_TARGET_AVX2 NRC_SIMD_INLINE
+	bool intersectTriangleGroupAvx2(const Ray& ray, const TriangleGroup& group, Hit& hit)
+	{
+		__m256 u, v;
+		const __m256 t = intersectTriangleGroup8(ray, group, hit.t, u, v);
+		uint32_t	lane;
+		float		tNearest;
+		if (!nearestLane8(t, group, hit, lane, tNearest))
+		{
+			return false;
+		}
+		alignas(32) float us[8], vs[8];
+		_mm256_store_ps(us, u);
+		_mm256_store_ps(vs, v);
+		hit.t			= tNearest;
+		hit.u			= us[lane];
+		hit.v			= vs[lane];
+		hit.primitive	= group.primitive[lane];
+		return true;
+	}
+
+	// same arithmetic, the barycentrics are picked out with a permute instead of a store
+	NRC_TARGET_AVX512 NRC_SIMD_INLINE
+	bool intersectTriangleGroupAvx512(const Ray& ray, const TriangleGroup& group, Hit& hit)
+	{
+		__m256 u, v;
+		const __m256 t = intersectTriangleGroup8(ray, group, hit.t, u, v);
+		uint32_t	lane;
+		float		tNearest;
+		if (!nearestLane8(t, group, hit, lane, tNearest))
+		{
+			return false;
+		}
+		hit.t			= tNearest;
+		hit.u			= _mm256_cvtss_f32(_mm256_permutexvar_ps(_mm256_set1_epi32(int(lane)), u));
+		hit.v			= _mm256_cvtss_f32(_mm256_permutexvar_ps(_mm256_set1_epi32(int(lane)), v));
+		hit.primitive	= group.primitive[lane];
+		return true;
+	}
+
+	// closest hit against a run of groups, for benchmarking the kernels in isolation
+	bool intersectTriangleGroups(const Ray& ray, const TriangleGroup* groups, uint32_t groupCount, Hit& hit, SimdLevel level);
+}
@@ -3,9 +3,22 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <chrono>
 #include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <utility.h>
+#include <accelstruct.h>
+#include <cpu_renderer.h>
+#include <cpu_benchmark.h>
+#include <wavefront_renderer.h>
+#include <nrc_cache.h>
+#include <nrc_renderer.h>
+#include "shaders/common.h"
 
 //#include <nvh/fileoperations.hpp>           // For nvh::loadfiles
 //#include <nvvk/descriptorsets_vk.hpp>		// For nvvk::DescriptorSetContainer
@@ -15,15 +28,248 @@
 //#include <nvvk/resourceallocator_vk.hpp>	// For NVVK memory allocators
 //#include <nvvk/error_vk.hpp>                // For NVVK_CHECK
 
+static const char* outputImagePath = "../../outputs/pixelColor.hdr";
+
+enum class Backend
+{
+	Auto,		// Vulkan when a ray query device is available, CPU otherwise
+	Vulkan,
+	Cpu,
+};
+
+// path tracer of the Vulkan backend
+enum class VulkanRenderer
+{
+	Megakernel,			// raytracer.comp.glsl, one thread per pixel
+	Wavefront,			// wavefront_*.comp.glsl
+	WavefrontSorted,	// wavefront with the bounces binned before they are traced
+	WavefrontCompare,	// both wavefront variants, the sorted one writes the image
+	RadianceCache,		// nrc_path.comp.glsl and nrc_resolve.comp.glsl, paths end in the neural radiance cache
+};
+
+// render the scene with the CPU reference path tracer and write the image
+static int renderOnCpu(const std::vector<float>& vertices, const std::vector<uint32_t>& indices, const NRC::CpuRenderSettings& settings,
+					   const NRC::BvhBuildSettings& bvhSettings, const std::string& bvhCacheDirectory, bool quantizeBvh,
+					   NRC::BvhPlacement bvhPlacement)
+{
+	NRC::CpuRenderer renderer;
+	const auto initStart = std::chrono::high_resolution_clock::now();
+	renderer.init(vertices, indices, bvhSettings, bvhCacheDirectory, quantizeBvh);
+	const auto initEnd = std::chrono::high_resolution_clock::now();
+	printf("CPU backend: BVH %s in %.3f s\n", renderer.bvhFromCache() ? "mapped from cache" : "built",
+		   std::chrono::duration<double>(initEnd - initStart).count());
+	if (!renderer.placeBvh(bvhPlacement))
+	{
+		printf("CPU backend: BVH stays shared, %s placement needs several NUMA nodes\n", NRC::bvhPlacementName(bvhPlacement));
+	}
+
+	NRC::CpuImage imageData;
+	const NRC::CpuRenderStats stats = renderer.render(settings, imageData);
+	printf("CPU backend: %.3f s, %.2f Mrays/s (%s tiles: %llu chunks, %llu steals, imbalance %.2f)\n", stats.seconds,
+		   stats.raysPerSecond() * 1e-6, NRC::tileSchedulingName(settings.scheduling), static_cast<unsigned long long>(stats.tileChunks),
+		   static_cast<unsigned long long>(stats.tileSteals), stats.imbalance);
+	if (settings.radianceCache)
+	{
+		printf("CPU backend: radiance cache, %.2f rays per path, %llu queries, %llu training records, %u training steps, %.3f s in the cache\n",
+			   double(stats.raysTraced) / (double(settings.width) * settings.height * NUM_SAMPLES), static_cast<unsigned long long>(stats.cacheQueries),
+			   static_cast<unsigned long long>(stats.trainingRecords), stats.trainingSteps, stats.cacheSeconds);
+		if (!settings.nrcCheckpointDirectory.empty())
+		{
+			printf("CPU backend: radiance cache checkpoint %s, %s\n", NRC::nrcWarmStartName(stats.warmStart),
+				   stats.checkpointSaved ? "saved" : "could not be saved");
+		}
+	}
+	if (NRC::heapAllocationsCounted())
+	{
+		printf("CPU backend: %llu heap allocations on the workers after warm-up\n", static_cast<unsigned long long>(stats.steadyHeapAllocations));
+	}
+	const NRC::NumaTopology& topology = renderer.numaTopology();
+	for (uint32_t node = 0; node < topology.nodeCount(); node++)
+	{
+		printf("CPU backend: NUMA node %u (%zu CPUs): %.2f Mrays/s\n", topology.nodeIds[node], topology.nodeCpus[node].size(),
+			   stats.seconds > 0.0 ? double(stats.nodeRaysTraced[node]) / stats.seconds * 1e-6 : 0.0);
+	}
+
+	stbi_write_hdr(outputImagePath, int(settings.width), int(settings.height), 3, imageData.data());
+	return 0;
+}
+
 int main(int argc, const char** argv)
 {
 	// ---------
 	// Constants
 	// ---------
-	static const uint64_t img_width = 800;
-	static const uint64_t img_height = 600;
-	static const uint32_t workgroup_width = 16;
-	static const uint32_t workgroup_height = 8;
+	static const uint64_t img_width = RENDER_WIDTH;
+	static const uint64_t img_height = RENDER_HEIGHT;
+	static const uint32_t workgroup_width = WORKGROUP_WIDTH;
+	static const uint32_t workgroup_height = WORKGROUP_HEIGHT;
+
+	// --------------------
+	// Command line options
+	// --------------------
+	// --backend auto|vulkan|cpu   --threads N (CPU backend workers, 0 = all)   --packet N (CPU rays per packet, 0 = single rays)
+	// --scheduler static|counter|stealing: how the CPU backend spreads tiles over its workers (default stealing)
+	// --sort-rays: CPU backend bins every bounce by origin cell and direction octant, slower so far (--bench raysort)
+	// --bvh-cache DIR: CPU backend maps its BVH from DIR, building and storing it there on a miss
+	// --sbvh BUDGET: CPU backend BVH with spatial splits, up to BUDGET (e.g. 0.25) extra references per triangle
+	// --bvh-quantized: CPU backend traces BVH8 nodes with 8-bit child bounds
+	// --numa-bvh shared|replicate|interleave: CPU backend BVH placement over the NUMA nodes (default shared)
+	// --no-numa-pinning: CPU backend workers are not pinned to their NUMA node
+	// --bench <name> [--bench-triangles N] [--bench-scene FILE.obj]: run a CPU backend benchmark instead of rendering
+	// --wavefront unsorted|sorted|compare: Vulkan backend renders with the wavefront kernels
+	// --nrc-bench: fused neural radiance cache kernels on the Vulkan device instead of rendering
+	// --blas-bench [--bench-triangles N]: BLAS refit against rebuild for deforming meshes on the Vulkan device instead of rendering
+	// --blas-host: Vulkan backend builds the scene BLAS on host threads (accelerationStructureHostCommands) while it sets up
+	//   the pipeline, into host-visible memory; the default builds it device-local on the queue
+	// --nrc [--nrc-vertex N] [--nrc-suffix N] [--nrc-tile N] [--nrc-grid LEVELS] [--nrc-spread C]: either backend ends its paths in the
+	//   neural radiance cache at path vertex N (0 is the primary hit), training one path per N x N pixels on a suffix of N more vertices;
+	//   with C > 0 paths end earlier, where their area spread exceeds C times the primary hit's footprint
+	// --nrc-warmup N: with --nrc, a cold cache trains for N frames (default 16) on paths traced to the end before it answers any
+	// --nrc-checkpoint DIR: with --nrc, the cache starts from the checkpoint of the scene and network in DIR and writes its own back
+	// --nrc-half: with --nrc, cache queries read fp16 copies of the weights and grid (fp32 on devices without fp16 support;
+	//   the CPU backend rounds like the device, for the error, not for speed)
+	// --nrc-async: with --nrc, the Vulkan backend trains on the async compute queue alongside each frame, whose queries use the
+	//   weights of the step before (in sequence on devices without a second queue); the CPU backend keeps the order, not the overlap
+	// --nrc-regions N: with --nrc, the cache splits the scene bounds into N x N x N regions (up to 4) with a network and grid each;
+	//   not blended at the faces and no gain on the test scene (see NrcNetworkConfig::regionsPerAxis)
+	Backend backend = Backend::Auto;
+	VulkanRenderer vulkanRenderer = VulkanRenderer::Megakernel;
+	NRC::CpuRenderSettings cpuSettings;
+	NRC::BvhBuildSettings bvhSettings = NRC::Bvh8::buildSettings();
+	std::string benchmarkName;
+	std::string benchmarkScene;
+	std::string bvhCacheDirectory;
+	bool quantizeBvh = false;
+	NRC::BvhPlacement bvhPlacement = NRC::BvhPlacement::Shared;
+	uint32_t benchmarkTriangles = 1 << 20;
+	bool nrcBenchmark = false;
+	bool blasBenchmark = false;
+	bool blasOnHost = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			backend = strcmp(name, "cpu") == 0 ? Backend::Cpu : strcmp(name, "vulkan") == 0 ? Backend::Vulkan : Backend::Auto;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			cpuSettings.threadCount = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--packet") == 0 && i + 1 < argc)
+		{
+			cpuSettings.packetSize = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--scheduler") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			cpuSettings.scheduling = strcmp(name, "static") == 0 ? NRC::TileScheduling::Static
+								   : strcmp(name, "counter") == 0 ? NRC::TileScheduling::SharedCounter : NRC::TileScheduling::WorkStealing;
+		}
+		else if (strcmp(argv[i], "--sort-rays") == 0)
+		{
+			cpuSettings.sortSecondaryRays = true;
+		}
+		else if (strcmp(argv[i], "--bvh-cache") == 0 && i + 1 < argc)
+		{
+			bvhCacheDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--sbvh") == 0 && i + 1 < argc)
+		{
+			bvhSettings.spatialSplits	= true;
+			bvhSettings.splitBudget		= float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bvh-quantized") == 0)
+		{
+			quantizeBvh = true;
+		}
+		else if (strcmp(argv[i], "--numa-bvh") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			bvhPlacement = strcmp(name, "replicate") == 0 ? NRC::BvhPlacement::Replicate
+						 : strcmp(name, "interleave") == 0 ? NRC::BvhPlacement::Interleave : NRC::BvhPlacement::Shared;
+		}
+		else if (strcmp(argv[i], "--no-numa-pinning") == 0)
+		{
+			cpuSettings.numaPinning = false;
+		}
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+		{
+			benchmarkName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--bench-triangles") == 0 && i + 1 < argc)
+		{
+			benchmarkTriangles = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--bench-scene") == 0 && i + 1 < argc)
+		{
+			benchmarkScene = argv[++i];
+		}
+		else if (strcmp(argv[i], "--wavefront") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			vulkanRenderer = strcmp(name, "sorted") == 0 ? VulkanRenderer::WavefrontSorted
+						   : strcmp(name, "compare") == 0 ? VulkanRenderer::WavefrontCompare : VulkanRenderer::Wavefront;
+		}
+		else if (strcmp(argv[i], "--nrc-bench") == 0)
+		{
+			nrcBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--blas-host") == 0)
+		{
+			blasOnHost = true;
+		}
+		else if (strcmp(argv[i], "--blas-bench") == 0)
+		{
+			blasBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--nrc") == 0)
+		{
+			cpuSettings.radianceCache	= true;
+			vulkanRenderer				= VulkanRenderer::RadianceCache;
+		}
+		else if (strcmp(argv[i], "--nrc-vertex") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.cacheVertex = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-suffix") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.suffixVertices = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-tile") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.trainingTile = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-grid") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.cache.network.gridLevels = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-spread") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.spreadThreshold = float(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-warmup") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.warmupFrames = uint32_t(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--nrc-checkpoint") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrcCheckpointDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--nrc-half") == 0)
+		{
+			cpuSettings.nrc.cache.halfPrecision = true;
+		}
+		else if (strcmp(argv[i], "--nrc-async") == 0)
+		{
+			cpuSettings.nrc.cache.asyncTraining = true;
+		}
+		else if (strcmp(argv[i], "--nrc-regions") == 0 && i + 1 < argc)
+		{
+			cpuSettings.nrc.cache.network.regionsPerAxis = uint32_t(atoi(argv[++i]));
+		}
+	}
+
 	// possible paths of shader and other files
 	const std::string exePath(argv[0], std::string(argv[0]).find_last_of("/\\") + 1);
 	std::vector<std::string> searchPaths = {exePath + PROJECT_RELDIRECTORY,
@@ -48,6 +294,48 @@ int main(int argc, const char** argv)
 		cornellBox_indices.push_back(index.vertex_index);
 	}
 
+	if (!benchmarkName.empty())
+	{
+		// another .obj in place of the Cornell box, all of its shapes merged
+		std::vector<float>		benchmarkVertices	= cornellBox_vertices;
+		std::vector<uint32_t>	benchmarkIndices	= cornellBox_indices;
+		if (!benchmarkScene.empty())
+		{
+			tinyobj::ObjReader sceneReader;
+			if (!sceneReader.ParseFromFile(benchmarkScene))
+			{
+				fprintf(stderr, "Could not load '%s': %s\n", benchmarkScene.c_str(), sceneReader.Error().c_str());
+				return EXIT_FAILURE;
+			}
+			benchmarkVertices = sceneReader.GetAttrib().GetVertices();
+			benchmarkIndices.clear();
+			for (const tinyobj::shape_t& shape : sceneReader.GetShapes())
+			{
+				for (const tinyobj::index_t& index : shape.mesh.indices)
+				{
+					benchmarkIndices.push_back(index.vertex_index);
+				}
+			}
+		}
+		const NRC::BenchmarkResult result = NRC::runBenchmark(benchmarkName, benchmarkVertices, benchmarkIndices, benchmarkTriangles);
+		if (result == NRC::BenchmarkResult::Unknown)
+		{
+			fprintf(stderr, "Unknown benchmark '%s'.\n", benchmarkName.c_str());
+			return EXIT_FAILURE;
+		}
+		if (result == NRC::BenchmarkResult::Failed)
+		{
+			fprintf(stderr, "Benchmark '%s' failed its checks.\n", benchmarkName.c_str());
+			return EXIT_FAILURE;
+		}
+		return 0;
+	}
+
+	if (backend == Backend::Cpu && !nrcBenchmark && !blasBenchmark)
+	{
+		return renderOnCpu(cornellBox_vertices, cornellBox_indices, cpuSettings, bvhSettings, bvhCacheDirectory, quantizeBvh, bvhPlacement);
+	}
+
 
 	// ---------------------
 	// Create Vulkan context
@@ -82,8 +370,21 @@ int main(int argc, const char** argv)
 	// Initialize Vulkan context
 	// -------------------------
 	nvvk::Context context;               // Encapsulates device state in a single object
-	context.init(ctxInfo);
-	assert(asFeature.accelerationStructure == VK_TRUE && rqFeature.rayQuery == VK_TRUE); // Device must support acceleration structures and ray queries.
+	const bool contextReady = context.init(ctxInfo);
+	if (!contextReady || asFeature.accelerationStructure != VK_TRUE || rqFeature.rayQuery != VK_TRUE) // Device must support acceleration structures and ray queries.
+	{
+		if (backend == Backend::Vulkan || nrcBenchmark || blasBenchmark)
+		{
+			fprintf(stderr, "No Vulkan device with acceleration structure and ray query support.\n");
+			return EXIT_FAILURE;
+		}
+		// headless or GPU-less host: fall back to the CPU backend
+		if (contextReady)
+		{
+			context.deinit();
+		}
+		return renderOnCpu(cornellBox_vertices, cornellBox_indices, cpuSettings, bvhSettings, bvhCacheDirectory, quantizeBvh, bvhPlacement);
+	}
 
 
 	// ------------------------
@@ -101,6 +402,33 @@ int main(int argc, const char** argv)
 	VkCommandPool cmdPool;
 	NVVK_CHECK(vkCreateCommandPool(context.m_device, &cmdPoolCreateInfo, nullptr, &cmdPool));   // nullptr means using default Vulkan memory allocator.
 
+	if (nrcBenchmark)
+	{
+		NRC::benchmarkNrcInference(context, cmdPool, searchPaths);
+		NRC::benchmarkNrcTraining(context, cmdPool, searchPaths);
+		vkDestroyCommandPool(context.m_device, cmdPool, nullptr);
+		allocator.deinit();
+		context.deinit();
+		return 0;
+	}
+
+	if (blasBenchmark)
+	{
+		// the Cornell box, then a generated mesh large enough for the update cost to show
+		std::vector<float>		meshPositions;
+		std::vector<uint32_t>	meshIndices;
+		NRC::makeBenchmarkMesh(benchmarkTriangles, meshPositions, meshIndices);
+		NRC::AccelStructBuilder benchmarkBuilder;
+		benchmarkBuilder.init(context, asFeature);
+		NRC::benchmarkBlasRefit(context, cmdPool, benchmarkBuilder, cornellBox_vertices, cornellBox_indices);
+		NRC::benchmarkBlasRefit(context, cmdPool, benchmarkBuilder, meshPositions, meshIndices);
+		benchmarkBuilder.deinit();
+		vkDestroyCommandPool(context.m_device, cmdPool, nullptr);
+		allocator.deinit();
+		context.deinit();
+		return 0;
+	}
+
 
 	// ----------------
 	// Create Resources
@@ -144,7 +472,7 @@ int main(int argc, const char** argv)
 					  &tempStagingBufferMemory2vertex, stagingMemPropFlags);
 	void* vertexData;
 	vkMapMemory(context.m_device, tempStagingBufferMemory2vertex, 0, vertexBufferSizeBytes, 0, &vertexData);
-	memcpy(vertexData, &cornellBox_vertices, (size_t)vertexBufferSizeBytes);
+	memcpy(vertexData, cornellBox_vertices.data(), (size_t)vertexBufferSizeBytes);
 	vkUnmapMemory(context.m_device, tempStagingBufferMemory2vertex);
 	NRC::createBuffer(context, storage2LocalCmdBuffer,
 					  vertexBufferSizeBytes,
@@ -159,7 +487,7 @@ int main(int argc, const char** argv)
 					  &tempStagingBufferMemory2index, stagingMemPropFlags);
 	void* indexData;
 	vkMapMemory(context.m_device, tempStagingBufferMemory2index, 0, indexBufferSizeBytes, 0, &indexData);
-	memcpy(indexData, &cornellBox_indices, (size_t)indexBufferSizeBytes);
+	memcpy(indexData, cornellBox_indices.data(), (size_t)indexBufferSizeBytes);
 	vkUnmapMemory(context.m_device, tempStagingBufferMemory2index);
 	NRC::createBuffer(context, storage2LocalCmdBuffer, 
 					  indexBufferSizeBytes,
@@ -182,6 +510,38 @@ int main(int argc, const char** argv)
 	allocator.finalizeAndReleaseStaging();*/
 
 
+	// -------------------------------
+	// Build acceleration structures
+	// -------------------------------
+	// all BLAS builds share one recycled scratch arena and are issued in batches; the scene does not deform, so its
+	// BLAS is built without ALLOW_UPDATE, which would cost trace speed and memory (--blas-bench refits deforming ones)
+	NRC::AccelStructBuilder asBuilder;
+	asBuilder.init(context, asFeature);
+	std::vector<NRC::AccelStruct> blases;
+	std::future<std::vector<NRC::AccelStruct>> pendingBlases;
+	if (blasOnHost && !asBuilder.supportsHostBuilds())
+	{
+		printf("The device lacks accelerationStructureHostCommands, the BLAS is built on the device\n");
+	}
+	if (blasOnHost && asBuilder.supportsHostBuilds())
+	{
+		// build on CPU worker threads through deferred host operations while the pipeline is set up below;
+		// the BLAS ends up in host-visible memory, so this only pays off when the build is long
+		std::vector<NRC::BlasInput> hostBlasInputs;
+		hostBlasInputs.push_back(NRC::makeTriangleBlasInput(cornellBox_vertices.data(), uint32_t(cornellBox_vertices.size() / 3),
+															cornellBox_indices.data(), uint32_t(cornellBox_indices.size())));
+		pendingBlases = asBuilder.buildBlasOnHostAsync(hostBlasInputs);
+	}
+	else
+	{
+		// device-local, built on the queue
+		std::vector<NRC::BlasInput> blasInputs;
+		blasInputs.push_back(NRC::makeTriangleBlasInput(context.m_device,
+														vertexBuffer, uint32_t(cornellBox_vertices.size() / 3),
+														indexBuffer, uint32_t(cornellBox_indices.size())));
+		blases = asBuilder.buildBlas(cmdPool, blasInputs);
+	}
+
 	// --------------------
 	// Create Shader Module
 	// --------------------
@@ -191,16 +551,20 @@ int main(int argc, const char** argv)
 	// -----------------------------------------
 	// Create Descriptor Set bindings and layout
 	// -----------------------------------------
-	VkDescriptorSetLayoutBinding storageBufferBinding0{};
-	storageBufferBinding0.binding			= 0;
-	storageBufferBinding0.descriptorCount	= 1;
-	storageBufferBinding0.descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	storageBufferBinding0.stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
-	
+	// image, TLAS, vertices and indices (see shaders/common.h)
+	std::array<VkDescriptorSetLayoutBinding, 4> descriptorSetBindings{};
+	for (uint32_t i = 0; i < uint32_t(descriptorSetBindings.size()); i++)
+	{
+		descriptorSetBindings[i].binding			= i;
+		descriptorSetBindings[i].descriptorCount	= 1;
+		descriptorSetBindings[i].descriptorType		= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorSetBindings[i].stageFlags			= VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	descriptorSetBindings[BINDING_TLAS].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
 
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreatInfo = nvvk::make<VkDescriptorSetLayoutCreateInfo>();
-	descriptorSetLayoutCreatInfo.bindingCount	= 1;
-	descriptorSetLayoutCreatInfo.pBindings		= &storageBufferBinding0;
+	descriptorSetLayoutCreatInfo.bindingCount	= uint32_t(descriptorSetBindings.size());
+	descriptorSetLayoutCreatInfo.pBindings		= descriptorSetBindings.data();
 	VkDescriptorSetLayout descriptorSetLayout;
 	NVVK_CHECK(vkCreateDescriptorSetLayout(context.m_device, &descriptorSetLayoutCreatInfo, nullptr, &descriptorSetLayout));
 
@@ -208,14 +572,16 @@ int main(int argc, const char** argv)
 	// ----------------------------------------
 	// Create Descriptor Pool and allocate Sets
 	// ----------------------------------------
-	VkDescriptorPoolSize descriptorPoolSize = nvvk::make<VkDescriptorPoolSize>();
-	descriptorPoolSize.descriptorCount	= 1;
-	descriptorPoolSize.type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	std::array<VkDescriptorPoolSize, 2> descriptorPoolSizes{};
+	descriptorPoolSizes[0].descriptorCount	= 3;
+	descriptorPoolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorPoolSizes[1].descriptorCount	= 1;
+	descriptorPoolSizes[1].type				= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
 	descriptorPoolCreateInfo.maxSets		= 1;
-	descriptorPoolCreateInfo.poolSizeCount	= 1;
-	descriptorPoolCreateInfo.pPoolSizes		= &descriptorPoolSize;
+	descriptorPoolCreateInfo.poolSizeCount	= uint32_t(descriptorPoolSizes.size());
+	descriptorPoolCreateInfo.pPoolSizes		= descriptorPoolSizes.data();
 	VkDescriptorPool descriptorPool;
 	NVVK_CHECK(vkCreateDescriptorPool(context.m_device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
 
@@ -228,24 +594,6 @@ int main(int argc, const char** argv)
 	NVVK_CHECK(vkAllocateDescriptorSets(context.m_device, &descriptorSetAllocateInfo, descriptorsets.data()));
 
 
-	// --------------------------------
-	// Write and update descriptor sets
-	// --------------------------------
-	VkDescriptorBufferInfo descriptorBufferInfo{};
-	descriptorBufferInfo.buffer		= stgBuffer.buffer;
-	descriptorBufferInfo.offset		= 0;
-	descriptorBufferInfo.range		= bufferSizeBytes;
-
-	VkWriteDescriptorSet writeDescriptorSet = nvvk::make<VkWriteDescriptorSet>();
-	writeDescriptorSet.descriptorCount	= 1;
-	writeDescriptorSet.descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	writeDescriptorSet.dstArrayElement	= 0;
-	writeDescriptorSet.dstBinding		= 0;
-	writeDescriptorSet.dstSet			= descriptorsets[0];
-	writeDescriptorSet.pBufferInfo		= &descriptorBufferInfo;
-	vkUpdateDescriptorSets(context.m_device, 1, &writeDescriptorSet, 0, nullptr);
-
-
 	// ---------------
 	// Create Pipeline
 	// ---------------
@@ -271,35 +619,171 @@ int main(int argc, const char** argv)
 	NVVK_CHECK(vkCreateComputePipelines(context.m_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, VK_NULL_HANDLE, &computePipeline));
 
 
-	// -----------------------
-	// Record Dispatch Command
-	// -----------------------
-	VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(context.m_device, cmdPool);
-
-	// bind compute pipeline
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
-							descriptorsets.data(), 0, nullptr);
-	// use compute shader
-	vkCmdDispatch(cmdBuffer, (uint32_t(img_width) + workgroup_width - 1) / workgroup_width,
-							 (uint32_t(img_height) + workgroup_height - 1) / workgroup_height, 
-							 1);
-
-	// add barrier
-	// -------
-	auto mBarrier = nvvk::make<VkMemoryBarrier>();
-	mBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-	mBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-	vkCmdPipelineBarrier(cmdBuffer,
-		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,	// src stage: wait for compute shader stage to finish
-		VK_PIPELINE_STAGE_HOST_BIT,				// dst stage: make cache available and visible for CPU
-		0,										// dependency flags
-		1, &mBarrier,							// memory barrier
-		0, nullptr,								// buffer memory barrier
-		0, nullptr);							// image memory barrier
-
-	// end record and submit
-	NRC::endSubmitSingleTimeCommandRecord(context.m_device, context.m_queueGCT, cmdPool, cmdBuffer);
+	// ---------------------------------------
+	// Finish the BLAS and build the TLAS on it
+	// ---------------------------------------
+	if (pendingBlases.valid())
+	{
+		const auto waitStart = std::chrono::high_resolution_clock::now();
+		blases = pendingBlases.get();
+		const auto waitEnd = std::chrono::high_resolution_clock::now();
+		printf("BLAS built on the host, %.3f ms left to wait after the pipeline setup\n",
+			   1e3 * std::chrono::duration<double>(waitEnd - waitStart).count());
+	}
+
+	// one instance of the scene with identity transform
+	VkAccelerationStructureInstanceKHR cornellBoxInstance{};
+	cornellBoxInstance.transform.matrix[0][0] = 1.0f;
+	cornellBoxInstance.transform.matrix[1][1] = 1.0f;
+	cornellBoxInstance.transform.matrix[2][2] = 1.0f;
+	cornellBoxInstance.instanceCustomIndex		= 0;
+	cornellBoxInstance.mask						= 0xFF;
+	cornellBoxInstance.instanceShaderBindingTableRecordOffset = 0;
+	cornellBoxInstance.flags					= VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+	cornellBoxInstance.accelerationStructureReference = blases[0].address;
+	// allow updates so that moved instances only cost a TLAS refit (AccelStructBuilder::updateTlas)
+	NRC::AccelStruct tlas = asBuilder.buildTlas(cmdPool, { cornellBoxInstance },
+												VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+
+	// --------------------------------
+	// Write and update descriptor sets
+	// --------------------------------
+	std::array<VkDescriptorBufferInfo, 4> descriptorBufferInfos{};
+	descriptorBufferInfos[BINDING_IMAGEDATA]	= { stgBuffer.buffer, 0, bufferSizeBytes };
+	descriptorBufferInfos[BINDING_VERTICES]		= { vertexBuffer, 0, vertexBufferSizeBytes };
+	descriptorBufferInfos[BINDING_INDICES]		= { indexBuffer, 0, indexBufferSizeBytes };
+
+	auto descriptorAS = nvvk::make<VkWriteDescriptorSetAccelerationStructureKHR>();
+	descriptorAS.accelerationStructureCount = 1;
+	descriptorAS.pAccelerationStructures	= &tlas.handle;
+
+	std::array<VkWriteDescriptorSet, 4> writeDescriptorSets;
+	for (uint32_t i = 0; i < uint32_t(writeDescriptorSets.size()); i++)
+	{
+		writeDescriptorSets[i] = nvvk::make<VkWriteDescriptorSet>();
+		writeDescriptorSets[i].descriptorCount	= 1;
+		writeDescriptorSets[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writeDescriptorSets[i].dstArrayElement	= 0;
+		writeDescriptorSets[i].dstBinding		= i;
+		writeDescriptorSets[i].dstSet			= descriptorsets[0];
+		writeDescriptorSets[i].pBufferInfo		= &descriptorBufferInfos[i];
+	}
+	writeDescriptorSets[BINDING_TLAS].descriptorType	= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+	writeDescriptorSets[BINDING_TLAS].pBufferInfo		= nullptr;
+	writeDescriptorSets[BINDING_TLAS].pNext				= &descriptorAS;
+	vkUpdateDescriptorSets(context.m_device, uint32_t(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+
+	// ------------------------------------------
+	// Wavefront and radiance cache path tracers
+	// ------------------------------------------
+	float sceneMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float sceneMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < cornellBox_vertices.size(); v++)
+	{
+		sceneMin[v % 3] = std::min(sceneMin[v % 3], cornellBox_vertices[v]);
+		sceneMax[v % 3] = std::max(sceneMax[v % 3], cornellBox_vertices[v]);
+	}
+	NRC::WavefrontRenderer wavefrontRenderer;
+	NRC::NrcRenderer nrcRenderer;
+	if (vulkanRenderer == VulkanRenderer::RadianceCache)
+	{
+		nrcRenderer.init(context, searchPaths, tlas.handle, stgBuffer.buffer, bufferSizeBytes, vertexBuffer, vertexBufferSizeBytes,
+						 indexBuffer, indexBufferSizeBytes, sceneMin, sceneMax, cpuSettings.nrc);
+		// a cache that cannot answer or learn would only darken the image
+		if (!nrcRenderer.pathSupported() || !nrcRenderer.cache().querySupported() || !nrcRenderer.cache().trainingSupported())
+		{
+			printf("Radiance cache: the device lacks clustered or arithmetic subgroup operations or has too little compute shared "
+				   "memory (%u bytes), rendering without the cache\n", nrcRenderer.cache().sharedMemorySize());
+			nrcRenderer.deinit();
+			vulkanRenderer = VulkanRenderer::Megakernel;
+		}
+	}
+	if (vulkanRenderer == VulkanRenderer::RadianceCache)
+	{
+		if (cpuSettings.nrc.cache.halfPrecision && !nrcRenderer.cache().halfPrecision())
+		{
+			printf("Radiance cache: the device lacks shaderFloat16 or storageBuffer16BitAccess, queries stay in fp32\n");
+		}
+		if (cpuSettings.nrc.cache.asyncTraining && !nrcRenderer.cache().asyncTraining())
+		{
+			printf("Radiance cache: no compute queue besides the graphics one, no timeline semaphores or no training, training stays in the frame\n");
+		}
+		const std::string&	checkpointDirectory = cpuSettings.nrcCheckpointDirectory;
+		const uint64_t		sceneHash			= NRC::hashNrcScene(cornellBox_vertices.data(), cornellBox_vertices.size(),
+																	cornellBox_indices.data(), cornellBox_indices.size());
+		if (!checkpointDirectory.empty())
+		{
+			const NRC::NrcWarmStart warmStart = nrcRenderer.loadCheckpoint(cmdPool, checkpointDirectory, sceneHash, cpuSettings.nrcCheckpointPolicy);
+			printf("Radiance cache: checkpoint %s\n", NRC::nrcWarmStartName(warmStart));
+		}
+		const NRC::NrcRenderStats stats = nrcRenderer.render(cmdPool);
+		if (!checkpointDirectory.empty() && !nrcRenderer.saveCheckpoint(cmdPool, checkpointDirectory, sceneHash))
+		{
+			printf("Radiance cache: checkpoint could not be saved to %s\n", checkpointDirectory.c_str());
+		}
+		printf("Radiance cache: %.3f s, %.2f Mrays/s, %.2f rays per path, %llu training records, %u training steps\n", stats.seconds,
+			   stats.raysPerSecond() * 1e-6, double(stats.raysTraced) / (double(RENDER_WIDTH) * RENDER_HEIGHT * NUM_SAMPLES),
+			   static_cast<unsigned long long>(stats.trainingRecords), stats.trainingSteps);
+	}
+	else if (vulkanRenderer != VulkanRenderer::Megakernel)
+	{
+		wavefrontRenderer.init(context, searchPaths, tlas.handle, stgBuffer.buffer, bufferSizeBytes,
+							   vertexBuffer, vertexBufferSizeBytes, indexBuffer, indexBufferSizeBytes, sceneMin, sceneMax);
+
+		double unsortedRate = 0.0;
+		if (vulkanRenderer != VulkanRenderer::WavefrontSorted)
+		{
+			NRC::WavefrontRenderSettings settings;
+			const NRC::WavefrontRenderStats stats = wavefrontRenderer.render(cmdPool, settings);
+			unsortedRate = stats.raysPerSecond();
+			printf("Wavefront, unsorted: %.3f s, %.2f Mrays/s\n", stats.seconds, unsortedRate * 1e-6);
+		}
+		if (vulkanRenderer != VulkanRenderer::Wavefront)
+		{
+			NRC::WavefrontRenderSettings settings;
+			settings.sortRays = true;
+			const NRC::WavefrontRenderStats stats = wavefrontRenderer.render(cmdPool, settings);
+			printf("Wavefront, sorted:   %.3f s, %.2f Mrays/s\n", stats.seconds, stats.raysPerSecond() * 1e-6);
+			if (unsortedRate > 0.0)
+			{
+				printf("Sorting gain: %.2fx\n", stats.raysPerSecond() / unsortedRate);
+			}
+		}
+	}
+	else
+	{
+		// -----------------------
+		// Record Dispatch Command
+		// -----------------------
+		VkCommandBuffer cmdBuffer = NRC::beginSingleTimeCommandRecord(context.m_device, cmdPool);
+
+		// bind compute pipeline
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+								descriptorsets.data(), 0, nullptr);
+		// use compute shader
+		vkCmdDispatch(cmdBuffer, (uint32_t(img_width) + workgroup_width - 1) / workgroup_width,
+								 (uint32_t(img_height) + workgroup_height - 1) / workgroup_height, 
+								 1);
+
+		// add barrier
+		// -------
+		auto mBarrier = nvvk::make<VkMemoryBarrier>();
+		mBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		mBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,	// src stage: wait for compute shader stage to finish
+			VK_PIPELINE_STAGE_HOST_BIT,				// dst stage: make cache available and visible for CPU
+			0,										// dependency flags
+			1, &mBarrier,							// memory barrier
+			0, nullptr,								// buffer memory barrier
+			0, nullptr);							// image memory barrier
+
+		// end record and submit
+		NRC::endSubmitSingleTimeCommandRecord(context.m_device, context.m_queueGCT, cmdPool, cmdBuffer);
+	}
 
 
 	// -----------------------------
@@ -308,7 +792,7 @@ int main(int argc, const char** argv)
 	void* data = allocator.map(stgBuffer);
 	// float* fData = reinterpret_cast<float*>(data);
 	// printf("First three element in GPU buffer: %f, %f, %f\n", fData[0], fData[1], fData[2]);
-	stbi_write_hdr("../../outputs/pixelColor.hdr", img_width, img_height, 3, reinterpret_cast<float*>(data));
+	stbi_write_hdr(outputImagePath, img_width, img_height, 3, reinterpret_cast<float*>(data));
 	allocator.unmap(stgBuffer);
 
 
@@ -316,6 +800,14 @@ int main(int argc, const char** argv)
 	// Clean up
 	// --------
 	descriptorsets.clear();
+	wavefrontRenderer.deinit();
+	nrcRenderer.deinit();
+	NRC::destroyAccelStruct(context.m_device, tlas);
+	for (NRC::AccelStruct& blas : blases)
+	{
+		NRC::destroyAccelStruct(context.m_device, blas);
+	}
+	asBuilder.deinit();
 	vkDestroyBuffer(context.m_device, vertexBuffer, nullptr);
 	vkDestroyBuffer(context.m_device, indexBuffer, nullptr);
 	vkFreeMemory(context.m_device, vertexBufferMemory, nullptr);
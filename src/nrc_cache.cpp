@@ -0,0 +1,879 @@
+#include <nrc_cache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace NRC
+{
+	static const char* kernelFiles[] = {
+		"shaders/nrc_query.comp.glsl.spv",
+		"shaders/nrc_train.comp.glsl.spv",
+		"shaders/nrc_adam.comp.glsl.spv",
+		"shaders/nrc_query_half.comp.glsl.spv",
+		"shaders/nrc_bin.comp.glsl.spv",
+	};
+
+	// make the writes of one dispatch (or transfer) visible to the next dispatch
+	static void computeBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	static void shaderToShaderBarrier(VkCommandBuffer cmdBuffer)
+	{
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	// the fill of the gradient slices must not overtake the previous step still reading them
+	static void shaderToTransferBarrier(VkCommandBuffer cmdBuffer)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	static void shaderToHostBarrier(VkCommandBuffer cmdBuffer)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+
+	// -------------------
+	// NeuralRadianceCache
+	// -------------------
+	void NeuralRadianceCache::init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, const NrcSettings& settings,
+								   uint32_t maxQueries, uint32_t maxTrainingRecords, const float sceneMin[3], const float sceneMax[3])
+	{
+		m_context				= &context;
+		m_settings				= settings;
+		m_settings.network		= validNrcConfig(settings.network);
+		m_maxQueries			= maxQueries;
+		m_maxTrainingRecords	= maxTrainingRecords;
+		for (int a = 0; a < 3; a++)
+		{
+			const float extent = sceneMax[a] - sceneMin[a];
+			m_sceneMin[a]	= sceneMin[a];
+			m_sceneScale[a]	= extent > 0.0f ? 1.0f / extent : 0.0f;
+		}
+
+		// the gradient of a batch is summed over the lanes of clusters of NRC_TRAIN_SLICES
+		auto subgroupProperties = nvvk::make<VkPhysicalDeviceSubgroupProperties>();
+		auto properties			= nvvk::make<VkPhysicalDeviceProperties2>();
+		properties.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(context.m_physicalDevice, &properties);
+		m_sharedMemorySize	= properties.properties.limits.maxComputeSharedMemorySize;
+		m_trainingSupported = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0
+						   && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_CLUSTERED_BIT) != 0
+						   && subgroupProperties.subgroupSize >= NRC_TRAIN_SLICES
+						   && m_sharedMemorySize >= NRC_TRAIN_SHARED_BYTES;
+
+		// fp16 shared memory and arithmetic, fp16 loads from storage buffers and, for async training, timeline semaphores;
+		// nvvk::Context enables every core feature the device has, so supported is enabled
+		auto float16Features	= nvvk::make<VkPhysicalDeviceShaderFloat16Int8Features>();
+		auto storage16Features	= nvvk::make<VkPhysicalDevice16BitStorageFeatures>();
+		auto timelineFeatures	= nvvk::make<VkPhysicalDeviceTimelineSemaphoreFeatures>();
+		auto features			= nvvk::make<VkPhysicalDeviceFeatures2>();
+		features.pNext			= &float16Features;
+		float16Features.pNext	= &storage16Features;
+		storage16Features.pNext	= &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(context.m_physicalDevice, &features);
+		m_halfPrecision = settings.halfPrecision && float16Features.shaderFloat16 && storage16Features.storageBuffer16BitAccess;
+		// 16 KiB are guaranteed, the fp32 query kernel needs 32
+		m_querySupported = m_sharedMemorySize >= (m_halfPrecision ? NRC_QUERY_HALF_SHARED_BYTES : NRC_QUERY_SHARED_BYTES);
+
+		// a compute queue besides the one that renders, and timeline semaphores to hand the steps between them
+		m_asyncTraining = settings.asyncTraining && m_trainingSupported && timelineFeatures.timelineSemaphore
+					   && context.m_queueC.queue != VK_NULL_HANDLE && context.m_queueC.queue != context.m_queueGCT.queue;
+
+		createBuffers();
+		createPipelines(searchPaths);
+		if (m_asyncTraining)
+		{
+			auto cmdPoolCreateInfo = nvvk::make<VkCommandPoolCreateInfo>();
+			cmdPoolCreateInfo.queueFamilyIndex = context.m_queueC;
+			NVVK_CHECK(vkCreateCommandPool(context.m_device, &cmdPoolCreateInfo, nullptr, &m_computeCmdPool));
+			m_trainingSemaphore	= createTimelineSemaphore(context.m_device);
+			m_trainingValue		= 0;
+		}
+	}
+
+	void NeuralRadianceCache::createBuffers()
+	{
+		const VkDevice device = m_context->m_device;
+
+		// ----------------
+		// Create Resources
+		// ----------------
+		m_bufferSizes[BINDING_NRC_WEIGHTS]	= VkDeviceSize(config().regionCount()) * NRC_GRADIENT_STRIDE * sizeof(float);
+		m_bufferSizes[BINDING_NRC_QUERIES]	= VkDeviceSize(m_maxQueries) * NRC_QUERY_SIZE;
+		m_bufferSizes[BINDING_NRC_RESULTS]	= VkDeviceSize(m_maxQueries) * NRC_OUTPUT_WIDTH * sizeof(float);
+		m_bufferSizes[BINDING_NRC_TRAINING]	= VkDeviceSize(std::max(m_maxTrainingRecords, 1u)) * NRC_TRAINING_RECORD_SIZE;
+		m_bufferSizes[BINDING_NRC_GRADIENTS]	= VkDeviceSize(NRC_TRAIN_GROUPS) * NRC_GRADIENT_STRIDE * sizeof(float);
+		m_bufferSizes[BINDING_NRC_ADAM]		= 2 * m_bufferSizes[BINDING_NRC_WEIGHTS];
+		// never empty, even without a grid
+		const VkDeviceSize gridBytes = VkDeviceSize(std::max(config().gridParameterCount(), size_t(4))) * sizeof(float);
+		m_bufferSizes[BINDING_NRC_GRID]				= gridBytes;
+		m_bufferSizes[BINDING_NRC_GRID_GRADIENTS]	= gridBytes;
+		m_bufferSizes[BINDING_NRC_GRID_ADAM]		= 2 * gridBytes;
+		// written in pairs of halves; a placeholder in fp32
+		m_bufferSizes[BINDING_NRC_WEIGHTS_HALF]		= m_halfPrecision ? m_bufferSizes[BINDING_NRC_WEIGHTS] / 2 : 4;
+		m_bufferSizes[BINDING_NRC_GRID_HALF]		= m_halfPrecision ? (gridBytes / 2 + 3) & ~VkDeviceSize(3) : 4;
+		// the sort by region; a region's queries may end in a partial batch
+		m_bufferSizes[BINDING_NRC_QUERY_REGIONS]	= sizeof(NrcRegionTable);
+		m_bufferSizes[BINDING_NRC_QUERY_ORDER]		= (VkDeviceSize(m_maxQueries) + NRC_MAX_REGIONS * NRC_QUERY_BATCH) * sizeof(uint32_t);
+		m_bufferSizes[BINDING_NRC_RECORD_REGIONS]	= sizeof(NrcRegionTable);
+		m_bufferSizes[BINDING_NRC_RECORD_ORDER]		= VkDeviceSize(std::max(m_maxTrainingRecords, 1u)) * sizeof(uint32_t);
+		// with async training both queues use the parameters, snapshots and record copies; shared if their families differ
+		std::vector<uint32_t> queueFamilies;
+		if (m_asyncTraining && m_context->m_queueC.familyIndex != m_context->m_queueGCT.familyIndex)
+		{
+			queueFamilies = { m_context->m_queueGCT.familyIndex, m_context->m_queueC.familyIndex };
+		}
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < NRC_BINDING_COUNT; i++)
+		{
+			const bool hostVisible = i == BINDING_NRC_QUERIES || i == BINDING_NRC_RESULTS || i == BINDING_NRC_TRAINING;
+			createBuffer(*m_context, unusedCmdBuffer, m_bufferSizes[i], &m_buffers[i], usage, &m_memories[i],
+						 hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+									 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+		}
+		if (m_asyncTraining)
+		{
+			// the parameters the query kernel of the cache's precision reads
+			m_snapshotBindings = m_halfPrecision ? std::array<uint32_t, 2>{ BINDING_NRC_WEIGHTS_HALF, BINDING_NRC_GRID_HALF }
+												 : std::array<uint32_t, 2>{ BINDING_NRC_WEIGHTS, BINDING_NRC_GRID };
+			for (uint32_t slot = 0; slot < 2; slot++)
+			{
+				for (uint32_t b = 0; b < 2; b++)
+				{
+					createBuffer(*m_context, unusedCmdBuffer, m_bufferSizes[m_snapshotBindings[b]], &m_snapshotBuffers[slot][b], usage,
+								 &m_snapshotMemories[slot][b], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+				}
+				createBuffer(*m_context, unusedCmdBuffer, m_bufferSizes[BINDING_NRC_TRAINING], &m_recordCopyBuffers[slot], usage,
+							 &m_recordCopyMemories[slot], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, queueFamilies);
+			}
+		}
+		void* queries;
+		void* results;
+		void* trainingRecords;
+		NVVK_CHECK(vkMapMemory(device, m_memories[BINDING_NRC_QUERIES], 0, VK_WHOLE_SIZE, 0, &queries));
+		NVVK_CHECK(vkMapMemory(device, m_memories[BINDING_NRC_RESULTS], 0, VK_WHOLE_SIZE, 0, &results));
+		NVVK_CHECK(vkMapMemory(device, m_memories[BINDING_NRC_TRAINING], 0, VK_WHOLE_SIZE, 0, &trainingRecords));
+		m_queries			= reinterpret_cast<NrcQuery*>(queries);
+		m_results			= reinterpret_cast<float*>(results);
+		m_trainingRecords	= reinterpret_cast<NrcTrainingRecord*>(trainingRecords);
+
+
+		// -----------------------------------------
+		// Create Descriptor Set bindings and layout
+		// -----------------------------------------
+		std::array<VkDescriptorSetLayoutBinding, NRC_BINDING_COUNT> descriptorSetBindings{};
+		for (uint32_t i = 0; i < NRC_BINDING_COUNT; i++)
+		{
+			descriptorSetBindings[i].binding			= i;
+			descriptorSetBindings[i].descriptorCount	= 1;
+			descriptorSetBindings[i].descriptorType		= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorSetBindings[i].stageFlags			= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = nvvk::make<VkDescriptorSetLayoutCreateInfo>();
+		descriptorSetLayoutCreateInfo.bindingCount	= uint32_t(descriptorSetBindings.size());
+		descriptorSetLayoutCreateInfo.pBindings		= descriptorSetBindings.data();
+		NVVK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
+
+		// async training adds a set per query snapshot and per record copy
+		const uint32_t setCount = m_asyncTraining ? 5 : 1;
+		VkDescriptorPoolSize descriptorPoolSize{};
+		descriptorPoolSize.descriptorCount	= NRC_BINDING_COUNT * setCount;
+		descriptorPoolSize.type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
+		descriptorPoolCreateInfo.maxSets		= setCount;
+		descriptorPoolCreateInfo.poolSizeCount	= 1;
+		descriptorPoolCreateInfo.pPoolSizes		= &descriptorPoolSize;
+		NVVK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool));
+
+		m_descriptorSet = writeDescriptorSet(m_buffers);
+		if (m_asyncTraining)
+		{
+			// queries read a snapshot, steps train on a record copy; the rest is the cache's own
+			for (uint32_t slot = 0; slot < 2; slot++)
+			{
+				std::array<VkBuffer, NRC_BINDING_COUNT> queryBuffers = m_buffers;
+				queryBuffers[m_snapshotBindings[0]] = m_snapshotBuffers[slot][0];
+				queryBuffers[m_snapshotBindings[1]] = m_snapshotBuffers[slot][1];
+				m_queryDescriptorSets[slot] = writeDescriptorSet(queryBuffers);
+
+				std::array<VkBuffer, NRC_BINDING_COUNT> trainBuffers = m_buffers;
+				trainBuffers[BINDING_NRC_TRAINING] = m_recordCopyBuffers[slot];
+				m_trainDescriptorSets[slot] = writeDescriptorSet(trainBuffers);
+			}
+		}
+	}
+
+	VkDescriptorSet NeuralRadianceCache::writeDescriptorSet(const std::array<VkBuffer, NRC_BINDING_COUNT>& buffers) const
+	{
+		const VkDevice device = m_context->m_device;
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = nvvk::make<VkDescriptorSetAllocateInfo>();
+		descriptorSetAllocateInfo.descriptorPool		= m_descriptorPool;
+		descriptorSetAllocateInfo.descriptorSetCount	= 1;
+		descriptorSetAllocateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		NVVK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet));
+
+
+		// --------------------------------
+		// Write and update descriptor sets
+		// --------------------------------
+		std::array<VkDescriptorBufferInfo, NRC_BINDING_COUNT> descriptorBufferInfos{};
+		std::array<VkWriteDescriptorSet, NRC_BINDING_COUNT> writeDescriptorSets;
+		for (uint32_t i = 0; i < NRC_BINDING_COUNT; i++)
+		{
+			descriptorBufferInfos[i] = { buffers[i], 0, m_bufferSizes[i] };
+			writeDescriptorSets[i] = nvvk::make<VkWriteDescriptorSet>();
+			writeDescriptorSets[i].descriptorCount	= 1;
+			writeDescriptorSets[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSets[i].dstArrayElement	= 0;
+			writeDescriptorSets[i].dstBinding		= i;
+			writeDescriptorSets[i].dstSet			= descriptorSet;
+			writeDescriptorSets[i].pBufferInfo		= &descriptorBufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, uint32_t(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		return descriptorSet;
+	}
+
+	void NeuralRadianceCache::createPipelines(const std::vector<std::string>& searchPaths)
+	{
+		const VkDevice device = m_context->m_device;
+
+		// one layout for all kernels: the descriptor set and NrcConstants
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset		= 0;
+		pushConstantRange.size			= sizeof(NrcConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = nvvk::make<VkPipelineLayoutCreateInfo>();
+		pipelineLayoutCreateInfo.setLayoutCount			= 1;
+		pipelineLayoutCreateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges	= &pushConstantRange;
+		NVVK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		for (uint32_t kernel = 0; kernel < KernelCount; kernel++)
+		{
+			// the modules would not even load without clustered subgroup operations or fp16, nor with too little shared memory
+			if ((kernel == KernelTrain && !m_trainingSupported) || (kernel == KernelQueryHalf && !m_halfPrecision) ||
+				(kernel == KernelQuery && m_sharedMemorySize < NRC_QUERY_SHARED_BYTES))
+			{
+				continue;
+			}
+			VkShaderModule shaderModule = nvvk::createShaderModule(device, nvh::loadFile(kernelFiles[kernel], true, searchPaths));
+
+			VkPipelineShaderStageCreateInfo shaderStageCreateInfo = nvvk::make<VkPipelineShaderStageCreateInfo>();
+			shaderStageCreateInfo.stage		= VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStageCreateInfo.module	= shaderModule;
+			shaderStageCreateInfo.pName		= "main";
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = nvvk::make<VkComputePipelineCreateInfo>();
+			computePipelineCreateInfo.layout	= m_pipelineLayout;
+			computePipelineCreateInfo.stage		= shaderStageCreateInfo;
+			NVVK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_pipelines[kernel]));
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}
+	}
+
+	void NeuralRadianceCache::deinit()
+	{
+		if (m_context == nullptr)
+		{
+			return;
+		}
+		const VkDevice device = m_context->m_device;
+		if (m_asyncTraining)
+		{
+			waitForTraining();
+			vkDestroySemaphore(device, m_trainingSemaphore, nullptr);
+			vkDestroyCommandPool(device, m_computeCmdPool, nullptr);
+			for (uint32_t slot = 0; slot < 2; slot++)
+			{
+				for (uint32_t b = 0; b < 2; b++)
+				{
+					vkDestroyBuffer(device, m_snapshotBuffers[slot][b], nullptr);
+					vkFreeMemory(device, m_snapshotMemories[slot][b], nullptr);
+				}
+				vkDestroyBuffer(device, m_recordCopyBuffers[slot], nullptr);
+				vkFreeMemory(device, m_recordCopyMemories[slot], nullptr);
+			}
+		}
+		for (VkPipeline pipeline : m_pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+		vkUnmapMemory(device, m_memories[BINDING_NRC_QUERIES]);
+		vkUnmapMemory(device, m_memories[BINDING_NRC_RESULTS]);
+		vkUnmapMemory(device, m_memories[BINDING_NRC_TRAINING]);
+		for (uint32_t i = 0; i < NRC_BINDING_COUNT; i++)
+		{
+			vkDestroyBuffer(device, m_buffers[i], nullptr);
+			vkFreeMemory(device, m_memories[i], nullptr);
+		}
+		*this = NeuralRadianceCache();
+	}
+
+	void NeuralRadianceCache::uploadBuffer(VkCommandBuffer cmdBuffer, uint32_t binding, const void* data, VkDeviceSize bytes,
+										   std::vector<std::pair<VkBuffer, VkDeviceMemory>>& stagingBuffers)
+	{
+		const VkDevice device = m_context->m_device;
+		if (bytes == 0)
+		{
+			return;
+		}
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingMemory;
+		createBuffer(*m_context, cmdBuffer, bytes, &stagingBuffer, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &stagingMemory,
+					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void* mapped;
+		NVVK_CHECK(vkMapMemory(device, stagingMemory, 0, bytes, 0, &mapped));
+		memcpy(mapped, data, size_t(bytes));
+		vkUnmapMemory(device, stagingMemory);
+		copyBuffer(cmdBuffer, stagingBuffer, m_buffers[binding], bytes);
+		stagingBuffers.emplace_back(stagingBuffer, stagingMemory);
+	}
+
+	void NeuralRadianceCache::uploadBuffer(VkCommandBuffer cmdBuffer, uint32_t binding, const std::vector<float>& values, size_t maxCount,
+										   std::vector<std::pair<VkBuffer, VkDeviceMemory>>& stagingBuffers)
+	{
+		uploadBuffer(cmdBuffer, binding, values.data(), VkDeviceSize(std::min(values.size(), maxCount)) * sizeof(float), stagingBuffers);
+	}
+
+	std::vector<float> NeuralRadianceCache::downloadBuffer(VkCommandPool cmdPool, uint32_t binding, size_t count) const
+	{
+		const VkDevice		device	= m_context->m_device;
+		const VkDeviceSize	bytes	= VkDeviceSize(count) * sizeof(float);
+		std::vector<float> values(count);
+		if (bytes == 0)
+		{
+			return values;
+		}
+
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(device, cmdPool);
+		VkBuffer		stagingBuffer;
+		VkDeviceMemory	stagingMemory;
+		createBuffer(*m_context, cmdBuffer, bytes, &stagingBuffer, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stagingMemory,
+					 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		shaderToTransferBarrier(cmdBuffer);
+		copyBuffer(cmdBuffer, m_buffers[binding], stagingBuffer, bytes);
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		endSubmitSingleTimeCommandRecord(device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+
+		void* data;
+		NVVK_CHECK(vkMapMemory(device, stagingMemory, 0, bytes, 0, &data));
+		memcpy(values.data(), data, size_t(bytes));
+		vkUnmapMemory(device, stagingMemory);
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingMemory, nullptr);
+		return values;
+	}
+
+	void NeuralRadianceCache::uploadParameters(VkCommandPool cmdPool, const std::vector<float>& weights, const std::vector<float>& grid)
+	{
+		const VkDevice device = m_context->m_device;
+		waitForTraining();
+
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(device, cmdPool);
+		std::vector<std::pair<VkBuffer, VkDeviceMemory>> stagingBuffers;
+		uploadBuffer(cmdBuffer, BINDING_NRC_WEIGHTS, weights, config().weightCount(), stagingBuffers);
+		uploadBuffer(cmdBuffer, BINDING_NRC_GRID, grid, config().gridParameterCount(), stagingBuffers);
+		// the fp16 copies of what was uploaded, Adam keeps them current from here on
+		if (m_halfPrecision)
+		{
+			const std::vector<uint16_t> weightsHalf = nrcHalfCopy(weights);
+			const std::vector<uint16_t> gridHalf	= nrcHalfCopy(grid);
+			uploadBuffer(cmdBuffer, BINDING_NRC_WEIGHTS_HALF, weightsHalf.data(),
+						 VkDeviceSize(std::min(weightsHalf.size(), config().weightCount())) * sizeof(uint16_t), stagingBuffers);
+			uploadBuffer(cmdBuffer, BINDING_NRC_GRID_HALF, gridHalf.data(),
+						 VkDeviceSize(std::min(gridHalf.size(), m_bufferSizes[BINDING_NRC_GRID_HALF] / sizeof(uint16_t))) * sizeof(uint16_t),
+						 stagingBuffers);
+		}
+		vkCmdFillBuffer(cmdBuffer, m_buffers[BINDING_NRC_ADAM], 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(cmdBuffer, m_buffers[BINDING_NRC_GRID_GRADIENTS], 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(cmdBuffer, m_buffers[BINDING_NRC_GRID_ADAM], 0, VK_WHOLE_SIZE, 0);
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		endSubmitSingleTimeCommandRecord(device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+		m_step = 0;
+
+		for (const auto& [stagingBuffer, stagingMemory] : stagingBuffers)
+		{
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingMemory, nullptr);
+		}
+	}
+
+	std::vector<float> NeuralRadianceCache::downloadWeights(VkCommandPool cmdPool) const
+	{
+		return downloadBuffer(cmdPool, BINDING_NRC_WEIGHTS, config().weightCount());
+	}
+
+	std::vector<float> NeuralRadianceCache::downloadGrid(VkCommandPool cmdPool) const
+	{
+		return downloadBuffer(cmdPool, BINDING_NRC_GRID, config().gridParameterCount());
+	}
+
+	NrcCacheState NeuralRadianceCache::downloadState(VkCommandPool cmdPool) const
+	{
+		// the moments are vec2 per parameter, the same layout as on the CPU
+		NrcCacheState state;
+		state.step			= m_step;
+		state.weights		= downloadWeights(cmdPool);
+		state.weightMoments	= downloadBuffer(cmdPool, BINDING_NRC_ADAM, 2 * config().weightCount());
+		state.grid			= downloadGrid(cmdPool);
+		state.gridMoments	= downloadBuffer(cmdPool, BINDING_NRC_GRID_ADAM, 2 * config().gridParameterCount());
+		return state;
+	}
+
+	void NeuralRadianceCache::uploadState(VkCommandPool cmdPool, const NrcCacheState& state)
+	{
+		// zeroes the moments past the state's, then the moments on top
+		uploadParameters(cmdPool, state.weights, state.grid);
+
+		const VkDevice device = m_context->m_device;
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(device, cmdPool);
+		std::vector<std::pair<VkBuffer, VkDeviceMemory>> stagingBuffers;
+		uploadBuffer(cmdBuffer, BINDING_NRC_ADAM, state.weightMoments, 2 * config().weightCount(), stagingBuffers);
+		uploadBuffer(cmdBuffer, BINDING_NRC_GRID_ADAM, state.gridMoments, 2 * config().gridParameterCount(), stagingBuffers);
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		endSubmitSingleTimeCommandRecord(device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+		m_step = state.step;
+
+		for (const auto& [stagingBuffer, stagingMemory] : stagingBuffers)
+		{
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingMemory, nullptr);
+		}
+	}
+
+	NrcConstants NeuralRadianceCache::makeConstants() const
+	{
+		NrcConstants constants{};
+		constants.hiddenLayers			= config().hiddenLayers;
+		constants.learningRate			= m_settings.learningRate;
+		constants.step					= m_step;
+		constants.gridLevels			= config().gridLevels;
+		constants.gridFeatures			= config().gridFeatures;
+		constants.gridLog2TableSize		= config().gridLog2TableSize;
+		constants.gridBaseResolution	= config().gridBaseResolution;
+		constants.gridPerLevelScale		= config().gridPerLevelScale;
+		constants.halfPrecision			= m_halfPrecision ? 1 : 0;
+		constants.regionsPerAxis		= config().regionsPerAxis;
+		for (int a = 0; a < 3; a++)
+		{
+			constants.sceneMin[a]	= m_sceneMin[a];
+			constants.sceneScale[a]	= m_sceneScale[a];
+		}
+		return constants;
+	}
+
+	void NeuralRadianceCache::dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupCount, const NrcConstants& constants,
+									   VkDescriptorSet descriptorSet) const
+	{
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[kernel]);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(NrcConstants), &constants);
+		vkCmdDispatch(cmdBuffer, groupCount, 1, 1);
+	}
+
+	void NeuralRadianceCache::recordBin(VkCommandBuffer cmdBuffer, bool records, uint32_t count, VkDescriptorSet descriptorSet) const
+	{
+		NrcConstants constants = makeConstants();
+		constants.queryCount	= records ? 0 : count;
+		constants.trainingCount	= records ? count : 0;
+		const uint32_t target		= records ? NRC_BIN_RECORDS : 0;
+
+		// counts from zero; the query padding reads as no query
+		shaderToTransferBarrier(cmdBuffer);
+		vkCmdFillBuffer(cmdBuffer, m_buffers[records ? BINDING_NRC_RECORD_REGIONS : BINDING_NRC_QUERY_REGIONS], 0, VK_WHOLE_SIZE, 0);
+		if (!records)
+		{
+			vkCmdFillBuffer(cmdBuffer, m_buffers[BINDING_NRC_QUERY_ORDER], 0, VK_WHOLE_SIZE, ~0u);
+		}
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		const uint32_t groupCount = std::max(std::min((count + NRC_BIN_WORKGROUP_SIZE - 1) / NRC_BIN_WORKGROUP_SIZE, 65535u), 1u);
+		constants.binPass = NRC_BIN_COUNT | target;
+		dispatch(cmdBuffer, KernelBin, groupCount, constants, descriptorSet);
+		shaderToShaderBarrier(cmdBuffer);
+		constants.binPass = NRC_BIN_SCAN | target;
+		dispatch(cmdBuffer, KernelBin, 1, constants, descriptorSet);
+		shaderToShaderBarrier(cmdBuffer);
+		constants.binPass = NRC_BIN_SCATTER | target;
+		dispatch(cmdBuffer, KernelBin, groupCount, constants, descriptorSet);
+		shaderToShaderBarrier(cmdBuffer);
+	}
+
+	void NeuralRadianceCache::recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount) const
+	{
+		recordQuery(cmdBuffer, queryCount, m_descriptorSet);
+	}
+
+	void NeuralRadianceCache::recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount, uint32_t slot) const
+	{
+		recordQuery(cmdBuffer, queryCount, m_queryDescriptorSets[slot]);
+	}
+
+	void NeuralRadianceCache::recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount, VkDescriptorSet descriptorSet) const
+	{
+		if (!m_querySupported)
+		{
+			return;
+		}
+		NrcConstants constants = makeConstants();
+		constants.queryCount = std::min(queryCount, m_maxQueries);
+		uint32_t groupCount = (constants.queryCount + NRC_QUERY_BATCH - 1) / NRC_QUERY_BATCH;
+		if (config().regionCount() > 1)
+		{
+			// every region's queries start a batch of their own, the last one of each may be partial
+			recordBin(cmdBuffer, false, constants.queryCount, descriptorSet);
+			groupCount += config().regionCount();
+		}
+		dispatch(cmdBuffer, m_halfPrecision ? KernelQueryHalf : KernelQuery, groupCount, constants, descriptorSet);
+	}
+
+	void NeuralRadianceCache::recordTrain(VkCommandBuffer cmdBuffer, uint32_t recordCount)
+	{
+		recordTrain(cmdBuffer, recordCount, m_descriptorSet);
+	}
+
+	void NeuralRadianceCache::recordTrain(VkCommandBuffer cmdBuffer, uint32_t recordCount, VkDescriptorSet descriptorSet)
+	{
+		recordCount = std::min(recordCount, m_maxTrainingRecords);
+		if (!m_trainingSupported || recordCount == 0)
+		{
+			return;
+		}
+		m_step++;
+		// with regions the workgroups are dealt out to the regions in turn, as many to each
+		const uint32_t regionCount = config().regionCount();
+		NrcConstants constants = makeConstants();
+		constants.trainingCount		= recordCount;
+		constants.trainingGroups	= std::max(std::min(uint32_t(NRC_TRAIN_GROUPS), (recordCount + NRC_TRAIN_BATCH - 1) / NRC_TRAIN_BATCH) / regionCount, 1u)
+									* regionCount;
+		if (regionCount > 1)
+		{
+			recordBin(cmdBuffer, true, recordCount, descriptorSet);
+		}
+
+		// every workgroup adds into its own slice, which starts from zero
+		shaderToTransferBarrier(cmdBuffer);
+		vkCmdFillBuffer(cmdBuffer, m_buffers[BINDING_NRC_GRADIENTS], 0, VkDeviceSize(constants.trainingGroups) * NRC_GRADIENT_STRIDE * sizeof(float), 0);
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		dispatch(cmdBuffer, KernelTrain, constants.trainingGroups, constants, descriptorSet);
+		shaderToShaderBarrier(cmdBuffer);
+		// one Adam thread per pair of parameters, the workgroups stride over them past the dispatch limit
+		const size_t pairCount = (config().weightCount() + config().gridParameterCount() + 1) / 2;
+		dispatch(cmdBuffer, KernelAdam, uint32_t(std::min((pairCount + NRC_ADAM_WORKGROUP_SIZE - 1) / NRC_ADAM_WORKGROUP_SIZE, size_t(65535))),
+				 constants, descriptorSet);
+		shaderToShaderBarrier(cmdBuffer);
+	}
+
+
+	// --------------
+	// Async training
+	// --------------
+	void NeuralRadianceCache::recordSnapshot(VkCommandBuffer cmdBuffer, uint32_t slot) const
+	{
+		shaderToTransferBarrier(cmdBuffer);
+		for (uint32_t b = 0; b < 2; b++)
+		{
+			copyBuffer(cmdBuffer, m_buffers[m_snapshotBindings[b]], m_snapshotBuffers[slot][b], m_bufferSizes[m_snapshotBindings[b]]);
+		}
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	void NeuralRadianceCache::resetSnapshots(VkCommandPool cmdPool)
+	{
+		waitForTraining();
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(m_context->m_device, cmdPool);
+		recordSnapshot(cmdBuffer, 0);
+		recordSnapshot(cmdBuffer, 1);
+		endSubmitSingleTimeCommandRecord(m_context->m_device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+	}
+
+	void NeuralRadianceCache::recordCopyTrainingRecords(VkCommandBuffer cmdBuffer, uint32_t slot) const
+	{
+		// the semaphore the step waits for makes the copy visible on the compute queue
+		shaderToTransferBarrier(cmdBuffer);
+		copyBuffer(cmdBuffer, m_buffers[BINDING_NRC_TRAINING], m_recordCopyBuffers[slot], m_bufferSizes[BINDING_NRC_TRAINING]);
+	}
+
+	uint64_t NeuralRadianceCache::submitTrain(uint32_t recordCount, uint32_t slot, VkSemaphore waitSemaphore, uint64_t waitValue)
+	{
+		const VkDevice device = m_context->m_device;
+		uint64_t completedValue;
+		NVVK_CHECK(vkGetSemaphoreCounterValue(device, m_trainingSemaphore, &completedValue));
+		releaseTrainingCommands(completedValue);
+
+		// waitSemaphore marks the frame that wrote the records of slot, the last one to read snapshot slot as well
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(device, m_computeCmdPool);
+		recordTrain(cmdBuffer, recordCount, m_trainDescriptorSets[slot]);
+		recordSnapshot(cmdBuffer, slot);
+		m_trainingValue++;
+		submitTimelineCommandRecord(m_context->m_queueC, cmdBuffer, waitSemaphore, waitValue,
+									VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, m_trainingSemaphore, m_trainingValue);
+		m_trainingCmdBuffers.emplace_back(m_trainingValue, cmdBuffer);
+		return m_trainingValue;
+	}
+
+	void NeuralRadianceCache::waitForTraining()
+	{
+		if (!m_asyncTraining || m_trainingValue == 0)
+		{
+			return;
+		}
+		waitTimelineSemaphore(m_context->m_device, m_trainingSemaphore, m_trainingValue);
+		releaseTrainingCommands(m_trainingValue);
+	}
+
+	void NeuralRadianceCache::releaseTrainingCommands(uint64_t completedValue)
+	{
+		auto done = [&](const std::pair<uint64_t, VkCommandBuffer>& entry) { return entry.first <= completedValue; };
+		for (const auto& entry : m_trainingCmdBuffers)
+		{
+			if (done(entry))
+			{
+				vkFreeCommandBuffers(m_context->m_device, m_computeCmdPool, 1, &entry.second);
+			}
+		}
+		m_trainingCmdBuffers.erase(std::remove_if(m_trainingCmdBuffers.begin(), m_trainingCmdBuffers.end(), done), m_trainingCmdBuffers.end());
+	}
+
+
+	// ---------
+	// Benchmark
+	// ---------
+	static void submitAndWait(const nvvk::Context& context, VkCommandPool cmdPool, VkCommandBuffer cmdBuffer)
+	{
+		shaderToHostBarrier(cmdBuffer);
+		endSubmitSingleTimeCommandRecord(context.m_device, context.m_queueGCT, cmdPool, cmdBuffer);
+	}
+
+	void benchmarkNrcInference(const nvvk::Context& context, VkCommandPool cmdPool, const std::vector<std::string>& searchPaths)
+	{
+		const uint32_t	queryCount		= RENDER_WIDTH * RENDER_HEIGHT;
+		const uint32_t	repetitions		= 8;
+		const uint32_t	checkedQueries	= 4096;
+
+		printf("NRC inference, %u queries per dispatch, %d-wide network:\n", queryCount, NRC_WIDTH);
+		for (const NrcNetworkConfig& network : nrcBenchmarkNetworks())
+		{
+			for (bool half : { false, true })
+			{
+				NrcSettings settings;
+				settings.network		= network;
+				settings.halfPrecision	= half;
+				NeuralRadianceCache cache;
+				cache.init(context, searchPaths, settings, queryCount, 0, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax);
+				if (half && !cache.halfPrecision())
+				{
+					printf("  %-47s fp16 skipped: the device lacks shaderFloat16 or storageBuffer16BitAccess\n",
+						   (describeNrcNetwork(network) + ":").c_str());
+					cache.deinit();
+					continue;
+				}
+				if (!cache.querySupported())
+				{
+					printf("  %-47s %s skipped: %u bytes of compute shared memory, the kernel needs %u\n",
+						   (describeNrcNetwork(network) + ":").c_str(), half ? "fp16" : "fp32", cache.sharedMemorySize(),
+						   uint32_t(half ? NRC_QUERY_HALF_SHARED_BYTES : NRC_QUERY_SHARED_BYTES));
+					cache.deinit();
+					continue;
+				}
+				const std::vector<float> weights	= initializeNrcWeights(settings.network, settings.seed);
+				std::vector<float> grid				= initializeNrcGrid(settings.network, settings.seed);
+				// features of the size a trained grid has, so the check sees more than the initial noise
+				for (float& parameter : grid)
+				{
+					parameter *= 1e3f;
+				}
+				cache.uploadParameters(cmdPool, weights, grid);
+				uint32_t rngState = 4321u;
+				for (uint32_t q = 0; q < queryCount; q++)
+				{
+					cache.queries()[q] = nrcQueryOf(makeNrcBenchmarkRecord(rngState));
+				}
+
+				// one warm-up dispatch, then the timed ones in a single submission
+				VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(context.m_device, cmdPool);
+				cache.recordQuery(cmdBuffer, queryCount);
+				submitAndWait(context, cmdPool, cmdBuffer);
+
+				cmdBuffer = beginSingleTimeCommandRecord(context.m_device, cmdPool);
+				for (uint32_t r = 0; r < repetitions; r++)
+				{
+					cache.recordQuery(cmdBuffer, queryCount);
+					shaderToShaderBarrier(cmdBuffer);
+				}
+				const auto start = std::chrono::high_resolution_clock::now();
+				submitAndWait(context, cmdPool, cmdBuffer);
+				const auto end = std::chrono::high_resolution_clock::now();
+				const double seconds = std::chrono::duration<double>(end - start).count();
+
+				// largest difference to the reference of the same precision and to fp32, relative to the largest output
+				const std::vector<uint16_t> weightsHalf	= nrcHalfCopy(weights);
+				const std::vector<uint16_t> gridHalf	= nrcHalfCopy(grid);
+				float maxError		= 0.0f;
+				float fp32Error		= 0.0f;
+				float maxOutput		= 0.0f;
+				for (uint32_t q = 0; q < checkedQueries; q++)
+				{
+					const uint32_t	index = q * (queryCount / checkedQueries);
+					float			unitPos[3];
+					float			encoded[NRC_WIDTH];
+					float			expected[NRC_OUTPUT_WIDTH];
+					float			expectedHalf[NRC_OUTPUT_WIDTH];
+					const size_t	regionWeights = nrcRegionUnitPosition(network, cache.queries()[index], nrcBenchmarkSceneMin,
+																		  nrcBenchmarkSceneScale, unitPos) * network.regionWeightCount();
+					nrcEncodeInput(settings.network, grid.data(), cache.queries()[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+					nrcForward(settings.network, weights.data() + regionWeights, encoded, expected);
+					nrcEncodeInput(settings.network, gridHalf.data(), cache.queries()[index], nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+					nrcForwardHalf(settings.network, weightsHalf.data() + regionWeights, encoded, expectedHalf);
+					for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+					{
+						const float result = cache.results()[index * NRC_OUTPUT_WIDTH + c];
+						maxError	= std::max(maxError, std::fabs(result - (half ? expectedHalf[c] : expected[c])));
+						fp32Error	= std::max(fp32Error, std::fabs(result - expected[c]));
+						maxOutput	= std::max(maxOutput, std::fabs(expected[c]));
+					}
+				}
+				printf("  %-47s %s %8.2f Mqueries/s, max error %.2e, %.2e against fp32 (of outputs up to %.2f)\n",
+					   (describeNrcNetwork(network) + ":").c_str(), half ? "fp16" : "fp32", double(queryCount) * repetitions / seconds * 1e-6,
+					   maxError, fp32Error, maxOutput);
+				cache.deinit();
+			}
+		}
+	}
+
+	void benchmarkNrcTraining(const nvvk::Context& context, VkCommandPool cmdPool, const std::vector<std::string>& searchPaths)
+	{
+		const uint32_t recordCount		= 1 << 16;		// per training step, as in real-time NRC
+		const uint32_t steps			= 64;
+		const uint32_t checkedRecords	= 4096;
+		const uint32_t testCount		= 4096;
+
+		printf("NRC training, %u records per step, %d-wide network:\n", recordCount, NRC_WIDTH);
+		for (const NrcNetworkConfig& network : nrcBenchmarkNetworks())
+		{
+			NrcSettings settings;
+			settings.network = network;
+			NeuralRadianceCache cache;
+			cache.init(context, searchPaths, settings, testCount, recordCount, nrcBenchmarkSceneMin, nrcBenchmarkSceneMax);
+			if (!cache.trainingSupported() || !cache.querySupported())
+			{
+				printf("  skipped: the device has no clustered subgroup operations in compute shaders, or less than %u bytes of "
+					   "compute shared memory (it has %u)\n", uint32_t(NRC_QUERY_SHARED_BYTES), cache.sharedMemorySize());
+				cache.deinit();
+				return;
+			}
+			std::vector<float> weights	= initializeNrcWeights(settings.network, settings.seed);
+			std::vector<float> grid		= initializeNrcGrid(settings.network, settings.seed);
+			cache.uploadParameters(cmdPool, weights, grid);
+
+			uint32_t rngState = 1234u;
+			for (uint32_t r = 0; r < recordCount; r++)
+			{
+				cache.trainingRecords()[r] = makeNrcBenchmarkRecord(rngState);
+			}
+			std::vector<NrcTrainingRecord> testRecords(testCount);
+			for (uint32_t q = 0; q < testCount; q++)
+			{
+				testRecords[q]		= makeNrcBenchmarkRecord(rngState);
+				cache.queries()[q]	= nrcQueryOf(testRecords[q]);
+			}
+			auto testLoss = [&]()
+			{
+				VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(context.m_device, cmdPool);
+				cache.recordQuery(cmdBuffer, testCount);
+				submitAndWait(context, cmdPool, cmdBuffer);
+				double loss = 0.0;
+				for (uint32_t q = 0; q < testCount; q++)
+				{
+					loss += nrcLoss(cache.results() + q * NRC_OUTPUT_WIDTH, testRecords[q].radiance, nullptr);
+				}
+				return loss / testCount;
+			};
+
+			// the first step on a few records against the host reference
+			VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(context.m_device, cmdPool);
+			cache.recordTrain(cmdBuffer, checkedRecords);
+			submitAndWait(context, cmdPool, cmdBuffer);
+			const std::vector<float> trainedWeights	= cache.downloadWeights(cmdPool);
+			const std::vector<float> trainedGrid	= cache.downloadGrid(cmdPool);
+			std::vector<float> gradients(weights.size(), 0.0f);
+			std::vector<float> gridGradients(grid.size(), 0.0f);
+			const std::vector<uint32_t> regionRecords = nrcRegionCounts(network, cache.trainingRecords(), checkedRecords, nrcBenchmarkSceneMin,
+																		nrcBenchmarkSceneScale);
+			for (uint32_t r = 0; r < checkedRecords; r++)
+			{
+				const NrcQuery	query	= nrcQueryOf(cache.trainingRecords()[r]);
+				float			encoded[NRC_WIDTH];
+				float			inputGradients[NRC_WIDTH];
+				float			unitPos[3];
+				const uint32_t	region	= nrcRegionUnitPosition(network, query, nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, unitPos);
+				nrcEncodeInput(settings.network, grid.data(), query, nrcBenchmarkSceneMin, nrcBenchmarkSceneScale, encoded);
+				nrcBackward(settings.network, weights.data() + region * network.regionWeightCount(), encoded, cache.trainingRecords()[r].radiance,
+							1.0f / float(regionRecords[region]), gradients.data() + region * network.regionWeightCount(), inputGradients);
+				nrcGridBackward(settings.network, unitPos, inputGradients, gridGradients.data() + region * network.regionGridParameterCount());
+			}
+			std::vector<float> moments(2 * weights.size(), 0.0f);
+			std::vector<float> gridMoments(2 * grid.size(), 0.0f);
+			nrcAdamStep(weights.data(), gradients.data(), moments.data(), weights.size(), 1, settings.learningRate);
+			nrcAdamStep(grid.data(), gridGradients.data(), gridMoments.data(), grid.size(), 1, settings.learningRate);
+			float maxError = 0.0f;
+			for (size_t w = 0; w < weights.size(); w++)
+			{
+				maxError = std::max(maxError, std::fabs(trainedWeights[w] - weights[w]));
+			}
+			for (size_t e = 0; e < grid.size(); e++)
+			{
+				maxError = std::max(maxError, std::fabs(trainedGrid[e] - grid[e]));
+			}
+
+			// from the initial parameters again: timed steps in one submission
+			cache.uploadParameters(cmdPool, initializeNrcWeights(settings.network, settings.seed), initializeNrcGrid(settings.network, settings.seed));
+			const double lossBefore = testLoss();
+			cmdBuffer = beginSingleTimeCommandRecord(context.m_device, cmdPool);
+			for (uint32_t step = 0; step < steps; step++)
+			{
+				cache.recordTrain(cmdBuffer, recordCount);
+			}
+			const auto start = std::chrono::high_resolution_clock::now();
+			submitAndWait(context, cmdPool, cmdBuffer);
+			const auto end = std::chrono::high_resolution_clock::now();
+			const double seconds = std::chrono::duration<double>(end - start).count();
+			const double lossAfter = testLoss();
+
+			printf("  %-47s %8.2f Mrecords/s (%.2f ms per step), test loss %.4f -> %.4f after %u steps, "
+				   "first step within %.1e of the reference (learning rate %.0e)\n", (describeNrcNetwork(network) + ":").c_str(),
+				   double(recordCount) * steps / seconds * 1e-6, seconds / steps * 1e3, lossBefore, lossAfter, steps, maxError,
+				   settings.learningRate);
+			cache.deinit();
+		}
+	}
+}
@@ -0,0 +1,211 @@
+# pragma once
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+#include <utility.h>
+#include <nrc_checkpoint.h>
+#include <nrc_network.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Neural radiance cache on the Vulkan device: the network weights
+	// and the fully-fused kernels that evaluate them.
+	//
+	// nrc_query.comp.glsl answers a batch of queries (position,
+	// direction, normal) with one workgroup per NRC_QUERY_BATCH queries;
+	// see shaders/nrc_mlp.h for how the layers stay in shared memory.
+	// A training step is two dispatches: nrc_train.comp.glsl
+	// accumulates the gradients of a batch of records into one slice
+	// per workgroup, nrc_adam.comp.glsl sums the slices and updates the
+	// weights. With NrcNetworkConfig::gridLevels the position is encoded
+	// by a multiresolution hash grid, trained along with the weights.
+	// Training needs clustered subgroup operations, see
+	// trainingSupported(). The fused kernels keep their layers in
+	// shared memory, more than the 16 KiB Vulkan guarantees except for
+	// the fp16 queries; a device with less than a kernel needs gets no
+	// pipeline for it, see querySupported(). The query, result and
+	// training record buffers are host-visible so the host can fill
+	// and read them directly.
+	//
+	// NrcSettings::halfPrecision answers queries with
+	// nrc_query_half.comp.glsl from fp16 copies of the weights and grid
+	// that Adam refreshes on every step. It needs shaderFloat16 and
+	// storageBuffer16BitAccess; without them the cache stays in fp32,
+	// see halfPrecision().
+	//
+	// NrcSettings::asyncTraining moves the training steps to the
+	// device's async compute queue (nvvk::Context::m_queueC) so they
+	// overlap the frame that renders meanwhile. Queries then read one
+	// of two snapshots of the parameters they need, which the step
+	// copies its result into at the end, and the steps train on one of
+	// two copies of the record buffer, so neither queue touches what
+	// the other is using; the order is under Async training below.
+	//
+	// With NrcNetworkConfig::regionsPerAxis > 1 every region has its own
+	// network and grid. The queries and the records of a step are first
+	// sorted by region (nrc_bin.comp.glsl, a counting sort in three
+	// dispatches), so each query workgroup loads one region's matrices
+	// into shared memory and each training workgroup trains a single
+	// region's network, with its share of the workgroups.
+	// ----------------------------------------------------------------
+	class NeuralRadianceCache
+	{
+	public:
+		// searchPaths locate shaders/nrc_*.comp.glsl.spv; sceneMin/sceneMax bound the query positions
+		void init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, const NrcSettings& settings,
+				  uint32_t maxQueries, uint32_t maxTrainingRecords, const float sceneMin[3], const float sceneMax[3]);
+		void deinit();
+
+		const NrcNetworkConfig&	config() const				{ return m_settings.network; }
+		bool					querySupported() const		{ return m_querySupported; }		// else recordQuery does nothing
+		bool					trainingSupported() const	{ return m_trainingSupported; }
+		uint32_t				sharedMemorySize() const	{ return m_sharedMemorySize; }		// maxComputeSharedMemorySize
+		bool					halfPrecision() const		{ return m_halfPrecision; }		// asked for and supported
+		bool					asyncTraining() const		{ return m_asyncTraining; }		// asked for, training supported, timeline semaphores and a compute queue
+		uint32_t				trainingSteps() const		{ return m_step; }
+		float					learningRate() const		{ return m_settings.learningRate; }
+
+		// mapped, maxQueries and maxTrainingRecords entries
+		NrcQuery*			queries() const			{ return m_queries; }
+		const float*		results() const			{ return m_results; }		// NRC_OUTPUT_WIDTH floats per query
+		NrcTrainingRecord*	trainingRecords() const	{ return m_trainingRecords; }
+
+		// BINDING_NRC_* buffer, for kernels of other passes that write the queries and training records on the device
+		VkBuffer			buffer(uint32_t binding) const		{ return m_buffers[binding]; }
+		VkDeviceSize		bufferSize(uint32_t binding) const	{ return m_bufferSizes[binding]; }
+
+		// replaces the weights (config().weightCount() floats) and the hash grid (config().gridParameterCount() floats)
+		// and their fp16 copies and restarts Adam, waits for the queue
+		void uploadParameters(VkCommandPool cmdPool, const std::vector<float>& weights, const std::vector<float>& grid);
+		std::vector<float> downloadWeights(VkCommandPool cmdPool) const;
+		std::vector<float> downloadGrid(VkCommandPool cmdPool) const;
+
+		// parameters, Adam moments and step, for checkpoints (nrc_checkpoint.h); both wait for the queue
+		NrcCacheState downloadState(VkCommandPool cmdPool) const;
+		void uploadState(VkCommandPool cmdPool, const NrcCacheState& state);
+
+		// of the training steps recorded from now on
+		void setLearningRate(float learningRate) { m_settings.learningRate = learningRate; }
+
+		// radiance of the first queryCount queries into results()
+		void recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount) const;
+
+		// one training step on the first recordCount training records; queries recorded after it see the new weights
+		void recordTrain(VkCommandBuffer cmdBuffer, uint32_t recordCount);
+
+		// ----------------------------------------------------------------
+		// Async training, with asyncTraining() only. Frame F of a renderer
+		// uses slot F % 2 and, on its own queue:
+		//  - submits the step on the records of frame F - 1 with
+		//    submitTrain(..., 1 - slot, ...), waiting for that frame,
+		//  - records its queries with recordQuery(..., slot) after waiting
+		//    for the training timeline value the step of frame F - 1
+		//    signalled, which wrote snapshot slot,
+		//  - records recordCopyTrainingRecords(..., slot) once its records
+		//    are complete, for the step of frame F + 1.
+		// So the step of frame F runs alongside the rest of frame F, and
+		// a frame's queries see the weights of the step before.
+		// ----------------------------------------------------------------
+
+		// both query snapshots from the current parameters, before the first frame; waits for the queue
+		void resetSnapshots(VkCommandPool cmdPool);
+
+		// radiance of the first queryCount queries into results(), from the parameters in snapshot slot
+		void recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount, uint32_t slot) const;
+
+		// the training records into copy slot, which the next submitTrain on that slot trains on
+		void recordCopyTrainingRecords(VkCommandBuffer cmdBuffer, uint32_t slot) const;
+
+		// one training step on the first recordCount records of copy slot on the compute queue, once waitSemaphore reaches
+		// waitValue, then the new parameters into snapshot slot; returns the training timeline value it signals when done
+		uint64_t submitTrain(uint32_t recordCount, uint32_t slot, VkSemaphore waitSemaphore, uint64_t waitValue);
+
+		// the training timeline and the value of the last step submitted
+		VkSemaphore trainingSemaphore() const	{ return m_trainingSemaphore; }
+		uint64_t	trainingValue() const		{ return m_trainingValue; }
+
+		// blocks until every submitted step is done; downloads and uploads expect no step in flight
+		void waitForTraining();
+
+	private:
+		enum Kernel
+		{
+			KernelQuery,
+			KernelTrain,
+			KernelAdam,
+			KernelQueryHalf,
+			KernelBin,
+			KernelCount
+		};
+
+		void createBuffers();
+		VkDescriptorSet writeDescriptorSet(const std::array<VkBuffer, NRC_BINDING_COUNT>& buffers) const;
+		void recordQuery(VkCommandBuffer cmdBuffer, uint32_t queryCount, VkDescriptorSet descriptorSet) const;
+		void recordTrain(VkCommandBuffer cmdBuffer, uint32_t recordCount, VkDescriptorSet descriptorSet);
+		void recordBin(VkCommandBuffer cmdBuffer, bool records, uint32_t count, VkDescriptorSet descriptorSet) const;
+		void recordSnapshot(VkCommandBuffer cmdBuffer, uint32_t slot) const;
+		void releaseTrainingCommands(uint64_t completedValue);
+		void uploadBuffer(VkCommandBuffer cmdBuffer, uint32_t binding, const void* data, VkDeviceSize bytes,
+						  std::vector<std::pair<VkBuffer, VkDeviceMemory>>& stagingBuffers);
+		void uploadBuffer(VkCommandBuffer cmdBuffer, uint32_t binding, const std::vector<float>& values, size_t maxCount,
+						  std::vector<std::pair<VkBuffer, VkDeviceMemory>>& stagingBuffers);
+		std::vector<float> downloadBuffer(VkCommandPool cmdPool, uint32_t binding, size_t count) const;
+		void createPipelines(const std::vector<std::string>& searchPaths);
+		void dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupCount, const NrcConstants& constants,
+					  VkDescriptorSet descriptorSet) const;
+		NrcConstants makeConstants() const;
+
+		const nvvk::Context*						m_context				= nullptr;
+		NrcSettings									m_settings;
+		uint32_t									m_maxQueries			= 0;
+		uint32_t									m_maxTrainingRecords	= 0;
+		uint32_t									m_step					= 0;
+		bool										m_querySupported		= false;
+		bool										m_trainingSupported		= false;
+		uint32_t									m_sharedMemorySize		= 0;
+		bool										m_halfPrecision			= false;
+		bool										m_asyncTraining			= false;
+		VkDescriptorSetLayout						m_descriptorSetLayout	= VK_NULL_HANDLE;
+		VkDescriptorPool							m_descriptorPool		= VK_NULL_HANDLE;
+		VkDescriptorSet								m_descriptorSet			= VK_NULL_HANDLE;
+		VkPipelineLayout							m_pipelineLayout		= VK_NULL_HANDLE;
+		std::array<VkPipeline, KernelCount>			m_pipelines{};
+
+		// weights, queries, results, training records, gradient slices, Adam moments, the same for the hash grid, the
+		// fp16 copies and the sort by region (BINDING_NRC_*)
+		std::array<VkBuffer, NRC_BINDING_COUNT>			m_buffers{};
+		std::array<VkDeviceMemory, NRC_BINDING_COUNT>	m_memories{};
+		std::array<VkDeviceSize, NRC_BINDING_COUNT>		m_bufferSizes{};
+		NrcQuery*									m_queries				= nullptr;
+		float*										m_results				= nullptr;
+		NrcTrainingRecord*							m_trainingRecords		= nullptr;
+		float										m_sceneMin[3]			= {};
+		float										m_sceneScale[3]			= {};
+
+		// async training: the two bindings a query reads (fp32 or fp16 parameters) and their snapshots, the record copies,
+		// the descriptor sets that use them, and the compute queue's command buffers still in flight with their values
+		std::array<uint32_t, 2>						m_snapshotBindings{};
+		std::array<std::array<VkBuffer, 2>, 2>		m_snapshotBuffers{};		// [slot][binding]
+		std::array<std::array<VkDeviceMemory, 2>, 2>	m_snapshotMemories{};
+		std::array<VkBuffer, 2>						m_recordCopyBuffers{};
+		std::array<VkDeviceMemory, 2>				m_recordCopyMemories{};
+		std::array<VkDescriptorSet, 2>				m_queryDescriptorSets{};
+		std::array<VkDescriptorSet, 2>				m_trainDescriptorSets{};
+		VkCommandPool								m_computeCmdPool		= VK_NULL_HANDLE;
+		VkSemaphore									m_trainingSemaphore		= VK_NULL_HANDLE;
+		uint64_t									m_trainingValue			= 0;
+		std::vector<std::pair<uint64_t, VkCommandBuffer>>	m_trainingCmdBuffers;
+	};
+
+	// Fused inference throughput for 2 to 5 hidden layers with the frequency encoding and for small networks
+	// on a hash grid, checked against nrcForward, in fp32 and, where the device supports it, in fp16 (also
+	// checked against nrcForwardHalf). Run with --nrc-bench on any Vulkan device, lavapipe included.
+	void benchmarkNrcInference(const nvvk::Context& context, VkCommandPool cmdPool, const std::vector<std::string>& searchPaths);
+
+	// Training throughput and loss for the networks of benchmarkNrcInference; the first step is checked against
+	// nrcBackward, nrcGridBackward and nrcAdamStep.
+	void benchmarkNrcTraining(const nvvk::Context& context, VkCommandPool cmdPool, const std::vector<std::string>& searchPaths);
+}
@@ -0,0 +1,245 @@
+#include <nrc_checkpoint.h>
+#include <cpu_bvh_cache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace NRC
+{
+	static const char nrcCheckpointMagic[8] = { 'N', 'R', 'C', 'C', 'K', 'P', 'T', '\0' };
+
+	struct NrcCheckpointHeader
+	{
+		char		magic[8];
+		uint32_t	version;
+		uint32_t	headerSize;
+		uint64_t	sceneHash;
+		uint64_t	configHash;
+		uint64_t	weightCount;
+		uint64_t	gridCount;
+		uint32_t	step;
+		float		camera[3];
+		uint64_t	payloadChecksum;	// weights, weight moments, grid, grid moments
+		uint64_t	headerChecksum;		// every field above
+	};
+	static_assert(sizeof(NrcCheckpointHeader) == 80, "NrcCheckpointHeader is expected to have no padding");
+
+	const char* nrcWarmStartName(NrcWarmStart warmStart)
+	{
+		switch (warmStart)
+		{
+		case NrcWarmStart::Parameters:	return "parameters";
+		case NrcWarmStart::Resumed:		return "resumed";
+		default:						return "cold";
+		}
+	}
+
+	uint64_t hashNrcScene(const float* positions, size_t positionCount, const uint32_t* indices, size_t indexCount)
+	{
+		const uint64_t h = hashBytes(positions, positionCount * sizeof(float));
+		return hashBytes(indices, indexCount * sizeof(uint32_t), h);
+	}
+
+	uint64_t hashNrcConfig(const NrcNetworkConfig& config)
+	{
+		// field by field, the struct may have padding; grid fields only matter with a grid
+		const NrcNetworkConfig valid = validNrcConfig(config);
+		uint64_t h = hashBytes(&valid.hiddenLayers, sizeof(valid.hiddenLayers), nrcCheckpointVersion);
+		h = hashBytes(&valid.gridLevels, sizeof(valid.gridLevels), h);
+		if (valid.gridLevels > 0)
+		{
+			h = hashBytes(&valid.gridFeatures, sizeof(valid.gridFeatures), h);
+			h = hashBytes(&valid.gridLog2TableSize, sizeof(valid.gridLog2TableSize), h);
+			h = hashBytes(&valid.gridBaseResolution, sizeof(valid.gridBaseResolution), h);
+			h = hashBytes(&valid.gridPerLevelScale, sizeof(valid.gridPerLevelScale), h);
+		}
+		// the regions only when there are several, so a single network keeps the hash it had
+		if (valid.regionsPerAxis > 1)
+		{
+			h = hashBytes(&valid.regionsPerAxis, sizeof(valid.regionsPerAxis), h);
+		}
+		return h;
+	}
+
+	std::string nrcCheckpointPath(const std::string& directory, uint64_t sceneHash, const NrcNetworkConfig& config)
+	{
+		char name[48];
+		snprintf(name, sizeof(name), "%016llx-%016llx.nrc", static_cast<unsigned long long>(sceneHash),
+				 static_cast<unsigned long long>(hashNrcConfig(config)));
+		if (directory.empty())
+		{
+			return name;
+		}
+		const char last = directory.back();
+		return directory + (last == '/' || last == '\\' ? "" : "/") + name;
+	}
+
+	static bool stateFits(const NrcNetworkConfig& config, const NrcCacheState& state)
+	{
+		return state.weights.size() == config.weightCount() && state.weightMoments.size() == 2 * config.weightCount()
+			&& state.grid.size() == config.gridParameterCount() && state.gridMoments.size() == 2 * config.gridParameterCount();
+	}
+
+	static uint64_t payloadChecksum(const NrcCacheState& state)
+	{
+		uint64_t h = hashBytes(state.weights.data(), state.weights.size() * sizeof(float));
+		h = hashBytes(state.weightMoments.data(), state.weightMoments.size() * sizeof(float), h);
+		h = hashBytes(state.grid.data(), state.grid.size() * sizeof(float), h);
+		return hashBytes(state.gridMoments.data(), state.gridMoments.size() * sizeof(float), h);
+	}
+
+	static uint64_t headerChecksum(const NrcCheckpointHeader& header)
+	{
+		return hashBytes(&header, offsetof(NrcCheckpointHeader, headerChecksum));
+	}
+
+
+	// -------------
+	// Save and load
+	// -------------
+	bool saveNrcCheckpoint(const std::string& path, uint64_t sceneHash, const NrcNetworkConfig& config, const float camera[3],
+						   const NrcCacheState& state)
+	{
+		const NrcNetworkConfig valid = validNrcConfig(config);
+		if (!stateFits(valid, state))
+		{
+			return false;
+		}
+		NrcCheckpointHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, nrcCheckpointMagic, sizeof(header.magic));
+		header.version		= nrcCheckpointVersion;
+		header.headerSize	= sizeof(NrcCheckpointHeader);
+		header.sceneHash	= sceneHash;
+		header.configHash	= hashNrcConfig(valid);
+		header.weightCount	= state.weights.size();
+		header.gridCount	= state.grid.size();
+		header.step			= state.step;
+		std::copy(camera, camera + 3, header.camera);
+		header.payloadChecksum	= payloadChecksum(state);
+		header.headerChecksum	= headerChecksum(header);
+
+		// unique per process, several jobs may finish on the same scene at once
+#ifdef _WIN32
+		const std::string temporaryPath = path + ".tmp" + std::to_string(GetCurrentProcessId());
+#else
+		const std::string temporaryPath = path + ".tmp" + std::to_string(getpid());
+#endif
+		FILE* file = fopen(temporaryPath.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (const std::vector<float>* values : { &state.weights, &state.weightMoments, &state.grid, &state.gridMoments })
+		{
+			written = written && fwrite(values->data(), sizeof(float), values->size(), file) == values->size();
+		}
+		written = fclose(file) == 0 && written;
+
+#ifdef _WIN32
+		written = written && MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		written = written && rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+		if (!written)
+		{
+			remove(temporaryPath.c_str());
+		}
+		return written;
+	}
+
+	bool loadNrcCheckpoint(const std::string& path, uint64_t sceneHash, const NrcNetworkConfig& config, float camera[3],
+						   NrcCacheState& state)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+		const NrcNetworkConfig	valid = validNrcConfig(config);
+		NrcCheckpointHeader		header;
+		if (fread(&header, sizeof(header), 1, file) != 1
+			|| memcmp(header.magic, nrcCheckpointMagic, sizeof(header.magic)) != 0
+			|| header.version		!= nrcCheckpointVersion
+			|| header.headerSize	!= sizeof(NrcCheckpointHeader)
+			|| header.sceneHash		!= sceneHash
+			|| header.configHash	!= hashNrcConfig(valid)
+			|| header.weightCount	!= valid.weightCount()
+			|| header.gridCount		!= valid.gridParameterCount()
+			|| header.headerChecksum != headerChecksum(header))
+		{
+			fclose(file);
+			return false;
+		}
+
+		NrcCacheState loaded;
+		loaded.step = header.step;
+		loaded.weights.resize(header.weightCount);
+		loaded.weightMoments.resize(2 * header.weightCount);
+		loaded.grid.resize(header.gridCount);
+		loaded.gridMoments.resize(2 * header.gridCount);
+		bool read = true;
+		for (std::vector<float>* values : { &loaded.weights, &loaded.weightMoments, &loaded.grid, &loaded.gridMoments })
+		{
+			read = read && fread(values->data(), sizeof(float), values->size(), file) == values->size();
+		}
+		// nothing may follow the payload
+		read = read && fgetc(file) == EOF;
+		fclose(file);
+		if (!read || payloadChecksum(loaded) != header.payloadChecksum)
+		{
+			return false;
+		}
+		std::copy(header.camera, header.camera + 3, camera);
+		state = std::move(loaded);
+		return true;
+	}
+
+	NrcWarmStart loadNrcWarmStart(const std::string& directory, uint64_t sceneHash, const NrcNetworkConfig& config,
+								  const NrcCheckpointPolicy& policy, const float camera[3], const float sceneMin[3],
+								  const float sceneMax[3], NrcCacheState& state)
+	{
+		float			checkpointCamera[3];
+		NrcCacheState	loaded;
+		if (!loadNrcCheckpoint(nrcCheckpointPath(directory, sceneHash, config), sceneHash, config, checkpointCamera, loaded))
+		{
+			return NrcWarmStart::Cold;
+		}
+
+		float diagonal = 0.0f;
+		float moved = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			diagonal	+= (sceneMax[a] - sceneMin[a]) * (sceneMax[a] - sceneMin[a]);
+			moved		+= (camera[a] - checkpointCamera[a]) * (camera[a] - checkpointCamera[a]);
+		}
+		const float distance = diagonal > 0.0f ? std::sqrt(moved / diagonal) : 0.0f;
+		if (distance > policy.discardDistance)
+		{
+			return NrcWarmStart::Cold;
+		}
+		if (distance > policy.resumeDistance)
+		{
+			std::fill(loaded.weightMoments.begin(), loaded.weightMoments.end(), 0.0f);
+			std::fill(loaded.gridMoments.begin(), loaded.gridMoments.end(), 0.0f);
+			loaded.step = 0;
+			state = std::move(loaded);
+			return NrcWarmStart::Parameters;
+		}
+		state = std::move(loaded);
+		return NrcWarmStart::Resumed;
+	}
+}
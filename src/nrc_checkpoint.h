@@ -0,0 +1,93 @@
+# pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nrc_network.h>
+
+namespace NRC
+{
+	// ----------------------------------------------------------------
+	// Checkpoints of the neural radiance cache, so a render job starts
+	// from what earlier jobs on the same scene have learned instead of
+	// spending its first frames on training from the seed.
+	//
+	// A checkpoint holds the weights, the hash grid, both Adam moments
+	// and the step count, in the layout both backends use, so a file
+	// written by the device cache loads into the CPU one and back. It
+	// is keyed by a hash of the scene geometry and one of the network
+	// config (the layout of the parameters); the learning rate and the
+	// path settings are free to change between jobs.
+	//
+	// The file is a header followed by the four float arrays. The
+	// header holds a version, the keys, the array sizes, the camera
+	// position of the writer and checksums of itself and the payload;
+	// a file that does not match is a miss. As with the BVH cache,
+	// files are written to a temporary name and renamed.
+	//
+	// The cache is a function of world space, so its parameters stay
+	// valid wherever the camera goes; what changes with the camera is
+	// which part of the scene the next frames train on. Adam's moments
+	// are tuned to the records of the old view, so NrcCheckpointPolicy
+	// resumes them only for a camera close to the writer's and
+	// otherwise restarts the optimizer on the learned parameters.
+	//
+	// A warm cache only has to follow the new job's records. At the
+	// learning rate that trains it from the seed, a hash grid keeps
+	// moving and loses more over a job than it had learned (2.6% darker
+	// after two resumed jobs), so warm starts train at a fraction of it.
+	// ----------------------------------------------------------------
+	static const uint32_t nrcCheckpointVersion = 1;
+
+	// everything a cache has learned; moments are two floats (first, second) per parameter
+	struct NrcCacheState
+	{
+		uint32_t			step = 0;			// Adam steps taken, 0 restarts the bias correction
+		std::vector<float>	weights;			// config.weightCount()
+		std::vector<float>	weightMoments;		// 2 * config.weightCount()
+		std::vector<float>	grid;				// config.gridParameterCount()
+		std::vector<float>	gridMoments;		// 2 * config.gridParameterCount()
+	};
+
+	// distances of the camera from the checkpoint's, as fractions of the scene diagonal
+	struct NrcCheckpointPolicy
+	{
+		float resumeDistance	= 0.1f;			// up to here training continues where the checkpoint stopped
+		float discardDistance	= FLT_MAX;		// past here the cache starts from the seed; in between Adam restarts
+		float learningRateScale	= 0.3f;			// of NrcSettings::learningRate, for a cache that did not start from the seed
+	};
+
+	enum class NrcWarmStart
+	{
+		Cold,			// no usable checkpoint, or discarded by the policy
+		Parameters,		// weights and grid, Adam restarted
+		Resumed,		// weights, grid and Adam state
+	};
+
+	const char* nrcWarmStartName(NrcWarmStart warmStart);
+
+	// key of the scene geometry, independent of any BVH build settings
+	uint64_t hashNrcScene(const float* positions, size_t positionCount, const uint32_t* indices, size_t indexCount);
+
+	// key of the parameter layout: layer count and hash grid
+	uint64_t hashNrcConfig(const NrcNetworkConfig& config);
+
+	// checkpoint file name of a scene and config inside directory
+	std::string nrcCheckpointPath(const std::string& directory, uint64_t sceneHash, const NrcNetworkConfig& config);
+
+	// writes state to path (through a temporary file), false on I/O errors or when the sizes do not fit config
+	bool saveNrcCheckpoint(const std::string& path, uint64_t sceneHash, const NrcNetworkConfig& config, const float camera[3],
+						   const NrcCacheState& state);
+
+	// Reads path into state and the writer's camera position. False when the file is missing, belongs to another
+	// scene or config, has another version, or a checksum fails; state is left untouched then.
+	bool loadNrcCheckpoint(const std::string& path, uint64_t sceneHash, const NrcNetworkConfig& config, float camera[3],
+						   NrcCacheState& state);
+
+	// Loads the checkpoint of the scene and config from directory and applies policy for a camera at camera in
+	// the scene bounds: with Parameters the moments are zeroed and the step reset, with Cold state is untouched.
+	NrcWarmStart loadNrcWarmStart(const std::string& directory, uint64_t sceneHash, const NrcNetworkConfig& config,
+								  const NrcCheckpointPolicy& policy, const float camera[3], const float sceneMin[3],
+								  const float sceneMax[3], NrcCacheState& state);
+}
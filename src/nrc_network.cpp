@@ -0,0 +1,578 @@
+#include <nrc_network.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace NRC
+{
+	// PCG hash stream in [0, 1)
+	struct NrcRandom
+	{
+		uint32_t state;
+
+		explicit NrcRandom(uint32_t seed) : state(seed * 747796405u + 2891336453u) {}
+
+		float operator()()
+		{
+			state = state * 747796405u + 1u;
+			uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+			word = (word >> 22) ^ word;
+			return float(word >> 8) / float(1u << 24);
+		}
+	};
+
+	NrcNetworkConfig validNrcConfig(const NrcNetworkConfig& config)
+	{
+		NrcNetworkConfig valid = config;
+		valid.hiddenLayers			= std::min(std::max(config.hiddenLayers, uint32_t(NRC_MIN_HIDDEN_LAYERS)), uint32_t(NRC_MAX_HIDDEN_LAYERS));
+		valid.gridFeatures			= std::min(std::max(config.gridFeatures, 1u), uint32_t(NRC_GRID_MAX_FEATURES));
+		valid.gridLevels			= std::min(std::min(config.gridLevels, uint32_t(NRC_GRID_MAX_LEVELS)), NRC_GRID_MAX_ENCODED / valid.gridFeatures);
+		valid.gridLog2TableSize		= std::min(config.gridLog2TableSize, uint32_t(NRC_GRID_MAX_LOG2_TABLE_SIZE));
+		valid.gridBaseResolution	= std::max(config.gridBaseResolution, 1.0f);
+		valid.gridPerLevelScale		= std::max(config.gridPerLevelScale, 1.0f);
+		valid.regionsPerAxis		= std::min(std::max(config.regionsPerAxis, 1u), uint32_t(NRC_MAX_REGIONS_PER_AXIS));
+		return valid;
+	}
+
+	std::vector<float> initializeNrcWeights(const NrcNetworkConfig& config, uint32_t seed)
+	{
+		NrcRandom random(seed);
+		std::vector<float> weights(config.weightCount(), 0.0f);
+		const uint32_t outputMatrix = config.matrixCount() - 1;
+		for (uint32_t region = 0; region < config.regionCount(); region++)
+		{
+			float* regionWeights = weights.data() + region * config.regionWeightCount();
+			for (uint32_t m = 0; m < config.matrixCount(); m++)
+			{
+				const uint32_t inputs	= m == 0 ? NRC_ENCODED_BIAS + 1 : NRC_WIDTH;
+				const uint32_t outputs	= m == outputMatrix ? NRC_OUTPUT_WIDTH : NRC_WIDTH;
+				const float bound = std::sqrt(6.0f / float(inputs));
+				for (uint32_t in = 0; in < inputs; in++)
+				{
+					for (uint32_t out = 0; out < outputs; out++)
+					{
+						regionWeights[nrcWeightIndex(m, out, in)] = bound * (2.0f * random() - 1.0f);
+					}
+				}
+			}
+		}
+		return weights;
+	}
+
+	std::vector<float> initializeNrcGrid(const NrcNetworkConfig& config, uint32_t seed)
+	{
+		NrcRandom random(seed ^ 0x9e3779b9u);
+		std::vector<float> grid(config.gridParameterCount());
+		for (float& parameter : grid)
+		{
+			parameter = 1e-4f * (2.0f * random() - 1.0f);
+		}
+		return grid;
+	}
+
+	void nrcUnitPosition(const NrcQuery& query, const float sceneMin[3], const float sceneScale[3], float unitPos[3])
+	{
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			unitPos[a] = std::min(std::max((query.position[a] - sceneMin[a]) * sceneScale[a], 0.0f), 1.0f);
+		}
+	}
+
+	uint32_t nrcRegionUnitPosition(const NrcNetworkConfig& config, const NrcQuery& query, const float sceneMin[3],
+								   const float sceneScale[3], float unitPos[3])
+	{
+		nrcUnitPosition(query, sceneMin, sceneScale, unitPos);
+		const uint32_t	regions	= config.regionsPerAxis;
+		uint32_t		region	= 0;
+		for (uint32_t a = 3; a-- > 0;)
+		{
+			const float		scaled	= unitPos[a] * float(regions);
+			const uint32_t	cell	= std::min(uint32_t(scaled), regions - 1);
+			unitPos[a]	= std::min(scaled - float(cell), 1.0f);
+			region		= region * regions + cell;
+		}
+		return region;
+	}
+
+	std::vector<uint32_t> nrcRegionCounts(const NrcNetworkConfig& config, const NrcTrainingRecord* records, uint32_t count,
+										  const float sceneMin[3], const float sceneScale[3])
+	{
+		std::vector<uint32_t> counts(config.regionCount(), 0);
+		for (uint32_t r = 0; r < count; r++)
+		{
+			float unitPos[3];
+			counts[nrcRegionUnitPosition(config, nrcQueryOf(records[r]), sceneMin, sceneScale, unitPos)]++;
+		}
+		return counts;
+	}
+
+	float nrcGridResolution(const NrcNetworkConfig& config, uint32_t level)
+	{
+		float resolution = config.gridBaseResolution;
+		for (uint32_t l = 0; l < level; l++)
+		{
+			resolution *= config.gridPerLevelScale;
+		}
+		return std::floor(resolution);
+	}
+
+	void nrcGridCorners(const NrcNetworkConfig& config, uint32_t level, const float unitPos[3], uint32_t entries[8], float weights[8])
+	{
+		const float		resolution	= nrcGridResolution(config, level);
+		const uint32_t	tableSize	= 1u << config.gridLog2TableSize;
+		const uint32_t	side		= uint32_t(resolution) + 1;
+		const bool		dense		= float(side) * float(side) * float(side) <= float(tableSize);
+
+		uint32_t	cell[3];
+		float		fraction[3];
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			const float scaled = unitPos[a] * resolution;
+			cell[a]		= std::min(uint32_t(scaled), side - 2);
+			fraction[a]	= scaled - float(cell[a]);
+		}
+
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			float		weight = 1.0f;
+			uint32_t	vertex[3];
+			for (uint32_t a = 0; a < 3; a++)
+			{
+				const uint32_t offset = (corner >> a) & 1u;
+				vertex[a]	= cell[a] + offset;
+				weight		*= offset != 0 ? fraction[a] : 1.0f - fraction[a];
+			}
+			const uint32_t entry = dense ? vertex[0] + (vertex[1] + vertex[2] * side) * side
+										 : (vertex[0] ^ (vertex[1] * NRC_GRID_PRIME_Y) ^ (vertex[2] * NRC_GRID_PRIME_Z)) & (tableSize - 1);
+			entries[corner] = level * tableSize + entry;
+			weights[corner] = weight;
+		}
+	}
+
+	// grid parameter i, of the fp32 parameters or of their fp16 copy
+	static float gridParameter(const float* grid, size_t i)
+	{
+		return grid[i];
+	}
+
+	static float gridParameter(const uint16_t* gridHalf, size_t i)
+	{
+		return nrcHalfToFloat(gridHalf[i]);
+	}
+
+	template <typename Parameter>
+	static void encodeInput(const NrcNetworkConfig& config, const Parameter* grid, const NrcQuery& query, const float sceneMin[3],
+							const float sceneScale[3], float* encoded)
+	{
+		float			unitPos[3];
+		const uint32_t	region = nrcRegionUnitPosition(config, query, sceneMin, sceneScale, unitPos);
+		if (config.gridLevels > 0)
+		{
+			grid += region * config.regionGridParameterCount();
+			std::fill(encoded, encoded + NRC_GRID_MAX_ENCODED, 0.0f);
+			for (uint32_t level = 0; level < config.gridLevels; level++)
+			{
+				uint32_t	entries[8];
+				float		weights[8];
+				nrcGridCorners(config, level, unitPos, entries, weights);
+				for (uint32_t corner = 0; corner < 8; corner++)
+				{
+					for (uint32_t c = 0; c < config.gridFeatures; c++)
+					{
+						encoded[level * config.gridFeatures + c] += weights[corner] * gridParameter(grid, size_t(entries[corner]) * config.gridFeatures + c);
+					}
+				}
+			}
+		}
+		for (uint32_t a = 0; a < 3; a++)
+		{
+			if (config.gridLevels == 0)
+			{
+				for (uint32_t f = 0; f < NRC_FREQUENCIES; f++)
+				{
+					const float angle = float(1u << f) * float(NRC_PI) * unitPos[a];
+					encoded[(a * NRC_FREQUENCIES + f) * 2 + 0] = std::sin(angle);
+					encoded[(a * NRC_FREQUENCIES + f) * 2 + 1] = std::cos(angle);
+				}
+			}
+			encoded[NRC_ENCODED_DIRECTION + a]	= query.direction[a];
+			encoded[NRC_ENCODED_NORMAL + a]		= query.normal[a];
+		}
+		encoded[NRC_ENCODED_BIAS] = 1.0f;
+		std::fill(encoded + NRC_ENCODED_BIAS + 1, encoded + NRC_WIDTH, 0.0f);
+	}
+
+	void nrcEncodeInput(const NrcNetworkConfig& config, const float* grid, const NrcQuery& query, const float sceneMin[3],
+						const float sceneScale[3], float* encoded)
+	{
+		encodeInput(config, grid, query, sceneMin, sceneScale, encoded);
+	}
+
+	void nrcEncodeInput(const NrcNetworkConfig& config, const uint16_t* gridHalf, const NrcQuery& query, const float sceneMin[3],
+						const float sceneScale[3], float* encoded)
+	{
+		encodeInput(config, gridHalf, query, sceneMin, sceneScale, encoded);
+	}
+
+	void nrcForward(const NrcNetworkConfig& config, const float* weights, const float* encoded, float* output)
+	{
+		float activations[NRC_WIDTH];
+		float next[NRC_WIDTH];
+		std::copy(encoded, encoded + NRC_WIDTH, activations);
+		for (uint32_t m = 0; m < config.matrixCount(); m++)
+		{
+			const bool relu = m < config.hiddenLayers;
+			for (uint32_t out = 0; out < NRC_WIDTH; out++)
+			{
+				float sum = 0.0f;
+				for (uint32_t in = 0; in < NRC_WIDTH; in++)
+				{
+					sum += weights[nrcWeightIndex(m, out, in)] * activations[in];
+				}
+				next[out] = relu ? std::max(sum, 0.0f) : sum;
+			}
+			std::copy(next, next + NRC_WIDTH, activations);
+		}
+		std::copy(activations, activations + NRC_OUTPUT_WIDTH, output);
+	}
+
+	// after Fabian Giesen's float_to_half_fast3_rtne and half_to_float
+	uint16_t nrcFloatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		uint32_t half;
+		if (bits >= (127u + 16u) << 23)
+		{
+			// past the largest half, or infinity and NaN
+			half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+		}
+		else if (bits < 113u << 23)
+		{
+			// subnormal or zero: adding 0.5 makes the float addition round the 10 mantissa bits into place
+			const uint32_t	magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+			float			magic;
+			float			magnitude;
+			memcpy(&magic, &magicBits, sizeof(magic));
+			memcpy(&magnitude, &bits, sizeof(magnitude));
+			magnitude += magic;
+			memcpy(&bits, &magnitude, sizeof(bits));
+			half = bits - magicBits;
+		}
+		else
+		{
+			// rebias the exponent and round to nearest even; a carry out of the mantissa bumps the exponent, up to infinity
+			const uint32_t odd = (bits >> 13) & 1u;
+			bits += ((15u - 127u) << 23) + 0xfffu + odd;
+			half = bits >> 13;
+		}
+		return uint16_t(half | (sign >> 16));
+	}
+
+	float nrcHalfToFloat(uint16_t half)
+	{
+		const uint32_t exponentMask = 0x7c00u << 13;
+		uint32_t bits = uint32_t(half & 0x7fffu) << 13;
+		const uint32_t exponent = bits & exponentMask;
+		bits += (127u - 15u) << 23;
+		float value;
+		if (exponent == exponentMask)
+		{
+			// infinity and NaN
+			bits += (128u - 16u) << 23;
+			memcpy(&value, &bits, sizeof(value));
+		}
+		else if (exponent == 0)
+		{
+			// subnormal or zero: renormalize with a float subtraction
+			bits += 1u << 23;
+			const uint32_t	magicBits = 113u << 23;
+			float			magic;
+			memcpy(&magic, &magicBits, sizeof(magic));
+			memcpy(&value, &bits, sizeof(value));
+			value -= magic;
+		}
+		else
+		{
+			memcpy(&value, &bits, sizeof(value));
+		}
+		return (half & 0x8000u) != 0 ? -value : value;
+	}
+
+	std::vector<uint16_t> nrcHalfCopy(const std::vector<float>& parameters)
+	{
+		std::vector<uint16_t> copy((parameters.size() + 1) & ~size_t(1), 0);
+		for (size_t p = 0; p < parameters.size(); p++)
+		{
+			copy[p] = nrcFloatToHalf(parameters[p]);
+		}
+		return copy;
+	}
+
+	void nrcForwardHalf(const NrcNetworkConfig& config, const uint16_t* weightsHalf, const float* encoded, float* output)
+	{
+		float activations[NRC_WIDTH];
+		float next[NRC_WIDTH];
+		for (uint32_t in = 0; in < NRC_WIDTH; in++)
+		{
+			activations[in] = nrcRoundToHalf(encoded[in]);
+		}
+		for (uint32_t m = 0; m < config.matrixCount(); m++)
+		{
+			const bool relu = m < config.hiddenLayers;
+			for (uint32_t out = 0; out < NRC_WIDTH; out++)
+			{
+				float sum = 0.0f;
+				for (uint32_t in = 0; in < NRC_WIDTH; in++)
+				{
+					sum += nrcHalfToFloat(weightsHalf[nrcWeightIndex(m, out, in)]) * activations[in];
+				}
+				next[out] = nrcRoundToHalf(relu ? std::max(sum, 0.0f) : sum);
+			}
+			std::copy(next, next + NRC_WIDTH, activations);
+		}
+		std::copy(activations, activations + NRC_OUTPUT_WIDTH, output);
+	}
+
+	float nrcLoss(const float* output, const float* target, float* gradient)
+	{
+		float loss = 0.0f;
+		for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+		{
+			const float difference	= output[c] - target[c];
+			const float denominator	= output[c] * output[c] + float(NRC_LOSS_EPSILON);
+			loss += difference * difference / denominator;
+			if (gradient != nullptr)
+			{
+				gradient[c] = 2.0f * difference / denominator;
+			}
+		}
+		return loss;
+	}
+
+	float nrcBackward(const NrcNetworkConfig& config, const float* weights, const float* encoded, const float* target,
+					  float gradientScale, float* gradients, float* inputGradients)
+	{
+		// inputs of every matrix
+		float layerInputs[NRC_MAX_HIDDEN_LAYERS + 1][NRC_WIDTH];
+		std::copy(encoded, encoded + NRC_WIDTH, layerInputs[0]);
+		float output[NRC_WIDTH];
+		for (uint32_t m = 0; m < config.matrixCount(); m++)
+		{
+			float* next = m < config.hiddenLayers ? layerInputs[m + 1] : output;
+			for (uint32_t out = 0; out < NRC_WIDTH; out++)
+			{
+				float sum = 0.0f;
+				for (uint32_t in = 0; in < NRC_WIDTH; in++)
+				{
+					sum += weights[nrcWeightIndex(m, out, in)] * layerInputs[m][in];
+				}
+				next[out] = m < config.hiddenLayers ? std::max(sum, 0.0f) : sum;
+			}
+		}
+
+		float deltas[NRC_WIDTH] = {};
+		const float loss = nrcLoss(output, target, deltas);
+		for (uint32_t c = 0; c < NRC_OUTPUT_WIDTH; c++)
+		{
+			deltas[c] *= gradientScale;
+		}
+		for (uint32_t m = config.matrixCount(); m-- > 0;)
+		{
+			for (uint32_t in = 0; in < NRC_WIDTH; in++)
+			{
+				for (uint32_t out = 0; out < NRC_WIDTH; out++)
+				{
+					gradients[nrcWeightIndex(m, out, in)] += layerInputs[m][in] * deltas[out];
+				}
+			}
+			if (m > 0)
+			{
+				float inputDeltas[NRC_WIDTH];
+				for (uint32_t in = 0; in < NRC_WIDTH; in++)
+				{
+					float sum = 0.0f;
+					for (uint32_t out = 0; out < NRC_WIDTH; out++)
+					{
+						sum += weights[nrcWeightIndex(m, out, in)] * deltas[out];
+					}
+					inputDeltas[in] = layerInputs[m][in] > 0.0f ? sum : 0.0f;
+				}
+				std::copy(inputDeltas, inputDeltas + NRC_WIDTH, deltas);
+			}
+		}
+		if (inputGradients != nullptr)
+		{
+			// the encoding has no activation, so no ReLU mask on the input
+			for (uint32_t in = 0; in < NRC_WIDTH; in++)
+			{
+				float sum = 0.0f;
+				for (uint32_t out = 0; out < NRC_WIDTH; out++)
+				{
+					sum += weights[nrcWeightIndex(0, out, in)] * deltas[out];
+				}
+				inputGradients[in] = sum;
+			}
+		}
+		return loss;
+	}
+
+	void nrcGridBackward(const NrcNetworkConfig& config, const float unitPos[3], const float* inputGradients, float* gridGradients)
+	{
+		for (uint32_t level = 0; level < config.gridLevels; level++)
+		{
+			uint32_t	entries[8];
+			float		weights[8];
+			nrcGridCorners(config, level, unitPos, entries, weights);
+			for (uint32_t corner = 0; corner < 8; corner++)
+			{
+				for (uint32_t c = 0; c < config.gridFeatures; c++)
+				{
+					gridGradients[size_t(entries[corner]) * config.gridFeatures + c] += weights[corner] * inputGradients[level * config.gridFeatures + c];
+				}
+			}
+		}
+	}
+
+	void nrcAdamStep(float* parameters, const float* gradients, float* moments, size_t count, uint32_t step, float learningRate)
+	{
+		const float beta1			= float(NRC_ADAM_BETA1);
+		const float beta2			= float(NRC_ADAM_BETA2);
+		const float correction1		= 1.0f - std::pow(beta1, float(step));
+		const float correction2		= 1.0f - std::pow(beta2, float(step));
+		for (size_t w = 0; w < count; w++)
+		{
+			const float g = gradients[w];
+			const float m = beta1 * moments[2 * w + 0] + (1.0f - beta1) * g;
+			const float v = beta2 * moments[2 * w + 1] + (1.0f - beta2) * g * g;
+			moments[2 * w + 0] = m;
+			moments[2 * w + 1] = v;
+			parameters[w] -= learningRate * (m / correction1) / (std::sqrt(v / correction2) + float(NRC_ADAM_EPSILON));
+		}
+	}
+
+
+	// -----
+	// Paths
+	// -----
+	NrcPathSettings validNrcPathSettings(const NrcPathSettings& settings, uint32_t width, uint32_t height)
+	{
+		NrcPathSettings valid = settings;
+		valid.cache.network		= validNrcConfig(settings.cache.network);
+		valid.trainingTile		= std::max(settings.trainingTile, 1u);
+		valid.cacheVertex		= std::min(settings.cacheVertex, std::min(uint32_t(NRC_PATH_MAX_RECORDS), uint32_t(NUM_TRACED_SEGMENTS) - 1));
+		valid.suffixVertices	= std::min(settings.suffixVertices,
+										   std::min(uint32_t(NRC_PATH_MAX_RECORDS), uint32_t(NUM_TRACED_SEGMENTS) - 1) - valid.cacheVertex);
+		// records of one frame never wrap onto each other before resolve has finished them
+		const uint32_t trainingPaths = ((width + valid.trainingTile - 1) / valid.trainingTile) * ((height + valid.trainingTile - 1) / valid.trainingTile);
+		valid.ringCapacity		= std::max({ settings.ringCapacity, trainingPaths * (valid.cacheVertex + valid.suffixVertices), 1u });
+		valid.spreadThreshold	= std::max(settings.spreadThreshold, 0.0f);
+		return valid;
+	}
+
+	void nrcTrainingOffset(const NrcPathSettings& settings, uint32_t frame, uint32_t offset[2])
+	{
+		NrcRandom random(settings.seed * 0x9E3779B9u + frame);
+		for (int a = 0; a < 2; a++)
+		{
+			offset[a] = std::min(uint32_t(random() * float(settings.trainingTile)), settings.trainingTile - 1);
+		}
+	}
+
+
+	// ---------
+	// Benchmark
+	// ---------
+	const float nrcBenchmarkSceneMin[3]		= { -1.0f, 0.0f, -1.0f };
+	const float nrcBenchmarkSceneMax[3]		= { 1.0f, 2.0f, 1.0f };
+	const float nrcBenchmarkSceneScale[3]	= { 0.5f, 0.5f, 0.5f };
+
+	// the radiance is smooth plus a finer pattern in the spirit of texture detail, which is where a hash grid beats the frequency encoding
+	NrcTrainingRecord makeNrcBenchmarkRecord(uint32_t& rngState)
+	{
+		auto random = [&rngState]()
+		{
+			rngState = rngState * 747796405u + 1u;
+			return float(rngState >> 8) / float(1u << 24);
+		};
+		NrcTrainingRecord record{};
+		const float z	= 2.0f * random() - 1.0f;
+		const float phi = 2.0f * float(NRC_PI) * random();
+		const float r	= std::sqrt(std::max(0.0f, 1.0f - z * z));
+		const uint32_t axis = uint32_t(random() * 3.0f) % 3;
+		for (int a = 0; a < 3; a++)
+		{
+			record.position[a]	= nrcBenchmarkSceneMin[a] + (nrcBenchmarkSceneMax[a] - nrcBenchmarkSceneMin[a]) * random();
+			record.normal[a]	= a == int(axis) ? 1.0f : 0.0f;
+		}
+		record.direction[0] = r * std::cos(phi);
+		record.direction[1] = r * std::sin(phi);
+		record.direction[2] = z;
+		for (int c = 0; c < NRC_OUTPUT_WIDTH; c++)
+		{
+			record.radiance[c] = 0.5f + 0.4f * std::sin(3.0f * record.position[0] + 2.0f * float(c)) * std::cos(2.0f * record.position[1])
+							   + 0.3f * std::max(record.direction[1], 0.0f) + 0.2f * record.normal[c]
+							   + 0.15f * std::sin(20.0f * record.position[0]) * std::sin(17.0f * record.position[2] + float(c));
+		}
+		return record;
+	}
+
+	NrcQuery nrcQueryOf(const NrcTrainingRecord& record)
+	{
+		NrcQuery query;
+		memcpy(query.position, record.position, sizeof(query.position));
+		memcpy(query.direction, record.direction, sizeof(query.direction));
+		memcpy(query.normal, record.normal, sizeof(query.normal));
+		return query;
+	}
+
+	std::vector<NrcNetworkConfig> nrcBenchmarkNetworks()
+	{
+		std::vector<NrcNetworkConfig> networks;
+		for (uint32_t hiddenLayers = NRC_MIN_HIDDEN_LAYERS; hiddenLayers <= NRC_MAX_HIDDEN_LAYERS; hiddenLayers++)
+		{
+			NrcNetworkConfig network;
+			network.hiddenLayers = hiddenLayers;
+			networks.push_back(network);
+		}
+		for (uint32_t hiddenLayers = NRC_MIN_HIDDEN_LAYERS; hiddenLayers <= NRC_MIN_HIDDEN_LAYERS + 1; hiddenLayers++)
+		{
+			NrcNetworkConfig network;
+			network.hiddenLayers	= hiddenLayers;
+			network.gridLevels		= 16;
+			network.gridFeatures	= 2;
+			networks.push_back(network);
+		}
+		// the first grid network split into eight regions, with as many grid parameters in all
+		NrcNetworkConfig partitioned = networks[NRC_MAX_HIDDEN_LAYERS - NRC_MIN_HIDDEN_LAYERS + 1];
+		partitioned.gridLog2TableSize	-= 3;
+		partitioned.regionsPerAxis		= 2;
+		networks.push_back(partitioned);
+		return networks;
+	}
+
+	std::string describeNrcNetwork(const NrcNetworkConfig& network)
+	{
+		char description[96];
+		if (network.gridLevels == 0)
+		{
+			snprintf(description, sizeof(description), "%u hidden layers, frequencies", network.hiddenLayers);
+		}
+		else
+		{
+			snprintf(description, sizeof(description), "%u hidden layers, grid %ux%u of 2^%u", network.hiddenLayers, network.gridLevels,
+					 network.gridFeatures, network.gridLog2TableSize);
+		}
+		if (network.regionCount() > 1)
+		{
+			const size_t length = strlen(description);
+			snprintf(description + length, sizeof(description) - length, ", %u regions", network.regionCount());
+		}
+		return description;
+	}
+}
@@ -0,0 +1,176 @@
+# pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "shaders/nrc_paths.h"
+
+namespace NRC
+{
+	struct NrcNetworkConfig
+	{
+		uint32_t hiddenLayers = 3;		// NRC_MIN_HIDDEN_LAYERS to NRC_MAX_HIDDEN_LAYERS
+
+		// multiresolution hash grid of the position in place of the frequency encoding when gridLevels > 0;
+		// gridLevels * gridFeatures features fill the first NRC_GRID_MAX_ENCODED inputs
+		uint32_t	gridLevels			= 0;		// up to NRC_GRID_MAX_LEVELS
+		uint32_t	gridFeatures		= 2;		// per level, up to NRC_GRID_MAX_FEATURES
+		uint32_t	gridLog2TableSize	= 16;		// entries per level, up to 2^NRC_GRID_MAX_LOG2_TABLE_SIZE
+		float		gridBaseResolution	= 16.0f;	// cells per axis of the coarsest level
+		float		gridPerLevelScale	= 1.5f;		// resolution growth from one level to the next
+
+		// > 1: the scene bounds split into regionsPerAxis^3 regions (up to NRC_MAX_REGIONS_PER_AXIS), each with a network
+		// and grid of the above of its own that only sees the positions inside it; the parameters go region by region.
+		// Neighbouring regions are not blended, so answers jump at the faces between them, and on the test scene the
+		// regions bring no lower error in less cache time (--bench nrcregions): a regression there, hence off by default
+		uint32_t	regionsPerAxis		= 1;
+
+		uint32_t	matrixCount() const					{ return hiddenLayers + 1; }
+		uint32_t	regionCount() const					{ return regionsPerAxis * regionsPerAxis * regionsPerAxis; }
+		size_t		regionWeightCount() const			{ return size_t(matrixCount()) * NRC_MATRIX_SIZE; }
+		size_t		regionGridParameterCount() const	{ return (size_t(gridLevels) << gridLog2TableSize) * gridFeatures; }
+		size_t		weightCount() const					{ return regionCount() * regionWeightCount(); }		// of all regions
+		size_t		gridParameterCount() const			{ return regionCount() * regionGridParameterCount(); }
+	};
+
+	struct NrcSettings
+	{
+		NrcNetworkConfig	network;
+		uint32_t			seed			= 1;		// of the initial weights
+		float				learningRate	= 1e-2f;	// Adam
+		bool				halfPrecision	= false;	// queries read fp16 copies of the weights and grid where supported
+		bool				asyncTraining	= false;	// training steps on a compute queue of their own where there is one
+	};
+
+	// config clamped to what the kernels support: the layer count, a grid whose features fit NRC_GRID_MAX_ENCODED, the regions
+	NrcNetworkConfig validNrcConfig(const NrcNetworkConfig& config);
+
+	// element (out, in) of matrix m in the layout of shaders/nrc.h
+	inline size_t nrcWeightIndex(uint32_t matrix, uint32_t out, uint32_t in)
+	{
+		return (size_t(matrix) * NRC_WIDTH + in) * NRC_WIDTH + out;
+	}
+
+	// ----------------------------------------------------------------
+	// Host reference of the NRC network, the ground truth the fused
+	// kernels are checked against. Scalar and unhurried on purpose.
+	// ----------------------------------------------------------------
+
+	// uniform He initialization of the ReLU layers of every region, reproducible for a seed; the weights of
+	// unused inputs (past NRC_ENCODED_BIAS) and of unused outputs of the last matrix are zero
+	std::vector<float> initializeNrcWeights(const NrcNetworkConfig& config, uint32_t seed);
+
+	// hash grid entries, uniform in +-1e-4 as in Instant NGP; empty without a grid
+	std::vector<float> initializeNrcGrid(const NrcNetworkConfig& config, uint32_t seed);
+
+	// position of a query in the scene bounds, mapped to [0, 1]
+	void nrcUnitPosition(const NrcQuery& query, const float sceneMin[3], const float sceneScale[3], float unitPos[3]);
+
+	// region of a query (0 with one region) and its position in the bounds of that region, mapped to [0, 1]; the weights
+	// of the region's network start at region * config.regionWeightCount(), its grid at region * config.regionGridParameterCount()
+	uint32_t nrcRegionUnitPosition(const NrcNetworkConfig& config, const NrcQuery& query, const float sceneMin[3],
+								   const float sceneScale[3], float unitPos[3]);
+
+	// training records of every region among count records; each region's network learns their mean loss
+	std::vector<uint32_t> nrcRegionCounts(const NrcNetworkConfig& config, const NrcTrainingRecord* records, uint32_t count,
+										  const float sceneMin[3], const float sceneScale[3]);
+
+	// cells per axis of a grid level, by repeated multiplication so the device computes the same value
+	float nrcGridResolution(const NrcNetworkConfig& config, uint32_t level);
+
+	// the eight table entries around a position on a grid level (in units of config.gridFeatures floats) and their trilinear weights
+	void nrcGridCorners(const NrcNetworkConfig& config, uint32_t level, const float unitPos[3], uint32_t entries[8], float weights[8]);
+
+	// NRC_WIDTH floats, as encodeQuery in shaders/nrc_mlp.h, for the network of the query's region; grid holds every region's
+	// grid and is ignored without grid levels
+	void nrcEncodeInput(const NrcNetworkConfig& config, const float* grid, const NrcQuery& query, const float sceneMin[3],
+						const float sceneScale[3], float* encoded);
+
+	// NRC_OUTPUT_WIDTH floats of radiance for one encoded input; weights of one region
+	void nrcForward(const NrcNetworkConfig& config, const float* weights, const float* encoded, float* output);
+
+	// IEEE half precision of the fp16 copies, rounded to nearest even; overflow becomes infinity
+	uint16_t nrcFloatToHalf(float value);
+	float nrcHalfToFloat(uint16_t half);
+
+	inline float nrcRoundToHalf(float value)
+	{
+		return nrcHalfToFloat(nrcFloatToHalf(value));
+	}
+
+	// fp16 copy of parameters, padded to an even count like the pairs nrc_adam.comp.glsl writes
+	std::vector<uint16_t> nrcHalfCopy(const std::vector<float>& parameters);
+
+	// nrcEncodeInput with the grid read from its fp16 copy
+	void nrcEncodeInput(const NrcNetworkConfig& config, const uint16_t* gridHalf, const NrcQuery& query, const float sceneMin[3],
+						const float sceneScale[3], float* encoded);
+
+	// nrcForward as nrc_query_half.comp.glsl computes it: the weights from their fp16 copy, the input and the output
+	// of every layer rounded to fp16, the sums in fp32
+	void nrcForwardHalf(const NrcNetworkConfig& config, const uint16_t* weightsHalf, const float* encoded, float* output);
+
+	// relative L2 loss of one output against its target; gradient (optional) receives d loss / d output
+	float nrcLoss(const float* output, const float* target, float* gradient);
+
+	// adds gradientScale times the weight gradient of one record's loss to gradients (regionWeightCount() floats) and,
+	// if inputGradients is given, stores the gradient with respect to the encoded input (NRC_WIDTH floats); returns the loss
+	float nrcBackward(const NrcNetworkConfig& config, const float* weights, const float* encoded, const float* target,
+					  float gradientScale, float* gradients, float* inputGradients = nullptr);
+
+	// adds the gradient of the grid entries of one record to gridGradients (the grid of the record's region), given its unit
+	// position in the region and the gradient of its encoded input
+	void nrcGridBackward(const NrcNetworkConfig& config, const float unitPos[3], const float* inputGradients, float* gridGradients);
+
+	// one Adam step over count parameters with the constants of shaders/nrc.h; moments holds two floats per parameter, step counts from 1
+	void nrcAdamStep(float* parameters, const float* gradients, float* moments, size_t count, uint32_t step, float learningRate);
+
+
+	// ----------------------------------------------------------------
+	// Rendering with the cache, shared by NrcRenderer and CpuRenderer
+	// (see shaders/nrc_paths.h)
+	// ----------------------------------------------------------------
+	struct NrcPathSettings
+	{
+		NrcSettings	cache;
+		uint32_t	trainingTile	= 8;		// one training path per trainingTile x trainingTile pixels
+		uint32_t	cacheVertex		= 1;		// path vertex where inference paths query the cache, 0 is the primary hit
+		uint32_t	suffixVertices	= 8;		// vertices training paths trace past the cache vertex before their own query
+		uint32_t	ringCapacity	= 1 << 16;	// training records kept; every frame trains one step on all of them
+		uint32_t	seed			= 1;		// of the training pixel offsets
+		// > 0: paths end where their area spread exceeds this many times the primary hit's footprint (0.01 in
+		// the NRC paper), at the cache vertex and after the suffix at the latest
+		float		spreadThreshold	= 0.0f;
+		// a cold cache answers with what its random weights make of a query and, training on its own answers, overshoots
+		// for a few dozen steps; until it has trained this many frames every path traces to the end as in the reference,
+		// no pixel asks it and the training paths teach it without asking it either. Warm starts skip this
+		uint32_t	warmupFrames	= 16;
+	};
+
+	// settings clamped to what the path kernels support (NRC_PATH_MAX_RECORDS, NUM_TRACED_SEGMENTS); the ring
+	// grows to hold the records of a frame of width x height pixels
+	NrcPathSettings validNrcPathSettings(const NrcPathSettings& settings, uint32_t width, uint32_t height);
+
+	// offset of the training pixels in frame, the same for every tile: pixel (x, y) trains when
+	// (x + offset[0]) % trainingTile and (y + offset[1]) % trainingTile are zero
+	void nrcTrainingOffset(const NrcPathSettings& settings, uint32_t frame, uint32_t offset[2]);
+
+
+	// ----------------------------------------------------------------
+	// Benchmark data shared by the device and the CPU implementations
+	// ----------------------------------------------------------------
+	extern const float nrcBenchmarkSceneMin[3];
+	extern const float nrcBenchmarkSceneMax[3];
+	extern const float nrcBenchmarkSceneScale[3];
+
+	// a point in the benchmark bounds with a random direction and an axis normal, and a radiance to learn; reproducible
+	NrcTrainingRecord makeNrcBenchmarkRecord(uint32_t& rngState);
+
+	NrcQuery nrcQueryOf(const NrcTrainingRecord& record);
+
+	// the frequency encoding at every depth, then shallow networks on a hash grid, the shallowest also split into eight regions
+	std::vector<NrcNetworkConfig> nrcBenchmarkNetworks();
+
+	// at most 46 characters ("5 hidden layers, grid 16x2 of 2^16, 27 regions"), the label column of the benchmark tables
+	std::string describeNrcNetwork(const NrcNetworkConfig& network);
+}
@@ -0,0 +1,412 @@
+#include <nrc_renderer.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace NRC
+{
+	static const uint32_t pixelCount = RENDER_WIDTH * RENDER_HEIGHT;
+
+	static const char* kernelFiles[] = {
+		"shaders/nrc_path.comp.glsl.spv",
+		"shaders/nrc_resolve.comp.glsl.spv",
+	};
+
+	// the renderer's own buffers in m_buffers, the others of the set belong to the cache
+	static const uint32_t ownBindings[] = {
+		BINDING_NRC_PATH_RNG,
+		BINDING_NRC_PATH_THROUGHPUT,
+		BINDING_NRC_PATH_RECORD_QUERIES,
+		BINDING_NRC_PATH_COUNTERS,
+	};
+	static const uint32_t countersBuffer = 3;
+
+	// make the writes of one dispatch (or transfer) visible to the next dispatch
+	static void computeBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	static void shaderToShaderBarrier(VkCommandBuffer cmdBuffer)
+	{
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	static void transferToShaderBarrier(VkCommandBuffer cmdBuffer)
+	{
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	// the copy of the ring cursor must not overtake the dispatches still reading or writing the counters
+	static void shaderToTransferBarrier(VkCommandBuffer cmdBuffer)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+
+	// -----------
+	// NrcRenderer
+	// -----------
+	void NrcRenderer::init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, VkAccelerationStructureKHR tlas,
+						   VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+						   VkBuffer indexBuffer, VkDeviceSize indexBytes, const float sceneMin[3], const float sceneMax[3],
+						   const NrcPathSettings& settings)
+	{
+		m_context		= &context;
+		m_settings		= validNrcPathSettings(settings, RENDER_WIDTH, RENDER_HEIGHT);
+		m_frames		= 0;
+		m_warmupFrames	= m_settings.warmupFrames;
+		m_imageBuffer	= imageBuffer;
+		m_imageBytes	= imageBytes;
+		// a query slot per pixel, the ring is the cache's training record buffer
+		m_cache.init(context, searchPaths, m_settings.cache, pixelCount, m_settings.ringCapacity, sceneMin, sceneMax);
+		std::copy(sceneMin, sceneMin + 3, m_sceneMin);
+		std::copy(sceneMax, sceneMax + 3, m_sceneMax);
+		createBuffers(imageBuffer, imageBytes, vertexBuffer, vertexBytes, indexBuffer, indexBytes, tlas);
+
+		// the path kernel would not load without subgroup arithmetic, so it gets no pipeline then
+		auto subgroupProperties = nvvk::make<VkPhysicalDeviceSubgroupProperties>();
+		auto properties			= nvvk::make<VkPhysicalDeviceProperties2>();
+		properties.pNext = &subgroupProperties;
+		vkGetPhysicalDeviceProperties2(context.m_physicalDevice, &properties);
+		m_pathSupported = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0
+					   && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_BASIC_BIT) != 0
+					   && (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) != 0;
+		if (m_pathSupported)
+		{
+			createPipelines(searchPaths);
+		}
+		if (m_cache.asyncTraining())
+		{
+			m_frameSemaphore	= createTimelineSemaphore(context.m_device);
+			m_frameValue		= 0;
+		}
+	}
+
+	void NrcRenderer::createBuffers(VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+									VkBuffer indexBuffer, VkDeviceSize indexBytes, VkAccelerationStructureKHR tlas)
+	{
+		const VkDevice device = m_context->m_device;
+
+		// ----------------
+		// Create Resources
+		// ----------------
+		const VkDeviceSize bufferSizes[4] = {
+			VkDeviceSize(pixelCount) * sizeof(uint32_t),						// BINDING_NRC_PATH_RNG
+			VkDeviceSize(pixelCount) * 4 * sizeof(float),						// BINDING_NRC_PATH_THROUGHPUT
+			VkDeviceSize(m_settings.ringCapacity) * sizeof(uint32_t),			// BINDING_NRC_PATH_RECORD_QUERIES
+			VkDeviceSize(NRC_COUNTER_COUNT) * sizeof(uint32_t),					// BINDING_NRC_PATH_COUNTERS
+		};
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		// createBuffer takes a command buffer for symmetry with the staged uploads, it records nothing
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			// the counters are read after every frame (records in the ring, rays traced)
+			const bool hostVisible = i == countersBuffer;
+			createBuffer(*m_context, unusedCmdBuffer, bufferSizes[i], &m_buffers[i], usage, &m_memories[i],
+						 hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+									 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		void* counters;
+		NVVK_CHECK(vkMapMemory(device, m_memories[countersBuffer], 0, VK_WHOLE_SIZE, 0, &counters));
+		m_counters = reinterpret_cast<uint32_t*>(counters);
+		std::fill(m_counters, m_counters + NRC_COUNTER_COUNT, 0u);
+
+
+		// -----------------------------------------
+		// Create Descriptor Set bindings and layout
+		// -----------------------------------------
+		// the four bindings of raytracer.comp.glsl followed by the path buffers (see shaders/nrc_paths.h)
+		std::array<VkDescriptorSetLayoutBinding, NRC_PATH_BINDING_COUNT> descriptorSetBindings{};
+		for (uint32_t i = 0; i < uint32_t(descriptorSetBindings.size()); i++)
+		{
+			descriptorSetBindings[i].binding			= i;
+			descriptorSetBindings[i].descriptorCount	= 1;
+			descriptorSetBindings[i].descriptorType		= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorSetBindings[i].stageFlags			= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		descriptorSetBindings[BINDING_TLAS].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = nvvk::make<VkDescriptorSetLayoutCreateInfo>();
+		descriptorSetLayoutCreateInfo.bindingCount	= uint32_t(descriptorSetBindings.size());
+		descriptorSetLayoutCreateInfo.pBindings		= descriptorSetBindings.data();
+		NVVK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
+
+		std::array<VkDescriptorPoolSize, 2> descriptorPoolSizes{};
+		descriptorPoolSizes[0].descriptorCount	= uint32_t(descriptorSetBindings.size()) - 1;
+		descriptorPoolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorPoolSizes[1].descriptorCount	= 1;
+		descriptorPoolSizes[1].type				= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
+		descriptorPoolCreateInfo.maxSets		= 1;
+		descriptorPoolCreateInfo.poolSizeCount	= uint32_t(descriptorPoolSizes.size());
+		descriptorPoolCreateInfo.pPoolSizes		= descriptorPoolSizes.data();
+		NVVK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool));
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = nvvk::make<VkDescriptorSetAllocateInfo>();
+		descriptorSetAllocateInfo.descriptorPool		= m_descriptorPool;
+		descriptorSetAllocateInfo.descriptorSetCount	= 1;
+		descriptorSetAllocateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		NVVK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &m_descriptorSet));
+
+
+		// --------------------------------
+		// Write and update descriptor sets
+		// --------------------------------
+		std::array<VkDescriptorBufferInfo, NRC_PATH_BINDING_COUNT> descriptorBufferInfos{};
+		descriptorBufferInfos[BINDING_IMAGEDATA]	= { imageBuffer, 0, imageBytes };
+		descriptorBufferInfos[BINDING_VERTICES]		= { vertexBuffer, 0, vertexBytes };
+		descriptorBufferInfos[BINDING_INDICES]		= { indexBuffer, 0, indexBytes };
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			descriptorBufferInfos[ownBindings[i]] = { m_buffers[i], 0, bufferSizes[i] };
+		}
+		descriptorBufferInfos[BINDING_NRC_PATH_QUERIES]	= { m_cache.buffer(BINDING_NRC_QUERIES), 0, m_cache.bufferSize(BINDING_NRC_QUERIES) };
+		descriptorBufferInfos[BINDING_NRC_PATH_RESULTS]	= { m_cache.buffer(BINDING_NRC_RESULTS), 0, m_cache.bufferSize(BINDING_NRC_RESULTS) };
+		descriptorBufferInfos[BINDING_NRC_PATH_RECORDS]	= { m_cache.buffer(BINDING_NRC_TRAINING), 0, m_cache.bufferSize(BINDING_NRC_TRAINING) };
+
+		auto descriptorAS = nvvk::make<VkWriteDescriptorSetAccelerationStructureKHR>();
+		descriptorAS.accelerationStructureCount = 1;
+		descriptorAS.pAccelerationStructures	= &tlas;
+
+		std::array<VkWriteDescriptorSet, NRC_PATH_BINDING_COUNT> writeDescriptorSets;
+		for (uint32_t i = 0; i < uint32_t(writeDescriptorSets.size()); i++)
+		{
+			writeDescriptorSets[i] = nvvk::make<VkWriteDescriptorSet>();
+			writeDescriptorSets[i].descriptorCount	= 1;
+			writeDescriptorSets[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSets[i].dstArrayElement	= 0;
+			writeDescriptorSets[i].dstBinding		= i;
+			writeDescriptorSets[i].dstSet			= m_descriptorSet;
+			writeDescriptorSets[i].pBufferInfo		= &descriptorBufferInfos[i];
+		}
+		writeDescriptorSets[BINDING_TLAS].descriptorType	= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		writeDescriptorSets[BINDING_TLAS].pBufferInfo		= nullptr;
+		writeDescriptorSets[BINDING_TLAS].pNext				= &descriptorAS;
+		vkUpdateDescriptorSets(device, uint32_t(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void NrcRenderer::createPipelines(const std::vector<std::string>& searchPaths)
+	{
+		const VkDevice device = m_context->m_device;
+
+		// one layout for both kernels: the descriptor set and NrcPathConstants
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset		= 0;
+		pushConstantRange.size			= sizeof(NrcPathConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = nvvk::make<VkPipelineLayoutCreateInfo>();
+		pipelineLayoutCreateInfo.setLayoutCount			= 1;
+		pipelineLayoutCreateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges	= &pushConstantRange;
+		NVVK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		for (uint32_t kernel = 0; kernel < KernelCount; kernel++)
+		{
+			VkShaderModule shaderModule = nvvk::createShaderModule(device, nvh::loadFile(kernelFiles[kernel], true, searchPaths));
+
+			VkPipelineShaderStageCreateInfo shaderStageCreateInfo = nvvk::make<VkPipelineShaderStageCreateInfo>();
+			shaderStageCreateInfo.stage		= VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStageCreateInfo.module	= shaderModule;
+			shaderStageCreateInfo.pName		= "main";
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = nvvk::make<VkComputePipelineCreateInfo>();
+			computePipelineCreateInfo.layout	= m_pipelineLayout;
+			computePipelineCreateInfo.stage		= shaderStageCreateInfo;
+			NVVK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_pipelines[kernel]));
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}
+	}
+
+	void NrcRenderer::deinit()
+	{
+		if (m_context == nullptr)
+		{
+			return;
+		}
+		const VkDevice device = m_context->m_device;
+		for (VkPipeline pipeline : m_pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+		vkUnmapMemory(device, m_memories[countersBuffer]);
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			vkDestroyBuffer(device, m_buffers[i], nullptr);
+			vkFreeMemory(device, m_memories[i], nullptr);
+		}
+		// render leaves no frame in flight
+		vkDestroySemaphore(device, m_frameSemaphore, nullptr);
+		m_cache.deinit();
+		*this = NrcRenderer();
+	}
+
+	void NrcRenderer::dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupsX, uint32_t groupsY, const NrcPathConstants& constants) const
+	{
+		// the cache's kernels bind a set of their own in between
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[kernel]);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(NrcPathConstants), &constants);
+		vkCmdDispatch(cmdBuffer, groupsX, groupsY, 1);
+	}
+
+	NrcRenderStats NrcRenderer::render(VkCommandPool cmdPool)
+	{
+		const VkDevice	device			= m_context->m_device;
+		const VkBuffer	counterBuffer	= m_buffers[countersBuffer];
+		const bool		async			= m_cache.asyncTraining();
+		if (!m_pathSupported)
+		{
+			return NrcRenderStats();
+		}
+
+		NrcPathConstants constants{};
+		constants.trainingTile		= m_settings.trainingTile;
+		constants.cacheVertex		= m_settings.cacheVertex;
+		constants.suffixVertices	= m_settings.suffixVertices;
+		constants.ringCapacity		= m_settings.ringCapacity;
+		constants.spreadThreshold	= m_settings.spreadThreshold;
+
+		// resolve covers every pixel and every record one frame can write
+		const uint32_t resolveGroups = (std::max(pixelCount, m_settings.ringCapacity) + NRC_PATH_WORKGROUP_SIZE - 1) / NRC_PATH_WORKGROUP_SIZE;
+
+		NrcRenderStats	stats;
+		const uint32_t	firstStep	= m_cache.trainingSteps();
+		uint32_t		ringCursor	= m_counters[NRC_COUNTER_RING_CURSOR];
+		uint32_t		raysTraced	= m_counters[NRC_COUNTER_RAYS_TRACED];
+		const uint32_t	firstCursor	= ringCursor;
+		const auto start = std::chrono::high_resolution_clock::now();
+		if (async)
+		{
+			m_cache.resetSnapshots(cmdPool);
+		}
+		for (uint32_t frame = 0; frame < NUM_SAMPLES; frame++, m_frames++)
+		{
+			// learn from the records of the frames so far: here, so this frame's queries see the new weights, or with async
+			// training on the compute queue alongside this frame, for the next one (see NeuralRadianceCache::submitTrain)
+			const uint32_t ringRecords	= std::min(ringCursor, m_settings.ringCapacity);
+			const uint32_t slot			= m_frames % 2;
+			const uint64_t previousStep	= m_cache.trainingValue();
+			if (async && ringRecords > 0)
+			{
+				m_cache.submitTrain(ringRecords, 1 - slot, m_frameSemaphore, m_frameValue);
+			}
+
+			VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(device, cmdPool);
+			// the paths add into the image, which starts from zero
+			if (frame == 0)
+			{
+				vkCmdFillBuffer(cmdBuffer, m_imageBuffer, 0, m_imageBytes, 0);
+				transferToShaderBarrier(cmdBuffer);
+			}
+			if (!async && ringRecords > 0)
+			{
+				m_cache.recordTrain(cmdBuffer, ringRecords);
+			}
+
+			// resolve finishes the records written after this point
+			shaderToTransferBarrier(cmdBuffer);
+			VkBufferCopy frameStart{};
+			frameStart.srcOffset	= NRC_COUNTER_RING_CURSOR * sizeof(uint32_t);
+			frameStart.dstOffset	= NRC_COUNTER_FRAME_START * sizeof(uint32_t);
+			frameStart.size			= sizeof(uint32_t);
+			vkCmdCopyBuffer(cmdBuffer, counterBuffer, counterBuffer, 1, &frameStart);
+			transferToShaderBarrier(cmdBuffer);
+
+			constants.frame		= frame;
+			constants.warmup	= m_warmupFrames > 0;
+			nrcTrainingOffset(m_settings, m_frames, constants.trainingOffset);
+			dispatch(cmdBuffer, KernelPath, (RENDER_WIDTH + WORKGROUP_WIDTH - 1) / WORKGROUP_WIDTH,
+					 (RENDER_HEIGHT + WORKGROUP_HEIGHT - 1) / WORKGROUP_HEIGHT, constants);
+			shaderToShaderBarrier(cmdBuffer);
+
+			// with async training the queries wait for the step of the previous frame, the paths above do not; while the cache
+			// warms up no path leaves a query
+			VkCommandBuffer pathCmdBuffer = VK_NULL_HANDLE;
+			if (async)
+			{
+				pathCmdBuffer = cmdBuffer;
+				submitTimelineCommandRecord(m_context->m_queueGCT, pathCmdBuffer, VK_NULL_HANDLE, 0, 0, VK_NULL_HANDLE, 0);
+				cmdBuffer = beginSingleTimeCommandRecord(device, cmdPool);
+				if (!constants.warmup)
+				{
+					m_cache.recordQuery(cmdBuffer, pixelCount, slot);
+				}
+			}
+			else if (!constants.warmup)
+			{
+				m_cache.recordQuery(cmdBuffer, pixelCount);
+			}
+			shaderToShaderBarrier(cmdBuffer);
+			dispatch(cmdBuffer, KernelResolve, resolveGroups, 1, constants);
+			if (async)
+			{
+				m_cache.recordCopyTrainingRecords(cmdBuffer, slot);
+			}
+
+			auto hostBarrier = nvvk::make<VkMemoryBarrier>();
+			hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+			if (async)
+			{
+				m_frameValue++;
+				submitTimelineCommandRecord(m_context->m_queueGCT, cmdBuffer, m_cache.trainingSemaphore(), previousStep,
+											VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, m_frameSemaphore, m_frameValue);
+				waitTimelineSemaphore(device, m_frameSemaphore, m_frameValue);
+				const VkCommandBuffer cmdBuffers[2] = { pathCmdBuffer, cmdBuffer };
+				vkFreeCommandBuffers(device, cmdPool, 2, cmdBuffers);
+			}
+			else
+			{
+				endSubmitSingleTimeCommandRecord(device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+			}
+			ringCursor		= m_counters[NRC_COUNTER_RING_CURSOR];
+			m_warmupFrames	= m_warmupFrames > 0 ? m_warmupFrames - 1 : 0;
+		}
+		// the step on the last frame's records, so the cache holds what it learned
+		m_cache.waitForTraining();
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		stats.seconds			= std::chrono::duration<double>(end - start).count();
+		stats.raysTraced		= m_counters[NRC_COUNTER_RAYS_TRACED] - raysTraced;
+		stats.trainingRecords	= ringCursor - firstCursor;
+		stats.trainingSteps		= m_cache.trainingSteps() - firstStep;
+		return stats;
+	}
+
+	NrcWarmStart NrcRenderer::loadCheckpoint(VkCommandPool cmdPool, const std::string& directory, uint64_t sceneHash,
+											 const NrcCheckpointPolicy& policy)
+	{
+		const float		camera[3] = { float(CAMERA_ORIGIN_X), float(CAMERA_ORIGIN_Y), float(CAMERA_ORIGIN_Z) };
+		NrcCacheState	state;
+		const NrcWarmStart warmStart = loadNrcWarmStart(directory, sceneHash, m_cache.config(), policy, camera, m_sceneMin, m_sceneMax, state);
+		if (warmStart != NrcWarmStart::Cold)
+		{
+			m_cache.uploadState(cmdPool, state);
+			m_cache.setLearningRate(m_cache.learningRate() * policy.learningRateScale);
+			m_warmupFrames = 0;
+		}
+		return warmStart;
+	}
+
+	bool NrcRenderer::saveCheckpoint(VkCommandPool cmdPool, const std::string& directory, uint64_t sceneHash) const
+	{
+		const float camera[3] = { float(CAMERA_ORIGIN_X), float(CAMERA_ORIGIN_Y), float(CAMERA_ORIGIN_Z) };
+		return saveNrcCheckpoint(nrcCheckpointPath(directory, sceneHash, m_cache.config()), sceneHash, m_cache.config(), camera,
+								 m_cache.downloadState(cmdPool));
+	}
+}
@@ -0,0 +1,102 @@
+# pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <utility.h>
+#include <nrc_cache.h>
+
+namespace NRC
+{
+	struct NrcRenderStats
+	{
+		double		seconds			= 0.0;
+		uint64_t	raysTraced		= 0;
+		uint64_t	trainingRecords	= 0;		// written into the ring over the render
+		uint32_t	trainingSteps	= 0;
+		double raysPerSecond() const { return seconds > 0.0 ? double(raysTraced) / seconds : 0.0; }
+	};
+
+	// ----------------------------------------------------------------
+	// Path tracer that ends its paths in the neural radiance cache.
+	//
+	// raytracer.comp.glsl runs every path to the end in one invocation
+	// per pixel. Here every one of the NUM_SAMPLES samples is a frame:
+	// a training step on the records of the previous frames, then
+	// nrc_path.comp.glsl traces one short path per pixel into a cache
+	// query and a sparse set of long training paths whose vertices go
+	// into the record ring, then the query kernel of the cache answers
+	// all pixels and nrc_resolve.comp.glsl adds the answers to the
+	// image and completes the self-training targets. Each frame is one
+	// submission, so the host knows how many records the ring holds
+	// when it records the next training step. The cache keeps learning
+	// across renders.
+	//
+	// With NrcSettings::asyncTraining the step runs on the compute
+	// queue instead, alongside the frame, and a frame's queries use the
+	// weights of the step submitted with the previous frame. Timeline
+	// semaphores order the two queues: the step waits for the frame
+	// whose records it trains on, the queries (not the paths) of the
+	// next frame wait for the step.
+	// ----------------------------------------------------------------
+	class NrcRenderer
+	{
+	public:
+		// searchPaths locate shaders/nrc_*.comp.glsl.spv; sceneMin/sceneMax bound the vertices
+		void init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, VkAccelerationStructureKHR tlas,
+				  VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+				  VkBuffer indexBuffer, VkDeviceSize indexBytes, const float sceneMin[3], const float sceneMax[3],
+				  const NrcPathSettings& settings);
+		void deinit();
+
+		const NrcPathSettings&		settings() const	{ return m_settings; }
+		const NeuralRadianceCache&	cache() const		{ return m_cache; }
+		// nrc_path.comp.glsl sums its ray counts with subgroup arithmetic in compute shaders; without it render does nothing
+		bool						pathSupported() const	{ return m_pathSupported; }
+
+		// all NUM_SAMPLES frames into the image, waits for the queue after each and for the last training step
+		NrcRenderStats render(VkCommandPool cmdPool);
+
+		// continues from the checkpoint of sceneHash and the cache's network in directory as far as policy allows
+		// for the camera (see nrc_checkpoint.h); Cold leaves the cache as it is
+		NrcWarmStart loadCheckpoint(VkCommandPool cmdPool, const std::string& directory, uint64_t sceneHash, const NrcCheckpointPolicy& policy);
+		// writes what the cache has learned for the next job, false on I/O errors
+		bool saveCheckpoint(VkCommandPool cmdPool, const std::string& directory, uint64_t sceneHash) const;
+
+	private:
+		enum Kernel
+		{
+			KernelPath,
+			KernelResolve,
+			KernelCount
+		};
+
+		void createBuffers(VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+						   VkBuffer indexBuffer, VkDeviceSize indexBytes, VkAccelerationStructureKHR tlas);
+		void createPipelines(const std::vector<std::string>& searchPaths);
+		void dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupsX, uint32_t groupsY, const NrcPathConstants& constants) const;
+
+		const nvvk::Context*						m_context				= nullptr;
+		NrcPathSettings								m_settings;
+		NeuralRadianceCache							m_cache;
+		uint32_t									m_frames				= 0;		// over all renders, for the training offsets
+		uint32_t									m_warmupFrames			= 0;		// left, see NrcPathSettings::warmupFrames
+		bool										m_pathSupported			= false;
+		VkSemaphore									m_frameSemaphore		= VK_NULL_HANDLE;	// async training: frames done
+		uint64_t									m_frameValue			= 0;
+		VkDescriptorSetLayout						m_descriptorSetLayout	= VK_NULL_HANDLE;
+		VkDescriptorPool							m_descriptorPool		= VK_NULL_HANDLE;
+		VkDescriptorSet								m_descriptorSet			= VK_NULL_HANDLE;
+		VkPipelineLayout							m_pipelineLayout		= VK_NULL_HANDLE;
+		std::array<VkPipeline, KernelCount>			m_pipelines{};
+
+		// random states, query throughputs, record queries and counters (BINDING_NRC_PATH_*, without the cache's buffers)
+		std::array<VkBuffer, 4>						m_buffers{};
+		std::array<VkDeviceMemory, 4>				m_memories{};
+		uint32_t*									m_counters				= nullptr;		// mapped, host-visible
+		VkBuffer									m_imageBuffer			= VK_NULL_HANDLE;
+		VkDeviceSize								m_imageBytes			= 0;
+		float										m_sceneMin[3]			= {};
+		float										m_sceneMax[3]			= {};
+	};
+}
@@ -0,0 +1,36 @@
+#ifndef NRC_COMMON_H
+#define NRC_COMMON_H
+
+// ------------------------------------------------------------------
+// Shared between the shaders and the C++ side (Vulkan host code and
+// the CPU backend), so both backends render the same image.
+// ------------------------------------------------------------------
+
+// output image
+#define RENDER_WIDTH			800
+#define RENDER_HEIGHT			600
+
+// compute workgroup, also the tile size of the CPU backend
+#define WORKGROUP_WIDTH			16
+#define WORKGROUP_HEIGHT		8
+
+// sampling
+#define NUM_SAMPLES				64		// paths per pixel
+#define NUM_TRACED_SEGMENTS		32		// maximum segments per path
+
+// pinhole camera looking down -z
+#define CAMERA_ORIGIN_X			-0.001
+#define CAMERA_ORIGIN_Y			1.0
+#define CAMERA_ORIGIN_Z			6.0
+#define CAMERA_FOV_VERTICAL_SLOPE	(1.0 / 5.0)
+
+// all surfaces are diffuse with this albedo
+#define SURFACE_ALBEDO			0.7
+
+// descriptor bindings of raytracer.comp.glsl
+#define BINDING_IMAGEDATA		0
+#define BINDING_TLAS			1
+#define BINDING_VERTICES		2
+#define BINDING_INDICES			3
+
+#endif // NRC_COMMON_H
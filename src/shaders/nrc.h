@@ -0,0 +1,216 @@
+#ifndef NRC_NRC_H
+#define NRC_NRC_H
+
+// -----------------------------------------------------------------
+// Layout shared by the neural radiance cache kernels (nrc_*.comp.glsl),
+// NeuralRadianceCache and the host reference (nrc_network.h).
+//
+// The network is a fully-connected MLP without biases, NRC_WIDTH
+// neurons wide, with 2 to NRC_MAX_HIDDEN_LAYERS ReLU hidden layers
+// and a linear radiance output. Every matrix, including the input and
+// output ones, is stored as NRC_WIDTH x NRC_WIDTH floats so the fused
+// kernels handle all layers alike; unused rows and columns are zero.
+// Element (out, in) of matrix m is at (m * NRC_WIDTH + in) * NRC_WIDTH + out,
+// so the threads of a workgroup (one per output neuron) read
+// consecutive floats.
+//
+// With half precision the weights and the hash grid also have fp16
+// copies in the same layout, which nrc_query_half.comp.glsl reads
+// into fp16 shared memory: half the memory traffic of a query and
+// half the shared memory per layer. The fp32 parameters stay the
+// master copy; training and Adam work on them and Adam rounds every
+// updated parameter into the copy.
+// -----------------------------------------------------------------
+#include "common.h"
+
+#define NRC_WIDTH					64
+#define NRC_MIN_HIDDEN_LAYERS		2
+#define NRC_MAX_HIDDEN_LAYERS		5
+#define NRC_MATRIX_SIZE				(NRC_WIDTH * NRC_WIDTH)
+#define NRC_OUTPUT_WIDTH			3		// radiance
+
+// encoded input: sin/cos of the normalized position at NRC_FREQUENCIES octaves per axis,
+// then the direction, the normal and a constant one that stands in for the first layer's bias
+#define NRC_FREQUENCIES				6
+#define NRC_ENCODED_DIRECTION		(3 * 2 * NRC_FREQUENCIES)
+#define NRC_ENCODED_NORMAL			(NRC_ENCODED_DIRECTION + 3)
+#define NRC_ENCODED_BIAS			(NRC_ENCODED_NORMAL + 3)
+#define NRC_PI						3.14159265
+
+// multiresolution hash grid (Instant NGP) in place of the frequencies: gridLevels levels of gridFeatures
+// features each, trilinearly interpolated from 2^gridLog2TableSize entries per level. Levels whose
+// vertices fit the table are indexed densely, the finer ones through a spatial hash.
+#define NRC_GRID_MAX_LEVELS				16
+#define NRC_GRID_MAX_FEATURES			4
+#define NRC_GRID_MAX_LOG2_TABLE_SIZE	20
+#define NRC_GRID_MAX_ENCODED			NRC_ENCODED_DIRECTION		// gridLevels * gridFeatures at most
+#define NRC_GRID_PRIME_Y				2654435761u
+#define NRC_GRID_PRIME_Z				805459861u
+
+// fused inference: one thread per neuron, NRC_QUERY_BATCH queries per workgroup,
+// evaluated in blocks of NRC_QUERY_BLOCK accumulators per thread
+#define NRC_WORKGROUP_SIZE			NRC_WIDTH
+#define NRC_QUERY_BATCH				64
+#define NRC_QUERY_BLOCK				16
+// shared memory of the query kernels: a matrix and the activations of the batch (nrc_mlp.h), fp32 and fp16
+#define NRC_QUERY_SHARED_BYTES		((NRC_MATRIX_SIZE + NRC_QUERY_BATCH * NRC_WIDTH) * 4)
+#define NRC_QUERY_HALF_SHARED_BYTES	((NRC_MATRIX_SIZE + NRC_QUERY_BATCH * NRC_WIDTH) * 2)
+
+// fused training: NRC_TRAIN_SLICES threads per neuron, each with NRC_TRAIN_ROWS_PER_SLICE records
+// of a batch; NRC_TRAIN_GROUPS persistent workgroups accumulate into gradient slices of their own
+#define NRC_TRAIN_SLICES			4
+#define NRC_TRAIN_ROWS_PER_SLICE	4
+#define NRC_TRAIN_BATCH				(NRC_TRAIN_SLICES * NRC_TRAIN_ROWS_PER_SLICE)
+#define NRC_TRAIN_WORKGROUP_SIZE	(NRC_WIDTH * NRC_TRAIN_SLICES)
+#define NRC_TRAIN_GROUPS			128
+#define NRC_GRADIENT_STRIDE			((NRC_MAX_HIDDEN_LAYERS + 1) * NRC_MATRIX_SIZE)		// floats per workgroup slice
+// shared memory of nrc_train.comp.glsl: the input of every matrix and the deltas, rows of NRC_WIDTH + 1 floats
+#define NRC_TRAIN_SHARED_BYTES		((NRC_MAX_HIDDEN_LAYERS + 2) * NRC_TRAIN_BATCH * (NRC_WIDTH + 1) * 4)
+
+// spatially partitioned cache: with regionsPerAxis > 1 the scene bounds are split into regionsPerAxis^3 regions, each
+// with a network and hash grid of its own, stored region by region (the weights of region r start at
+// r * (hiddenLayers + 1) * NRC_MATRIX_SIZE). nrc_bin.comp.glsl sorts the queries and training records by region
+// first, so every query batch and every training workgroup evaluates a single small network.
+#define NRC_MAX_REGIONS_PER_AXIS	4
+#define NRC_MAX_REGIONS				(NRC_MAX_REGIONS_PER_AXIS * NRC_MAX_REGIONS_PER_AXIS * NRC_MAX_REGIONS_PER_AXIS)
+#define NRC_BIN_WORKGROUP_SIZE		256
+
+// passes of nrc_bin.comp.glsl (binPass), on the queries or with NRC_BIN_RECORDS on the training records: count
+// per region, their start in the order (a region's queries start at a multiple of NRC_QUERY_BATCH), then the indices
+#define NRC_BIN_COUNT				0
+#define NRC_BIN_SCAN				1
+#define NRC_BIN_SCATTER				2
+#define NRC_BIN_RECORDS				4
+
+// relative L2 loss (y - t)^2 / (y^2 + NRC_LOSS_EPSILON), y not differentiated in the denominator
+#define NRC_LOSS_EPSILON			0.01
+
+// Adam, one thread per pair of parameters (the fp16 copies are written as pairs)
+#define NRC_ADAM_WORKGROUP_SIZE		256
+#define NRC_ADAM_BETA1				0.9
+#define NRC_ADAM_BETA2				0.99
+#define NRC_ADAM_EPSILON			1e-8
+
+// descriptor bindings of the NRC kernels
+#define BINDING_NRC_WEIGHTS			0
+#define BINDING_NRC_QUERIES			1
+#define BINDING_NRC_RESULTS			2
+#define BINDING_NRC_TRAINING		3
+#define BINDING_NRC_GRADIENTS		4
+#define BINDING_NRC_ADAM			5		// first and second moment per weight
+#define BINDING_NRC_GRID			6
+#define BINDING_NRC_GRID_GRADIENTS	7
+#define BINDING_NRC_GRID_ADAM		8
+#define BINDING_NRC_WEIGHTS_HALF	9		// fp16 copies, with halfPrecision
+#define BINDING_NRC_GRID_HALF		10
+#define BINDING_NRC_QUERY_REGIONS	11		// NrcRegionTable of the queries, with regionsPerAxis > 1
+#define BINDING_NRC_QUERY_ORDER		12		// query indices by region, ~0 where a region's range is padded
+#define BINDING_NRC_RECORD_REGIONS	13		// the same for the training records, without padding
+#define BINDING_NRC_RECORD_ORDER	14
+#define NRC_BINDING_COUNT			15
+
+// position.w, direction.w, normal.w, radiance.w: unused
+#define NRC_QUERY_SIZE				48
+#define NRC_TRAINING_RECORD_SIZE	64
+
+#ifdef __cplusplus
+#include <cstdint>
+namespace NRC
+{
+	struct NrcQuery
+	{
+		float	position[4];
+		float	direction[4];
+		float	normal[4];
+	};
+
+	// a query and the radiance the cache should answer with
+	struct NrcTrainingRecord
+	{
+		float	position[4];
+		float	direction[4];
+		float	normal[4];
+		float	radiance[4];
+	};
+
+	struct NrcConstants
+	{
+		uint32_t	queryCount;
+		uint32_t	hiddenLayers;
+		uint32_t	trainingCount;
+		uint32_t	trainingGroups;		// workgroups of the training dispatch, whose gradient slices Adam sums
+		float		sceneMin[4];
+		float		sceneScale[4];		// 1 / scene extent, positions are encoded in [0, 1]
+		float		learningRate;
+		uint32_t	step;				// Adam step, from 1
+		uint32_t	gridLevels;			// 0: frequency encoding
+		uint32_t	gridFeatures;
+		uint32_t	gridLog2TableSize;
+		float		gridBaseResolution;
+		float		gridPerLevelScale;
+		uint32_t	halfPrecision;		// nonzero: Adam also rounds the parameters into the fp16 copies
+		uint32_t	regionsPerAxis;		// 1: a single network
+		uint32_t	binPass;			// NRC_BIN_*, of nrc_bin.comp.glsl
+	};
+
+	struct NrcRegionTable
+	{
+		uint32_t	counts[NRC_MAX_REGIONS];
+		uint32_t	starts[NRC_MAX_REGIONS + 1];
+		uint32_t	cursors[NRC_MAX_REGIONS];
+	};
+}
+#else
+struct NrcQuery
+{
+	vec4 position;
+	vec4 direction;
+	vec4 normal;
+};
+
+struct NrcTrainingRecord
+{
+	vec4 position;
+	vec4 direction;
+	vec4 normal;
+	vec4 radiance;
+};
+
+struct NrcRegionTable
+{
+	uint counts[NRC_MAX_REGIONS];
+	uint starts[NRC_MAX_REGIONS + 1];
+	uint cursors[NRC_MAX_REGIONS];
+};
+
+// kernels of other passes that only share the structs (nrc_paths.h) push constants of their own
+#ifndef NRC_OWN_PUSH_CONSTANTS
+layout(push_constant) uniform NrcConstants
+{
+	uint queryCount;
+	uint hiddenLayers;
+	uint trainingCount;
+	uint trainingGroups;
+	vec4 sceneMin;
+	vec4 sceneScale;
+	float learningRate;
+	uint step;
+	uint gridLevels;
+	uint gridFeatures;
+	uint gridLog2TableSize;
+	float gridBaseResolution;
+	float gridPerLevelScale;
+	uint halfPrecision;
+	uint regionsPerAxis;
+	uint binPass;
+} constants;
+
+// networks of the cache, one per region
+uint nrcRegionCount()
+{
+	return constants.regionsPerAxis * constants.regionsPerAxis * constants.regionsPerAxis;
+}
+#endif
+#endif
+
+#endif
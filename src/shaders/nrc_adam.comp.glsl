@@ -0,0 +1,79 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "nrc.h"
+#include "nrc_bindings.h"
+
+layout(local_size_x = NRC_ADAM_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// first and second moment after one step
+vec2 adamMoments(vec2 moments, float g)
+{
+	return vec2(mix(g, moments.x, NRC_ADAM_BETA1), mix(g * g, moments.y, NRC_ADAM_BETA2));
+}
+
+float adamUpdate(vec2 moments)
+{
+	const float mHat = moments.x / (1.0 - pow(NRC_ADAM_BETA1, float(constants.step)));
+	const float vHat = moments.y / (1.0 - pow(NRC_ADAM_BETA2, float(constants.step)));
+	return constants.learningRate * mHat / (sqrt(vHat) + NRC_ADAM_EPSILON);
+}
+
+// one Adam step on parameter p, a weight below weightCount (of all regions), else a hash grid entry; returns its new
+// value. The gradient of a weight is the sum of the slices of the training workgroups of its region, the grid's is
+// cleared for the next step once read.
+float adamParameter(uint p, uint weightCount)
+{
+	if (p < weightCount)
+	{
+		const uint regionWeights = (constants.hiddenLayers + 1) * NRC_MATRIX_SIZE;
+		const uint region = p / regionWeights;
+		float g = 0.0;
+		for (uint group = region; group < constants.trainingGroups; group += nrcRegionCount())
+		{
+			g += gradients[group * NRC_GRADIENT_STRIDE + p % regionWeights];
+		}
+
+		// weights that never receive a gradient (the padding) keep zero moments and do not move
+		const vec2 moments = adamMoments(adamMoments[p], g);
+		adamMoments[p] = moments;
+		const float weight = weights[p] - adamUpdate(moments);
+		weights[p] = weight;
+		return weight;
+	}
+	const uint	e		= p - weightCount;
+	const float	g		= uintBitsToFloat(gridGradientBits[e]);
+	gridGradientBits[e] = 0;
+
+	const vec2 moments = adamMoments(gridAdamMoments[e], g);
+	gridAdamMoments[e] = moments;
+	const float parameter = grid[e] - adamUpdate(moments);
+	grid[e] = parameter;
+	return parameter;
+}
+
+// One Adam step, one thread per pair of parameters, which with halfPrecision it also rounds into the fp16 copy
+// (packed, so this kernel needs no 16-bit storage). The weight count is even, so no pair spans the weights and
+// the grid. The workgroups stride over the pairs since a large table needs more of them than a dispatch allows.
+void main()
+{
+	const uint weightCount		= nrcRegionCount() * (constants.hiddenLayers + 1) * NRC_MATRIX_SIZE;
+	const uint parameterCount	= weightCount + nrcRegionCount() * ((constants.gridLevels << constants.gridLog2TableSize) * constants.gridFeatures);
+	for (uint pair = gl_GlobalInvocationID.x; 2 * pair < parameterCount; pair += gl_NumWorkGroups.x * NRC_ADAM_WORKGROUP_SIZE)
+	{
+		const uint p		= 2 * pair;
+		const vec2 updated	= vec2(adamParameter(p, weightCount), p + 1 < parameterCount ? adamParameter(p + 1, weightCount) : 0.0);
+		if (constants.halfPrecision != 0)
+		{
+			if (p < weightCount)
+			{
+				weightHalfPairs[pair] = packHalf2x16(updated);
+			}
+			else
+			{
+				gridHalfPairs[pair - weightCount / 2] = packHalf2x16(updated);
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "nrc.h"
+#include "nrc_bindings.h"
+#include "nrc_encoding.h"
+
+layout(local_size_x = NRC_BIN_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// Counting sort of the queries or training records by region, for a
+// partitioned cache. Three dispatches, one pass each (binPass): count
+// the items of every region, turn the counts into the start of every
+// region in the order (a single thread, there are NRC_MAX_REGIONS at
+// most), and scatter the item indices. NeuralRadianceCache clears the
+// table before counting and the query order (to ~0) before scattering,
+// so the padding at the end of a region's queries reads as no query.
+// The order within a region is whatever the atomics make of it.
+// ------------------------------------------------------------------
+
+void main()
+{
+	const bool	records	= (constants.binPass & NRC_BIN_RECORDS) != 0;
+	const uint	pass	= constants.binPass & ~uint(NRC_BIN_RECORDS);
+	const uint	count	= records ? constants.trainingCount : constants.queryCount;
+
+	if (pass == NRC_BIN_SCAN)
+	{
+		if (gl_GlobalInvocationID.x == 0)
+		{
+			uint start = 0;
+			for (uint region = 0; region < nrcRegionCount(); region++)
+			{
+				if (records)
+				{
+					recordRegions.starts[region]	= start;
+					recordRegions.cursors[region]	= start;
+					start += recordRegions.counts[region];
+				}
+				else
+				{
+					queryRegions.starts[region]		= start;
+					queryRegions.cursors[region]	= start;
+					start += (queryRegions.counts[region] + NRC_QUERY_BATCH - 1) / NRC_QUERY_BATCH * NRC_QUERY_BATCH;
+				}
+			}
+			if (records)
+			{
+				recordRegions.starts[nrcRegionCount()] = start;
+			}
+			else
+			{
+				queryRegions.starts[nrcRegionCount()] = start;
+			}
+		}
+		return;
+	}
+
+	for (uint i = gl_GlobalInvocationID.x; i < count; i += gl_NumWorkGroups.x * NRC_BIN_WORKGROUP_SIZE)
+	{
+		const uint region = nrcRegion(records ? trainingRecords[i].position.xyz : queries[i].position.xyz);
+		if (pass == NRC_BIN_COUNT)
+		{
+			if (records)
+			{
+				atomicAdd(recordRegions.counts[region], 1);
+			}
+			else
+			{
+				atomicAdd(queryRegions.counts[region], 1);
+			}
+		}
+		else if (records)
+		{
+			recordOrder[atomicAdd(recordRegions.cursors[region], 1)] = i;
+		}
+		else
+		{
+			queryOrder[atomicAdd(queryRegions.cursors[region], 1)] = i;
+		}
+	}
+}
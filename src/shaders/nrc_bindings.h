@@ -0,0 +1,81 @@
+#ifndef NRC_NRC_BINDINGS_H
+#define NRC_NRC_BINDINGS_H
+
+// descriptor set of the NRC kernels (include nrc.h first; define NRC_HALF, with the 16-bit storage and
+// float16 extensions enabled, to read the fp16 copies as float16_t)
+
+layout(binding = BINDING_NRC_WEIGHTS, set = 0, scalar) buffer Weights
+{
+	float weights[];
+};
+layout(binding = BINDING_NRC_QUERIES, set = 0, scalar) buffer Queries
+{
+	NrcQuery queries[];
+};
+layout(binding = BINDING_NRC_RESULTS, set = 0, scalar) buffer Results
+{
+	vec3 results[];
+};
+layout(binding = BINDING_NRC_TRAINING, set = 0, scalar) buffer Training
+{
+	NrcTrainingRecord trainingRecords[];
+};
+layout(binding = BINDING_NRC_GRADIENTS, set = 0, scalar) buffer Gradients
+{
+	float gradients[];
+};
+layout(binding = BINDING_NRC_ADAM, set = 0, scalar) buffer Adam
+{
+	vec2 adamMoments[];
+};
+layout(binding = BINDING_NRC_GRID, set = 0, scalar) buffer Grid
+{
+	float grid[];
+};
+// float gradients of the grid entries, added with compare-and-swap since float atomics are optional
+layout(binding = BINDING_NRC_GRID_GRADIENTS, set = 0, scalar) buffer GridGradients
+{
+	uint gridGradientBits[];
+};
+layout(binding = BINDING_NRC_GRID_ADAM, set = 0, scalar) buffer GridAdam
+{
+	vec2 gridAdamMoments[];
+};
+layout(binding = BINDING_NRC_QUERY_REGIONS, set = 0, scalar) buffer QueryRegions
+{
+	NrcRegionTable queryRegions;
+};
+layout(binding = BINDING_NRC_QUERY_ORDER, set = 0, scalar) buffer QueryOrder
+{
+	uint queryOrder[];
+};
+layout(binding = BINDING_NRC_RECORD_REGIONS, set = 0, scalar) buffer RecordRegions
+{
+	NrcRegionTable recordRegions;
+};
+layout(binding = BINDING_NRC_RECORD_ORDER, set = 0, scalar) buffer RecordOrder
+{
+	uint recordOrder[];
+};
+#ifdef NRC_HALF
+layout(binding = BINDING_NRC_WEIGHTS_HALF, set = 0, scalar) buffer WeightsHalf
+{
+	float16_t weightsHalf[];
+};
+layout(binding = BINDING_NRC_GRID_HALF, set = 0, scalar) buffer GridHalf
+{
+	float16_t gridHalf[];
+};
+#else
+// the same copies as two packed halves per uint, which needs no 16-bit storage
+layout(binding = BINDING_NRC_WEIGHTS_HALF, set = 0, scalar) buffer WeightsHalf
+{
+	uint weightHalfPairs[];
+};
+layout(binding = BINDING_NRC_GRID_HALF, set = 0, scalar) buffer GridHalf
+{
+	uint gridHalfPairs[];
+};
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef NRC_NRC_ENCODING_H
+#define NRC_NRC_ENCODING_H
+
+// input encoding of the NRC kernels (include nrc.h and nrc_bindings.h first), nrcEncodeInput on the host
+
+// the region whose network the kernel evaluates, set by nrcSelectRegion: its cell in the scene bounds and where its
+// weights and grid start (region 0 of 1 without partitioning)
+uvec3	nrcRegionCell		= uvec3(0);
+uint	nrcRegionWeights	= 0;
+uint	nrcRegionGrid		= 0;
+
+// position in the scene bounds, mapped to [0, 1] and scaled by the regions per axis
+vec3 nrcScaledPosition(vec3 position)
+{
+	return clamp((position - constants.sceneMin.xyz) * constants.sceneScale.xyz, vec3(0.0), vec3(1.0)) * float(constants.regionsPerAxis);
+}
+
+// region of a position, as nrcRegionUnitPosition on the host
+uint nrcRegion(vec3 position)
+{
+	const uint	regions	= constants.regionsPerAxis;
+	const uvec3	cell	= min(uvec3(nrcScaledPosition(position)), uvec3(regions - 1));
+	return cell.x + (cell.y + cell.z * regions) * regions;
+}
+
+void nrcSelectRegion(uint region)
+{
+	const uint regions = constants.regionsPerAxis;
+	nrcRegionCell		= uvec3(region % regions, (region / regions) % regions, region / (regions * regions));
+	nrcRegionWeights	= region * (constants.hiddenLayers + 1) * NRC_MATRIX_SIZE;
+	nrcRegionGrid		= region * ((constants.gridLevels << constants.gridLog2TableSize) * constants.gridFeatures);
+}
+
+// position in the bounds of the selected region, mapped to [0, 1]
+vec3 nrcUnitPosition(vec3 position)
+{
+	return min(nrcScaledPosition(position) - vec3(nrcRegionCell), vec3(1.0));
+}
+
+// cells per axis of a grid level, as nrcGridResolution on the host
+float nrcGridResolution(uint level)
+{
+	float resolution = constants.gridBaseResolution;
+	for (uint l = 0; l < level; l++)
+	{
+		resolution *= constants.gridPerLevelScale;
+	}
+	return floor(resolution);
+}
+
+// the eight table entries around unitPos on a grid level (in units of gridFeatures floats) and their trilinear weights,
+// as nrcGridCorners on the host: dense while the level's vertices fit the table, hashed beyond
+void nrcGridCorners(uint level, vec3 unitPos, out uint entries[8], out float cornerWeights[8])
+{
+	const float	resolution	= nrcGridResolution(level);
+	const uint	tableSize	= 1u << constants.gridLog2TableSize;
+	const uint	side		= uint(resolution) + 1;
+	const bool	dense		= float(side) * float(side) * float(side) <= float(tableSize);
+	const vec3	scaled		= unitPos * resolution;
+	const uvec3	cell		= min(uvec3(scaled), uvec3(side - 2));
+	const vec3	fraction	= scaled - vec3(cell);
+
+	for (uint corner = 0; corner < 8; corner++)
+	{
+		const uvec3 offset = uvec3(corner, corner >> 1, corner >> 2) & 1u;
+		const uvec3 vertex = cell + offset;
+		const vec3	w		= mix(1.0 - fraction, fraction, bvec3(offset));
+		const uint	entry	= dense ? vertex.x + (vertex.y + vertex.z * side) * side
+									: (vertex.x ^ (vertex.y * NRC_GRID_PRIME_Y) ^ (vertex.z * NRC_GRID_PRIME_Z)) & (tableSize - 1);
+		entries[corner]			= level * tableSize + entry;
+		cornerWeights[corner]	= w.x * w.y * w.z;
+	}
+}
+
+// grid parameter i of the selected region, from the fp16 copy in the half-precision query kernel
+float nrcGridParameter(uint i)
+{
+#ifdef NRC_HALF
+	return float(gridHalf[nrcRegionGrid + i]);
+#else
+	return grid[nrcRegionGrid + i];
+#endif
+}
+
+// the interpolated features of a grid level, zero past gridFeatures
+vec4 nrcGridFeatures(uint level, vec3 unitPos)
+{
+	uint	entries[8];
+	float	cornerWeights[8];
+	nrcGridCorners(level, unitPos, entries, cornerWeights);
+	vec4 features = vec4(0.0);
+	for (uint corner = 0; corner < 8; corner++)
+	{
+		for (uint c = 0; c < constants.gridFeatures; c++)
+		{
+			features[c] += cornerWeights[corner] * nrcGridParameter(entries[corner] * constants.gridFeatures + c);
+		}
+	}
+	return features;
+}
+
+// element i of the encoded input; with a grid the position elements are zero here and the caller writes nrcGridFeatures
+float nrcEncoding(uint i, vec3 unitPos, vec3 direction, vec3 normal)
+{
+	if (i < NRC_ENCODED_DIRECTION)
+	{
+		if (constants.gridLevels > 0)
+		{
+			return 0.0;
+		}
+		const float angle = exp2(float((i / 2) % NRC_FREQUENCIES)) * NRC_PI * unitPos[i / (2 * NRC_FREQUENCIES)];
+		return (i & 1) == 0 ? sin(angle) : cos(angle);
+	}
+	if (i < NRC_ENCODED_NORMAL)
+	{
+		return direction[i - NRC_ENCODED_DIRECTION];
+	}
+	if (i < NRC_ENCODED_BIAS)
+	{
+		return normal[i - NRC_ENCODED_NORMAL];
+	}
+	return i == NRC_ENCODED_BIAS ? 1.0 : 0.0;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef NRC_NRC_MLP_H
+#define NRC_NRC_MLP_H
+
+// ------------------------------------------------------------------
+// Fully-fused MLP evaluation of the NRC kernels (include nrc.h,
+// nrc_bindings.h and nrc_encoding.h first).
+//
+// A workgroup evaluates NRC_QUERY_BATCH queries with one thread per
+// neuron. The activations of all its queries and the matrix of the
+// layer being evaluated stay in shared memory, 16 KiB each; nothing
+// goes back to global memory between layers. Those 32 KiB
+// (NRC_QUERY_SHARED_BYTES) are what desktop GPUs and lavapipe
+// provide, but Vulkan only guarantees 16 KiB of
+// maxComputeSharedMemorySize, so NeuralRadianceCache checks the limit
+// before it creates the pipeline (querySupported()). Thread j
+// computes output neuron j for a block of NRC_QUERY_BLOCK queries at
+// a time: the weights are read along j (consecutive banks) and each
+// activation is read by all threads at once (a broadcast). The block's
+// outputs overwrite its inputs once every thread has read them.
+//
+// With NRC_HALF the matrices come from the fp16 copy and both shared
+// arrays hold float16_t, 8 KiB each, within the guaranteed 16 KiB;
+// the sums are still accumulated in fp32 so 64-term dot products do
+// not lose the small terms.
+// ------------------------------------------------------------------
+
+#ifdef NRC_HALF
+#define NRC_MLP_REAL float16_t
+#else
+#define NRC_MLP_REAL float
+#endif
+
+shared NRC_MLP_REAL mlpWeights[NRC_MATRIX_SIZE];
+shared NRC_MLP_REAL mlpActivations[NRC_QUERY_BATCH * NRC_WIDTH];
+
+// encoded input of one query into row `row` of mlpActivations
+void encodeQuery(uint row, vec3 position, vec3 direction, vec3 normal)
+{
+	const vec3 unitPos = nrcUnitPosition(position);
+	for (uint i = 0; i < NRC_WIDTH; i++)
+	{
+		mlpActivations[row * NRC_WIDTH + i] = NRC_MLP_REAL(nrcEncoding(i, unitPos, direction, normal));
+	}
+	for (uint level = 0; level < constants.gridLevels; level++)
+	{
+		const vec4 features = nrcGridFeatures(level, unitPos);
+		for (uint c = 0; c < constants.gridFeatures; c++)
+		{
+			mlpActivations[row * NRC_WIDTH + level * constants.gridFeatures + c] = NRC_MLP_REAL(features[c]);
+		}
+	}
+}
+
+// matrix m of the selected region into mlpWeights, one column of floats per thread
+void loadMatrix(uint m)
+{
+	const uint neuron	= gl_LocalInvocationIndex;
+	const uint base		= nrcRegionWeights + m * NRC_MATRIX_SIZE;
+	for (uint i = 0; i < NRC_WIDTH; i++)
+	{
+#ifdef NRC_HALF
+		mlpWeights[i * NRC_WIDTH + neuron] = weightsHalf[base + i * NRC_WIDTH + neuron];
+#else
+		mlpWeights[i * NRC_WIDTH + neuron] = weights[base + i * NRC_WIDTH + neuron];
+#endif
+	}
+}
+
+// one layer over all queries of the workgroup, in place
+void mlpLayer(bool relu)
+{
+	const uint neuron = gl_LocalInvocationIndex;
+	for (uint first = 0; first < NRC_QUERY_BATCH; first += NRC_QUERY_BLOCK)
+	{
+		float sums[NRC_QUERY_BLOCK];
+		for (uint b = 0; b < NRC_QUERY_BLOCK; b++)
+		{
+			sums[b] = 0.0;
+		}
+		for (uint k = 0; k < NRC_WIDTH; k++)
+		{
+			const float w = float(mlpWeights[k * NRC_WIDTH + neuron]);
+			for (uint b = 0; b < NRC_QUERY_BLOCK; b++)
+			{
+				sums[b] += w * float(mlpActivations[(first + b) * NRC_WIDTH + k]);
+			}
+		}
+		// every thread has read the block's inputs before any of them is overwritten
+		barrier();
+		for (uint b = 0; b < NRC_QUERY_BLOCK; b++)
+		{
+			mlpActivations[(first + b) * NRC_WIDTH + neuron] = NRC_MLP_REAL(relu ? max(sums[b], 0.0) : sums[b]);
+		}
+	}
+}
+
+// all layers; on return row q of mlpActivations holds the output of query q in its first NRC_OUTPUT_WIDTH floats
+void mlpForward()
+{
+	for (uint m = 0; m <= constants.hiddenLayers; m++)
+	{
+		// the previous layer (or the encoding) is complete and nobody reads the old matrix any more
+		barrier();
+		loadMatrix(m);
+		barrier();
+		mlpLayer(m < constants.hiddenLayers);
+	}
+	barrier();
+}
+
+#endif
@@ -0,0 +1,168 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+
+#include "nrc_paths.h"
+#include "sampling.h"
+#include "nrc_path_bindings.h"
+
+layout(local_size_x = WORKGROUP_WIDTH, local_size_y = WORKGROUP_HEIGHT, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// One sample per pixel, shaded like raytracer.comp.glsl until the
+// path ends in the cache (see nrc_paths.h). The sky a path reaches by
+// itself goes to the image here, the cache's answer at its end is
+// weighted by queryThroughputs[pixel] in nrc_resolve.comp.glsl.
+//
+// A training record holds the radiance leaving its vertex back along
+// the path. The only light is where the path ends (the sky or the
+// final query), so that is the end's contribution divided by the
+// throughput up to the vertex; with a final query the record keeps
+// the ratio of the throughputs until resolve knows the answer.
+//
+// The diffuse bounces sample the cosine lobe, so the pdf of a bounce
+// direction is cos / pi at the vertex it leaves.
+// ------------------------------------------------------------------
+
+void main()
+{
+	const uvec2 resolution = uvec2(RENDER_WIDTH, RENDER_HEIGHT);
+	const uvec2 pixel = gl_GlobalInvocationID.xy;
+	if (pixel.x >= resolution.x || pixel.y >= resolution.y)
+	{
+		return;
+	}
+	const uint pixelIndex = pixel.y * resolution.x + pixel.x;
+
+	// one random sequence per pixel, continued across frames
+	uint rngState = constants.frame == 0 ? pixelIndex : rngStates[pixelIndex];
+
+	const bool training		= all(equal((pixel + constants.trainingOffset) % constants.trainingTile, uvec2(0)));
+	// where the path queries the cache; a training path that gets there goes on for its suffix instead
+	uint endVertex			= constants.warmup != 0 ? NUM_TRACED_SEGMENTS : constants.cacheVertex;
+	bool suffix				= false;
+
+	vec3 rayOrigin		= vec3(CAMERA_ORIGIN_X, CAMERA_ORIGIN_Y, CAMERA_ORIGIN_Z);
+	vec3 rayDirection	= cameraRayDirection(pixel, resolution, rngState);
+	vec3 throughput		= vec3(1.0);
+	vec3 skyRadiance	= vec3(0.0);
+	bool queried		= false;
+	NrcQuery query;
+	query.position	= vec4(rayOrigin, 0.0);
+	query.direction	= vec4(rayDirection, 0.0);
+	query.normal	= vec4(0.0, 1.0, 0.0, 0.0);
+
+	// vertices of a training path before its end
+	NrcQuery	pathVertices[NRC_PATH_MAX_RECORDS];
+	vec3		vertexThroughputs[NRC_PATH_MAX_RECORDS];
+	uint		vertexCount = 0;
+
+	// area spread: footprint of the primary hit, square root of the spread so far and pdf of the last bounce
+	float primarySpread	= 0.0;
+	float spread		= 0.0;
+	float bouncePdf		= 1.0;
+
+	uint raysTraced = 0;
+	for (uint vertex = 0; vertex < NUM_TRACED_SEGMENTS; vertex++)
+	{
+		rayQueryEXT rayQuery;
+		rayQueryInitializeEXT(rayQuery, tlas, gl_RayFlagsOpaqueEXT, 0xFF, rayOrigin, 0.0, rayDirection, 10000.0);
+		while (rayQueryProceedEXT(rayQuery))
+		{
+		}
+		raysTraced++;
+
+		if (rayQueryGetIntersectionTypeEXT(rayQuery, true) != gl_RayQueryCommittedIntersectionTriangleEXT)
+		{
+			// escaped: the sky is the only light source
+			skyRadiance = throughput * skyColor(rayDirection);
+			break;
+		}
+
+		const int	primitiveID		= rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true);
+		const vec2	barycentrics	= rayQueryGetIntersectionBarycentricsEXT(rayQuery, true);
+		const vec3	v0				= vertices[indices[3 * primitiveID + 0]];
+		const vec3	v1				= vertices[indices[3 * primitiveID + 1]];
+		const vec3	v2				= vertices[indices[3 * primitiveID + 2]];
+		const vec3	worldPosition	= v0 * (1.0 - barycentrics.x - barycentrics.y) + v1 * barycentrics.x + v2 * barycentrics.y;
+		vec3		worldNormal		= normalize(cross(v1 - v0, v2 - v0));
+		if (dot(rayDirection, worldNormal) > 0.0)
+		{
+			worldNormal = -worldNormal;
+		}
+
+		const float	distanceSquared	= dot(worldPosition - rayOrigin, worldPosition - rayOrigin);
+		const float	cosine			= max(abs(dot(rayDirection, worldNormal)), 1e-6);
+		if (vertex == 0)
+		{
+			primarySpread = distanceSquared / (4.0 * 3.14159265 * cosine);
+		}
+		else
+		{
+			spread += sqrt(distanceSquared / (bouncePdf * cosine));
+		}
+		const bool spreadOut = constants.warmup == 0 && constants.spreadThreshold > 0.0 &&
+							   spread * spread > constants.spreadThreshold * primarySpread;
+
+		NrcQuery here;
+		here.position	= vec4(worldPosition, 0.0);
+		here.direction	= vec4(rayDirection, 0.0);
+		here.normal		= vec4(worldNormal, 0.0);
+		if (vertex == endVertex || spreadOut)
+		{
+			if (!training || suffix)
+			{
+				query	= here;
+				queried = true;
+				break;
+			}
+			// the suffix spreads from here on
+			suffix		= true;
+			endVertex	= vertex + constants.suffixVertices;
+			spread		= 0.0;
+		}
+		if (training && vertexCount < constants.cacheVertex + constants.suffixVertices)
+		{
+			pathVertices[vertexCount]		= here;
+			vertexThroughputs[vertexCount]	= throughput;
+			vertexCount++;
+		}
+
+		throughput		*= SURFACE_ALBEDO;
+		rayOrigin		= worldPosition + 0.0001 * worldNormal;
+		rayDirection	= diffuseReflection(worldNormal, rngState);
+		bouncePdf		= max(dot(rayDirection, worldNormal), 1e-6) / 3.14159265;
+	}
+
+	// one path per pixel at a time, so no atomics; paths cut off by NUM_TRACED_SEGMENTS stay black as in the megakernel
+	imageData[pixelIndex]			+= skyRadiance / float(NUM_SAMPLES);
+	queryThroughputs[pixelIndex]	= vec4(queried ? throughput : vec3(0.0), 0.0);
+	queries[pixelIndex]				= query;
+	rngStates[pixelIndex]			= rngState;
+	// one atomic per subgroup on the shared counter; the pixels outside the image returned above and add nothing
+	const uint subgroupRaysTraced = subgroupAdd(raysTraced);
+	if (subgroupElect())
+	{
+		atomicAdd(counters[NRC_COUNTER_RAYS_TRACED], subgroupRaysTraced);
+	}
+
+	if (vertexCount > 0)
+	{
+		const uint	first	= atomicAdd(counters[NRC_COUNTER_RING_CURSOR], vertexCount);
+		const vec3	end		= queried ? throughput : skyRadiance;
+		for (uint v = 0; v < vertexCount; v++)
+		{
+			const uint slot = (first + v) % constants.ringCapacity;
+			NrcTrainingRecord record;
+			record.position		= pathVertices[v].position;
+			record.direction	= pathVertices[v].direction;
+			record.normal		= pathVertices[v].normal;
+			record.radiance		= vec4(end / vertexThroughputs[v], 0.0);
+			trainingRecords[slot]	= record;
+			recordQueries[slot]		= queried ? pixelIndex : ~0u;
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef NRC_NRC_PATH_BINDINGS_H
+#define NRC_NRC_PATH_BINDINGS_H
+
+// descriptor set of the path kernels (include nrc_paths.h first)
+
+layout(binding = BINDING_IMAGEDATA, set = 0, scalar) buffer storageBuffer
+{
+	vec3 imageData[];
+};
+layout(binding = BINDING_TLAS, set = 0) uniform accelerationStructureEXT tlas;
+layout(binding = BINDING_VERTICES, set = 0, scalar) buffer Vertices
+{
+	vec3 vertices[];
+};
+layout(binding = BINDING_INDICES, set = 0, scalar) buffer Indices
+{
+	uint indices[];
+};
+layout(binding = BINDING_NRC_PATH_RNG, set = 0, scalar) buffer RngStates
+{
+	uint rngStates[];
+};
+layout(binding = BINDING_NRC_PATH_THROUGHPUT, set = 0, scalar) buffer Throughputs
+{
+	vec4 queryThroughputs[];
+};
+layout(binding = BINDING_NRC_PATH_QUERIES, set = 0, scalar) buffer Queries
+{
+	NrcQuery queries[];
+};
+layout(binding = BINDING_NRC_PATH_RESULTS, set = 0, scalar) buffer Results
+{
+	vec3 results[];
+};
+layout(binding = BINDING_NRC_PATH_RECORDS, set = 0, scalar) buffer Training
+{
+	NrcTrainingRecord trainingRecords[];
+};
+layout(binding = BINDING_NRC_PATH_RECORD_QUERIES, set = 0, scalar) buffer RecordQueries
+{
+	uint recordQueries[];
+};
+layout(binding = BINDING_NRC_PATH_COUNTERS, set = 0, scalar) buffer Counters
+{
+	uint counters[];
+};
+
+#endif
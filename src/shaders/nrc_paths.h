@@ -0,0 +1,86 @@
+#ifndef NRC_NRC_PATHS_H
+#define NRC_NRC_PATHS_H
+
+// -----------------------------------------------------------------
+// Layout shared by the path kernels that render with the neural
+// radiance cache (nrc_path.comp.glsl, nrc_resolve.comp.glsl),
+// NrcRenderer and the CPU backend.
+//
+// Every frame traces one sample per pixel. Inference paths stop at
+// the cache vertex and leave a query in the slot of their pixel.
+// One pixel per training tile (at an offset random per frame) traces
+// a training path: it goes on past the cache vertex for a suffix of
+// more vertices and then queries the cache itself, so the cache
+// learns from its own answers further along (self-training). Every
+// vertex before the end becomes a training record in a ring buffer;
+// targets that wait for the final query are finished by the resolve
+// pass, which also adds the cache's answers to the image.
+//
+// With a spread threshold c the paths end where their footprint has
+// grown large instead (the area spread of the NRC paper): along the
+// path a sums sqrt(d^2 / (pdf * cos)) of every bounce segment, and the
+// path queries the first vertex where a^2 exceeds c times the primary
+// hit's pixel footprint d^2 / (4 pi cos), but no later than the cache
+// vertex. A training suffix starts its own sum and ends the same way,
+// after suffixVertices at most.
+//
+// While the cache warms up (NrcPathSettings::warmupFrames) all paths
+// trace to the end as in raytracer.comp.glsl and none queries the
+// cache; training paths keep their first cacheVertex + suffixVertices
+// vertices as records, with final targets.
+// -----------------------------------------------------------------
+#ifndef __cplusplus
+#define NRC_OWN_PUSH_CONSTANTS
+#endif
+#include "nrc.h"
+
+#define NRC_PATH_WORKGROUP_SIZE			128		// resolve, one thread per pixel and per record of the frame
+#define NRC_PATH_MAX_RECORDS			16		// vertices of a training path before its end, cacheVertex + suffixVertices at most
+
+// bindings after the four of common.h; queries, results and training records are the buffers of NeuralRadianceCache
+#define BINDING_NRC_PATH_RNG			4		// random state per pixel, kept across frames
+#define BINDING_NRC_PATH_THROUGHPUT		5		// per pixel, weight of its query's answer in the image (zero without a query)
+#define BINDING_NRC_PATH_QUERIES		6
+#define BINDING_NRC_PATH_RESULTS		7
+#define BINDING_NRC_PATH_RECORDS		8		// ring of ringCapacity training records
+#define BINDING_NRC_PATH_RECORD_QUERIES	9		// per ring slot, the query that scales the record's radiance, ~0u when final
+#define BINDING_NRC_PATH_COUNTERS		10
+#define NRC_PATH_BINDING_COUNT			11
+
+// uints of the counters buffer
+#define NRC_COUNTER_RING_CURSOR			0		// records written so far, the next one goes to slot cursor % ringCapacity
+#define NRC_COUNTER_FRAME_START			1		// the cursor before the current frame
+#define NRC_COUNTER_RAYS_TRACED			2
+#define NRC_COUNTER_COUNT				4
+
+#ifdef __cplusplus
+#include <cstdint>
+namespace NRC
+{
+	struct NrcPathConstants
+	{
+		uint32_t	frame;				// of the current render, 0 starts the random sequences
+		uint32_t	trainingTile;
+		uint32_t	trainingOffset[2];
+		uint32_t	cacheVertex;
+		uint32_t	suffixVertices;
+		uint32_t	ringCapacity;
+		float		spreadThreshold;	// 0 ends every path at the fixed vertices
+		uint32_t	warmup;				// nonzero: no path ends in the cache
+	};
+}
+#else
+layout(push_constant) uniform NrcPathConstants
+{
+	uint frame;
+	uint trainingTile;
+	uvec2 trainingOffset;
+	uint cacheVertex;
+	uint suffixVertices;
+	uint ringCapacity;
+	float spreadThreshold;
+	uint warmup;
+} constants;
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef NRC_NRC_QUERY_H
+#define NRC_NRC_QUERY_H
+
+// the query kernel, in fp32 (nrc_query.comp.glsl) and with NRC_HALF (nrc_query_half.comp.glsl)
+#include "nrc.h"
+#include "nrc_bindings.h"
+#include "nrc_encoding.h"
+#include "nrc_mlp.h"
+
+layout(local_size_x = NRC_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// region of the batch starting at slot first of queryOrder, whose regions start at multiples of NRC_QUERY_BATCH
+uint batchRegion(uint first)
+{
+	uint region = 0;
+	while (region + 1 < nrcRegionCount() && queryRegions.starts[region + 1] <= first)
+	{
+		region++;
+	}
+	return region;
+}
+
+// radiance of NRC_QUERY_BATCH queries per workgroup, fully fused: thread q encodes query q, all threads evaluate the layers.
+// With regions the workgroup takes a batch of queryOrder, which holds one region's queries, and writes the results back
+// in query order; the dispatch covers the padding, the workgroups past the last region leave at once.
+void main()
+{
+	const uint	row		= gl_LocalInvocationIndex;
+	const uint	first	= gl_WorkGroupID.x * NRC_QUERY_BATCH;
+	uint		query	= first + row;
+	if (constants.regionsPerAxis > 1)
+	{
+		if (first >= queryRegions.starts[nrcRegionCount()])
+		{
+			return;
+		}
+		nrcSelectRegion(batchRegion(first));
+		query = queryOrder[first + row];
+	}
+
+	// threads past the last query encode zeros but still take part in every barrier
+	if (query < constants.queryCount)
+	{
+		const NrcQuery q = queries[query];
+		encodeQuery(row, q.position.xyz, q.direction.xyz, q.normal.xyz);
+	}
+	else
+	{
+		for (uint i = 0; i < NRC_WIDTH; i++)
+		{
+			mlpActivations[row * NRC_WIDTH + i] = NRC_MLP_REAL(0.0);
+		}
+	}
+
+	mlpForward();
+
+	if (query < constants.queryCount)
+	{
+		const uint base = row * NRC_WIDTH;
+		results[query] = vec3(float(mlpActivations[base + 0]), float(mlpActivations[base + 1]), float(mlpActivations[base + 2]));
+	}
+}
+
+#endif
@@ -0,0 +1,9 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+
+// needs shaderFloat16 and storageBuffer16BitAccess, see NeuralRadianceCache::halfPrecision()
+#define NRC_HALF
+#include "nrc_query.h"
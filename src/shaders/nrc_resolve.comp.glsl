@@ -0,0 +1,33 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "nrc_paths.h"
+#include "nrc_path_bindings.h"
+
+layout(local_size_x = NRC_PATH_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// after the queries of the frame: thread i adds the answer of pixel i's query to the image and finishes the i-th record
+// of the frame; the network's output is clamped to zero, radiance is never negative. While the cache warms up there
+// were no queries and the results are stale
+void main()
+{
+	const uint i = gl_GlobalInvocationID.x;
+	if (constants.warmup == 0 && i < RENDER_WIDTH * RENDER_HEIGHT)
+	{
+		imageData[i] += queryThroughputs[i].xyz * max(results[i], vec3(0.0)) / float(NUM_SAMPLES);
+	}
+
+	const uint frameStart	= counters[NRC_COUNTER_FRAME_START];
+	const uint frameRecords	= min(counters[NRC_COUNTER_RING_CURSOR] - frameStart, constants.ringCapacity);
+	if (i < frameRecords)
+	{
+		const uint slot		= (frameStart + i) % constants.ringCapacity;
+		const uint query	= recordQueries[slot];
+		if (query != ~0u)
+		{
+			trainingRecords[slot].radiance.xyz *= max(results[query], vec3(0.0));
+		}
+	}
+}
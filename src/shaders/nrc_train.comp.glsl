@@ -0,0 +1,254 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_clustered : require
+
+#include "nrc.h"
+#include "nrc_bindings.h"
+#include "nrc_encoding.h"
+
+layout(local_size_x = NRC_TRAIN_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// ------------------------------------------------------------------
+// Fused training pass: forward, relative L2 loss and backward for
+// batches of NRC_TRAIN_BATCH records, all in shared memory
+// (NRC_TRAIN_SHARED_BYTES, about 28 KiB).
+//
+// Thread (neuron, slice) handles one neuron for the
+// NRC_TRAIN_ROWS_PER_SLICE records of its slice. The input of every
+// layer is kept for the backward pass (rows padded by one float, so
+// the slices read different banks) and the deltas are updated in
+// place. A weight's gradient over the batch is the sum over the
+// NRC_TRAIN_SLICES lanes of a cluster, which subgroupClusteredAdd
+// forms without shared memory; one lane of the cluster then adds it
+// to the workgroup's own gradient slice. The persistent workgroups
+// stride over the batches, so the weights need no atomics and
+// nrc_adam.comp.glsl sums the NRC_TRAIN_GROUPS slices.
+//
+// With a hash grid the deltas go on through the first matrix to the
+// encoded input and are spread over the eight grid entries each
+// feature interpolates. Those writes are sparse and collide only
+// where records share an entry, so they are atomic adds instead of
+// per-workgroup slices (which would be as large as the table).
+//
+// With regions workgroup g trains the network of region
+// g % nrcRegionCount() on that region's records in recordOrder, so
+// its slice holds one region's gradient and Adam sums the slices of
+// the region's workgroups. Each network learns the mean loss of its
+// own records.
+// ------------------------------------------------------------------
+
+#define ROW_STRIDE	(NRC_WIDTH + 1)
+#define LAYER_SIZE	(NRC_TRAIN_BATCH * ROW_STRIDE)
+
+shared float layerInputs[(NRC_MAX_HIDDEN_LAYERS + 1) * LAYER_SIZE];		// encoded input, then the output of every hidden layer
+shared float deltas[LAYER_SIZE];										// loss gradient at the output of the current matrix
+
+// float add on gridGradientBits, which needs no float atomics extension
+void gridGradientAdd(uint index, float value)
+{
+	uint expected = gridGradientBits[index];
+	for (;;)
+	{
+		const uint previous = atomicCompSwap(gridGradientBits[index], expected, floatBitsToUint(uintBitsToFloat(expected) + value));
+		if (previous == expected)
+		{
+			break;
+		}
+		expected = previous;
+	}
+}
+
+// first record of the workgroup's region in recordOrder, and their count
+uint regionStart	= 0;
+uint regionRecords	= 0;
+
+// record i of the workgroup's region
+uint trainingRecordIndex(uint i)
+{
+	return constants.regionsPerAxis > 1 ? recordOrder[regionStart + i] : i;
+}
+
+void main()
+{
+	// the lanes of a cluster share a neuron however the device forms its subgroups
+	const uint	thread			= gl_SubgroupID * gl_SubgroupSize + gl_SubgroupInvocationID;
+	const uint	neuron			= thread / NRC_TRAIN_SLICES;
+	const uint	slice			= thread % NRC_TRAIN_SLICES;
+	const uint	firstRow		= slice * NRC_TRAIN_ROWS_PER_SLICE;
+	const uint	hiddenLayers	= constants.hiddenLayers;
+	const uint	sliceBase		= gl_WorkGroupID.x * NRC_GRADIENT_STRIDE;
+	const uint	gridEncoded		= constants.gridLevels * constants.gridFeatures;
+	const uint	region			= gl_WorkGroupID.x % nrcRegionCount();
+	const uint	regionGroups	= gl_NumWorkGroups.x / nrcRegionCount();
+	nrcSelectRegion(region);
+	regionStart		= constants.regionsPerAxis > 1 ? recordRegions.starts[region] : 0;
+	regionRecords	= constants.regionsPerAxis > 1 ? recordRegions.counts[region] : constants.trainingCount;
+	const float	lossScale		= 1.0 / float(regionRecords);
+
+	for (uint batchStart = gl_WorkGroupID.x / nrcRegionCount() * NRC_TRAIN_BATCH; batchStart < regionRecords;
+		 batchStart += regionGroups * NRC_TRAIN_BATCH)
+	{
+		// the previous batch is done with the shared arrays
+		barrier();
+		for (uint e = gl_LocalInvocationIndex; e < NRC_TRAIN_BATCH * NRC_WIDTH; e += NRC_TRAIN_WORKGROUP_SIZE)
+		{
+			const uint	row		= e / NRC_WIDTH;
+			const uint	i		= e % NRC_WIDTH;
+			const uint	record	= batchStart + row;
+			// with a grid, element i < gridLevels writes the features of level i and the elements they cover write nothing
+			if (i >= constants.gridLevels && i < gridEncoded)
+			{
+				continue;
+			}
+			const bool	valid	= record < regionRecords;
+			const uint	index	= valid ? trainingRecordIndex(record) : 0;
+			const vec3	unitPos	= nrcUnitPosition(trainingRecords[index].position.xyz);
+			if (i < constants.gridLevels)
+			{
+				const vec4 features = valid ? nrcGridFeatures(i, unitPos) : vec4(0.0);
+				for (uint c = 0; c < constants.gridFeatures; c++)
+				{
+					layerInputs[row * ROW_STRIDE + i * constants.gridFeatures + c] = features[c];
+				}
+			}
+			else
+			{
+				const NrcTrainingRecord r = trainingRecords[index];
+				layerInputs[row * ROW_STRIDE + i] = valid ? nrcEncoding(i, unitPos, r.direction.xyz, r.normal.xyz) : 0.0;
+			}
+		}
+		barrier();
+
+		// ------------------------------------------
+		// Forward, keeping the input of every matrix
+		// ------------------------------------------
+		for (uint m = 0; m < hiddenLayers; m++)
+		{
+			const uint inBase	= m * LAYER_SIZE;
+			const uint outBase	= inBase + LAYER_SIZE;
+			float sums[NRC_TRAIN_ROWS_PER_SLICE];
+			for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+			{
+				sums[b] = 0.0;
+			}
+			for (uint k = 0; k < NRC_WIDTH; k++)
+			{
+				const float w = weights[nrcRegionWeights + m * NRC_MATRIX_SIZE + k * NRC_WIDTH + neuron];
+				for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+				{
+					sums[b] += w * layerInputs[inBase + (firstRow + b) * ROW_STRIDE + k];
+				}
+			}
+			for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+			{
+				layerInputs[outBase + (firstRow + b) * ROW_STRIDE + neuron] = max(sums[b], 0.0);
+			}
+			barrier();
+		}
+
+		// output and gradient of the loss, zero for the unused outputs and the records past the end
+		{
+			const uint inBase = hiddenLayers * LAYER_SIZE;
+			for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+			{
+				const uint record = batchStart + firstRow + b;
+				float delta = 0.0;
+				if (neuron < NRC_OUTPUT_WIDTH && record < regionRecords)
+				{
+					float y = 0.0;
+					for (uint k = 0; k < NRC_WIDTH; k++)
+					{
+						y += weights[nrcRegionWeights + hiddenLayers * NRC_MATRIX_SIZE + k * NRC_WIDTH + neuron]
+						   * layerInputs[inBase + (firstRow + b) * ROW_STRIDE + k];
+					}
+					const float target = trainingRecords[trainingRecordIndex(record)].radiance[neuron];
+					delta = 2.0 * (y - target) / (y * y + NRC_LOSS_EPSILON) * lossScale;
+				}
+				deltas[(firstRow + b) * ROW_STRIDE + neuron] = delta;
+			}
+			barrier();
+		}
+
+		// -------------------------------------------------------------
+		// Backward: gradients of matrix m, then the deltas at its input
+		// -------------------------------------------------------------
+		for (int m = int(hiddenLayers); m >= 0; m--)
+		{
+			const uint inBase		= uint(m) * LAYER_SIZE;
+			const uint matrixBase	= uint(m) * NRC_MATRIX_SIZE;
+			float rowDeltas[NRC_TRAIN_ROWS_PER_SLICE];
+			for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+			{
+				rowDeltas[b] = deltas[(firstRow + b) * ROW_STRIDE + neuron];
+			}
+			for (uint k = 0; k < NRC_WIDTH; k++)
+			{
+				float g = 0.0;
+				for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+				{
+					g += layerInputs[inBase + (firstRow + b) * ROW_STRIDE + k] * rowDeltas[b];
+				}
+				// every lane of the cluster receives the batch's sum, they take turns writing it
+				g = subgroupClusteredAdd(g, NRC_TRAIN_SLICES);
+				if (k % NRC_TRAIN_SLICES == slice)
+				{
+					gradients[sliceBase + matrixBase + k * NRC_WIDTH + neuron] += g;
+				}
+			}
+
+			if (m > 0)
+			{
+				// here neuron indexes the inputs of matrix m, which are the outputs of hidden layer m
+				float inputDeltas[NRC_TRAIN_ROWS_PER_SLICE];
+				for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+				{
+					inputDeltas[b] = 0.0;
+				}
+				for (uint j = 0; j < NRC_WIDTH; j++)
+				{
+					const float w = weights[nrcRegionWeights + matrixBase + neuron * NRC_WIDTH + j];
+					for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+					{
+						inputDeltas[b] += w * deltas[(firstRow + b) * ROW_STRIDE + j];
+					}
+				}
+				// every thread has read the deltas of matrix m before they are replaced
+				barrier();
+				for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+				{
+					const bool active = layerInputs[inBase + (firstRow + b) * ROW_STRIDE + neuron] > 0.0;
+					deltas[(firstRow + b) * ROW_STRIDE + neuron] = active ? inputDeltas[b] : 0.0;
+				}
+				barrier();
+			}
+			else if (neuron < gridEncoded)
+			{
+				// the grid features: no activation to mask, each record's delta goes to the level's eight entries
+				const uint level	= neuron / constants.gridFeatures;
+				const uint feature	= neuron % constants.gridFeatures;
+				for (uint b = 0; b < NRC_TRAIN_ROWS_PER_SLICE; b++)
+				{
+					const uint record = batchStart + firstRow + b;
+					if (record >= regionRecords)
+					{
+						break;
+					}
+					float inputDelta = 0.0;
+					for (uint j = 0; j < NRC_WIDTH; j++)
+					{
+						inputDelta += weights[nrcRegionWeights + neuron * NRC_WIDTH + j] * deltas[(firstRow + b) * ROW_STRIDE + j];
+					}
+					uint	entries[8];
+					float	cornerWeights[8];
+					nrcGridCorners(level, nrcUnitPosition(trainingRecords[trainingRecordIndex(record)].position.xyz), entries, cornerWeights);
+					for (uint corner = 0; corner < 8; corner++)
+					{
+						gridGradientAdd(nrcRegionGrid + entries[corner] * constants.gridFeatures + feature, cornerWeights[corner] * inputDelta);
+					}
+				}
+			}
+		}
+	}
+}
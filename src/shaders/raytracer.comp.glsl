@@ -1,17 +1,65 @@
 #version 460
 #extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
 
+#include "common.h"
+#include "sampling.h"
 
-layout(local_size_x = 16, local_size_y = 8, local_size_z = 1) in;
+layout(local_size_x = WORKGROUP_WIDTH, local_size_y = WORKGROUP_HEIGHT, local_size_z = 1) in;
 
-layout(binding = 0, set = 0, scalar) buffer storageBuffer
+layout(binding = BINDING_IMAGEDATA, set = 0, scalar) buffer storageBuffer
 {
 	vec3 imageData[];
 };
+layout(binding = BINDING_TLAS, set = 0) uniform accelerationStructureEXT tlas;
+layout(binding = BINDING_VERTICES, set = 0, scalar) buffer Vertices
+{
+	vec3 vertices[];
+};
+layout(binding = BINDING_INDICES, set = 0, scalar) buffer Indices
+{
+	uint indices[];
+};
+
+struct HitInfo
+{
+	vec3 color;
+	vec3 worldPosition;
+	vec3 worldNormal;
+};
+
+HitInfo getObjectHitInfo(rayQueryEXT rayQuery)
+{
+	HitInfo result;
+	const int primitiveID = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true);
+
+	const uint i0 = indices[3 * primitiveID + 0];
+	const uint i1 = indices[3 * primitiveID + 1];
+	const uint i2 = indices[3 * primitiveID + 2];
+	const vec3 v0 = vertices[i0];
+	const vec3 v1 = vertices[i1];
+	const vec3 v2 = vertices[i2];
+
+	vec3 barycentrics = vec3(0.0, rayQueryGetIntersectionBarycentricsEXT(rayQuery, true));
+	barycentrics.x    = 1.0 - barycentrics.y - barycentrics.z;
+	result.worldPosition = v0 * barycentrics.x + v1 * barycentrics.y + v2 * barycentrics.z;
+
+	// geometric normal, facing the incoming ray
+	result.worldNormal = normalize(cross(v1 - v0, v2 - v0));
+	const vec3 rayDirection = rayQueryGetWorldRayDirectionEXT(rayQuery);
+	if (dot(rayDirection, result.worldNormal) > 0.0)
+	{
+		result.worldNormal = -result.worldNormal;
+	}
+
+	result.color = vec3(SURFACE_ALBEDO);
+	return result;
+}
 
 void main()
 {
-	const uvec2 resolution = uvec2(800, 600);
+	const uvec2 resolution = uvec2(RENDER_WIDTH, RENDER_HEIGHT);
 	const uvec2 pixel = gl_GlobalInvocationID.xy;
 
 	if (pixel.x >= resolution.x || pixel.y >= resolution.y)
@@ -19,14 +67,46 @@ void main()
 		return;
 	}
 
-	const vec3 color = vec3(float(pixel.x) / resolution.x,
-							float(pixel.y) / resolution.y,
-							0.0);
-	
+	// one random sequence per pixel
+	uint rngState = resolution.x * pixel.y + pixel.x;
+
+	const vec3 cameraOrigin = vec3(CAMERA_ORIGIN_X, CAMERA_ORIGIN_Y, CAMERA_ORIGIN_Z);
+
+	vec3 summedPixelColor = vec3(0.0);
+	for (int sampleIdx = 0; sampleIdx < NUM_SAMPLES; sampleIdx++)
+	{
+		vec3 rayOrigin    = cameraOrigin;
+		vec3 rayDirection = cameraRayDirection(pixel, resolution, rngState);
+
+		vec3 accumulatedRayColor = vec3(1.0);
+		for (int tracedSegments = 0; tracedSegments < NUM_TRACED_SEGMENTS; tracedSegments++)
+		{
+			rayQueryEXT rayQuery;
+			rayQueryInitializeEXT(rayQuery, tlas, gl_RayFlagsOpaqueEXT, 0xFF,
+								  rayOrigin, 0.0, rayDirection, 10000.0);
+			while (rayQueryProceedEXT(rayQuery))
+			{
+			}
+
+			if (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionTriangleEXT)
+			{
+				HitInfo hitInfo = getObjectHitInfo(rayQuery);
+				accumulatedRayColor *= hitInfo.color;
+
+				// continue from slightly above the surface to avoid self-intersection
+				rayOrigin    = hitInfo.worldPosition + 0.0001 * hitInfo.worldNormal;
+				rayDirection = diffuseReflection(hitInfo.worldNormal, rngState);
+			}
+			else
+			{
+				// escaped: the sky is the only light source
+				summedPixelColor += accumulatedRayColor * skyColor(rayDirection);
+				break;
+			}
+		}
+	}
+
 	//should be row by row first, then the column
 	uint index = pixel.y * resolution.x + pixel.x;
-
-	imageData[index].x = color.r;
-	imageData[index].y = color.g;
-	imageData[index].z = color.b;
-}
\ No newline at end of file
+	imageData[index] = summedPixelColor / float(NUM_SAMPLES);
+}
@@ -0,0 +1,52 @@
+#ifndef NRC_SAMPLING_H
+#define NRC_SAMPLING_H
+
+// random numbers and sampling shared by the path tracing kernels (include common.h first)
+
+// PCG random number generator, returns a float in [0, 1]
+float stepAndOutputRNGFloat(inout uint rngState)
+{
+	rngState  = rngState * 747796405 + 1;
+	uint word = ((rngState >> ((rngState >> 28) + 4)) ^ rngState) * 277803737;
+	word      = (word >> 22) ^ word;
+	return float(word) / 4294967295.0f;
+}
+
+// two normally distributed numbers (Box-Muller)
+vec2 randomGaussian(inout uint rngState)
+{
+	const float u1    = max(1e-38, stepAndOutputRNGFloat(rngState));
+	const float u2    = stepAndOutputRNGFloat(rngState);
+	const float r     = sqrt(-2.0 * log(u1));
+	const float theta = 2 * 3.14159265 * u2;
+	return r * vec2(cos(theta), sin(theta));
+}
+
+// jittered camera ray through the pixel, screen y points up
+vec3 cameraRayDirection(uvec2 pixel, uvec2 resolution, inout uint rngState)
+{
+	const vec2 randomPixelCenter = vec2(pixel) + vec2(0.5) + 0.375 * randomGaussian(rngState);
+	const vec2 screenUV = vec2((2.0 * randomPixelCenter.x - resolution.x) / resolution.y,
+							   -(2.0 * randomPixelCenter.y - resolution.y) / resolution.y);
+	return normalize(vec3(CAMERA_FOV_VERTICAL_SLOPE * screenUV.x, CAMERA_FOV_VERTICAL_SLOPE * screenUV.y, -1.0));
+}
+
+vec3 skyColor(vec3 direction)
+{
+	if (direction.y > 0.0f)
+	{
+		return mix(vec3(1.0f), vec3(0.25f, 0.5f, 1.0f), direction.y);
+	}
+	return vec3(0.03f);
+}
+
+// cosine-weighted direction around the normal
+vec3 diffuseReflection(vec3 normal, inout uint rngState)
+{
+	const float theta = 2.0 * 3.14159265 * stepAndOutputRNGFloat(rngState);
+	const float u     = 2.0 * stepAndOutputRNGFloat(rngState) - 1.0;
+	const float r     = sqrt(1.0 - u * u);
+	return normalize(normal + vec3(r * cos(theta), r * sin(theta), u));
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef NRC_WAVEFRONT_H
+#define NRC_WAVEFRONT_H
+
+// -----------------------------------------------------------------
+// Layout shared by the wavefront kernels (wavefront_*.comp.glsl) and
+// WavefrontRenderer. The path tracer of raytracer.comp.glsl is split
+// into generate / extend / shade kernels over a ray queue, and an
+// optional sort stage bins the queue by origin cell and direction
+// octant before it is extended.
+// -----------------------------------------------------------------
+#include "common.h"
+
+#define WAVEFRONT_WORKGROUP_SIZE		128
+#define WAVEFRONT_QUEUE_CAPACITY		(RENDER_WIDTH * RENDER_HEIGHT)		// one live path per pixel
+
+// binning: origin cells per axis over the scene bounds, times eight octants
+#define WAVEFRONT_SORT_GRID				4
+#define WAVEFRONT_SORT_BINS				(8 * WAVEFRONT_SORT_GRID * WAVEFRONT_SORT_GRID * WAVEFRONT_SORT_GRID)
+#define WAVEFRONT_SORT_BINS_PER_THREAD	(WAVEFRONT_SORT_BINS / WAVEFRONT_WORKGROUP_SIZE)
+
+// sort passes, one dispatch each
+#define WAVEFRONT_SORT_COUNT			0		// histogram of the bin keys
+#define WAVEFRONT_SORT_SCAN				1		// exclusive prefix sum, one workgroup
+#define WAVEFRONT_SORT_SCATTER			2		// rays to their bin in the other queue
+
+// bindings after the four of common.h
+#define BINDING_WF_RAYS					4		// two queues of WAVEFRONT_QUEUE_CAPACITY rays
+#define BINDING_WF_HITS					5		// hit of each ray of the queue being extended
+#define BINDING_WF_RNG					6		// random state per pixel, kept across samples
+#define BINDING_WF_COUNTERS				7
+#define BINDING_WF_BINS					8
+
+// uints of the counters buffer
+#define WF_COUNTER_QUEUE0				0		// live rays of queue 0
+#define WF_COUNTER_QUEUE1				1		// live rays of queue 1
+#define WF_COUNTER_RAYS_TRACED			2
+#define WF_COUNTER_COUNT				4
+
+// origin.w: pixel index, direction.w: unused, throughput.w: unused
+#define WAVEFRONT_RAY_SIZE				48
+#define WAVEFRONT_HIT_SIZE				16		// t, u, v, primitive (~0u: miss)
+
+#ifdef __cplusplus
+#include <cstdint>
+namespace NRC
+{
+	struct WavefrontConstants
+	{
+		uint32_t	sampleIndex;
+		uint32_t	segment;
+		uint32_t	inQueue;
+		uint32_t	outQueue;
+		uint32_t	sortPass;
+		uint32_t	padding[3];
+		float		sceneMin[4];
+		float		cellScale[4];		// WAVEFRONT_SORT_GRID / scene extent
+	};
+}
+#else
+struct WavefrontRay
+{
+	vec4 origin;
+	vec4 direction;
+	vec4 throughput;
+};
+
+layout(push_constant) uniform WavefrontConstants
+{
+	uint sampleIndex;
+	uint segment;
+	uint inQueue;
+	uint outQueue;
+	uint sortPass;
+	uint padding0;
+	uint padding1;
+	uint padding2;
+	vec4 sceneMin;
+	vec4 cellScale;
+} constants;
+#endif
+
+#endif
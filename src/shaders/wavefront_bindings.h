@@ -0,0 +1,45 @@
+#ifndef NRC_WAVEFRONT_BINDINGS_H
+#define NRC_WAVEFRONT_BINDINGS_H
+
+// descriptor set of the wavefront kernels (include wavefront.h first)
+
+layout(binding = BINDING_IMAGEDATA, set = 0, scalar) buffer storageBuffer
+{
+	vec3 imageData[];
+};
+layout(binding = BINDING_TLAS, set = 0) uniform accelerationStructureEXT tlas;
+layout(binding = BINDING_VERTICES, set = 0, scalar) buffer Vertices
+{
+	vec3 vertices[];
+};
+layout(binding = BINDING_INDICES, set = 0, scalar) buffer Indices
+{
+	uint indices[];
+};
+layout(binding = BINDING_WF_RAYS, set = 0, scalar) buffer Rays
+{
+	WavefrontRay rays[];
+};
+layout(binding = BINDING_WF_HITS, set = 0, scalar) buffer Hits
+{
+	vec4 hits[];
+};
+layout(binding = BINDING_WF_RNG, set = 0, scalar) buffer RngStates
+{
+	uint rngStates[];
+};
+layout(binding = BINDING_WF_COUNTERS, set = 0, scalar) buffer Counters
+{
+	uint counters[];
+};
+layout(binding = BINDING_WF_BINS, set = 0, scalar) buffer Bins
+{
+	uint bins[];
+};
+
+uint queueBase(uint queue)
+{
+	return queue * WAVEFRONT_QUEUE_CAPACITY;
+}
+
+#endif
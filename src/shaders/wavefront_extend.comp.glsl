@@ -0,0 +1,41 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.h"
+#include "wavefront_bindings.h"
+
+layout(local_size_x = WAVEFRONT_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// closest hit of every ray of constants.inQueue
+void main()
+{
+	const uint rayCount = counters[WF_COUNTER_QUEUE0 + constants.inQueue];
+	const uint groupBase = gl_WorkGroupID.x * WAVEFRONT_WORKGROUP_SIZE;
+	if (gl_LocalInvocationIndex == 0 && groupBase < rayCount)
+	{
+		atomicAdd(counters[WF_COUNTER_RAYS_TRACED], min(uint(WAVEFRONT_WORKGROUP_SIZE), rayCount - groupBase));
+	}
+	const uint rayIndex = gl_GlobalInvocationID.x;
+	if (rayIndex >= rayCount)
+	{
+		return;
+	}
+
+	const WavefrontRay ray = rays[queueBase(constants.inQueue) + rayIndex];
+	rayQueryEXT rayQuery;
+	rayQueryInitializeEXT(rayQuery, tlas, gl_RayFlagsOpaqueEXT, 0xFF, ray.origin.xyz, 0.0, ray.direction.xyz, 10000.0);
+	while (rayQueryProceedEXT(rayQuery))
+	{
+	}
+
+	vec4 hit = vec4(0.0, 0.0, 0.0, uintBitsToFloat(~0u));
+	if (rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionTriangleEXT)
+	{
+		hit.x	= rayQueryGetIntersectionTEXT(rayQuery, true);
+		hit.yz	= rayQueryGetIntersectionBarycentricsEXT(rayQuery, true);
+		hit.w	= uintBitsToFloat(uint(rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, true)));
+	}
+	hits[rayIndex] = hit;
+}
@@ -0,0 +1,36 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.h"
+#include "sampling.h"
+#include "wavefront_bindings.h"
+
+layout(local_size_x = WAVEFRONT_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// one camera ray per pixel into constants.inQueue, in pixel order
+void main()
+{
+	const uvec2 resolution = uvec2(RENDER_WIDTH, RENDER_HEIGHT);
+	const uint	pixelIndex = gl_GlobalInvocationID.x;
+	if (pixelIndex == 0)
+	{
+		counters[WF_COUNTER_QUEUE0 + constants.inQueue] = resolution.x * resolution.y;
+	}
+	if (pixelIndex >= resolution.x * resolution.y)
+	{
+		return;
+	}
+
+	// same random sequence per pixel as raytracer.comp.glsl, continued across samples
+	uint rngState = constants.sampleIndex == 0 ? pixelIndex : rngStates[pixelIndex];
+	const uvec2 pixel = uvec2(pixelIndex % resolution.x, pixelIndex / resolution.x);
+
+	WavefrontRay ray;
+	ray.origin		= vec4(CAMERA_ORIGIN_X, CAMERA_ORIGIN_Y, CAMERA_ORIGIN_Z, uintBitsToFloat(pixelIndex));
+	ray.direction	= vec4(cameraRayDirection(pixel, resolution, rngState), 0.0);
+	ray.throughput	= vec4(1.0);
+	rays[queueBase(constants.inQueue) + pixelIndex] = ray;
+	rngStates[pixelIndex] = rngState;
+}
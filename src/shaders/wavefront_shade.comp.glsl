@@ -0,0 +1,53 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.h"
+#include "sampling.h"
+#include "wavefront_bindings.h"
+
+layout(local_size_x = WAVEFRONT_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+// sky on a miss, otherwise the next diffuse segment is appended to constants.outQueue
+void main()
+{
+	const uint rayIndex = gl_GlobalInvocationID.x;
+	if (rayIndex >= counters[WF_COUNTER_QUEUE0 + constants.inQueue])
+	{
+		return;
+	}
+
+	WavefrontRay	ray			= rays[queueBase(constants.inQueue) + rayIndex];
+	const vec4		hit			= hits[rayIndex];
+	const uint		pixelIndex	= floatBitsToUint(ray.origin.w);
+	const uint		primitiveID = floatBitsToUint(hit.w);
+	if (primitiveID == ~0u)
+	{
+		// escaped: the sky is the only light source; one path per pixel at a time, so no atomics
+		imageData[pixelIndex] += ray.throughput.xyz * skyColor(ray.direction.xyz) / float(NUM_SAMPLES);
+		return;
+	}
+
+	const vec3 v0 = vertices[indices[3 * primitiveID + 0]];
+	const vec3 v1 = vertices[indices[3 * primitiveID + 1]];
+	const vec3 v2 = vertices[indices[3 * primitiveID + 2]];
+	const vec3 worldPosition = v0 * (1.0 - hit.y - hit.z) + v1 * hit.y + v2 * hit.z;
+	vec3 worldNormal = normalize(cross(v1 - v0, v2 - v0));
+	if (dot(ray.direction.xyz, worldNormal) > 0.0)
+	{
+		worldNormal = -worldNormal;
+	}
+
+	uint rngState = rngStates[pixelIndex];
+	ray.throughput.xyz	*= SURFACE_ALBEDO;
+	ray.origin.xyz		= worldPosition + 0.0001 * worldNormal;
+	ray.direction.xyz	= diffuseReflection(worldNormal, rngState);
+	rngStates[pixelIndex] = rngState;
+
+	if (constants.segment + 1 < NUM_TRACED_SEGMENTS)
+	{
+		const uint slot = atomicAdd(counters[WF_COUNTER_QUEUE0 + constants.outQueue], 1u);
+		rays[queueBase(constants.outQueue) + slot] = ray;
+	}
+}
@@ -0,0 +1,81 @@
+#version 460
+#extension GL_EXT_scalar_block_layout : require
+#extension GL_EXT_ray_query : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "wavefront.h"
+#include "wavefront_bindings.h"
+
+layout(local_size_x = WAVEFRONT_WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+shared uint partialSums[WAVEFRONT_WORKGROUP_SIZE];
+
+uint expandBits3(uint v)
+{
+	v = (v | (v << 8)) & 0x0300F00Fu;
+	v = (v | (v << 4)) & 0x030C30C3u;
+	v = (v | (v << 2)) & 0x09249249u;
+	return v;
+}
+
+// Morton index of the origin cell, then the direction octant (same order as the CPU backend)
+uint binKey(WavefrontRay ray)
+{
+	const uvec3 cell	= uvec3(clamp((ray.origin.xyz - constants.sceneMin.xyz) * constants.cellScale.xyz,
+									  vec3(0.0), vec3(WAVEFRONT_SORT_GRID - 1)));
+	const uvec3 octant	= uvec3(lessThan(ray.direction.xyz, vec3(0.0)));
+	const uint	morton	= expandBits3(cell.x) | (expandBits3(cell.y) << 1) | (expandBits3(cell.z) << 2);
+	return morton * 8 + (octant.x | (octant.y << 1) | (octant.z << 2));
+}
+
+// counting sort of constants.inQueue into constants.outQueue, one pass per dispatch
+void main()
+{
+	const uint rayCount = counters[WF_COUNTER_QUEUE0 + constants.inQueue];
+	const uint rayIndex = gl_GlobalInvocationID.x;
+
+	if (constants.sortPass == WAVEFRONT_SORT_COUNT)
+	{
+		if (rayIndex < rayCount)
+		{
+			atomicAdd(bins[binKey(rays[queueBase(constants.inQueue) + rayIndex])], 1u);
+		}
+	}
+	else if (constants.sortPass == WAVEFRONT_SORT_SCAN)
+	{
+		// single workgroup: every thread owns WAVEFRONT_SORT_BINS_PER_THREAD consecutive bins
+		const uint	first	= gl_LocalInvocationIndex * WAVEFRONT_SORT_BINS_PER_THREAD;
+		uint		sum		= 0;
+		for (uint i = 0; i < WAVEFRONT_SORT_BINS_PER_THREAD; i++)
+		{
+			sum += bins[first + i];
+		}
+		partialSums[gl_LocalInvocationIndex] = sum;
+		barrier();
+		// Hillis-Steele inclusive scan of the per-thread sums
+		for (uint offset = 1; offset < WAVEFRONT_WORKGROUP_SIZE; offset *= 2)
+		{
+			const uint addend = gl_LocalInvocationIndex >= offset ? partialSums[gl_LocalInvocationIndex - offset] : 0;
+			barrier();
+			partialSums[gl_LocalInvocationIndex] += addend;
+			barrier();
+		}
+		uint running = partialSums[gl_LocalInvocationIndex] - sum;
+		for (uint i = 0; i < WAVEFRONT_SORT_BINS_PER_THREAD; i++)
+		{
+			const uint count = bins[first + i];
+			bins[first + i] = running;
+			running += count;
+		}
+		if (gl_LocalInvocationIndex == 0)
+		{
+			counters[WF_COUNTER_QUEUE0 + constants.outQueue] = rayCount;
+		}
+	}
+	else if (rayIndex < rayCount)
+	{
+		const WavefrontRay ray = rays[queueBase(constants.inQueue) + rayIndex];
+		const uint slot = atomicAdd(bins[binKey(ray)], 1u);
+		rays[queueBase(constants.outQueue) + slot] = ray;
+	}
+}
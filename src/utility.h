@@ -57,15 +57,72 @@ namespace NRC
 		vkFreeCommandBuffers(device, cmdPool, 1, &cmdBuffer);
 	}
 
+	// a timeline semaphore, starting at value 0
+	static VkSemaphore createTimelineSemaphore(VkDevice device)
+	{
+		auto semaphoreTypeCreateInfo = nvvk::make<VkSemaphoreTypeCreateInfo>();
+		semaphoreTypeCreateInfo.semaphoreType	= VK_SEMAPHORE_TYPE_TIMELINE;
+		semaphoreTypeCreateInfo.initialValue	= 0;
+		auto semaphoreCreateInfo = nvvk::make<VkSemaphoreCreateInfo>();
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+		VkSemaphore semaphore;
+		NVVK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+		return semaphore;
+	}
+
+	// ends and submits a command record without waiting for it: it starts once waitSemaphore reaches waitValue (at waitStage)
+	// and sets signalSemaphore to signalValue when done, either timeline semaphore may be VK_NULL_HANDLE. The caller frees
+	// the command buffer once the signal is seen.
+	static void submitTimelineCommandRecord(VkQueue queue, VkCommandBuffer cmdBuffer, VkSemaphore waitSemaphore, uint64_t waitValue,
+											VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore, uint64_t signalValue)
+	{
+		NVVK_CHECK(vkEndCommandBuffer(cmdBuffer));
+
+		auto timelineSubmitInfo = nvvk::make<VkTimelineSemaphoreSubmitInfo>();
+		timelineSubmitInfo.waitSemaphoreValueCount		= waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+		timelineSubmitInfo.pWaitSemaphoreValues			= &waitValue;
+		timelineSubmitInfo.signalSemaphoreValueCount	= signalSemaphore != VK_NULL_HANDLE ? 1 : 0;
+		timelineSubmitInfo.pSignalSemaphoreValues		= &signalValue;
+
+		auto submitInfo = nvvk::make<VkSubmitInfo>();
+		submitInfo.pNext				= &timelineSubmitInfo;
+		submitInfo.waitSemaphoreCount	= timelineSubmitInfo.waitSemaphoreValueCount;
+		submitInfo.pWaitSemaphores		= &waitSemaphore;
+		submitInfo.pWaitDstStageMask	= &waitStage;
+		submitInfo.commandBufferCount	= 1;
+		submitInfo.pCommandBuffers		= &cmdBuffer;
+		submitInfo.signalSemaphoreCount	= timelineSubmitInfo.signalSemaphoreValueCount;
+		submitInfo.pSignalSemaphores	= &signalSemaphore;
+		NVVK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
+
+	// blocks the host until semaphore reaches value
+	static void waitTimelineSemaphore(VkDevice device, VkSemaphore semaphore, uint64_t value)
+	{
+		auto waitInfo = nvvk::make<VkSemaphoreWaitInfo>();
+		waitInfo.semaphoreCount	= 1;
+		waitInfo.pSemaphores	= &semaphore;
+		waitInfo.pValues		= &value;
+		NVVK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+	}
+
+	// queueFamilies: with two or more distinct families the buffer is shared between them (VK_SHARING_MODE_CONCURRENT)
 	static void createBuffer(const nvvk::Context& _context, VkCommandBuffer& _cmdBuffer, 
 								 const size_t _size,  
 								 VkBuffer* buffer, VkBufferUsageFlags _bufferUsages, 
-								 VkDeviceMemory* bufferMemory, VkMemoryPropertyFlags _memUsages)
+								 VkDeviceMemory* bufferMemory, VkMemoryPropertyFlags _memUsages,
+								 const std::vector<uint32_t>& queueFamilies = {})
 	{
 		// Create Buffer
 		VkBufferCreateInfo bufferCreateInfo = nvvk::make<VkBufferCreateInfo>();
 		bufferCreateInfo.size = _size;
 		bufferCreateInfo.usage = _bufferUsages;
+		if (queueFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode			= VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount	= uint32_t(queueFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices	= queueFamilies.data();
+		}
 		NVVK_CHECK(vkCreateBuffer(_context.m_device, &bufferCreateInfo, nullptr, buffer));
 
 		// Memory Requirement
@@ -0,0 +1,314 @@
+#include <wavefront_renderer.h>
+
+#include <chrono>
+
+namespace NRC
+{
+	// all kernels run one thread per queue slot
+	static const uint32_t queueGroupCount = (WAVEFRONT_QUEUE_CAPACITY + WAVEFRONT_WORKGROUP_SIZE - 1) / WAVEFRONT_WORKGROUP_SIZE;
+
+	static const char* kernelFiles[] = {
+		"shaders/wavefront_generate.comp.glsl.spv",
+		"shaders/wavefront_extend.comp.glsl.spv",
+		"shaders/wavefront_shade.comp.glsl.spv",
+		"shaders/wavefront_sort.comp.glsl.spv",
+	};
+
+	// make the writes of one dispatch (or transfer) visible to the next dispatch
+	static void computeBarrier(VkCommandBuffer cmdBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	static void shaderToShaderBarrier(VkCommandBuffer cmdBuffer)
+	{
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	static void transferToShaderBarrier(VkCommandBuffer cmdBuffer)
+	{
+		computeBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+
+	// the fill of a counter must not overtake the dispatches still reading it
+	static void shaderToTransferBarrier(VkCommandBuffer cmdBuffer)
+	{
+		auto barrier = nvvk::make<VkMemoryBarrier>();
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+
+	// -----------------
+	// WavefrontRenderer
+	// -----------------
+	void WavefrontRenderer::init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, VkAccelerationStructureKHR tlas,
+								 VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+								 VkBuffer indexBuffer, VkDeviceSize indexBytes, const float sceneMin[3], const float sceneMax[3])
+	{
+		m_context		= &context;
+		m_imageBuffer	= imageBuffer;
+		m_imageBytes	= imageBytes;
+		for (int a = 0; a < 3; a++)
+		{
+			const float extent = sceneMax[a] - sceneMin[a];
+			m_sceneMin[a]	= sceneMin[a];
+			m_cellScale[a]	= extent > 0.0f ? float(WAVEFRONT_SORT_GRID) / extent : 0.0f;
+		}
+		createBuffers(imageBuffer, imageBytes, vertexBuffer, vertexBytes, indexBuffer, indexBytes, tlas);
+		createPipelines(searchPaths);
+	}
+
+	void WavefrontRenderer::createBuffers(VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+										  VkBuffer indexBuffer, VkDeviceSize indexBytes, VkAccelerationStructureKHR tlas)
+	{
+		const VkDevice device = m_context->m_device;
+
+		// ----------------
+		// Create Resources
+		// ----------------
+		const VkDeviceSize bufferSizes[5] = {
+			VkDeviceSize(2) * WAVEFRONT_QUEUE_CAPACITY * WAVEFRONT_RAY_SIZE,	// BINDING_WF_RAYS
+			VkDeviceSize(WAVEFRONT_QUEUE_CAPACITY) * WAVEFRONT_HIT_SIZE,		// BINDING_WF_HITS
+			VkDeviceSize(WAVEFRONT_QUEUE_CAPACITY) * sizeof(uint32_t),			// BINDING_WF_RNG
+			VkDeviceSize(WF_COUNTER_COUNT) * sizeof(uint32_t),					// BINDING_WF_COUNTERS
+			VkDeviceSize(WAVEFRONT_SORT_BINS) * sizeof(uint32_t),				// BINDING_WF_BINS
+		};
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		// createBuffer takes a command buffer for symmetry with the staged uploads, it records nothing
+		VkCommandBuffer unusedCmdBuffer = VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			// the counters are read back after every render (rays traced)
+			const bool hostVisible = BINDING_WF_RAYS + i == BINDING_WF_COUNTERS;
+			createBuffer(*m_context, unusedCmdBuffer, bufferSizes[i], &m_buffers[i], usage, &m_memories[i],
+						 hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+									 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		}
+		void* counters;
+		NVVK_CHECK(vkMapMemory(device, m_memories[BINDING_WF_COUNTERS - BINDING_WF_RAYS], 0, VK_WHOLE_SIZE, 0, &counters));
+		m_counters = reinterpret_cast<uint32_t*>(counters);
+
+
+		// -----------------------------------------
+		// Create Descriptor Set bindings and layout
+		// -----------------------------------------
+		// the four bindings of raytracer.comp.glsl followed by the queue buffers (see shaders/wavefront.h)
+		std::array<VkDescriptorSetLayoutBinding, BINDING_WF_BINS + 1> descriptorSetBindings{};
+		for (uint32_t i = 0; i < uint32_t(descriptorSetBindings.size()); i++)
+		{
+			descriptorSetBindings[i].binding			= i;
+			descriptorSetBindings[i].descriptorCount	= 1;
+			descriptorSetBindings[i].descriptorType		= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorSetBindings[i].stageFlags			= VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		descriptorSetBindings[BINDING_TLAS].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = nvvk::make<VkDescriptorSetLayoutCreateInfo>();
+		descriptorSetLayoutCreateInfo.bindingCount	= uint32_t(descriptorSetBindings.size());
+		descriptorSetLayoutCreateInfo.pBindings		= descriptorSetBindings.data();
+		NVVK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout));
+
+		std::array<VkDescriptorPoolSize, 2> descriptorPoolSizes{};
+		descriptorPoolSizes[0].descriptorCount	= uint32_t(descriptorSetBindings.size()) - 1;
+		descriptorPoolSizes[0].type				= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorPoolSizes[1].descriptorCount	= 1;
+		descriptorPoolSizes[1].type				= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = nvvk::make<VkDescriptorPoolCreateInfo>();
+		descriptorPoolCreateInfo.maxSets		= 1;
+		descriptorPoolCreateInfo.poolSizeCount	= uint32_t(descriptorPoolSizes.size());
+		descriptorPoolCreateInfo.pPoolSizes		= descriptorPoolSizes.data();
+		NVVK_CHECK(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool));
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = nvvk::make<VkDescriptorSetAllocateInfo>();
+		descriptorSetAllocateInfo.descriptorPool		= m_descriptorPool;
+		descriptorSetAllocateInfo.descriptorSetCount	= 1;
+		descriptorSetAllocateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		NVVK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &m_descriptorSet));
+
+
+		// --------------------------------
+		// Write and update descriptor sets
+		// --------------------------------
+		std::array<VkDescriptorBufferInfo, BINDING_WF_BINS + 1> descriptorBufferInfos{};
+		descriptorBufferInfos[BINDING_IMAGEDATA]	= { imageBuffer, 0, imageBytes };
+		descriptorBufferInfos[BINDING_VERTICES]		= { vertexBuffer, 0, vertexBytes };
+		descriptorBufferInfos[BINDING_INDICES]		= { indexBuffer, 0, indexBytes };
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			descriptorBufferInfos[BINDING_WF_RAYS + i] = { m_buffers[i], 0, bufferSizes[i] };
+		}
+
+		auto descriptorAS = nvvk::make<VkWriteDescriptorSetAccelerationStructureKHR>();
+		descriptorAS.accelerationStructureCount = 1;
+		descriptorAS.pAccelerationStructures	= &tlas;
+
+		std::array<VkWriteDescriptorSet, BINDING_WF_BINS + 1> writeDescriptorSets;
+		for (uint32_t i = 0; i < uint32_t(writeDescriptorSets.size()); i++)
+		{
+			writeDescriptorSets[i] = nvvk::make<VkWriteDescriptorSet>();
+			writeDescriptorSets[i].descriptorCount	= 1;
+			writeDescriptorSets[i].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writeDescriptorSets[i].dstArrayElement	= 0;
+			writeDescriptorSets[i].dstBinding		= i;
+			writeDescriptorSets[i].dstSet			= m_descriptorSet;
+			writeDescriptorSets[i].pBufferInfo		= &descriptorBufferInfos[i];
+		}
+		writeDescriptorSets[BINDING_TLAS].descriptorType	= VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		writeDescriptorSets[BINDING_TLAS].pBufferInfo		= nullptr;
+		writeDescriptorSets[BINDING_TLAS].pNext				= &descriptorAS;
+		vkUpdateDescriptorSets(device, uint32_t(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
+	void WavefrontRenderer::createPipelines(const std::vector<std::string>& searchPaths)
+	{
+		const VkDevice device = m_context->m_device;
+
+		// one layout for all kernels: the descriptor set and WavefrontConstants
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags	= VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset		= 0;
+		pushConstantRange.size			= sizeof(WavefrontConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = nvvk::make<VkPipelineLayoutCreateInfo>();
+		pipelineLayoutCreateInfo.setLayoutCount			= 1;
+		pipelineLayoutCreateInfo.pSetLayouts			= &m_descriptorSetLayout;
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges	= &pushConstantRange;
+		NVVK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout));
+
+		for (uint32_t kernel = 0; kernel < KernelCount; kernel++)
+		{
+			VkShaderModule shaderModule = nvvk::createShaderModule(device, nvh::loadFile(kernelFiles[kernel], true, searchPaths));
+
+			VkPipelineShaderStageCreateInfo shaderStageCreateInfo = nvvk::make<VkPipelineShaderStageCreateInfo>();
+			shaderStageCreateInfo.stage		= VK_SHADER_STAGE_COMPUTE_BIT;
+			shaderStageCreateInfo.module	= shaderModule;
+			shaderStageCreateInfo.pName		= "main";
+
+			VkComputePipelineCreateInfo computePipelineCreateInfo = nvvk::make<VkComputePipelineCreateInfo>();
+			computePipelineCreateInfo.layout	= m_pipelineLayout;
+			computePipelineCreateInfo.stage		= shaderStageCreateInfo;
+			NVVK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_pipelines[kernel]));
+			vkDestroyShaderModule(device, shaderModule, nullptr);
+		}
+	}
+
+	void WavefrontRenderer::deinit()
+	{
+		if (m_context == nullptr)
+		{
+			return;
+		}
+		const VkDevice device = m_context->m_device;
+		for (VkPipeline pipeline : m_pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+		vkUnmapMemory(device, m_memories[BINDING_WF_COUNTERS - BINDING_WF_RAYS]);
+		for (uint32_t i = 0; i < uint32_t(m_buffers.size()); i++)
+		{
+			vkDestroyBuffer(device, m_buffers[i], nullptr);
+			vkFreeMemory(device, m_memories[i], nullptr);
+		}
+		*this = WavefrontRenderer();
+	}
+
+	void WavefrontRenderer::dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupCount, const WavefrontConstants& constants) const
+	{
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[kernel]);
+		vkCmdPushConstants(cmdBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(WavefrontConstants), &constants);
+		vkCmdDispatch(cmdBuffer, groupCount, 1, 1);
+	}
+
+	WavefrontRenderStats WavefrontRenderer::render(VkCommandPool cmdPool, const WavefrontRenderSettings& settings)
+	{
+		const VkBuffer counterBuffer	= m_buffers[BINDING_WF_COUNTERS - BINDING_WF_RAYS];
+		const VkBuffer binBuffer		= m_buffers[BINDING_WF_BINS - BINDING_WF_RAYS];
+
+		WavefrontConstants constants{};
+		for (int a = 0; a < 3; a++)
+		{
+			constants.sceneMin[a]	= m_sceneMin[a];
+			constants.cellScale[a]	= m_cellScale[a];
+		}
+
+		VkCommandBuffer cmdBuffer = beginSingleTimeCommandRecord(m_context->m_device, cmdPool);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+		// shade adds into the image, the counters start from zero
+		vkCmdFillBuffer(cmdBuffer, m_imageBuffer, 0, m_imageBytes, 0);
+		vkCmdFillBuffer(cmdBuffer, counterBuffer, 0, VK_WHOLE_SIZE, 0);
+		transferToShaderBarrier(cmdBuffer);
+
+		// The queue lengths only exist on the device, so every kernel is dispatched over the full
+		// capacity and threads past the live count return at once. Paths are at most
+		// NUM_TRACED_SEGMENTS long and most of them end within a few bounces.
+		for (uint32_t sampleIndex = 0; sampleIndex < NUM_SAMPLES; sampleIndex++)
+		{
+			uint32_t queue = 0;
+			constants.sampleIndex	= sampleIndex;
+			constants.segment		= 0;
+			constants.inQueue		= queue;
+			dispatch(cmdBuffer, KernelGenerate, queueGroupCount, constants);
+			shaderToShaderBarrier(cmdBuffer);
+
+			for (uint32_t segment = 0; segment < NUM_TRACED_SEGMENTS; segment++)
+			{
+				constants.segment = segment;
+
+				// camera rays are coherent in pixel order already, only the bounces are binned
+				if (settings.sortRays && segment > 0)
+				{
+					vkCmdFillBuffer(cmdBuffer, binBuffer, 0, VK_WHOLE_SIZE, 0);
+					transferToShaderBarrier(cmdBuffer);
+					constants.inQueue	= queue;
+					constants.outQueue	= 1 - queue;
+					constants.sortPass	= WAVEFRONT_SORT_COUNT;
+					dispatch(cmdBuffer, KernelSort, queueGroupCount, constants);
+					shaderToShaderBarrier(cmdBuffer);
+					constants.sortPass	= WAVEFRONT_SORT_SCAN;
+					dispatch(cmdBuffer, KernelSort, 1, constants);
+					shaderToShaderBarrier(cmdBuffer);
+					constants.sortPass	= WAVEFRONT_SORT_SCATTER;
+					dispatch(cmdBuffer, KernelSort, queueGroupCount, constants);
+					shaderToShaderBarrier(cmdBuffer);
+					queue = 1 - queue;
+				}
+
+				constants.inQueue	= queue;
+				constants.outQueue	= 1 - queue;
+				dispatch(cmdBuffer, KernelExtend, queueGroupCount, constants);
+
+				// shade appends to the other queue, which starts empty
+				shaderToTransferBarrier(cmdBuffer);
+				vkCmdFillBuffer(cmdBuffer, counterBuffer, (WF_COUNTER_QUEUE0 + constants.outQueue) * sizeof(uint32_t), sizeof(uint32_t), 0);
+				transferToShaderBarrier(cmdBuffer);
+				dispatch(cmdBuffer, KernelShade, queueGroupCount, constants);
+				shaderToShaderBarrier(cmdBuffer);
+				queue = 1 - queue;
+			}
+		}
+
+		auto hostBarrier = nvvk::make<VkMemoryBarrier>();
+		hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		endSubmitSingleTimeCommandRecord(m_context->m_device, m_context->m_queueGCT, cmdPool, cmdBuffer);
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		WavefrontRenderStats stats;
+		stats.seconds		= std::chrono::duration<double>(end - start).count();
+		stats.raysTraced	= m_counters[WF_COUNTER_RAYS_TRACED];
+		return stats;
+	}
+}
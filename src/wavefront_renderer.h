@@ -0,0 +1,79 @@
+# pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <utility.h>
+#include "shaders/wavefront.h"
+
+namespace NRC
+{
+	struct WavefrontRenderSettings
+	{
+		bool sortRays = false;		// bin every bounce by origin cell and direction octant before it is traced
+	};
+
+	struct WavefrontRenderStats
+	{
+		double		seconds		= 0.0;
+		uint64_t	raysTraced	= 0;
+		double raysPerSecond() const { return seconds > 0.0 ? double(raysTraced) / seconds : 0.0; }
+	};
+
+	// ----------------------------------------------------------------
+	// Wavefront variant of raytracer.comp.glsl.
+	//
+	// Instead of one thread following a path to the end, every sample
+	// is split into kernels over a queue of live rays: generate writes
+	// the camera rays, then per segment extend finds the closest hits
+	// and shade accumulates the sky or appends the bounce to the other
+	// of the two queues. With sortRays the queue is counting-sorted by
+	// the same key as CpuRenderer::binRays before each bounce is
+	// extended, so a subgroup traces rays that start close together and
+	// head the same way. Renders into the image buffer of the
+	// megakernel, with the same random sequence per pixel.
+	// ----------------------------------------------------------------
+	class WavefrontRenderer
+	{
+	public:
+		// searchPaths locate shaders/wavefront_*.comp.glsl.spv; sceneMin/sceneMax bound the vertices
+		void init(const nvvk::Context& context, const std::vector<std::string>& searchPaths, VkAccelerationStructureKHR tlas,
+				  VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+				  VkBuffer indexBuffer, VkDeviceSize indexBytes, const float sceneMin[3], const float sceneMax[3]);
+		void deinit();
+
+		// all NUM_SAMPLES samples in one submission, waits for the queue
+		WavefrontRenderStats render(VkCommandPool cmdPool, const WavefrontRenderSettings& settings);
+
+	private:
+		enum Kernel
+		{
+			KernelGenerate,
+			KernelExtend,
+			KernelShade,
+			KernelSort,
+			KernelCount
+		};
+
+		void createBuffers(VkBuffer imageBuffer, VkDeviceSize imageBytes, VkBuffer vertexBuffer, VkDeviceSize vertexBytes,
+						   VkBuffer indexBuffer, VkDeviceSize indexBytes, VkAccelerationStructureKHR tlas);
+		void createPipelines(const std::vector<std::string>& searchPaths);
+		void dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t groupCount, const WavefrontConstants& constants) const;
+
+		const nvvk::Context*						m_context				= nullptr;
+		VkDescriptorSetLayout						m_descriptorSetLayout	= VK_NULL_HANDLE;
+		VkDescriptorPool							m_descriptorPool		= VK_NULL_HANDLE;
+		VkDescriptorSet								m_descriptorSet			= VK_NULL_HANDLE;
+		VkPipelineLayout							m_pipelineLayout		= VK_NULL_HANDLE;
+		std::array<VkPipeline, KernelCount>			m_pipelines{};
+
+		// queues, hits, random states, counters and sort bins (BINDING_WF_*)
+		std::array<VkBuffer, 5>						m_buffers{};
+		std::array<VkDeviceMemory, 5>				m_memories{};
+		uint32_t*									m_counters				= nullptr;		// mapped, host-visible
+		VkBuffer									m_imageBuffer			= VK_NULL_HANDLE;
+		VkDeviceSize								m_imageBytes			= 0;
+		float										m_sceneMin[3]			= {};
+		float										m_cellScale[3]			= {};
+	};
+}